@@ -28,6 +28,11 @@
  * property. Setting this property to a value N > 1 will only decode every 
  * Nth frame.
  *
+ * DV frames are coded independently of each other, so with the
+ * #GstDVDec:n-threads property set to a value N > 1 up to N frames are
+ * decoded at the same time. The decoded frames are still pushed downstream
+ * in order.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -70,6 +75,8 @@
 
 #define DV_DEFAULT_QUALITY DV_QUALITY_BEST
 #define DV_DEFAULT_DECODE_NTH 1
+#define DV_DEFAULT_N_THREADS 1
+#define DV_MAX_N_THREADS 64
 
 GST_DEBUG_CATEGORY_STATIC (dvdec_debug);
 #define GST_CAT_DEFAULT dvdec_debug
@@ -80,7 +87,8 @@ enum
   PROP_CLAMP_LUMA,
   PROP_CLAMP_CHROMA,
   PROP_QUALITY,
-  PROP_DECODE_NTH
+  PROP_DECODE_NTH,
+  PROP_N_THREADS
 };
 
 const gint qualities[] = {
@@ -108,6 +116,17 @@ static GstStaticPadTemplate src_temp = GST_STATIC_PAD_TEMPLATE ("src",
     );
 
 #define GST_TYPE_DVDEC_QUALITY (gst_dvdec_quality_get_type())
+/* a frame handed to the worker threads */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstMapInfo inmap;
+  GstBuffer *outbuf;
+  GstVideoFrame frame;
+  gint bpp;
+  gboolean decoded;
+} GstDVDecFrame;
+
 static GType
 gst_dvdec_quality_get_type (void)
 {
@@ -144,6 +163,7 @@ static void gst_dvdec_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_dvdec_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
+static void gst_dvdec_finalize (GObject * object);
 
 static void
 gst_dvdec_class_init (GstDVDecClass * klass)
@@ -156,6 +176,7 @@ gst_dvdec_class_init (GstDVDecClass * klass)
 
   gobject_class->set_property = gst_dvdec_set_property;
   gobject_class->get_property = gst_dvdec_get_property;
+  gobject_class->finalize = gst_dvdec_finalize;
 
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_CLAMP_LUMA,
       g_param_spec_boolean ("clamp-luma", "Clamp luma", "Clamp luma",
@@ -171,6 +192,19 @@ gst_dvdec_class_init (GstDVDecClass * klass)
       g_param_spec_int ("drop-factor", "Drop Factor", "Only decode Nth frame",
           1, G_MAXINT, DV_DEFAULT_DECODE_NTH,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstDVDec:n-threads:
+   *
+   * Number of frames decoded in parallel. Takes effect on the next
+   * READY to PAUSED state change.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Threads",
+          "Maximum number of threads to use (0 = number of CPUs)", 0,
+          DV_MAX_N_THREADS, DV_DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_dvdec_change_state);
 
@@ -205,6 +239,138 @@ gst_dvdec_init (GstDVDec * dvdec)
   dvdec->clamp_luma = FALSE;
   dvdec->clamp_chroma = FALSE;
   dvdec->quality = DV_DEFAULT_QUALITY;
+  dvdec->n_threads = DV_DEFAULT_N_THREADS;
+
+  g_queue_init (&dvdec->pending);
+  g_mutex_init (&dvdec->lock);
+  g_cond_init (&dvdec->cond);
+}
+
+static void
+gst_dvdec_finalize (GObject * object)
+{
+  GstDVDec *dvdec = GST_DVDEC (object);
+
+  g_mutex_clear (&dvdec->lock);
+  g_cond_clear (&dvdec->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_dvdec_decode_frame (dv_decoder_t * decoder, guint8 * inframe,
+    GstVideoFrame * frame, gint bpp)
+{
+  guint8 *outframe_ptrs[3];
+  gint outframe_pitches[3];
+
+  outframe_ptrs[0] = GST_VIDEO_FRAME_COMP_DATA (frame, 0);
+  outframe_pitches[0] = GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+
+  /* the rest only matters for YUY2 */
+  if (bpp < 3) {
+    outframe_ptrs[1] = GST_VIDEO_FRAME_COMP_DATA (frame, 1);
+    outframe_ptrs[2] = GST_VIDEO_FRAME_COMP_DATA (frame, 2);
+
+    outframe_pitches[1] = GST_VIDEO_FRAME_COMP_STRIDE (frame, 1);
+    outframe_pitches[2] = GST_VIDEO_FRAME_COMP_STRIDE (frame, 2);
+  }
+
+  dv_decode_full_frame (decoder, inframe,
+      e_dv_color_yuv, outframe_ptrs, outframe_pitches);
+}
+
+/* runs in a worker thread, with a decoder of its own */
+static void
+gst_dvdec_worker_func (GstDVDecFrame * frame, GstDVDec * dvdec)
+{
+  dv_decoder_t *decoder;
+
+  decoder = g_async_queue_pop (dvdec->decoders);
+  dv_parse_header (decoder, frame->inmap.data);
+  gst_dvdec_decode_frame (decoder, frame->inmap.data, &frame->frame,
+      frame->bpp);
+  g_async_queue_push (dvdec->decoders, decoder);
+
+  g_mutex_lock (&dvdec->lock);
+  frame->decoded = TRUE;
+  g_cond_broadcast (&dvdec->cond);
+  g_mutex_unlock (&dvdec->lock);
+}
+
+/* waits for @frame to be decoded, frees it and returns the output buffer */
+static GstBuffer *
+gst_dvdec_finish_frame (GstDVDec * dvdec, GstDVDecFrame * frame)
+{
+  GstBuffer *outbuf = frame->outbuf;
+
+  g_mutex_lock (&dvdec->lock);
+  while (!frame->decoded)
+    g_cond_wait (&dvdec->cond, &dvdec->lock);
+  g_mutex_unlock (&dvdec->lock);
+
+  gst_video_frame_unmap (&frame->frame);
+  gst_buffer_unmap (frame->inbuf, &frame->inmap);
+  gst_buffer_unref (frame->inbuf);
+  g_slice_free (GstDVDecFrame, frame);
+
+  return outbuf;
+}
+
+static void
+gst_dvdec_discard_pending (GstDVDec * dvdec)
+{
+  GstDVDecFrame *frame;
+
+  while ((frame = g_queue_pop_head (&dvdec->pending)))
+    gst_buffer_unref (gst_dvdec_finish_frame (dvdec, frame));
+}
+
+/* pushes the oldest frames until at most @max_pending are left in flight */
+static GstFlowReturn
+gst_dvdec_push_pending (GstDVDec * dvdec, guint max_pending)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  while (dvdec->pending.length > max_pending) {
+    GstBuffer *outbuf;
+
+    outbuf = gst_dvdec_finish_frame (dvdec, g_queue_pop_head (&dvdec->pending));
+    ret = gst_pad_push (dvdec->srcpad, outbuf);
+    if (G_UNLIKELY (ret != GST_FLOW_OK)) {
+      GST_DEBUG_OBJECT (dvdec, "dropping %u pending frames, flow %s",
+          dvdec->pending.length, gst_flow_get_name (ret));
+      gst_dvdec_discard_pending (dvdec);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_dvdec_acquire_buffer (GstDVDec * dvdec, GstBuffer ** outbuf)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstFlowReturn ret;
+
+  if (dvdec->pending.length == 0)
+    return gst_buffer_pool_acquire_buffer (dvdec->pool, outbuf, NULL);
+
+  /* the frames in flight hold output buffers, so don't block on a pool that
+   * ran dry but push those frames out to get buffers back */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  while ((ret = gst_buffer_pool_acquire_buffer (dvdec->pool, outbuf,
+              &params)) == GST_FLOW_EOS) {
+    if (dvdec->pending.length == 0)
+      return gst_buffer_pool_acquire_buffer (dvdec->pool, outbuf, NULL);
+
+    ret = gst_dvdec_push_pending (dvdec, dvdec->pending.length - 1);
+    if (ret != GST_FLOW_OK)
+      break;
+  }
+
+  return ret;
 }
 
 static gboolean
@@ -362,8 +528,14 @@ gst_dvdec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 
   dvdec = GST_DVDEC (parent);
 
+  /* keep serialized events in order with the frames still in flight */
+  if (GST_EVENT_IS_SERIALIZED (event) &&
+      GST_EVENT_TYPE (event) != GST_EVENT_FLUSH_STOP)
+    gst_dvdec_push_pending (dvdec, 0);
+
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_STOP:
+      gst_dvdec_discard_pending (dvdec);
       gst_segment_init (&dvdec->segment, GST_FORMAT_UNDEFINED);
       dvdec->need_segment = FALSE;
       break;
@@ -411,8 +583,6 @@ gst_dvdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
   GstDVDec *dvdec;
   guint8 *inframe;
-  guint8 *outframe_ptrs[3];
-  gint outframe_pitches[3];
   GstMapInfo map;
   GstVideoFrame frame;
   GstBuffer *outbuf;
@@ -459,6 +629,10 @@ gst_dvdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 
   /* renegotiate on change */
   if (PAL != dvdec->PAL || wide != dvdec->wide) {
+    ret = gst_dvdec_push_pending (dvdec, 0);
+    if (G_UNLIKELY (ret != GST_FLOW_OK))
+      goto done;
+
     dvdec->src_negotiated = FALSE;
     dvdec->PAL = PAL;
     dvdec->wide = wide;
@@ -477,6 +651,10 @@ gst_dvdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   if (gst_pad_check_reconfigure (dvdec->srcpad)) {
     GstCaps *caps;
 
+    ret = gst_dvdec_push_pending (dvdec, 0);
+    if (G_UNLIKELY (ret != GST_FLOW_OK))
+      goto done;
+
     caps = gst_pad_get_current_caps (dvdec->srcpad);
     if (!caps)
       goto flushing;
@@ -490,30 +668,10 @@ gst_dvdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
     dvdec->need_segment = FALSE;
   }
 
-  ret = gst_buffer_pool_acquire_buffer (dvdec->pool, &outbuf, NULL);
+  ret = gst_dvdec_acquire_buffer (dvdec, &outbuf);
   if (G_UNLIKELY (ret != GST_FLOW_OK))
     goto no_buffer;
 
-  gst_video_frame_map (&frame, &dvdec->vinfo, outbuf, GST_MAP_WRITE);
-
-  outframe_ptrs[0] = GST_VIDEO_FRAME_COMP_DATA (&frame, 0);
-  outframe_pitches[0] = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
-
-  /* the rest only matters for YUY2 */
-  if (dvdec->bpp < 3) {
-    outframe_ptrs[1] = GST_VIDEO_FRAME_COMP_DATA (&frame, 1);
-    outframe_ptrs[2] = GST_VIDEO_FRAME_COMP_DATA (&frame, 2);
-
-    outframe_pitches[1] = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1);
-    outframe_pitches[2] = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 2);
-  }
-
-  GST_DEBUG_OBJECT (dvdec, "decoding and pushing buffer");
-  dv_decode_full_frame (dvdec->decoder, inframe,
-      e_dv_color_yuv, outframe_ptrs, outframe_pitches);
-
-  gst_video_frame_unmap (&frame);
-
   GST_BUFFER_FLAG_UNSET (outbuf, GST_VIDEO_BUFFER_FLAG_TFF);
 
   GST_BUFFER_OFFSET (outbuf) = GST_BUFFER_OFFSET (buf);
@@ -528,7 +686,31 @@ gst_dvdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
       GST_BUFFER_DURATION (outbuf) = cstop - cstart;
   }
 
-  ret = gst_pad_push (dvdec->srcpad, outbuf);
+  if (dvdec->workers) {
+    GstDVDecFrame *pending = g_slice_new0 (GstDVDecFrame);
+
+    pending->inbuf = gst_buffer_ref (buf);
+    gst_buffer_map (pending->inbuf, &pending->inmap, GST_MAP_READ);
+    pending->outbuf = outbuf;
+    gst_video_frame_map (&pending->frame, &dvdec->vinfo, outbuf,
+        GST_MAP_WRITE);
+    pending->bpp = dvdec->bpp;
+
+    GST_DEBUG_OBJECT (dvdec, "queueing buffer for decoding");
+    g_queue_push_tail (&dvdec->pending, pending);
+    g_thread_pool_push (dvdec->workers, pending, NULL);
+
+    ret = gst_dvdec_push_pending (dvdec, dvdec->max_pending);
+  } else {
+    gst_video_frame_map (&frame, &dvdec->vinfo, outbuf, GST_MAP_WRITE);
+
+    GST_DEBUG_OBJECT (dvdec, "decoding and pushing buffer");
+    gst_dvdec_decode_frame (dvdec->decoder, inframe, &frame, dvdec->bpp);
+
+    gst_video_frame_unmap (&frame);
+
+    ret = gst_pad_push (dvdec->srcpad, outbuf);
+  }
 
 skip:
   dvdec->video_offset++;
@@ -583,6 +765,59 @@ dropping:
   }
 }
 
+static void
+gst_dvdec_start_workers (GstDVDec * dvdec)
+{
+  guint i, n_threads;
+
+  GST_OBJECT_LOCK (dvdec);
+  n_threads = dvdec->n_threads;
+  GST_OBJECT_UNLOCK (dvdec);
+
+  if (n_threads == 0)
+    n_threads = MIN (g_get_num_processors (), DV_MAX_N_THREADS);
+  if (n_threads <= 1)
+    return;
+
+  GST_DEBUG_OBJECT (dvdec, "decoding with %u threads", n_threads);
+
+  /* libdv keeps the parsing state in the decoder, so every worker needs its
+   * own. Creating them here also keeps dv_init() out of the workers. */
+  dvdec->decoders = g_async_queue_new ();
+  for (i = 0; i < n_threads; i++) {
+    dv_decoder_t *decoder;
+
+    decoder = dv_decoder_new (0, dvdec->clamp_luma, dvdec->clamp_chroma);
+    decoder->quality = qualities[dvdec->quality];
+    dv_set_error_log (decoder, NULL);
+    g_async_queue_push (dvdec->decoders, decoder);
+  }
+
+  dvdec->workers = g_thread_pool_new ((GFunc) gst_dvdec_worker_func, dvdec,
+      n_threads, FALSE, NULL);
+  /* one more frame per worker waits in the queue so that the workers don't
+   * run dry while the streaming thread pushes */
+  dvdec->max_pending = 2 * n_threads;
+}
+
+static void
+gst_dvdec_stop_workers (GstDVDec * dvdec)
+{
+  dv_decoder_t *decoder;
+
+  if (dvdec->workers == NULL)
+    return;
+
+  g_thread_pool_free (dvdec->workers, FALSE, TRUE);
+  dvdec->workers = NULL;
+  gst_dvdec_discard_pending (dvdec);
+
+  while ((decoder = g_async_queue_try_pop (dvdec->decoders)))
+    dv_decoder_free (decoder);
+  g_async_queue_unref (dvdec->decoders);
+  dvdec->decoders = NULL;
+}
+
 static GstStateChangeReturn
 gst_dvdec_change_state (GstElement * element, GstStateChange transition)
 {
@@ -603,6 +838,7 @@ gst_dvdec_change_state (GstElement * element, GstStateChange transition)
       dvdec->src_negotiated = FALSE;
       dvdec->sink_negotiated = FALSE;
       dvdec->need_segment = FALSE;
+      gst_dvdec_start_workers (dvdec);
       /* 
        * Enable this function call when libdv2 0.100 or higher is more
        * common
@@ -621,6 +857,7 @@ gst_dvdec_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_dvdec_stop_workers (dvdec);
       dv_decoder_free (dvdec->decoder);
       dvdec->decoder = NULL;
       if (dvdec->pool) {
@@ -658,6 +895,11 @@ gst_dvdec_set_property (GObject * object, guint prop_id, const GValue * value,
     case PROP_DECODE_NTH:
       dvdec->drop_factor = g_value_get_int (value);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (dvdec);
+      dvdec->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (dvdec);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -683,6 +925,11 @@ gst_dvdec_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_DECODE_NTH:
       g_value_set_int (value, dvdec->drop_factor);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (dvdec);
+      g_value_set_uint (value, dvdec->n_threads);
+      GST_OBJECT_UNLOCK (dvdec);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
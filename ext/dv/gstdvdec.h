@@ -82,6 +82,16 @@ struct _GstDVDec {
   GstBufferPool *pool;
   GstSegment     segment;
   gboolean       need_segment;
+
+  /* frame-parallel decoding, frames are decoded by the workers and pushed
+   * in order from the streaming thread */
+  guint          n_threads;
+  GThreadPool   *workers;
+  GAsyncQueue   *decoders;
+  GQueue         pending;
+  guint          max_pending;
+  GMutex         lock;
+  GCond          cond;
 };
 
 struct _GstDVDecClass {
@@ -103,6 +103,26 @@
 #define NTSC_WIDE_PAR_X         32
 #define NTSC_WIDE_PAR_Y         27
 
+#define DIF_BLOCK_SIZE          80
+#define DIF_SEQUENCE_SIZE       12000
+#define AUDIO_BLOCKS_PER_SEQUENCE 9
+#define AUDIO_SAMPLES_PER_BLOCK 36
+
+/* Byte offsets of the 16 bit samples of one channel in the DIF sequences
+ * carrying that channel, in sample order. Sample n is stored in DIF
+ * sequence (n / 3 + 2 * (n % 3)) % N, audio block 3 * (n % 3) +
+ * (n % 9N) / 3N and sample slot n / 9N of that block, for N = 5 DIF
+ * sequences per channel in 525/60 and N = 6 in 625/50 */
+static guint32 audio_lut_525_60[5 * AUDIO_BLOCKS_PER_SEQUENCE *
+    AUDIO_SAMPLES_PER_BLOCK];
+static guint32 audio_lut_625_50[6 * AUDIO_BLOCKS_PER_SEQUENCE *
+    AUDIO_SAMPLES_PER_BLOCK];
+
+/* samples per frame for an AF_SIZE of 0, for 48, 44.1 and 32 kHz */
+static const gint audio_min_samples_525_60[3] = { 1580, 1452, 1053 };
+static const gint audio_min_samples_625_50[3] = { 1896, 1742, 1264 };
+static const gint audio_frequencies[3] = { 48000, 44100, 32000 };
+
 GST_DEBUG_CATEGORY_STATIC (dvdemux_debug);
 #define GST_CAT_DEFAULT dvdemux_debug
 
@@ -168,6 +188,23 @@ static gboolean gst_dvdemux_sink_activate_mode (GstPad * sinkpad,
 static GstStateChangeReturn gst_dvdemux_change_state (GstElement * element,
     GstStateChange transition);
 
+static void
+gst_dvdemux_init_audio_lut (guint32 * lut, gint n_seqs)
+{
+  gint stride = n_seqs * AUDIO_BLOCKS_PER_SEQUENCE;
+  gint n;
+
+  for (n = 0; n < stride * AUDIO_SAMPLES_PER_BLOCK; n++) {
+    gint seq = (n / 3 + 2 * (n % 3)) % n_seqs;
+    gint block = 3 * (n % 3) + (n % stride) / (stride / 3);
+
+    /* audio block b is DIF block 6 + 16 * b of the sequence, the samples
+     * start after the 3 byte ID and the 5 byte AAUX pack */
+    lut[n] = seq * DIF_SEQUENCE_SIZE + (6 + 16 * block) * DIF_BLOCK_SIZE +
+        8 + 2 * (n / stride);
+  }
+}
+
 static void
 gst_dvdemux_class_init (GstDVDemuxClass * klass)
 {
@@ -192,6 +229,9 @@ gst_dvdemux_class_init (GstDVDemuxClass * klass)
       "Erik Walthinsen <omega@cse.ogi.edu>, Wim Taymans <wim@fluendo.com>");
 
   GST_DEBUG_CATEGORY_INIT (dvdemux_debug, "dvdemux", 0, "DV demuxer element");
+
+  gst_dvdemux_init_audio_lut (audio_lut_525_60, 5);
+  gst_dvdemux_init_audio_lut (audio_lut_625_50, 6);
 }
 
 static void
@@ -1237,86 +1277,168 @@ gst_dvdemux_handle_src_event (GstPad * pad, GstObject * parent,
   return res;
 }
 
-/* does not take ownership of buffer */
+/* Parses the AAUX source pack of the first channel. Returns the number of
+ * samples in the frame for 16 bit, 2 channel audio without emphasis, which
+ * is what gst_dvdemux_deshuffle_audio() handles, and 0 otherwise */
+static gint
+gst_dvdemux_parse_audio_source (GstDVDemux * dvdemux, const guint8 * data,
+    gint * frequency)
+{
+  const guint8 *pack;
+  gint smp;
+
+  /* DIF sequence 0 has the source pack in audio block 3 */
+  pack = data + (6 + 16 * 3) * DIF_BLOCK_SIZE + 3;
+  if (pack[0] != 0x50)
+    return 0;
+
+  /* STYPE: 2 channels per 25 Mbit/s frame, EF: no emphasis, QU: 16 bit */
+  if ((pack[3] & 0x1f) != 0 || (pack[4] & 0x80) == 0 || (pack[4] & 0x07) != 0)
+    return 0;
+
+  smp = (pack[4] >> 3) & 0x07;
+  if ((guint) smp >= G_N_ELEMENTS (audio_frequencies))
+    return 0;
+
+  *frequency = audio_frequencies[smp];
+  if (dvdemux->decoder->system == e_dv_system_625_50)
+    return audio_min_samples_625_50[smp] + (pack[1] & 0x3f);
+  else
+    return audio_min_samples_525_60[smp] + (pack[1] & 0x3f);
+}
+
+/* Writes the samples of both channels straight from the DIF blocks into
+ * interleaved S16LE. Returns FALSE if the frame has error samples, which
+ * libdv conceals */
+static gboolean
+gst_dvdemux_deshuffle_audio (GstDVDemux * dvdemux, const guint8 * data,
+    gint num_samples, gint16 * out)
+{
+  const guint8 *ch1, *ch2;
+  const guint32 *lut;
+  guint16 errors = 0;
+  gint i;
+
+  /* the first half of the DIF sequences carries the first channel */
+  ch1 = data;
+  ch2 = data + dvdemux->decoder->num_dif_seqs / 2 * DIF_SEQUENCE_SIZE;
+
+  if (dvdemux->decoder->system == e_dv_system_625_50) {
+    if ((guint) num_samples > G_N_ELEMENTS (audio_lut_625_50))
+      return FALSE;
+    lut = audio_lut_625_50;
+  } else {
+    if ((guint) num_samples > G_N_ELEMENTS (audio_lut_525_60))
+      return FALSE;
+    lut = audio_lut_525_60;
+  }
+
+  for (i = 0; i < num_samples; i++) {
+    guint16 l = GST_READ_UINT16_BE (ch1 + lut[i]);
+    guint16 r = GST_READ_UINT16_BE (ch2 + lut[i]);
+
+    errors |= (l == 0x8000) | (r == 0x8000);
+    *out++ = GUINT16_TO_LE (l);
+    *out++ = GUINT16_TO_LE (r);
+  }
+
+  return errors == 0;
+}
+
 static GstFlowReturn
-gst_dvdemux_demux_audio (GstDVDemux * dvdemux, GstBuffer * buffer,
+gst_dvdemux_demux_audio (GstDVDemux * dvdemux, const guint8 * data,
     guint64 duration)
 {
   gint num_samples;
-  GstFlowReturn ret;
+  gint frequency = 0, channels = 2;
+  GstBuffer *outbuf = NULL;
   GstMapInfo map;
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  dv_decode_full_audio (dvdemux->decoder, map.data, dvdemux->audio_buffers);
-  gst_buffer_unmap (buffer, &map);
+  /* common case, deshuffle in one pass over the audio blocks */
+  num_samples = gst_dvdemux_parse_audio_source (dvdemux, data, &frequency);
+  if (G_LIKELY (num_samples > 0)) {
+    gboolean ok;
 
-  if (G_LIKELY ((num_samples = dv_get_num_samples (dvdemux->decoder)) > 0)) {
-    gint16 *a_ptr;
-    gint i, j;
-    GstBuffer *outbuf;
-    gint frequency, channels;
-
-    /* get initial format or check if format changed */
-    frequency = dv_get_frequency (dvdemux->decoder);
-    channels = dv_get_num_channels (dvdemux->decoder);
+    outbuf = gst_buffer_new_and_alloc (num_samples * sizeof (gint16) *
+        channels);
+    gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+    ok = gst_dvdemux_deshuffle_audio (dvdemux, data, num_samples,
+        (gint16 *) map.data);
+    gst_buffer_unmap (outbuf, &map);
 
-    if (G_UNLIKELY ((dvdemux->audiosrcpad == NULL)
-            || (frequency != dvdemux->frequency)
-            || (channels != dvdemux->channels))) {
-      GstCaps *caps;
-      GstAudioInfo info;
+    if (G_UNLIKELY (!ok)) {
+      GST_LOG_OBJECT (dvdemux, "error samples, decoding with libdv");
+      gst_buffer_unref (outbuf);
+      outbuf = NULL;
+    }
+  }
 
-      dvdemux->frequency = frequency;
-      dvdemux->channels = channels;
+  if (outbuf == NULL) {
+    gint16 *a_ptr;
+    gint i, j;
 
-      gst_audio_info_init (&info);
-      gst_audio_info_set_format (&info, GST_AUDIO_FORMAT_S16LE,
-          frequency, channels, NULL);
-      caps = gst_audio_info_to_caps (&info);
-      if (G_UNLIKELY (dvdemux->audiosrcpad == NULL)) {
-        dvdemux->audiosrcpad =
-            gst_dvdemux_add_pad (dvdemux, &audio_src_temp, caps);
+    dv_decode_full_audio (dvdemux->decoder, data, dvdemux->audio_buffers);
 
-        if (dvdemux->videosrcpad && dvdemux->audiosrcpad)
-          gst_element_no_more_pads (GST_ELEMENT (dvdemux));
+    if (G_UNLIKELY ((num_samples = dv_get_num_samples (dvdemux->decoder)) <= 0))
+      return GST_FLOW_OK;
 
-      } else {
-        gst_pad_set_caps (dvdemux->audiosrcpad, caps);
-      }
-      gst_caps_unref (caps);
-    }
+    frequency = dv_get_frequency (dvdemux->decoder);
+    channels = dv_get_num_channels (dvdemux->decoder);
 
-    outbuf = gst_buffer_new_and_alloc (num_samples *
-        sizeof (gint16) * dvdemux->channels);
+    outbuf = gst_buffer_new_and_alloc (num_samples * sizeof (gint16) *
+        channels);
 
     gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
     a_ptr = (gint16 *) map.data;
 
     for (i = 0; i < num_samples; i++) {
-      for (j = 0; j < dvdemux->channels; j++) {
+      for (j = 0; j < channels; j++) {
         *(a_ptr++) = dvdemux->audio_buffers[j][i];
       }
     }
     gst_buffer_unmap (outbuf, &map);
+  }
 
-    GST_DEBUG ("pushing audio %" GST_TIME_FORMAT,
-        GST_TIME_ARGS (dvdemux->time_segment.position));
+  /* get initial format or check if format changed */
+  if (G_UNLIKELY ((dvdemux->audiosrcpad == NULL)
+          || (frequency != dvdemux->frequency)
+          || (channels != dvdemux->channels))) {
+    GstCaps *caps;
+    GstAudioInfo info;
 
-    GST_BUFFER_TIMESTAMP (outbuf) = dvdemux->time_segment.position;
-    GST_BUFFER_DURATION (outbuf) = duration;
-    GST_BUFFER_OFFSET (outbuf) = dvdemux->audio_offset;
-    dvdemux->audio_offset += num_samples;
-    GST_BUFFER_OFFSET_END (outbuf) = dvdemux->audio_offset;
+    dvdemux->frequency = frequency;
+    dvdemux->channels = channels;
 
-    if (dvdemux->new_media || dvdemux->discont)
-      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
-    ret = gst_pad_push (dvdemux->audiosrcpad, outbuf);
-  } else {
-    /* no samples */
-    ret = GST_FLOW_OK;
+    gst_audio_info_init (&info);
+    gst_audio_info_set_format (&info, GST_AUDIO_FORMAT_S16LE,
+        frequency, channels, NULL);
+    caps = gst_audio_info_to_caps (&info);
+    if (G_UNLIKELY (dvdemux->audiosrcpad == NULL)) {
+      dvdemux->audiosrcpad =
+          gst_dvdemux_add_pad (dvdemux, &audio_src_temp, caps);
+
+      if (dvdemux->videosrcpad && dvdemux->audiosrcpad)
+        gst_element_no_more_pads (GST_ELEMENT (dvdemux));
+
+    } else {
+      gst_pad_set_caps (dvdemux->audiosrcpad, caps);
+    }
+    gst_caps_unref (caps);
   }
 
-  return ret;
+  GST_DEBUG ("pushing audio %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (dvdemux->time_segment.position));
+
+  GST_BUFFER_TIMESTAMP (outbuf) = dvdemux->time_segment.position;
+  GST_BUFFER_DURATION (outbuf) = duration;
+  GST_BUFFER_OFFSET (outbuf) = dvdemux->audio_offset;
+  dvdemux->audio_offset += num_samples;
+  GST_BUFFER_OFFSET_END (outbuf) = dvdemux->audio_offset;
+
+  if (dvdemux->new_media || dvdemux->discont)
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+
+  return gst_pad_push (dvdemux->audiosrcpad, outbuf);
 }
 
 /* takes ownership of buffer */
@@ -1418,17 +1540,13 @@ get_ssyb_offset (int dif, int ssyb)
 }
 
 static gboolean
-gst_dvdemux_get_timecode (GstDVDemux * dvdemux, GstBuffer * buffer,
+gst_dvdemux_get_timecode (GstDVDemux * dvdemux, const guint8 * data,
     GstSMPTETimeCode * timecode)
 {
-  guint8 *data;
-  GstMapInfo map;
   int offset;
   int dif;
   int n_difs = dvdemux->decoder->num_dif_seqs;
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  data = map.data;
   for (dif = 0; dif < n_difs; dif++) {
     offset = get_ssyb_offset (dif, 3);
     if (data[offset + 3] == 0x13) {
@@ -1442,28 +1560,22 @@ gst_dvdemux_get_timecode (GstDVDemux * dvdemux, GstBuffer * buffer,
           (data[offset + 7] & 0xf);
       GST_DEBUG ("got timecode %" GST_SMPTE_TIME_CODE_FORMAT,
           GST_SMPTE_TIME_CODE_ARGS (timecode));
-      gst_buffer_unmap (buffer, &map);
       return TRUE;
     }
   }
 
-  gst_buffer_unmap (buffer, &map);
   return FALSE;
 }
 
 static gboolean
-gst_dvdemux_is_new_media (GstDVDemux * dvdemux, GstBuffer * buffer)
+gst_dvdemux_is_new_media (GstDVDemux * dvdemux, const guint8 * data)
 {
-  guint8 *data;
-  GstMapInfo map;
   int aaux_offset;
   int dif;
   int n_difs;
 
   n_difs = dvdemux->decoder->num_dif_seqs;
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  data = map.data;
   for (dif = 0; dif < n_difs; dif++) {
     if (dif & 1) {
       aaux_offset = (dif * 12000) + (6 + 16 * 1) * 80 + 3;
@@ -1471,24 +1583,22 @@ gst_dvdemux_is_new_media (GstDVDemux * dvdemux, GstBuffer * buffer)
       aaux_offset = (dif * 12000) + (6 + 16 * 4) * 80 + 3;
     }
     if (data[aaux_offset + 0] == 0x51) {
-      if ((data[aaux_offset + 2] & 0x80) == 0) {
-        gst_buffer_unmap (buffer, &map);
+      if ((data[aaux_offset + 2] & 0x80) == 0)
         return TRUE;
-      }
     }
   }
 
-  gst_buffer_unmap (buffer, &map);
   return FALSE;
 }
 
-/* takes ownership of buffer */
+/* takes ownership of buffer, @data are the contents of @buffer and are only
+ * read before the buffer is pushed */
 static GstFlowReturn
-gst_dvdemux_demux_frame (GstDVDemux * dvdemux, GstBuffer * buffer)
+gst_dvdemux_demux_frame (GstDVDemux * dvdemux, GstBuffer * buffer,
+    const guint8 * data)
 {
   GstClockTime next_ts;
   GstFlowReturn aret, vret, ret;
-  GstMapInfo map;
   guint64 duration;
   GstSMPTETimeCode timecode;
   int frame_number;
@@ -1531,7 +1641,7 @@ gst_dvdemux_demux_frame (GstDVDemux * dvdemux, GstBuffer * buffer)
     dvdemux->need_segment = FALSE;
   }
 
-  gst_dvdemux_get_timecode (dvdemux, buffer, &timecode);
+  gst_dvdemux_get_timecode (dvdemux, data, &timecode);
   gst_smpte_time_code_get_frame_number (
       (dvdemux->decoder->system == e_dv_system_625_50) ?
       GST_SMPTE_TIME_CODE_SYSTEM_25 : GST_SMPTE_TIME_CODE_SYSTEM_30,
@@ -1550,19 +1660,16 @@ gst_dvdemux_demux_frame (GstDVDemux * dvdemux, GstBuffer * buffer)
     duration = next_ts - dvdemux->time_segment.position;
   }
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  dv_parse_packs (dvdemux->decoder, map.data);
-  gst_buffer_unmap (buffer, &map);
+  dv_parse_packs (dvdemux->decoder, data);
   dvdemux->new_media = FALSE;
-  if (gst_dvdemux_is_new_media (dvdemux, buffer) &&
+  if (gst_dvdemux_is_new_media (dvdemux, data) &&
       dvdemux->frames_since_new_media > 2) {
     dvdemux->new_media = TRUE;
     dvdemux->frames_since_new_media = 0;
   }
   dvdemux->frames_since_new_media++;
 
-  /* does not take ownership of buffer */
-  aret = ret = gst_dvdemux_demux_audio (dvdemux, buffer, duration);
+  aret = ret = gst_dvdemux_demux_audio (dvdemux, data, duration);
   if (G_UNLIKELY (ret != GST_FLOW_OK && ret != GST_FLOW_NOT_LINKED)) {
     gst_buffer_unref (buffer);
     goto done;
@@ -1651,10 +1758,15 @@ gst_dvdemux_flush (GstDVDemux * dvdemux)
     if (G_LIKELY (gst_adapter_available (dvdemux->adapter) >= length)) {
       GstBuffer *buffer;
 
-      buffer = gst_adapter_take_buffer (dvdemux->adapter, length);
+      /* the video buffer references the input memory, only the parser
+       * needs the frame in one piece */
+      buffer = gst_adapter_get_buffer_fast (dvdemux->adapter, length);
+      data = gst_adapter_map (dvdemux->adapter, length);
 
       /* and decode the buffer, takes ownership */
-      ret = gst_dvdemux_demux_frame (dvdemux, buffer);
+      ret = gst_dvdemux_demux_frame (dvdemux, buffer, data);
+      gst_adapter_unmap (dvdemux->adapter);
+      gst_adapter_flush (dvdemux->adapter, length);
       if (G_UNLIKELY (ret != GST_FLOW_OK))
         goto done;
     }
@@ -1835,8 +1947,11 @@ gst_dvdemux_loop (GstPad * pad)
     if (gst_buffer_get_size (buffer) < dvdemux->frame_len)
       goto small_buffer;
   }
-  /* and decode the buffer */
-  ret = gst_dvdemux_demux_frame (dvdemux, buffer);
+  /* and decode the buffer, the video buffer shares its memory */
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  ret = gst_dvdemux_demux_frame (dvdemux, gst_buffer_ref (buffer), map.data);
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
   if (G_UNLIKELY (ret != GST_FLOW_OK))
     goto pause;
 
@@ -119,6 +119,10 @@ enum
   PROP_RETRIES,
   PROP_METHOD,
   PROP_TLS_INTERACTION,
+  PROP_PARALLEL_REQUESTS,
+  PROP_RANGE_CHUNK_SIZE,
+  PROP_STATS,
+  PROP_CACHE_SIZE,
 };
 
 #define DEFAULT_USER_AGENT           "GStreamer souphttpsrc " PACKAGE_VERSION " "
@@ -134,6 +138,9 @@ enum
 #define DEFAULT_TIMEOUT              15
 #define DEFAULT_RETRIES              3
 #define DEFAULT_SOUP_METHOD          NULL
+#define DEFAULT_PARALLEL_REQUESTS    1
+#define DEFAULT_RANGE_CHUNK_SIZE     (1024 * 1024)
+#define DEFAULT_CACHE_SIZE           (64 * 1024)
 
 #define GROW_BLOCKSIZE_LIMIT 1
 #define GROW_BLOCKSIZE_COUNT 1
@@ -142,6 +149,32 @@ enum
 #define REDUCE_BLOCKSIZE_COUNT 2
 #define REDUCE_BLOCKSIZE_FACTOR 0.5
 
+/* Number of ranges queued per download thread */
+#define RANGE_QUEUE_FACTOR 2
+
+typedef struct
+{
+  GstSoupHTTPSrc *src;
+  GThread *thread;
+  guint id;
+  GCancellable *cancellable;
+  SoupMessage *msg;             /* Request in flight */
+
+  /* Statistics */
+  guint requests;
+  guint64 bytes;
+  GstClockTime busy_time;       /* Time spent waiting for and reading data */
+} GstSoupHTTPSrcRangeWorker;
+
+typedef struct
+{
+  guint64 offset;
+  guint64 size;
+  gboolean done;
+  GstFlowReturn ret;
+  GstBuffer *buffer;
+} GstSoupHTTPSrcRange;
+
 static void gst_soup_http_src_uri_handler_init (gpointer g_iface,
     gpointer iface_data);
 static void gst_soup_http_src_finalize (GObject * gobject);
@@ -186,6 +219,9 @@ static GstFlowReturn gst_soup_http_src_got_headers (GstSoupHTTPSrc * src,
 static void gst_soup_http_src_authenticate_cb (SoupSession * session,
     SoupMessage * msg, SoupAuth * auth, gboolean retrying,
     GstSoupHTTPSrc * src);
+static GstStructure *gst_soup_http_src_get_stats (GstSoupHTTPSrc * src);
+static void gst_soup_http_src_cache_push (GstSoupHTTPSrc * src,
+    const guint8 * data, gsize size);
 
 #define gst_soup_http_src_parent_class parent_class
 G_DEFINE_TYPE_WITH_CODE (GstSoupHTTPSrc, gst_soup_http_src, GST_TYPE_PUSH_SRC,
@@ -409,6 +445,70 @@ gst_soup_http_src_class_init (GstSoupHTTPSrcClass * klass)
           "The HTTP method to use (GET, HEAD, OPTIONS, etc)",
           DEFAULT_SOUP_METHOD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSoupHTTPSrc:parallel-requests:
+   *
+   * Number of concurrent Range requests used to download the resource once
+   * its size is known and the server accepts Range requests. The ranges are
+   * pushed downstream in order. A value of 1 reads a single response
+   * sequentially.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_PARALLEL_REQUESTS,
+      g_param_spec_uint ("parallel-requests", "Parallel requests",
+          "Number of concurrent Range requests (1 = disabled)", 1, 64,
+          DEFAULT_PARALLEL_REQUESTS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstSoupHTTPSrc:range-chunk-size:
+   *
+   * Size in bytes of each Range request when #GstSoupHTTPSrc:parallel-requests
+   * is larger than 1. Each range is pushed downstream as one buffer.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_RANGE_CHUNK_SIZE,
+      g_param_spec_uint ("range-chunk-size", "Range chunk size",
+          "Size in bytes of each parallel Range request", 16 * 1024,
+          G_MAXINT, DEFAULT_RANGE_CHUNK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstSoupHTTPSrc:stats:
+   *
+   * Statistics of the parallel Range requests. The "connections" field
+   * holds one structure per download thread with the number of "requests",
+   * the "bytes" received and the average "bitrate" in bits per second
+   * while a request was in flight.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Parallel Range request statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstSoupHTTPSrc:cache-size:
+   *
+   * Amount of recently read data kept around. Seeks back into it are
+   * served without a new request, and seeks forward by up to this many
+   * bytes read through the open response instead of reconnecting, which
+   * keeps the connection alive.
+   *
+   * The cache keeps its own copy of the data, so the buffers pushed
+   * downstream stay writable.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_SIZE,
+      g_param_spec_uint ("cache-size", "Cache size",
+          "Recently read bytes kept to serve short seeks without a new "
+          "request (0 = disabled)", 0, G_MAXINT, DEFAULT_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (gstelement_class, &srctemplate);
 
   gst_element_class_set_static_metadata (gstelement_class, "HTTP client source",
@@ -437,6 +537,23 @@ gst_soup_http_src_class_init (GstSoupHTTPSrcClass * klass)
       "SOUP HTTP src");
 }
 
+static void
+gst_soup_http_src_cache_clear (GstSoupHTTPSrc * src)
+{
+  src->cache_head = 0;
+  src->cache_bytes = 0;
+}
+
+static void
+gst_soup_http_src_release_pool (GstSoupHTTPSrc * src)
+{
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+  }
+}
+
 static void
 gst_soup_http_src_reset (GstSoupHTTPSrc * src)
 {
@@ -447,17 +564,27 @@ gst_soup_http_src_reset (GstSoupHTTPSrc * src)
   src->read_position = 0;
   src->request_position = 0;
   src->stop_position = -1;
+  src->stream_stop_position = -1;
   src->content_size = 0;
   src->have_body = FALSE;
 
   src->reduce_blocksize_count = 0;
   src->increase_blocksize_count = 0;
 
+  src->range_next = 0;
+  src->range_end = 0;
+  src->range_restart = TRUE;
+  src->range_unsupported = FALSE;
+
   g_cancellable_reset (src->cancellable);
   if (src->input_stream) {
     g_object_unref (src->input_stream);
     src->input_stream = NULL;
   }
+  gst_soup_http_src_cache_clear (src);
+  g_free (src->cache);
+  src->cache = NULL;
+  gst_soup_http_src_release_pool (src);
 
   gst_caps_replace (&src->src_caps, NULL);
   g_free (src->iradio_name);
@@ -475,6 +602,10 @@ gst_soup_http_src_init (GstSoupHTTPSrc * src)
 
   g_mutex_init (&src->mutex);
   g_cond_init (&src->have_headers_cond);
+  g_mutex_init (&src->range_lock);
+  g_cond_init (&src->range_cond);
+  g_queue_init (&src->range_queue);
+  src->range_workers = g_ptr_array_new ();
   src->cancellable = g_cancellable_new ();
   src->location = NULL;
   src->redirection_uri = NULL;
@@ -500,6 +631,9 @@ gst_soup_http_src_init (GstSoupHTTPSrc * src)
   src->tls_interaction = DEFAULT_TLS_INTERACTION;
   src->max_retries = DEFAULT_RETRIES;
   src->method = DEFAULT_SOUP_METHOD;
+  src->parallel_requests = DEFAULT_PARALLEL_REQUESTS;
+  src->range_chunk_size = DEFAULT_RANGE_CHUNK_SIZE;
+  src->cache_size = DEFAULT_CACHE_SIZE;
   src->minimum_blocksize = gst_base_src_get_blocksize (GST_BASE_SRC_CAST (src));
   proxy = g_getenv ("http_proxy");
   if (!gst_soup_http_src_set_proxy (src, proxy)) {
@@ -539,6 +673,9 @@ gst_soup_http_src_finalize (GObject * gobject)
 
   g_mutex_clear (&src->mutex);
   g_cond_clear (&src->have_headers_cond);
+  g_mutex_clear (&src->range_lock);
+  g_cond_clear (&src->range_cond);
+  g_ptr_array_unref (src->range_workers);
   g_object_unref (src->cancellable);
   g_free (src->location);
   g_free (src->redirection_uri);
@@ -682,6 +819,20 @@ gst_soup_http_src_set_property (GObject * object, guint prop_id,
       g_free (src->method);
       src->method = g_value_dup_string (value);
       break;
+    case PROP_PARALLEL_REQUESTS:
+      src->parallel_requests = g_value_get_uint (value);
+      break;
+    case PROP_RANGE_CHUNK_SIZE:
+      src->range_chunk_size = g_value_get_uint (value);
+      break;
+    case PROP_CACHE_SIZE:
+      g_mutex_lock (&src->mutex);
+      src->cache_size = g_value_get_uint (value);
+      g_free (src->cache);
+      src->cache = NULL;
+      gst_soup_http_src_cache_clear (src);
+      g_mutex_unlock (&src->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -773,6 +924,18 @@ gst_soup_http_src_get_property (GObject * object, guint prop_id,
     case PROP_METHOD:
       g_value_set_string (value, src->method);
       break;
+    case PROP_PARALLEL_REQUESTS:
+      g_value_set_uint (value, src->parallel_requests);
+      break;
+    case PROP_RANGE_CHUNK_SIZE:
+      g_value_set_uint (value, src->range_chunk_size);
+      break;
+    case PROP_CACHE_SIZE:
+      g_value_set_uint (value, src->cache_size);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_soup_http_src_get_stats (src));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -820,13 +983,14 @@ gst_soup_http_src_add_range_header (GstSoupHTTPSrc * src, guint64 offset,
     soup_message_headers_append (src->msg->request_headers, "Range", buf);
   }
   src->read_position = offset;
+  src->stream_stop_position = stop_offset;
   return TRUE;
 }
 
 static gboolean
 _append_extra_header (GQuark field_id, const GValue * value, gpointer user_data)
 {
-  GstSoupHTTPSrc *src = GST_SOUP_HTTP_SRC (user_data);
+  SoupMessage *msg = user_data;
   const gchar *field_name = g_quark_to_string (field_id);
   gchar *field_content = NULL;
 
@@ -842,14 +1006,14 @@ _append_extra_header (GQuark field_id, const GValue * value, gpointer user_data)
   }
 
   if (field_content == NULL) {
-    GST_ERROR_OBJECT (src, "extra-headers field '%s' contains no value "
+    GST_ERROR ("extra-headers field '%s' contains no value "
         "or can't be converted to a string", field_name);
     return FALSE;
   }
 
-  GST_DEBUG_OBJECT (src, "Appending extra header: \"%s: %s\"", field_name,
+  GST_DEBUG ("Appending extra header: \"%s: %s\"", field_name,
       field_content);
-  soup_message_headers_append (src->msg->request_headers, field_name,
+  soup_message_headers_append (msg->request_headers, field_name,
       field_content);
 
   g_free (field_content);
@@ -890,12 +1054,12 @@ _append_extra_headers (GQuark field_id, const GValue * value,
 
 
 static gboolean
-gst_soup_http_src_add_extra_headers (GstSoupHTTPSrc * src)
+gst_soup_http_src_add_extra_headers (GstSoupHTTPSrc * src, SoupMessage * msg)
 {
   if (!src->extra_headers)
     return TRUE;
 
-  return gst_structure_foreach (src->extra_headers, _append_extra_headers, src);
+  return gst_structure_foreach (src->extra_headers, _append_extra_headers, msg);
 }
 
 static gboolean
@@ -998,6 +1162,12 @@ gst_soup_http_src_session_open (GstSoupHTTPSrc * src)
           gst_object_unref (src->session);
         } else {
           src->session_is_shared = FALSE;
+
+          /* The default limit of 2 connections per host would serialize
+           * the parallel range requests */
+          if (src->parallel_requests > 1)
+            g_object_set (src->session, SOUP_SESSION_MAX_CONNS_PER_HOST,
+                src->parallel_requests + 1, NULL);
         }
       }
     }
@@ -1053,12 +1223,30 @@ gst_soup_http_src_session_close (GstSoupHTTPSrc * src)
   g_mutex_unlock (&src->mutex);
 }
 
+static gboolean
+gst_soup_http_src_owns_message (GstSoupHTTPSrc * src, SoupMessage * msg)
+{
+  gboolean ret = (msg == src->msg);
+  guint i;
+
+  g_mutex_lock (&src->range_lock);
+  for (i = 0; i < src->range_workers->len && !ret; i++) {
+    GstSoupHTTPSrcRangeWorker *worker =
+        g_ptr_array_index (src->range_workers, i);
+
+    ret = (msg == worker->msg);
+  }
+  g_mutex_unlock (&src->range_lock);
+
+  return ret;
+}
+
 static void
 gst_soup_http_src_authenticate_cb (SoupSession * session, SoupMessage * msg,
     SoupAuth * auth, gboolean retrying, GstSoupHTTPSrc * src)
 {
   /* Might be from another user of the shared session */
-  if (!GST_IS_SOUP_HTTP_SRC (src) || msg != src->msg)
+  if (!GST_IS_SOUP_HTTP_SRC (src) || !gst_soup_http_src_owns_message (src, msg))
     return;
 
   if (!retrying) {
@@ -1329,14 +1517,49 @@ static GstBuffer *
 gst_soup_http_src_alloc_buffer (GstSoupHTTPSrc * src)
 {
   GstBaseSrc *basesrc = GST_BASE_SRC_CAST (src);
+  GstBufferPool *pool;
   GstFlowReturn rc;
   GstBuffer *gstbuf;
 
-  rc = GST_BASE_SRC_CLASS (parent_class)->alloc (basesrc, -1,
-      basesrc->blocksize, &gstbuf);
+  /* Use the pool negotiated with downstream if there is one */
+  pool = gst_base_src_get_buffer_pool (basesrc);
+  if (pool) {
+    gst_object_unref (pool);
+
+    rc = GST_BASE_SRC_CLASS (parent_class)->alloc (basesrc, -1,
+        basesrc->blocksize, &gstbuf);
+    if (G_UNLIKELY (rc != GST_FLOW_OK)) {
+      return NULL;
+    }
+
+    return gstbuf;
+  }
+
+  /* Otherwise recycle our own buffers instead of allocating one per read.
+   * The pool is only recreated when the blocksize grows past its size,
+   * smaller blocksizes use part of its buffers */
+  if (src->pool && src->pool_size < basesrc->blocksize)
+    gst_soup_http_src_release_pool (src);
+
+  if (!src->pool) {
+    GstStructure *config;
+
+    src->pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (src->pool);
+    gst_buffer_pool_config_set_params (config, NULL, basesrc->blocksize, 0, 0);
+    if (!gst_buffer_pool_set_config (src->pool, config) ||
+        !gst_buffer_pool_set_active (src->pool, TRUE)) {
+      gst_soup_http_src_release_pool (src);
+      return NULL;
+    }
+    src->pool_size = basesrc->blocksize;
+  }
+
+  rc = gst_buffer_pool_acquire_buffer (src->pool, &gstbuf, NULL);
   if (G_UNLIKELY (rc != GST_FLOW_OK)) {
     return NULL;
   }
+  gst_buffer_set_size (gstbuf, basesrc->blocksize);
 
   return gstbuf;
 }
@@ -1449,18 +1672,10 @@ gst_soup_http_src_restarted_cb (SoupMessage * msg, GstSoupHTTPSrc * src)
   }
 }
 
-static gboolean
-gst_soup_http_src_build_message (GstSoupHTTPSrc * src, const gchar * method)
+/* Request headers shared by the main request and the range requests */
+static void
+gst_soup_http_src_add_request_headers (GstSoupHTTPSrc * src, SoupMessage * msg)
 {
-  g_return_val_if_fail (src->msg == NULL, FALSE);
-
-  src->msg = soup_message_new (method, src->location);
-  if (!src->msg) {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
-        ("Error parsing URL."), ("URL: %s", src->location));
-    return FALSE;
-  }
-
   /* Duplicating the defaults of libsoup here. We don't want to set a
    * User-Agent in the session as each source might have its own User-Agent
    * set */
@@ -1468,40 +1683,54 @@ gst_soup_http_src_build_message (GstSoupHTTPSrc * src, const gchar * method)
     gchar *user_agent =
         g_strdup_printf ("libsoup/%u.%u.%u", soup_get_major_version (),
         soup_get_minor_version (), soup_get_micro_version ());
-    soup_message_headers_append (src->msg->request_headers, "User-Agent",
+    soup_message_headers_append (msg->request_headers, "User-Agent",
         user_agent);
     g_free (user_agent);
   } else if (g_str_has_suffix (src->user_agent, " ")) {
     gchar *user_agent = g_strdup_printf ("%slibsoup/%u.%u.%u", src->user_agent,
         soup_get_major_version (),
         soup_get_minor_version (), soup_get_micro_version ());
-    soup_message_headers_append (src->msg->request_headers, "User-Agent",
+    soup_message_headers_append (msg->request_headers, "User-Agent",
         user_agent);
     g_free (user_agent);
   } else {
-    soup_message_headers_append (src->msg->request_headers, "User-Agent",
+    soup_message_headers_append (msg->request_headers, "User-Agent",
         src->user_agent);
   }
 
   if (!src->keep_alive) {
-    soup_message_headers_append (src->msg->request_headers, "Connection",
-        "close");
-  }
-  if (src->iradio_mode) {
-    soup_message_headers_append (src->msg->request_headers, "icy-metadata",
-        "1");
+    soup_message_headers_append (msg->request_headers, "Connection", "close");
   }
   if (src->cookies) {
     gchar **cookie;
 
     for (cookie = src->cookies; *cookie != NULL; cookie++) {
-      soup_message_headers_append (src->msg->request_headers, "Cookie",
-          *cookie);
+      soup_message_headers_append (msg->request_headers, "Cookie", *cookie);
     }
   }
 
   if (!src->compress)
-    soup_message_disable_feature (src->msg, SOUP_TYPE_CONTENT_DECODER);
+    soup_message_disable_feature (msg, SOUP_TYPE_CONTENT_DECODER);
+}
+
+static gboolean
+gst_soup_http_src_build_message (GstSoupHTTPSrc * src, const gchar * method)
+{
+  g_return_val_if_fail (src->msg == NULL, FALSE);
+
+  src->msg = soup_message_new (method, src->location);
+  if (!src->msg) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
+        ("Error parsing URL."), ("URL: %s", src->location));
+    return FALSE;
+  }
+
+  gst_soup_http_src_add_request_headers (src, src->msg);
+
+  if (src->iradio_mode) {
+    soup_message_headers_append (src->msg->request_headers, "icy-metadata",
+        "1");
+  }
 
   soup_message_set_flags (src->msg, SOUP_MESSAGE_OVERWRITE_CHUNKS |
       (src->automatic_redirect ? 0 : SOUP_MESSAGE_NO_REDIRECT));
@@ -1514,7 +1743,7 @@ gst_soup_http_src_build_message (GstSoupHTTPSrc * src, const gchar * method)
   gst_soup_http_src_add_range_header (src, src->request_position,
       src->stop_position);
 
-  gst_soup_http_src_add_extra_headers (src);
+  gst_soup_http_src_add_extra_headers (src, src->msg);
 
   return TRUE;
 }
@@ -1576,12 +1805,18 @@ gst_soup_http_src_do_request (GstSoupHTTPSrc * src, const gchar * method)
 
   GST_LOG_OBJECT (src, "Running request for method: %s", method);
 
+  /* The cache holds the data right before read_position */
+  if (src->read_position != src->request_position)
+    gst_soup_http_src_cache_clear (src);
+
   /* Update the position if we are retrying */
   if (src->msg && src->request_position > 0) {
     gst_soup_http_src_add_range_header (src, src->request_position,
         src->stop_position);
-  } else if (src->msg && src->request_position == 0)
+  } else if (src->msg && src->request_position == 0) {
     soup_message_headers_remove (src->msg->request_headers, "Range");
+    src->stream_stop_position = -1;
+  }
 
   /* add_range_header() has the side effect of setting read_position to
    * the requested position. This *needs* to be set regardless of having
@@ -1720,6 +1955,8 @@ gst_soup_http_src_read_buffer (GstSoupHTTPSrc * src, GstBuffer ** outbuf)
     return GST_FLOW_FLUSHING;
   }
 
+  if (read_bytes > 0)
+    gst_soup_http_src_cache_push (src, mapinfo.data, read_bytes);
   gst_buffer_unmap (*outbuf, &mapinfo);
   if (read_bytes > 0) {
     gst_buffer_set_size (*outbuf, read_bytes);
@@ -1770,12 +2007,497 @@ gst_soup_http_src_read_buffer (GstSoupHTTPSrc * src, GstBuffer ** outbuf)
   return ret;
 }
 
+/* Copies the end of the data just read into the cache. Holding a reference
+ * to the buffer instead would make downstream copy it when writing to it.
+ * Must be called with the mutex */
+static void
+gst_soup_http_src_cache_push (GstSoupHTTPSrc * src, const guint8 * data,
+    gsize size)
+{
+  gsize len;
+
+  if (src->cache_size == 0)
+    return;
+
+  if (!src->cache) {
+    src->cache = g_malloc (src->cache_size);
+    src->cache_head = src->cache_bytes = 0;
+  }
+
+  if (size > src->cache_size) {
+    data += size - src->cache_size;
+    size = src->cache_size;
+  }
+
+  while (size > 0) {
+    len = MIN (size, src->cache_size - src->cache_head);
+    memcpy (src->cache + src->cache_head, data, len);
+    src->cache_head = (src->cache_head + len) % src->cache_size;
+    data += len;
+    size -= len;
+    src->cache_bytes = MIN (src->cache_bytes + len, src->cache_size);
+  }
+}
+
+/* Whether the pending seek can be handled with the open response, either
+ * from the cache or by reading ahead. Must be called with the mutex */
+static gboolean
+gst_soup_http_src_can_reuse_stream (GstSoupHTTPSrc * src)
+{
+  if (!src->input_stream || src->cache_size == 0)
+    return FALSE;
+
+  /* The open response must cover the new segment */
+  if (src->stop_position != -1 || src->stream_stop_position != -1)
+    return FALSE;
+
+  if (src->request_position < src->read_position)
+    return src->read_position - src->request_position <= src->cache_bytes;
+
+  return src->request_position - src->read_position <= src->cache_size;
+}
+
+static GstFlowReturn
+gst_soup_http_src_cache_read (GstSoupHTTPSrc * src, GstBuffer ** outbuf)
+{
+  GstBaseSrc *bsrc = GST_BASE_SRC_CAST (src);
+  GstMapInfo mapinfo;
+  gsize back, pos, len, n;
+
+  *outbuf = gst_soup_http_src_alloc_buffer (src);
+  if (!*outbuf) {
+    GST_WARNING_OBJECT (src, "Failed to allocate buffer");
+    return GST_FLOW_ERROR;
+  }
+
+  if (!gst_buffer_map (*outbuf, &mapinfo, GST_MAP_WRITE)) {
+    GST_WARNING_OBJECT (src, "Failed to map buffer");
+    gst_buffer_unref (*outbuf);
+    return GST_FLOW_ERROR;
+  }
+
+  g_mutex_lock (&src->mutex);
+  back = src->read_position - src->request_position;
+  g_assert (back <= src->cache_bytes);
+
+  len = MIN (back, mapinfo.size);
+  pos = (src->cache_head + src->cache_size - back) % src->cache_size;
+  n = MIN (len, src->cache_size - pos);
+  memcpy (mapinfo.data, src->cache + pos, n);
+  memcpy (mapinfo.data + n, src->cache, len - n);
+
+  GST_LOG_OBJECT (src, "Serving %" G_GSIZE_FORMAT " bytes at %"
+      G_GUINT64_FORMAT " from the cache", len, src->request_position);
+  src->request_position += len;
+  g_mutex_unlock (&src->mutex);
+
+  gst_buffer_unmap (*outbuf, &mapinfo);
+  gst_buffer_set_size (*outbuf, len);
+  GST_BUFFER_OFFSET (*outbuf) = bsrc->segment.position;
+
+  return GST_FLOW_OK;
+}
+
+/* Reads through the open response up to a forward seek position. The part
+ * of the last read after that position is returned in @outbuf */
+static GstFlowReturn
+gst_soup_http_src_skip (GstSoupHTTPSrc * src, GstBuffer ** outbuf)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  GST_DEBUG_OBJECT (src, "Skipping %" G_GUINT64_FORMAT " bytes",
+      src->request_position - src->read_position);
+
+  *outbuf = NULL;
+  while (ret == GST_FLOW_OK && src->request_position > src->read_position) {
+    GstBuffer *buffer;
+    gsize size, skip;
+
+    ret = gst_soup_http_src_read_buffer (src, &buffer);
+    if (ret != GST_FLOW_OK)
+      break;
+
+    if (src->read_position <= src->request_position) {
+      gst_buffer_unref (buffer);
+      continue;
+    }
+
+    size = gst_buffer_get_size (buffer);
+    skip = size - (src->read_position - src->request_position);
+    gst_buffer_resize (buffer, skip, size - skip);
+    src->request_position = src->read_position;
+    *outbuf = buffer;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_soup_http_src_range_possible (GstSoupHTTPSrc * src)
+{
+  if (src->parallel_requests < 2 || src->range_unsupported)
+    return FALSE;
+
+  if (!src->got_headers || !src->have_size || !src->seekable || src->compress)
+    return FALSE;
+
+  if (src->method && g_ascii_strcasecmp (src->method, SOUP_METHOD_GET) != 0)
+    return FALSE;
+
+  /* Metadata is interleaved with the data of Icecast streams */
+  if (src->src_caps && gst_structure_has_name (gst_caps_get_structure
+          (src->src_caps, 0), "application/x-icy"))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+gst_soup_http_src_range_free (GstSoupHTTPSrcRange * range)
+{
+  if (range->buffer)
+    gst_buffer_unref (range->buffer);
+  g_slice_free (GstSoupHTTPSrcRange, range);
+}
+
+/* Drops all queued ranges and interrupts the requests in flight. Must be
+ * called with the range lock */
+static void
+gst_soup_http_src_range_flush (GstSoupHTTPSrc * src)
+{
+  guint i;
+
+  src->range_cookie++;
+  for (i = 0; i < src->range_workers->len; i++) {
+    GstSoupHTTPSrcRangeWorker *worker =
+        g_ptr_array_index (src->range_workers, i);
+
+    g_cancellable_cancel (worker->cancellable);
+  }
+
+  g_queue_foreach (&src->range_queue, (GFunc) gst_soup_http_src_range_free,
+      NULL);
+  g_queue_clear (&src->range_queue);
+  g_cond_broadcast (&src->range_cond);
+}
+
+static GstFlowReturn
+gst_soup_http_src_range_fetch (GstSoupHTTPSrc * src,
+    GstSoupHTTPSrcRangeWorker * worker, guint64 offset, guint64 size,
+    GstBuffer ** outbuf)
+{
+  SoupMessage *msg;
+  GInputStream *stream;
+  GstBuffer *buffer;
+  GstMapInfo map;
+  GError *error = NULL;
+  gsize bytes_read = 0;
+  gint64 start_time;
+  gchar range[64];
+  GstFlowReturn ret;
+
+  msg = soup_message_new (SOUP_METHOD_GET,
+      src->redirection_uri ? src->redirection_uri : src->location);
+  if (!msg)
+    return GST_FLOW_ERROR;
+
+  gst_soup_http_src_add_request_headers (src, msg);
+  g_snprintf (range, sizeof (range), "bytes=%" G_GUINT64_FORMAT "-%"
+      G_GUINT64_FORMAT, offset, offset + size - 1);
+  soup_message_headers_append (msg->request_headers, "Range", range);
+  gst_soup_http_src_add_extra_headers (src, msg);
+
+  GST_LOG_OBJECT (src, "worker %u requesting %s", worker->id, range);
+
+  g_mutex_lock (&src->range_lock);
+  worker->msg = msg;
+  g_mutex_unlock (&src->range_lock);
+
+  start_time = g_get_monotonic_time ();
+  stream = soup_session_send (src->session, msg, worker->cancellable, &error);
+
+  if (g_cancellable_is_cancelled (worker->cancellable)) {
+    ret = GST_FLOW_FLUSHING;
+  } else if (!stream) {
+    GST_DEBUG_OBJECT (src, "worker %u didn't get an input stream: %s",
+        worker->id, error->message);
+    ret = GST_FLOW_CUSTOM_ERROR;
+  } else if (msg->status_code == SOUP_STATUS_OK) {
+    ret = GST_FLOW_NOT_SUPPORTED;
+  } else if (msg->status_code != SOUP_STATUS_PARTIAL_CONTENT) {
+    /* Reports the error */
+    ret = gst_soup_http_src_parse_status (msg, src);
+    if (ret == GST_FLOW_OK)
+      ret = GST_FLOW_ERROR;
+  } else {
+    ret = GST_FLOW_OK;
+  }
+  g_clear_error (&error);
+
+  if (ret == GST_FLOW_OK) {
+    buffer = gst_buffer_new_allocate (NULL, size, NULL);
+    gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+    g_input_stream_read_all (stream, map.data, size, &bytes_read,
+        worker->cancellable, NULL);
+    gst_buffer_unmap (buffer, &map);
+
+    if (bytes_read == size) {
+      *outbuf = buffer;
+    } else {
+      gst_buffer_unref (buffer);
+      /* Maybe the server disconnected, retry */
+      ret = g_cancellable_is_cancelled (worker->cancellable) ?
+          GST_FLOW_FLUSHING : GST_FLOW_CUSTOM_ERROR;
+    }
+  }
+
+  if (stream) {
+    g_input_stream_close (stream, NULL, NULL);
+    g_object_unref (stream);
+  }
+
+  g_mutex_lock (&src->range_lock);
+  worker->msg = NULL;
+  worker->requests++;
+  worker->bytes += bytes_read;
+  worker->busy_time +=
+      (g_get_monotonic_time () - start_time) * GST_USECOND;
+  g_mutex_unlock (&src->range_lock);
+
+  g_object_unref (msg);
+
+  return ret;
+}
+
+static gpointer
+gst_soup_http_src_range_worker (GstSoupHTTPSrcRangeWorker * worker)
+{
+  GstSoupHTTPSrc *src = worker->src;
+
+  g_mutex_lock (&src->range_lock);
+  while (!src->range_stopping) {
+    GstSoupHTTPSrcRange *range;
+    GstBuffer *buffer = NULL;
+    GstFlowReturn ret;
+    guint64 offset, size;
+    guint cookie;
+    gint retries = 0;
+
+    if (src->range_flushing || src->range_next >= src->range_end ||
+        g_queue_get_length (&src->range_queue) >=
+        src->range_workers->len * RANGE_QUEUE_FACTOR) {
+      g_cond_wait (&src->range_cond, &src->range_lock);
+      continue;
+    }
+
+    offset = src->range_next;
+    size = MIN (src->range_chunk_size, src->range_end - offset);
+    src->range_next += size;
+
+    range = g_slice_new0 (GstSoupHTTPSrcRange);
+    range->offset = offset;
+    range->size = size;
+    g_queue_push_tail (&src->range_queue, range);
+    cookie = src->range_cookie;
+
+    /* Flushes cancel with the lock held, so this only forgets about
+     * cancellations of ranges that were already dropped */
+    g_cancellable_reset (worker->cancellable);
+    g_mutex_unlock (&src->range_lock);
+
+    do {
+      ret = gst_soup_http_src_range_fetch (src, worker, offset, size, &buffer);
+    } while (ret == GST_FLOW_CUSTOM_ERROR &&
+        (src->max_retries == -1 || retries++ < src->max_retries));
+
+    if (ret == GST_FLOW_CUSTOM_ERROR) {
+      GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+          ("Failed to read range %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+              offset, offset + size - 1));
+      ret = GST_FLOW_ERROR;
+    }
+
+    g_mutex_lock (&src->range_lock);
+    if (cookie == src->range_cookie) {
+      range->buffer = buffer;
+      range->ret = ret;
+      range->done = TRUE;
+      g_cond_broadcast (&src->range_cond);
+    } else if (buffer) {
+      /* The range was dropped by a seek or flush in the meantime */
+      gst_buffer_unref (buffer);
+    }
+  }
+  g_mutex_unlock (&src->range_lock);
+
+  return NULL;
+}
+
+static void
+gst_soup_http_src_range_start (GstSoupHTTPSrc * src)
+{
+  guint i;
+
+  GST_DEBUG_OBJECT (src, "Starting %u range download threads",
+      src->parallel_requests);
+
+  for (i = 0; i < src->parallel_requests; i++) {
+    GstSoupHTTPSrcRangeWorker *worker = g_new0 (GstSoupHTTPSrcRangeWorker, 1);
+
+    worker->src = src;
+    worker->id = i;
+    worker->cancellable = g_cancellable_new ();
+    g_ptr_array_add (src->range_workers, worker);
+  }
+
+  for (i = 0; i < src->range_workers->len; i++) {
+    GstSoupHTTPSrcRangeWorker *worker =
+        g_ptr_array_index (src->range_workers, i);
+
+    worker->thread = g_thread_new ("souphttpsrc-range",
+        (GThreadFunc) gst_soup_http_src_range_worker, worker);
+  }
+}
+
+static void
+gst_soup_http_src_range_stop (GstSoupHTTPSrc * src)
+{
+  guint i;
+
+  g_mutex_lock (&src->range_lock);
+  src->range_stopping = TRUE;
+  gst_soup_http_src_range_flush (src);
+  g_mutex_unlock (&src->range_lock);
+
+  for (i = 0; i < src->range_workers->len; i++) {
+    GstSoupHTTPSrcRangeWorker *worker =
+        g_ptr_array_index (src->range_workers, i);
+
+    g_thread_join (worker->thread);
+    g_object_unref (worker->cancellable);
+    g_free (worker);
+  }
+
+  g_mutex_lock (&src->range_lock);
+  g_ptr_array_set_size (src->range_workers, 0);
+  src->range_stopping = FALSE;
+  src->range_restart = TRUE;
+  g_mutex_unlock (&src->range_lock);
+}
+
+static GstFlowReturn
+gst_soup_http_src_range_read_buffer (GstSoupHTTPSrc * src, GstBuffer ** outbuf)
+{
+  GstBaseSrc *bsrc = GST_BASE_SRC_CAST (src);
+  GstSoupHTTPSrcRange *range;
+  GstFlowReturn ret;
+  guint64 end;
+
+  end = src->content_size;
+  if (src->stop_position != -1 && src->stop_position < end)
+    end = src->stop_position;
+
+  g_mutex_lock (&src->range_lock);
+  if (src->range_restart || src->request_position != src->read_position ||
+      src->range_end != end) {
+    GST_DEBUG_OBJECT (src, "Requesting ranges from %" G_GUINT64_FORMAT
+        " to %" G_GUINT64_FORMAT, src->request_position, end);
+    gst_soup_http_src_range_flush (src);
+    src->read_position = src->request_position;
+    src->range_next = src->request_position;
+    src->range_end = end;
+    src->range_restart = FALSE;
+  }
+
+  if (src->range_workers->len == 0)
+    gst_soup_http_src_range_start (src);
+
+  if (src->read_position >= src->range_end) {
+    g_mutex_unlock (&src->range_lock);
+    return GST_FLOW_EOS;
+  }
+
+  while (!(range = g_queue_peek_head (&src->range_queue)) || !range->done) {
+    if (src->range_flushing) {
+      g_mutex_unlock (&src->range_lock);
+      return GST_FLOW_FLUSHING;
+    }
+    g_cond_wait (&src->range_cond, &src->range_lock);
+  }
+  g_queue_pop_head (&src->range_queue);
+  /* Room for one more range */
+  g_cond_broadcast (&src->range_cond);
+  g_mutex_unlock (&src->range_lock);
+
+  ret = range->ret;
+  if (ret == GST_FLOW_OK && range->offset != src->read_position) {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("Got range at offset %" G_GUINT64_FORMAT ", expected %"
+            G_GUINT64_FORMAT ", URL: %s", range->offset, src->read_position,
+            src->location));
+    ret = GST_FLOW_ERROR;
+  } else if (ret == GST_FLOW_OK) {
+    *outbuf = range->buffer;
+    range->buffer = NULL;
+
+    g_mutex_lock (&src->mutex);
+    GST_BUFFER_OFFSET (*outbuf) = bsrc->segment.position;
+    gst_soup_http_src_update_position (src, range->size);
+    src->retry_count = 0;
+    g_mutex_unlock (&src->mutex);
+  }
+  gst_soup_http_src_range_free (range);
+
+  return ret;
+}
+
+static GstStructure *
+gst_soup_http_src_get_stats (GstSoupHTTPSrc * src)
+{
+  GstStructure *s;
+  GValue connections = G_VALUE_INIT;
+  guint64 total = 0;
+  guint i;
+
+  g_value_init (&connections, GST_TYPE_ARRAY);
+
+  g_mutex_lock (&src->range_lock);
+  for (i = 0; i < src->range_workers->len; i++) {
+    GstSoupHTTPSrcRangeWorker *worker =
+        g_ptr_array_index (src->range_workers, i);
+    GValue v = G_VALUE_INIT;
+    guint64 bitrate = 0;
+
+    if (worker->busy_time > 0)
+      bitrate = gst_util_uint64_scale (worker->bytes * 8, GST_SECOND,
+          worker->busy_time);
+
+    g_value_init (&v, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&v, gst_structure_new ("connection",
+            "id", G_TYPE_UINT, worker->id,
+            "requests", G_TYPE_UINT, worker->requests,
+            "bytes", G_TYPE_UINT64, worker->bytes,
+            "bitrate", G_TYPE_UINT64, bitrate, NULL));
+    gst_value_array_append_and_take_value (&connections, &v);
+
+    total += worker->bytes;
+  }
+  g_mutex_unlock (&src->range_lock);
+
+  s = gst_structure_new ("application/x-souphttpsrc-stats",
+      "bytes", G_TYPE_UINT64, total, NULL);
+  gst_structure_take_value (s, "connections", &connections);
+
+  return s;
+}
+
 static GstFlowReturn
 gst_soup_http_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
 {
   GstSoupHTTPSrc *src;
   GstFlowReturn ret = GST_FLOW_OK;
   GstEvent *http_headers_event = NULL;
+  gboolean use_ranges;
 
   src = GST_SOUP_HTTP_SRC (psrc);
 
@@ -1784,7 +2506,10 @@ retry:
 
   /* Check for pending position change */
   if (src->request_position != src->read_position) {
-    if (src->input_stream) {
+    if (gst_soup_http_src_can_reuse_stream (src)) {
+      GST_DEBUG_OBJECT (src, "Seeking to %" G_GUINT64_FORMAT " without a new "
+          "request", src->request_position);
+    } else if (src->input_stream) {
       g_input_stream_close (src->input_stream, src->cancellable, NULL);
       g_object_unref (src->input_stream);
       src->input_stream = NULL;
@@ -1798,13 +2523,30 @@ retry:
   }
 
   /* If we have no open connection to the server, start one */
-  if (!src->input_stream) {
+  use_ranges = gst_soup_http_src_range_possible (src);
+  if (!src->input_stream && !use_ranges) {
     *outbuf = NULL;
     ret =
         gst_soup_http_src_do_request (src,
         src->method ? src->method : SOUP_METHOD_GET);
     http_headers_event = src->http_headers_event;
     src->http_headers_event = NULL;
+
+    /* Now that the size is known, the rest is downloaded with parallel
+     * range requests */
+    if (ret == GST_FLOW_OK && gst_soup_http_src_range_possible (src)) {
+      GST_DEBUG_OBJECT (src, "Switching to %u parallel range requests",
+          src->parallel_requests);
+      g_input_stream_close (src->input_stream, src->cancellable, NULL);
+      g_object_unref (src->input_stream);
+      src->input_stream = NULL;
+      g_object_unref (src->msg);
+      src->msg = NULL;
+      use_ranges = TRUE;
+    }
+  } else if (use_ranges) {
+    http_headers_event = src->http_headers_event;
+    src->http_headers_event = NULL;
   }
   g_mutex_unlock (&src->mutex);
 
@@ -1815,8 +2557,28 @@ retry:
     }
   }
 
-  if (ret == GST_FLOW_OK)
-    ret = gst_soup_http_src_read_buffer (src, outbuf);
+  if (ret == GST_FLOW_OK && use_ranges) {
+    ret = gst_soup_http_src_range_read_buffer (src, outbuf);
+    if (ret == GST_FLOW_NOT_SUPPORTED) {
+      GST_WARNING_OBJECT (src, "Server ignored the Range header, reading the "
+          "response sequentially");
+      gst_soup_http_src_range_stop (src);
+      src->range_unsupported = TRUE;
+      goto retry;
+    }
+  } else if (ret == GST_FLOW_OK) {
+    GstBuffer *rest = NULL;
+
+    if (src->request_position > src->read_position)
+      ret = gst_soup_http_src_skip (src, &rest);
+
+    if (rest)
+      *outbuf = rest;
+    else if (ret == GST_FLOW_OK && src->request_position < src->read_position)
+      ret = gst_soup_http_src_cache_read (src, outbuf);
+    else if (ret == GST_FLOW_OK)
+      ret = gst_soup_http_src_read_buffer (src, outbuf);
+  }
 
 done:
   GST_DEBUG_OBJECT (src, "Returning %d %s", ret, gst_flow_get_name (ret));
@@ -1855,6 +2617,7 @@ gst_soup_http_src_stop (GstBaseSrc * bsrc)
 
   src = GST_SOUP_HTTP_SRC (bsrc);
   GST_DEBUG_OBJECT (src, "stop()");
+  gst_soup_http_src_range_stop (src);
   if (src->keep_alive && !src->msg && !src->session_is_shared)
     gst_soup_http_src_cancel_message (src);
   else
@@ -1922,6 +2685,12 @@ gst_soup_http_src_unlock (GstBaseSrc * bsrc)
   GST_DEBUG_OBJECT (src, "unlock()");
 
   gst_soup_http_src_cancel_message (src);
+
+  g_mutex_lock (&src->range_lock);
+  src->range_flushing = TRUE;
+  src->range_restart = TRUE;
+  gst_soup_http_src_range_flush (src);
+  g_mutex_unlock (&src->range_lock);
   return TRUE;
 }
 
@@ -1935,6 +2704,10 @@ gst_soup_http_src_unlock_stop (GstBaseSrc * bsrc)
   GST_DEBUG_OBJECT (src, "unlock_stop()");
 
   g_cancellable_reset (src->cancellable);
+
+  g_mutex_lock (&src->range_lock);
+  src->range_flushing = FALSE;
+  g_mutex_unlock (&src->range_lock);
   return TRUE;
 }
 
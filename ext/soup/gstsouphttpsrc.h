@@ -77,6 +77,7 @@ struct _GstSoupHTTPSrc {
                                   Range. */
   guint64 request_position;    /* Seek to this position. */
   guint64 stop_position;       /* Stop at this position. */
+  guint64 stream_stop_position; /* Stop position of the open request. */
   gboolean have_body;          /* Indicates if it has just been signaled the
                                 * end of the message body. This is used to
                                 * decide if an out of range request should be
@@ -96,6 +97,15 @@ struct _GstSoupHTTPSrc {
   gint increase_blocksize_count;
   guint minimum_blocksize;
 
+  GstBufferPool *pool;         /* Read buffers if downstream has no pool */
+  guint pool_size;
+
+  /* Copy of the recently read data, ending at read_position */
+  guint cache_size;            /* Maximum size of the cache */
+  guint8 *cache;               /* Ring of cache_size bytes */
+  guint cache_head;            /* Where the next byte goes */
+  guint cache_bytes;
+
   /* Shoutcast/icecast metadata extraction handling. */
   gboolean iradio_mode;
   GstCaps *src_caps;
@@ -115,6 +125,21 @@ struct _GstSoupHTTPSrc {
   GCond have_headers_cond;
 
   GstEvent *http_headers_event;
+
+  /* Parallel range requests, all protected by range_lock */
+  guint parallel_requests;     /* Number of concurrent range requests */
+  guint range_chunk_size;      /* Size of each range request */
+  GMutex range_lock;
+  GCond range_cond;
+  GPtrArray *range_workers;    /* Download threads */
+  GQueue range_queue;          /* Requested ranges, in offset order */
+  guint range_cookie;          /* Changes when the queued ranges are dropped */
+  guint64 range_next;          /* Next offset to hand out to a worker */
+  guint64 range_end;           /* Offset after the last range to request */
+  gboolean range_restart;      /* Restart from request_position */
+  gboolean range_flushing;
+  gboolean range_stopping;
+  gboolean range_unsupported;  /* Server ignored a Range header */
 };
 
 struct _GstSoupHTTPSrcClass {
@@ -108,6 +108,7 @@ enum
 #define DEFAULT_BLACK_SENSITIVITY 100
 #define DEFAULT_WHITE_SENSITIVITY 100
 #define DEFAULT_PREFER_PASSTHROUGH FALSE
+#define DEFAULT_N_THREADS 1
 
 enum
 {
@@ -121,7 +122,8 @@ enum
   PROP_NOISE_LEVEL,
   PROP_BLACK_SENSITIVITY,
   PROP_WHITE_SENSITIVITY,
-  PROP_PREFER_PASSTHROUGH
+  PROP_PREFER_PASSTHROUGH,
+  PROP_N_THREADS
 };
 
 static GstStaticPadTemplate gst_alpha_src_template =
@@ -265,6 +267,11 @@ gst_alpha_class_init (GstAlphaClass * klass)
           "Don't do any processing for alpha=1.0 if possible",
           DEFAULT_PREFER_PASSTHROUGH,
           G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_N_THREADS, g_param_spec_uint ("n-threads", "Threads",
+          "Maximum number of threads to use for processing a frame "
+          "(0 = number of CPUs)", 0, G_MAXINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class, "Alpha filter",
       "Filter/Effect/Video",
@@ -299,8 +306,11 @@ gst_alpha_init (GstAlpha * alpha)
   alpha->noise_level = DEFAULT_NOISE_LEVEL;
   alpha->black_sensitivity = DEFAULT_BLACK_SENSITIVITY;
   alpha->white_sensitivity = DEFAULT_WHITE_SENSITIVITY;
+  alpha->n_threads = DEFAULT_N_THREADS;
 
   g_mutex_init (&alpha->lock);
+  g_mutex_init (&alpha->slice_lock);
+  g_cond_init (&alpha->slice_cond);
 }
 
 static void
@@ -308,7 +318,13 @@ gst_alpha_finalize (GObject * object)
 {
   GstAlpha *alpha = GST_ALPHA (object);
 
+  if (alpha->pool)
+    g_thread_pool_free (alpha->pool, FALSE, TRUE);
+  g_free (alpha->chroma_lut);
+
   g_mutex_clear (&alpha->lock);
+  g_mutex_clear (&alpha->slice_lock);
+  g_cond_clear (&alpha->slice_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -376,6 +392,9 @@ gst_alpha_set_property (GObject * object, guint prop_id,
       alpha->prefer_passthrough = prefer_passthrough;
       break;
     }
+    case PROP_N_THREADS:
+      alpha->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -424,6 +443,9 @@ gst_alpha_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_PREFER_PASSTHROUGH:
       g_value_set_boolean (value, alpha->prefer_passthrough);
       break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, alpha->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -616,6 +638,77 @@ chroma_keying_yuv (gint a, gint * y, gint * u,
   return b_alpha;
 }
 
+/* Everything chroma_keying_yuv() computes except the luma range check and
+ * the final alpha multiplication only depends on the (Cb,Cr) pair, so it is
+ * precalculated for all 65536 pairs whenever the keying parameters change.
+ *
+ * Each entry packs the alpha factor (bits 24-31), the luma suppression
+ * (bits 16-23) and the suppressed Cb/Cr values with offset (bits 8-15 and
+ * 0-7). Pixels outside the accept angle are marked with CHROMA_KEY_LUT_KEEP,
+ * which can't be a real entry as a factor of 255 implies no suppression.
+ */
+#define CHROMA_KEY_LUT_SIZE (256 * 256)
+#define CHROMA_KEY_LUT_KEEP G_MAXUINT32
+
+static void
+gst_alpha_init_chroma_lut (GstAlpha * alpha)
+{
+  guint32 *lut = alpha->chroma_lut;
+  gint i, j;
+  gint a, y, u, v;
+
+  for (i = 0; i < 256; i++) {
+    for (j = 0; j < 256; j++) {
+      /* Use the reference implementation with full luma and alpha so that
+       * the result is bit-exact with it for every input */
+      a = 256;
+      y = 255;
+      u = i - 128;
+      v = j - 128;
+
+      a = chroma_keying_yuv (a, &y, &u, &v, alpha->cr, alpha->cb, 0, 255,
+          alpha->accept_angle_tg, alpha->accept_angle_ctg,
+          alpha->one_over_kc, alpha->kfgy_scale, alpha->kg,
+          alpha->noise_level2);
+
+      if (a == 256)
+        lut[(i << 8) | j] = CHROMA_KEY_LUT_KEEP;
+      else
+        lut[(i << 8) | j] = ((guint32) a << 24) | ((255 - y) << 16) |
+            ((u + 128) << 8) | (v + 128);
+    }
+  }
+}
+
+static inline gint
+chroma_keying_yuv_lut (gint a, gint * y, gint * u, gint * v, gint smin,
+    gint smax, const guint32 * lut, const GstAlpha * alpha)
+{
+  guint32 entry;
+  gint y_sub;
+
+  /* too dark or too bright, keep alpha */
+  if (*y < smin || *y > smax)
+    return a;
+
+  /* colorimetry conversions can produce chroma outside of 8 bits */
+  if (G_UNLIKELY ((guint) (*u + 128) > 255 || (guint) (*v + 128) > 255))
+    return chroma_keying_yuv (a, y, u, v, alpha->cr, alpha->cb, smin, smax,
+        alpha->accept_angle_tg, alpha->accept_angle_ctg, alpha->one_over_kc,
+        alpha->kfgy_scale, alpha->kg, alpha->noise_level2);
+
+  entry = lut[((*u + 128) << 8) | (*v + 128)];
+  if (entry == CHROMA_KEY_LUT_KEEP)
+    return a;
+
+  y_sub = (entry >> 16) & 0xff;
+  *y = (*y < y_sub) ? 0 : *y - y_sub;
+  *u = (gint) ((entry >> 8) & 0xff) - 128;
+  *v = (gint) (entry & 0xff) - 128;
+
+  return (a * (gint) (entry >> 24)) >> 8;
+}
+
 #define APPLY_MATRIX(m,o,v1,v2,v3) ((m[o*4] * v1 + m[o*4+1] * v2 + m[o*4+2] * v3 + m[o*4+3]) >> 8)
 
 static void
@@ -676,13 +769,7 @@ gst_alpha_chroma_key_argb_ayuv (const GstVideoFrame * in_frame,
   gint r, g, b;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 256), 0, 256);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint matrix[12];
   gint o[4];
 
@@ -715,9 +802,7 @@ gst_alpha_chroma_key_argb_ayuv (const GstVideoFrame * in_frame,
       u = APPLY_MATRIX (matrix, 1, r, g, b) - 128;
       v = APPLY_MATRIX (matrix, 2, r, g, b) - 128;
 
-      a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
       u += 128;
       v += 128;
@@ -786,13 +871,7 @@ gst_alpha_chroma_key_argb_argb (const GstVideoFrame * in_frame,
   gint r, g, b;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 256), 0, 256);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint matrix[12], matrix2[12];
   gint p[4], o[4];
 
@@ -829,9 +908,7 @@ gst_alpha_chroma_key_argb_argb (const GstVideoFrame * in_frame,
       u = APPLY_MATRIX (matrix, 1, r, g, b) - 128;
       v = APPLY_MATRIX (matrix, 2, r, g, b) - 128;
 
-      a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
       u += 128;
       v += 128;
@@ -909,13 +986,7 @@ gst_alpha_chroma_key_ayuv_argb (const GstVideoFrame * in_frame,
   gint r, g, b;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 256), 0, 256);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint matrix[12];
   gint p[4];
 
@@ -944,9 +1015,7 @@ gst_alpha_chroma_key_ayuv_argb (const GstVideoFrame * in_frame,
       u = src[2] - 128;
       v = src[3] - 128;
 
-      a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
       u += 128;
       v += 128;
@@ -1026,13 +1095,7 @@ gst_alpha_chroma_key_ayuv_ayuv (const GstVideoFrame * in_frame,
   gint a, y, u, v;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 256), 0, 256);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
 
   src = GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0);
   dest = GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0);
@@ -1051,9 +1114,7 @@ gst_alpha_chroma_key_ayuv_ayuv (const GstVideoFrame * in_frame,
         u = src[2] - 128;
         v = src[3] - 128;
 
-        a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
         u += 128;
         v += 128;
@@ -1081,9 +1142,7 @@ gst_alpha_chroma_key_ayuv_ayuv (const GstVideoFrame * in_frame,
         u = APPLY_MATRIX (matrix, 1, src[1], src[2], src[3]) - 128;
         v = APPLY_MATRIX (matrix, 2, src[1], src[2], src[3]) - 128;
 
-        a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
         u += 128;
         v += 128;
@@ -1159,13 +1218,7 @@ gst_alpha_chroma_key_rgb_ayuv (const GstVideoFrame * in_frame,
   gint r, g, b;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 255), 0, 255);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint matrix[12];
   gint o[3];
   gint bpp;
@@ -1200,9 +1253,7 @@ gst_alpha_chroma_key_rgb_ayuv (const GstVideoFrame * in_frame,
       u = APPLY_MATRIX (matrix, 1, r, g, b) - 128;
       v = APPLY_MATRIX (matrix, 2, r, g, b) - 128;
 
-      a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
       u += 128;
       v += 128;
@@ -1273,13 +1324,7 @@ gst_alpha_chroma_key_rgb_argb (const GstVideoFrame * in_frame,
   gint r, g, b;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 255), 0, 255);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint matrix[12], matrix2[12];
   gint p[4], o[3];
   gint bpp;
@@ -1318,9 +1363,7 @@ gst_alpha_chroma_key_rgb_argb (const GstVideoFrame * in_frame,
       u = APPLY_MATRIX (matrix, 1, r, g, b) - 128;
       v = APPLY_MATRIX (matrix, 2, r, g, b) - 128;
 
-      a = chroma_keying_yuv (a, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
       u += 128;
       v += 128;
@@ -1468,13 +1511,7 @@ gst_alpha_chroma_key_planar_yuv_ayuv (const GstVideoFrame * in_frame,
   gint v_subs, h_subs;
   gint smin = 128 - alpha->black_sensitivity;
   gint smax = 128 + alpha->white_sensitivity;
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
 
   dest = GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0);
 
@@ -1517,9 +1554,7 @@ gst_alpha_chroma_key_planar_yuv_ayuv (const GstVideoFrame * in_frame,
         u = srcU[0] - 128;
         v = srcV[0] - 128;
 
-        a = chroma_keying_yuv (a, &y, &u, &v, cr, cb, smin,
-            smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
         u += 128;
         v += 128;
@@ -1560,9 +1595,7 @@ gst_alpha_chroma_key_planar_yuv_ayuv (const GstVideoFrame * in_frame,
         u = APPLY_MATRIX (matrix, 1, srcY[0], srcU[0], srcV[0]) - 128;
         v = APPLY_MATRIX (matrix, 2, srcY[0], srcU[0], srcV[0]) - 128;
 
-        a = chroma_keying_yuv (a, &y, &u, &v, cr, cb, smin,
-            smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[0] = a;
         dest[1] = y;
@@ -1700,13 +1733,7 @@ gst_alpha_chroma_key_planar_yuv_argb (const GstVideoFrame * in_frame,
   gint v_subs, h_subs;
   gint smin = 128 - alpha->black_sensitivity;
   gint smax = 128 + alpha->white_sensitivity;
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint matrix[12];
   gint p[4];
 
@@ -1759,9 +1786,7 @@ gst_alpha_chroma_key_planar_yuv_argb (const GstVideoFrame * in_frame,
       u = srcU[0] - 128;
       v = srcV[0] - 128;
 
-      a = chroma_keying_yuv (a, &y, &u, &v, cr, cb, smin,
-          smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (a, &y, &u, &v, smin, smax, lut, alpha);
 
       u += 128;
       v += 128;
@@ -1926,13 +1951,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
   gint a, y, u, v;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 255), 0, 255);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint p[4];                    /* Y U Y V */
   gint src_stride;
   const guint8 *src_tmp;
@@ -1968,9 +1987,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
         u = APPLY_MATRIX (matrix, 1, src[p[0]], src[p[1]], src[p[3]]) - 128;
         v = APPLY_MATRIX (matrix, 2, src[p[0]], src[p[1]], src[p[3]]) - 128;
 
-        a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[0] = a;
         dest[1] = y;
@@ -1981,9 +1998,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
         u = APPLY_MATRIX (matrix, 1, src[p[2]], src[p[1]], src[p[3]]) - 128;
         v = APPLY_MATRIX (matrix, 2, src[p[2]], src[p[1]], src[p[3]]) - 128;
 
-        a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[4] = a;
         dest[5] = y;
@@ -1999,9 +2014,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
         u = APPLY_MATRIX (matrix, 1, src[p[0]], src[p[1]], src[p[3]]) - 128;
         v = APPLY_MATRIX (matrix, 2, src[p[0]], src[p[1]], src[p[3]]) - 128;
 
-        a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[0] = a;
         dest[1] = y;
@@ -2022,9 +2035,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
         u = src[p[1]] - 128;
         v = src[p[3]] - 128;
 
-        a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[0] = a;
         dest[1] = y;
@@ -2035,9 +2046,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
         u = src[p[1]] - 128;
         v = src[p[3]] - 128;
 
-        a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[4] = a;
         dest[5] = y;
@@ -2053,9 +2062,7 @@ gst_alpha_chroma_key_packed_422_ayuv (const GstVideoFrame * in_frame,
         u = src[p[1]] - 128;
         v = src[p[3]] - 128;
 
-        a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-            smin, smax, accept_angle_tg, accept_angle_ctg,
-            one_over_kc, kfgy_scale, kg, noise_level2);
+        a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
 
         dest[0] = a;
         dest[1] = y;
@@ -2162,13 +2169,7 @@ gst_alpha_chroma_key_packed_422_argb (const GstVideoFrame * in_frame,
   gint r, g, b;
   gint smin, smax;
   gint pa = CLAMP ((gint) (alpha->alpha * 255), 0, 255);
-  gint8 cb = alpha->cb, cr = alpha->cr;
-  gint8 kg = alpha->kg;
-  guint8 accept_angle_tg = alpha->accept_angle_tg;
-  guint8 accept_angle_ctg = alpha->accept_angle_ctg;
-  guint8 one_over_kc = alpha->one_over_kc;
-  guint8 kfgy_scale = alpha->kfgy_scale;
-  guint noise_level2 = alpha->noise_level2;
+  const guint32 *lut = alpha->chroma_lut;
   gint p[4], o[4];
   gint src_stride;
   const guint8 *src_tmp;
@@ -2207,9 +2208,7 @@ gst_alpha_chroma_key_packed_422_argb (const GstVideoFrame * in_frame,
       u = src[o[1]] - 128;
       v = src[o[3]] - 128;
 
-      a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
       u += 128;
       v += 128;
 
@@ -2226,9 +2225,7 @@ gst_alpha_chroma_key_packed_422_argb (const GstVideoFrame * in_frame,
       u = src[o[1]] - 128;
       v = src[o[3]] - 128;
 
-      a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
       u += 128;
       v += 128;
 
@@ -2250,9 +2247,7 @@ gst_alpha_chroma_key_packed_422_argb (const GstVideoFrame * in_frame,
       u = src[o[1]] - 128;
       v = src[o[3]] - 128;
 
-      a = chroma_keying_yuv (pa, &y, &u, &v, cr, cb,
-          smin, smax, accept_angle_tg, accept_angle_ctg,
-          one_over_kc, kfgy_scale, kg, noise_level2);
+      a = chroma_keying_yuv_lut (pa, &y, &u, &v, smin, smax, lut, alpha);
       u += 128;
       v += 128;
 
@@ -2355,6 +2350,12 @@ gst_alpha_init_params_full (GstAlpha * alpha,
   alpha->kg = MIN (kgl, 127);
 
   alpha->noise_level2 = alpha->noise_level * alpha->noise_level;
+
+  if (alpha->method != ALPHA_METHOD_SET) {
+    if (!alpha->chroma_lut)
+      alpha->chroma_lut = g_new (guint32, CHROMA_KEY_LUT_SIZE);
+    gst_alpha_init_chroma_lut (alpha);
+  }
 }
 
 static void
@@ -2574,18 +2575,124 @@ gst_alpha_before_transform (GstBaseTransform * btrans, GstBuffer * buf)
     gst_object_sync_values (GST_OBJECT (alpha), timestamp);
 }
 
+typedef struct
+{
+  GstVideoFrame in_frame;
+  GstVideoFrame out_frame;
+} GstAlphaSlice;
+
+/* Makes @slice a view on the lines [@y, @y + @height) of @frame. @y must be
+ * a multiple of the vertical subsampling of all components */
+static void
+gst_alpha_frame_slice (const GstVideoFrame * frame, gint y, gint height,
+    GstVideoFrame * slice)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  guint i, plane;
+
+  *slice = *frame;
+  slice->info.height = height;
+
+  for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); i++) {
+    plane = GST_VIDEO_FORMAT_INFO_PLANE (finfo, i);
+    slice->data[plane] = (guint8 *) frame->data[plane] +
+        GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, i, y) *
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, plane);
+  }
+}
+
+static gint
+gst_alpha_frame_line_align (const GstVideoFrame * frame)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  guint i, h_sub = 0;
+
+  for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); i++)
+    h_sub = MAX (h_sub, GST_VIDEO_FORMAT_INFO_H_SUB (finfo, i));
+
+  return 1 << h_sub;
+}
+
+static void
+gst_alpha_process_slice (gpointer data, gpointer user_data)
+{
+  GstAlphaSlice *slice = data;
+  GstAlpha *alpha = user_data;
+
+  alpha->process (&slice->in_frame, &slice->out_frame, alpha);
+
+  g_mutex_lock (&alpha->slice_lock);
+  if (--alpha->slices_pending == 0)
+    g_cond_signal (&alpha->slice_cond);
+  g_mutex_unlock (&alpha->slice_lock);
+}
+
+/* Protected with the alpha lock */
+static void
+gst_alpha_process_sliced (GstAlpha * alpha, const GstVideoFrame * in_frame,
+    GstVideoFrame * out_frame, guint n_slices)
+{
+  GstAlphaSlice *slices;
+  gint height, align, lines, y;
+  guint i;
+
+  height = GST_VIDEO_FRAME_HEIGHT (in_frame);
+  align = MAX (gst_alpha_frame_line_align (in_frame),
+      gst_alpha_frame_line_align (out_frame));
+  lines = GST_ROUND_UP_N ((height + n_slices - 1) / n_slices, align);
+  n_slices = (height + lines - 1) / lines;
+
+  if (alpha->pool == NULL) {
+    alpha->pool = g_thread_pool_new (gst_alpha_process_slice, alpha,
+        n_slices - 1, FALSE, NULL);
+  } else if (g_thread_pool_get_max_threads (alpha->pool) < n_slices - 1) {
+    g_thread_pool_set_max_threads (alpha->pool, n_slices - 1, NULL);
+  }
+
+  slices = g_new (GstAlphaSlice, n_slices);
+  for (i = 0, y = 0; i < n_slices; i++, y += lines) {
+    gst_alpha_frame_slice (in_frame, y, MIN (lines, height - y),
+        &slices[i].in_frame);
+    gst_alpha_frame_slice (out_frame, y, MIN (lines, height - y),
+        &slices[i].out_frame);
+  }
+
+  alpha->slices_pending = n_slices - 1;
+  for (i = 1; i < n_slices; i++)
+    g_thread_pool_push (alpha->pool, &slices[i], NULL);
+
+  /* the first slice is handled by the streaming thread */
+  alpha->process (&slices[0].in_frame, &slices[0].out_frame, alpha);
+
+  g_mutex_lock (&alpha->slice_lock);
+  while (alpha->slices_pending > 0)
+    g_cond_wait (&alpha->slice_cond, &alpha->slice_lock);
+  g_mutex_unlock (&alpha->slice_lock);
+
+  g_free (slices);
+}
+
 static GstFlowReturn
 gst_alpha_transform_frame (GstVideoFilter * filter, GstVideoFrame * in_frame,
     GstVideoFrame * out_frame)
 {
   GstAlpha *alpha = GST_ALPHA (filter);
+  guint n_slices;
 
   GST_ALPHA_LOCK (alpha);
 
   if (G_UNLIKELY (!alpha->process))
     goto not_negotiated;
 
-  alpha->process (in_frame, out_frame, alpha);
+  n_slices = alpha->n_threads;
+  if (n_slices == 0)
+    n_slices = g_get_num_processors ();
+  n_slices = MIN (n_slices, GST_VIDEO_FRAME_HEIGHT (in_frame) / 16);
+
+  if (n_slices > 1)
+    gst_alpha_process_sliced (alpha, in_frame, out_frame, n_slices);
+  else
+    alpha->process (in_frame, out_frame, alpha);
 
   GST_ALPHA_UNLOCK (alpha);
 
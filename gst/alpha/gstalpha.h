@@ -88,6 +88,7 @@ struct _GstAlpha
   guint white_sensitivity;
 
   gboolean prefer_passthrough;
+  guint n_threads;
 
   /* processing function */
   void (*process) (const GstVideoFrame *in_frame, GstVideoFrame *out_frame, GstAlpha *alpha);
@@ -100,6 +101,13 @@ struct _GstAlpha
   guint8 one_over_kc;
   guint8 kfgy_scale;
   guint noise_level2;
+  guint32 *chroma_lut;
+
+  /* slice-parallel processing */
+  GThreadPool *pool;
+  GMutex slice_lock;
+  GCond slice_cond;
+  guint slices_pending;
 };
 
 struct _GstAlphaClass
@@ -60,6 +60,19 @@
 #define ENTRY_SET_KEYFRAME(e) ((e)->flags = GST_AVI_KEYFRAME)
 #define ENTRY_UNSET_KEYFRAME(e) ((e)->flags = 0)
 
+#define ENTRY_OFFSET(e) ((((guint64) (e)->offset_hi) << 32) | (e)->offset_lo)
+#define ENTRY_TOTAL(e) ((((guint64) (e)->total_hi) << 32) | (e)->total_lo)
+#define ENTRY_SET_OFFSET(e,o) G_STMT_START {    \
+  guint64 _o = (o);                             \
+  (e)->offset_hi = _o >> 32;                    \
+  (e)->offset_lo = _o & G_MAXUINT32;            \
+} G_STMT_END
+#define ENTRY_SET_TOTAL(e,t) G_STMT_START {     \
+  guint64 _t = (t);                             \
+  (e)->total_hi = _t >> 32;                     \
+  (e)->total_lo = _t & G_MAXUINT32;             \
+} G_STMT_END
+
 
 GST_DEBUG_CATEGORY_STATIC (avidemux_debug);
 #define GST_CAT_DEFAULT avidemux_debug
@@ -312,6 +325,14 @@ gst_avi_demux_reset (GstAviDemux * avi)
 }
 
 
+/* In pull mode, the subindexes of a stream are only loaded when they are
+ * needed, @stream->indexes then holds the ones that are still to be read */
+static inline gboolean
+gst_avi_demux_subindex_pending (GstAviDemux * avi, GstAviStream * stream)
+{
+  return !avi->streaming && stream->indexes != NULL;
+}
+
 /* GstElement methods */
 
 #if 0
@@ -545,7 +566,8 @@ gst_avi_demux_handle_src_query (GstPad * pad, GstObject * parent,
           GST_DEBUG_OBJECT (query, "total frames is %" G_GUINT32_FORMAT,
               stream->idx_n);
 
-          if (stream->idx_n > 0)
+          if (stream->idx_n > 0 && !gst_avi_demux_subindex_pending (avi,
+                  stream))
             gst_query_set_duration (query, fmt, stream->idx_n);
           else if (gst_pad_query_convert (pad, GST_FORMAT_TIME,
                   duration, fmt, &dur))
@@ -679,9 +701,9 @@ static gint
 gst_avi_demux_index_entry_offset_search (GstAviIndexEntry * entry,
     guint64 * offset)
 {
-  if (entry->offset < *offset)
+  if (ENTRY_OFFSET (entry) < *offset)
     return -1;
-  else if (entry->offset > *offset)
+  else if (ENTRY_OFFSET (entry) > *offset)
     return 1;
   return 0;
 }
@@ -713,7 +735,7 @@ gst_avi_demux_seek_streams_index (GstAviDemux * avi, guint64 offset,
 
     if (before) {
       if (entry) {
-        val = stream->index[index].offset;
+        val = ENTRY_OFFSET (&stream->index[index]);
         GST_DEBUG_OBJECT (avi,
             "stream %d, previous entry at %" G_GUINT64_FORMAT, i, val);
         if (val < min)
@@ -729,11 +751,11 @@ gst_avi_demux_seek_streams_index (GstAviDemux * avi, guint64 offset,
       continue;
     }
 
-    val = stream->index[index].offset - 8;
+    val = ENTRY_OFFSET (&stream->index[index]) - 8;
     GST_DEBUG_OBJECT (avi, "stream %d, next entry at %" G_GUINT64_FORMAT, i,
         val);
 
-    stream->current_total = stream->index[index].total;
+    stream->current_total = ENTRY_TOTAL (&stream->index[index]);
     stream->current_entry = index;
   }
 
@@ -798,12 +820,12 @@ gst_avi_demux_handle_sink_event (GstPad * pad, GstObject * parent,
           index = entry - stream->index;
 
           /* we are on the stream with a chunk start offset closest to start */
-          if (!offset || stream->index[index].offset < offset) {
-            offset = stream->index[index].offset;
+          if (!offset || ENTRY_OFFSET (&stream->index[index]) < offset) {
+            offset = ENTRY_OFFSET (&stream->index[index]);
             k = i;
           }
           /* exact match needs no further searching */
-          if (stream->index[index].offset == boffset)
+          if (ENTRY_OFFSET (&stream->index[index]) == boffset)
             break;
         } while (++i < avi->num_streams);
         boffset -= 8;
@@ -1352,9 +1374,9 @@ gst_avi_demux_add_index (GstAviDemux * avi, GstAviStream * stream,
     gint blockalign;
 
     if (stream->is_vbr) {
-      entry->total = stream->total_blocks;
+      ENTRY_SET_TOTAL (entry, stream->total_blocks);
     } else {
-      entry->total = stream->total_bytes;
+      ENTRY_SET_TOTAL (entry, stream->total_bytes);
     }
     blockalign = stream->strf.auds->blockalign;
     if (blockalign > 0)
@@ -1363,9 +1385,9 @@ gst_avi_demux_add_index (GstAviDemux * avi, GstAviStream * stream,
       stream->total_blocks++;
   } else {
     if (stream->is_vbr) {
-      entry->total = stream->idx_n;
+      ENTRY_SET_TOTAL (entry, stream->idx_n);
     } else {
-      entry->total = stream->total_bytes;
+      ENTRY_SET_TOTAL (entry, stream->total_bytes);
     }
   }
   stream->total_bytes += entry->size;
@@ -1376,8 +1398,8 @@ gst_avi_demux_add_index (GstAviDemux * avi, GstAviStream * stream,
   GST_LOG_OBJECT (avi,
       "Adding stream %u, index entry %d, kf %d, size %u "
       ", offset %" G_GUINT64_FORMAT ", total %" G_GUINT64_FORMAT, stream->num,
-      stream->idx_n, ENTRY_IS_KEYFRAME (entry), entry->size, entry->offset,
-      entry->total);
+      stream->idx_n, ENTRY_IS_KEYFRAME (entry), entry->size,
+      ENTRY_OFFSET (entry), ENTRY_TOTAL (entry));
   stream->index[stream->idx_n++] = *entry;
 
   return TRUE;
@@ -1399,13 +1421,14 @@ gst_avi_demux_get_buffer_info (GstAviDemux * avi, GstAviStream * stream,
     if (stream->strh->type == GST_RIFF_FCC_auds) {
       if (timestamp)
         *timestamp =
-            avi_stream_convert_frames_to_time_unchecked (stream, entry->total);
+            avi_stream_convert_frames_to_time_unchecked (stream,
+            ENTRY_TOTAL (entry));
       if (ts_end) {
         gint size = 1;
         if (G_LIKELY (entry_n + 1 < stream->idx_n))
-          size = stream->index[entry_n + 1].total - entry->total;
+          size = ENTRY_TOTAL (&stream->index[entry_n + 1]) - ENTRY_TOTAL (entry);
         *ts_end = avi_stream_convert_frames_to_time_unchecked (stream,
-            entry->total + size);
+            ENTRY_TOTAL (entry) + size);
       }
     } else {
       if (timestamp)
@@ -1419,10 +1442,11 @@ gst_avi_demux_get_buffer_info (GstAviDemux * avi, GstAviStream * stream,
     /* constant rate stream */
     if (timestamp)
       *timestamp =
-          avi_stream_convert_bytes_to_time_unchecked (stream, entry->total);
+          avi_stream_convert_bytes_to_time_unchecked (stream,
+          ENTRY_TOTAL (entry));
     if (ts_end)
       *ts_end = avi_stream_convert_bytes_to_time_unchecked (stream,
-          entry->total + entry->size);
+          ENTRY_TOTAL (entry) + entry->size);
   }
   if (stream->strh->type == GST_RIFF_FCC_vids) {
     /* video offsets are the frame number */
@@ -1484,7 +1508,8 @@ gst_avi_demux_do_index_stats (GstAviDemux * avi)
     if (!stream->taglist) {
       stream->taglist = gst_tag_list_new_empty ();
     }
-    if (stream->total_bytes && stream->idx_duration)
+    if (stream->total_bytes && stream->idx_duration
+        && !gst_avi_demux_subindex_pending (avi, stream))
       gst_tag_list_add (stream->taglist, GST_TAG_MERGE_REPLACE,
           GST_TAG_BITRATE,
           (guint) gst_util_uint64_scale (stream->total_bytes * 8,
@@ -1568,23 +1593,25 @@ gst_avi_demux_parse_subindex (GstAviDemux * avi, GstAviStream * stream,
 
   for (i = 0; i < num; i++) {
     GstAviIndexEntry entry;
+    guint32 size;
 
     if (map.size < 24 + bpe * (i + 1))
       break;
 
-    /* fill in offset and size. offset contains the keyframe flag in the
+    /* fill in offset and size. size contains the keyframe flag in the
      * upper bit*/
-    entry.offset = baseoff + GST_READ_UINT32_LE (&data[24 + bpe * i]);
-    entry.size = GST_READ_UINT32_LE (&data[24 + bpe * i + 4]);
+    ENTRY_SET_OFFSET (&entry, baseoff + GST_READ_UINT32_LE (&data[24 +
+                bpe * i]));
+    size = GST_READ_UINT32_LE (&data[24 + bpe * i + 4]);
     /* handle flags */
     if (stream->strh->type == GST_RIFF_FCC_auds) {
       /* all audio frames are keyframes */
       ENTRY_SET_KEYFRAME (&entry);
     } else {
       /* else read flags */
-      entry.flags = (entry.size & 0x80000000) ? 0 : GST_AVI_KEYFRAME;
+      entry.flags = (size & 0x80000000) ? 0 : GST_AVI_KEYFRAME;
     }
-    entry.size &= ~0x80000000;
+    entry.size = size & ~0x80000000;
 
     /* and add */
     if (G_UNLIKELY (!gst_avi_demux_add_index (avi, stream, num, &entry)))
@@ -1715,15 +1742,71 @@ gst_avi_demux_read_subindexes_push (GstAviDemux * avi)
       avi->segment_seqnum);
 }
 
+/*
+ * Read the next AVI subindex of @stream that has entries
+ *
+ * Returns: TRUE if entries were added to the index.
+ */
+static gboolean
+gst_avi_demux_read_next_subindex_pull (GstAviDemux * avi,
+    GstAviStream * stream)
+{
+  guint32 tag;
+  GstBuffer *buf;
+  guint64 offset;
+  guint old_n = stream->idx_n;
+
+  while (stream->indexes != NULL && stream->idx_n == old_n) {
+    offset = stream->indexes[stream->next_subindex];
+    if (offset == GST_BUFFER_OFFSET_NONE) {
+      g_free (stream->indexes);
+      stream->indexes = NULL;
+      break;
+    }
+    stream->next_subindex++;
+
+    GST_DEBUG_OBJECT (avi, "reading subindex %u of stream %u at %"
+        G_GUINT64_FORMAT, stream->next_subindex - 1, stream->num, offset);
+
+    if (gst_riff_read_chunk (GST_ELEMENT_CAST (avi), avi->sinkpad,
+            &offset, &tag, &buf) != GST_FLOW_OK)
+      continue;
+    else if ((tag != GST_MAKE_FOURCC ('i', 'x', '0' + stream->num / 10,
+                '0' + stream->num % 10)) &&
+        (tag != GST_MAKE_FOURCC ('0' + stream->num / 10,
+                '0' + stream->num % 10, 'i', 'x'))) {
+      /* Some ODML files (created by god knows what muxer) have a ##ix format
+       * instead of the 'official' ix##. They are still valid though. */
+      GST_WARNING_OBJECT (avi, "Not an ix## chunk (%" GST_FOURCC_FORMAT ")",
+          GST_FOURCC_ARGS (tag));
+      gst_buffer_unref (buf);
+      continue;
+    }
+
+    gst_avi_demux_parse_subindex (avi, stream, buf);
+  }
+
+  if (stream->idx_n == old_n)
+    return FALSE;
+
+  /* the index now reaches this far */
+  gst_avi_demux_get_buffer_info (avi, stream, stream->idx_n - 1,
+      NULL, &stream->idx_duration, NULL, NULL);
+
+  return TRUE;
+}
+
 /*
  * Read AVI index
+ *
+ * Only the first subindex of each stream is read here, the others follow
+ * on demand when playback or a seek gets there. For long OpenDML files this
+ * avoids reading all of the scattered subindexes before the first buffer.
  */
 static void
 gst_avi_demux_read_subindexes_pull (GstAviDemux * avi)
 {
-  guint32 tag;
-  GstBuffer *buf;
-  gint i, n;
+  gint n;
 
   GST_DEBUG_OBJECT (avi, "read subindexes for %d streams", avi->num_streams);
 
@@ -1733,31 +1816,19 @@ gst_avi_demux_read_subindexes_pull (GstAviDemux * avi)
     if (stream->indexes == NULL)
       continue;
 
-    for (i = 0; stream->indexes[i] != GST_BUFFER_OFFSET_NONE; i++) {
-      if (gst_riff_read_chunk (GST_ELEMENT_CAST (avi), avi->sinkpad,
-              &stream->indexes[i], &tag, &buf) != GST_FLOW_OK)
-        continue;
-      else if ((tag != GST_MAKE_FOURCC ('i', 'x', '0' + stream->num / 10,
-                  '0' + stream->num % 10)) &&
-          (tag != GST_MAKE_FOURCC ('0' + stream->num / 10,
-                  '0' + stream->num % 10, 'i', 'x'))) {
-        /* Some ODML files (created by god knows what muxer) have a ##ix format
-         * instead of the 'official' ix##. They are still valid though. */
-        GST_WARNING_OBJECT (avi, "Not an ix## chunk (%" GST_FOURCC_FORMAT ")",
-            GST_FOURCC_ARGS (tag));
-        gst_buffer_unref (buf);
-        continue;
-      }
-
-      if (!gst_avi_demux_parse_subindex (avi, stream, buf))
-        continue;
-    }
-
-    g_free (stream->indexes);
-    stream->indexes = NULL;
+    stream->next_subindex = 0;
+    gst_avi_demux_read_next_subindex_pull (avi, stream);
   }
   /* get stream stats now */
   avi->have_index = gst_avi_demux_do_index_stats (avi);
+
+  if (!avi->have_index) {
+    /* another index will be used, don't add the subindexes to it later */
+    for (n = 0; n < avi->num_streams; n++) {
+      g_free (avi->stream[n].indexes);
+      avi->stream[n].indexes = NULL;
+    }
+  }
 }
 
 /*
@@ -2611,9 +2682,9 @@ gst_avi_demux_index_next (GstAviDemux * avi, GstAviStream * stream,
 static guint
 gst_avi_demux_index_entry_search (GstAviIndexEntry * entry, guint64 * total)
 {
-  if (entry->total < *total)
+  if (ENTRY_TOTAL (entry) < *total)
     return -1;
-  else if (entry->total > *total)
+  else if (ENTRY_TOTAL (entry) > *total)
     return 1;
   return 0;
 }
@@ -2640,6 +2711,13 @@ gst_avi_demux_index_for_time (GstAviDemux * avi,
 
   GST_LOG_OBJECT (avi, "search time:%" GST_TIME_FORMAT, GST_TIME_ARGS (time));
 
+  /* load the subindexes up to @time */
+  while (time != 0 && (stream->idx_n == 0 || time >= stream->idx_duration) &&
+      gst_avi_demux_subindex_pending (avi, stream)) {
+    if (!gst_avi_demux_read_next_subindex_pull (avi, stream))
+      break;
+  }
+
   /* easy (and common) cases */
   if (time == 0 || stream->idx_n == 0)
     return 0;
@@ -2753,8 +2831,7 @@ gst_avi_demux_parse_index (GstAviDemux * avi, GstBuffer * buf)
   index = (gst_riff_index_entry *) map.data;
 
   /* figure out if the index is 0 based or relative to the MOVI start */
-  entry.offset = GST_READ_UINT32_LE (&index[0].offset);
-  if (entry.offset < avi->offset) {
+  if (GST_READ_UINT32_LE (&index[0].offset) < avi->offset) {
     avi->index_offset = avi->offset + 8;
     GST_DEBUG ("index_offset = %" G_GUINT64_FORMAT, avi->index_offset);
   } else {
@@ -2763,12 +2840,13 @@ gst_avi_demux_parse_index (GstAviDemux * avi, GstBuffer * buf)
   }
 
   for (i = 0, n = 0; i < num; i++) {
+    guint32 offset, size;
+
     id = GST_READ_UINT32_LE (&index[i].id);
-    entry.offset = GST_READ_UINT32_LE (&index[i].offset);
+    offset = GST_READ_UINT32_LE (&index[i].offset);
 
     /* some sanity checks */
-    if (G_UNLIKELY (id == GST_RIFF_rec || id == 0 ||
-            (entry.offset == 0 && n > 0)))
+    if (G_UNLIKELY (id == GST_RIFF_rec || id == 0 || (offset == 0 && n > 0)))
       continue;
 
     /* get the stream for this entry */
@@ -2776,9 +2854,16 @@ gst_avi_demux_parse_index (GstAviDemux * avi, GstBuffer * buf)
     if (G_UNLIKELY (!stream))
       continue;
 
-    /* handle offset and size */
-    entry.offset += avi->index_offset + 8;
-    entry.size = GST_READ_UINT32_LE (&index[i].size);
+    /* handle offset and size. Index entries only have 31 bits for the
+     * size, larger chunks can't be valid anyway */
+    size = GST_READ_UINT32_LE (&index[i].size);
+    if (G_UNLIKELY (size > GST_AVI_MAX_ENTRY_SIZE)) {
+      GST_WARNING_OBJECT (avi, "Ignoring index entry %u with invalid size %u",
+          i, size);
+      continue;
+    }
+    ENTRY_SET_OFFSET (&entry, offset + avi->index_offset + 8);
+    entry.size = size;
 
     /* handle flags */
     if (stream->strh->type == GST_RIFF_FCC_auds) {
@@ -3157,9 +3242,15 @@ gst_avi_demux_stream_scan (GstAviDemux * avi)
     if (G_UNLIKELY (!stream))
       goto next;
 
+    if (G_UNLIKELY (size > GST_AVI_MAX_ENTRY_SIZE)) {
+      GST_WARNING_OBJECT (avi, "Not indexing chunk at %" G_GUINT64_FORMAT
+          " with invalid size %u", pos, size);
+      goto next;
+    }
+
     /* we can't figure out the keyframes, assume they all are */
-    entry.flags = GST_AVI_KEYFRAME;
-    entry.offset = pos;
+    ENTRY_SET_KEYFRAME (&entry);
+    ENTRY_SET_OFFSET (&entry, pos);
     entry.size = size;
 
     /* and add to the index of this stream */
@@ -3212,8 +3303,12 @@ gst_avi_demux_calculate_durations_from_index (GstAviDemux * avi)
 
     /* get header duration for the stream */
     hduration = stream->hdr_duration;
-    /* index duration calculated during parsing */
-    duration = stream->idx_duration;
+    /* index duration calculated during parsing, unless the index is still
+     * partial */
+    if (gst_avi_demux_subindex_pending (avi, stream))
+      duration = GST_CLOCK_TIME_NONE;
+    else
+      duration = stream->idx_duration;
 
     /* now pick a good duration */
     if (GST_CLOCK_TIME_IS_VALID (duration)) {
@@ -4464,7 +4559,7 @@ gst_avi_demux_move_stream (GstAviDemux * avi, GstAviStream * stream,
       stream->current_offset_end);
 
   GST_DEBUG_OBJECT (avi, "Seeking to offset %" G_GUINT64_FORMAT,
-      stream->index[index].offset);
+      ENTRY_OFFSET (&stream->index[index]));
 }
 
 /*
@@ -4811,7 +4906,7 @@ avi_demux_handle_seek_push (GstAviDemux * avi, GstPad * pad, GstEvent * event)
   /* re-use cur to be the timestamp of the seek as it _will_ be */
   cur = stream->current_timestamp;
 
-  min_offset = stream->index[index].offset;
+  min_offset = ENTRY_OFFSET (&stream->index[index]);
   avi->seek_kf_offset = min_offset - 8;
 
   GST_DEBUG_OBJECT (avi,
@@ -4854,8 +4949,8 @@ avi_demux_handle_seek_push (GstAviDemux * avi, GstPad * pad, GstEvent * event)
         &str->current_timestamp, &str->current_ts_end,
         &str->current_offset, &str->current_offset_end);
 
-    if (str->index[idx].offset < min_offset) {
-      min_offset = str->index[idx].offset;
+    if (ENTRY_OFFSET (&str->index[idx]) < min_offset) {
+      min_offset = ENTRY_OFFSET (&str->index[idx]);
       GST_DEBUG_OBJECT (avi,
           "Found an earlier offset at %" G_GUINT64_FORMAT ", str %u",
           min_offset, n);
@@ -5091,6 +5186,13 @@ gst_avi_demux_advance (GstAviDemux * avi, GstAviStream * stream,
 
       /* and start from the previous keyframe now */
       new_entry = stream->step_entry;
+    } else if (stream->stop_entry == gst_avi_demux_index_last (avi, stream)
+        && gst_avi_demux_subindex_pending (avi, stream)
+        && gst_avi_demux_read_next_subindex_pull (avi, stream)) {
+      /* the index goes on in the next subindex */
+      stream->stop_entry = gst_avi_demux_index_last (avi, stream);
+      GST_DEBUG_OBJECT (avi, "loaded next subindex, stop now %u",
+          stream->stop_entry);
     } else {
       /* EOS */
       GST_DEBUG_OBJECT (avi, "forward reached stop %u", stream->stop_entry);
@@ -5100,7 +5202,7 @@ gst_avi_demux_advance (GstAviDemux * avi, GstAviStream * stream,
 
   if (new_entry != old_entry) {
     stream->current_entry = new_entry;
-    stream->current_total = stream->index[new_entry].total;
+    stream->current_total = ENTRY_TOTAL (&stream->index[new_entry]);
 
     if (new_entry == old_entry + 1) {
       GST_DEBUG_OBJECT (avi, "moved forwards from %u to %u",
@@ -5255,7 +5357,7 @@ gst_avi_demux_loop_data (GstAviDemux * avi)
 
     /* get the entry data info */
     entry = &stream->index[stream->current_entry];
-    offset = entry->offset;
+    offset = ENTRY_OFFSET (entry);
     size = entry->size;
     keyframe = ENTRY_IS_KEYFRAME (entry);
 
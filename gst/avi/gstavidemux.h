@@ -49,14 +49,20 @@ G_BEGIN_DECLS
    (((chunkid) >> 8) & 0xff) - '0')
 
 
-/* new index entries 24 bytes */
+/* new index entries 16 bytes. offset and total are 48 bits, split in a high
+ * and a low part to avoid padding, use the ENTRY_* macros to access them */
 typedef struct {
-  guint32        flags;
-  guint32        size;    /* bytes of the data */
-  guint64        offset;  /* data offset in file */
-  guint64        total;   /* total bytes before */
+  guint32        size:31; /* bytes of the data */
+  guint32        flags:1;
+  guint16        offset_hi;
+  guint16        total_hi;
+  guint32        offset_lo; /* data offset in file */
+  guint32        total_lo;  /* total bytes before */
 } GstAviIndexEntry;
 
+/* largest chunk size an index entry can hold */
+#define GST_AVI_MAX_ENTRY_SIZE G_MAXINT32
+
 typedef struct {
   /* index of this streamcontext */
   guint          num;
@@ -110,6 +116,8 @@ typedef struct {
   /* openDML support (for files >4GB) */
   gboolean       superindex;
   guint64       *indexes;
+  /* next subindex to load on demand, in pull mode */
+  guint          next_subindex;
 
   /* new indexes */
   GstAviIndexEntry *index;     /* array with index entries */
@@ -47,13 +47,6 @@
 #include <gst/video/video.h>
 #include <gst/tag/tag.h>
 
-/* FIXME: don't rely on own GstIndex */
-#include "gstindex.c"
-#include "gstmemindex.c"
-#define GST_ASSOCIATION_FLAG_NONE GST_INDEX_ASSOCIATION_FLAG_NONE
-#define GST_ASSOCIATION_FLAG_KEY_UNIT GST_INDEX_ASSOCIATION_FLAG_KEY_UNIT
-#define GST_ASSOCIATION_FLAG_DELTA_UNIT GST_INDEX_ASSOCIATION_FLAG_DELTA_UNIT
-
 static GstStaticPadTemplate flv_sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -102,6 +95,24 @@ G_DEFINE_TYPE (GstFlvDemux, gst_flv_demux, GST_TYPE_ELEMENT);
 /* how much stream time to wait for audio tags to appear after we have video, or vice versa */
 #define NO_MORE_PADS_THRESHOLD (6 * GST_SECOND)
 
+/* how many tags to scan ahead after each tag when building the index in the
+ * background */
+#define INDEX_SCAN_STEP 16
+
+enum
+{
+  PROP_0,
+  PROP_BACKGROUND_INDEX
+};
+
+#define DEFAULT_BACKGROUND_INDEX FALSE
+
+typedef struct
+{
+  GstClockTime time;
+  guint64 pos;
+} GstFlvDemuxIndexEntry;
+
 static gboolean flv_demux_handle_seek_push (GstFlvDemux * demux,
     GstEvent * event);
 static gboolean gst_flv_demux_handle_seek_pull (GstFlvDemux * demux,
@@ -112,17 +123,67 @@ static gboolean gst_flv_demux_query (GstPad * pad, GstObject * parent,
 static gboolean gst_flv_demux_src_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 
-static GstIndex *gst_flv_demux_get_index (GstElement * element);
-
 static void gst_flv_demux_push_tags (GstFlvDemux * demux);
 
+static void gst_flv_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_flv_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gint
+gst_flv_demux_index_compare_time (gconstpointer a, gconstpointer b,
+    gpointer user_data)
+{
+  const GstFlvDemuxIndexEntry *entry = a;
+  GstClockTime time = *(const GstClockTime *) b;
+
+  if (entry->time < time)
+    return -1;
+  else if (entry->time > time)
+    return 1;
+  return 0;
+}
+
+static gint
+gst_flv_demux_index_compare_pos (gconstpointer a, gconstpointer b,
+    gpointer user_data)
+{
+  const GstFlvDemuxIndexEntry *entry = a;
+  guint64 pos = *(const guint64 *) b;
+
+  if (entry->pos < pos)
+    return -1;
+  else if (entry->pos > pos)
+    return 1;
+  return 0;
+}
+
+/* Looks up a keyframe in the index, which is sorted by both time and
+ * position, and copies it into @result */
+static gboolean
+gst_flv_demux_index_lookup (GstFlvDemux * demux, GCompareDataFunc compare,
+    GstSearchMode mode, gconstpointer value, GstFlvDemuxIndexEntry * result)
+{
+  GstFlvDemuxIndexEntry *entry = NULL;
+
+  GST_OBJECT_LOCK (demux);
+  if (demux->index->len > 0)
+    entry = gst_util_array_binary_search (demux->index->data,
+        demux->index->len, sizeof (GstFlvDemuxIndexEntry), compare, mode,
+        value, NULL);
+  if (entry)
+    *result = *entry;
+  GST_OBJECT_UNLOCK (demux);
+
+  return entry != NULL;
+}
+
 static void
 gst_flv_demux_parse_and_add_index_entry (GstFlvDemux * demux, GstClockTime ts,
     guint64 pos, gboolean keyframe)
 {
-  GstIndexAssociation associations[2];
-  GstIndex *index;
-  GstIndexEntry *entry;
+  GstFlvDemuxIndexEntry entry, *prev;
+  guint idx;
 
   GST_LOG_OBJECT (demux,
       "adding key=%d association %" GST_TIME_FORMAT "-> %" G_GUINT64_FORMAT,
@@ -132,48 +193,54 @@ gst_flv_demux_parse_and_add_index_entry (GstFlvDemux * demux, GstClockTime ts,
   if (!demux->upstream_seekable)
     return;
 
-  index = gst_flv_demux_get_index (GST_ELEMENT (demux));
+  if (pos > demux->index_max_pos)
+    demux->index_max_pos = pos;
+  if (ts > demux->index_max_time)
+    demux->index_max_time = ts;
 
-  if (!index)
+  /* only keyframes are used as seek targets */
+  if (!keyframe)
     return;
 
-  /* entry may already have been added before, avoid adding indefinitely */
-  entry = gst_index_get_assoc_entry (index, demux->index_id,
-      GST_INDEX_LOOKUP_EXACT, GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, pos);
+  entry.time = ts;
+  entry.pos = pos;
 
-  if (entry) {
-#ifndef GST_DISABLE_GST_DEBUG
-    gint64 time = 0;
-    gboolean key;
-
-    gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
-    key = ! !(GST_INDEX_ASSOC_FLAGS (entry) & GST_ASSOCIATION_FLAG_KEY_UNIT);
-    GST_LOG_OBJECT (demux, "position already mapped to time %" GST_TIME_FORMAT
-        ", keyframe %d", GST_TIME_ARGS (time), key);
-    /* there is not really a way to delete the existing one */
-    if (time != ts || key != ! !keyframe)
-      GST_DEBUG_OBJECT (demux, "metadata mismatch");
-#endif
-    gst_object_unref (index);
-    return;
-  }
+  GST_OBJECT_LOCK (demux);
 
-  associations[0].format = GST_FORMAT_TIME;
-  associations[0].value = ts;
-  associations[1].format = GST_FORMAT_BYTES;
-  associations[1].value = pos;
+  /* entries mostly come in file order, so usually they are appended */
+  idx = demux->index->len;
+  if (idx > 0 &&
+      g_array_index (demux->index, GstFlvDemuxIndexEntry, idx - 1).pos >= pos) {
+    prev = gst_util_array_binary_search (demux->index->data, idx,
+        sizeof (GstFlvDemuxIndexEntry), gst_flv_demux_index_compare_pos,
+        GST_SEARCH_MODE_BEFORE, &pos, NULL);
+
+    /* entry may already have been added before, avoid adding indefinitely */
+    if (prev && prev->pos == pos) {
+      GST_LOG_OBJECT (demux, "position already mapped to time %"
+          GST_TIME_FORMAT, GST_TIME_ARGS (prev->time));
+      if (prev->time != ts)
+        GST_DEBUG_OBJECT (demux, "metadata mismatch");
+      goto done;
+    }
 
-  gst_index_add_associationv (index, demux->index_id,
-      (keyframe) ? GST_ASSOCIATION_FLAG_KEY_UNIT :
-      GST_ASSOCIATION_FLAG_DELTA_UNIT, 2,
-      (const GstIndexAssociation *) &associations);
+    idx = prev ? prev - (GstFlvDemuxIndexEntry *) demux->index->data + 1 : 0;
+  }
 
-  if (pos > demux->index_max_pos)
-    demux->index_max_pos = pos;
-  if (ts > demux->index_max_time)
-    demux->index_max_time = ts;
+  /* the index must stay sorted by time as well for seeking */
+  if ((idx > 0 &&
+          g_array_index (demux->index, GstFlvDemuxIndexEntry,
+              idx - 1).time > ts) || (idx < demux->index->len &&
+          g_array_index (demux->index, GstFlvDemuxIndexEntry, idx).time < ts)) {
+    GST_DEBUG_OBJECT (demux, "keyframe at %" GST_TIME_FORMAT " out of order, "
+        "not adding it", GST_TIME_ARGS (ts));
+    goto done;
+  }
 
-  gst_object_unref (index);
+  g_array_insert_val (demux->index, idx, entry);
+
+done:
+  GST_OBJECT_UNLOCK (demux);
 }
 
 static gchar *
@@ -1972,6 +2039,11 @@ gst_flv_demux_cleanup (GstFlvDemux * demux)
 
   demux->index_max_pos = 0;
   demux->index_max_time = 0;
+  demux->index_scan_stalled = FALSE;
+
+  GST_OBJECT_LOCK (demux);
+  g_array_set_size (demux->index, 0);
+  GST_OBJECT_UNLOCK (demux);
 
   demux->audio_start = demux->video_start = GST_CLOCK_TIME_NONE;
   demux->last_audio_pts = demux->last_video_dts = 0;
@@ -2448,8 +2520,8 @@ static GstFlowReturn
 gst_flv_demux_seek_to_prev_keyframe (GstFlvDemux * demux)
 {
   GstFlowReturn ret = GST_FLOW_EOS;
-  GstIndex *index;
-  GstIndexEntry *entry = NULL;
+  GstFlvDemuxIndexEntry entry;
+  guint64 pos;
 
   GST_DEBUG_OBJECT (demux,
       "terminated section started at offset %" G_GINT64_FORMAT,
@@ -2467,39 +2539,29 @@ gst_flv_demux_seek_to_prev_keyframe (GstFlvDemux * demux)
 
   GST_DEBUG_OBJECT (demux, "locating previous position");
 
-  index = gst_flv_demux_get_index (GST_ELEMENT (demux));
-
   /* locate index entry before previous start position */
-  if (index) {
-    entry = gst_index_get_assoc_entry (index, demux->index_id,
-        GST_INDEX_LOOKUP_BEFORE, GST_ASSOCIATION_FLAG_KEY_UNIT,
-        GST_FORMAT_BYTES, demux->from_offset - 1);
-
-    if (entry) {
-      gint64 bytes = 0, time = 0;
-
-      gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &bytes);
-      gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
-
-      GST_DEBUG_OBJECT (demux, "found index entry for %" G_GINT64_FORMAT
-          " at %" GST_TIME_FORMAT ", seeking to %" G_GINT64_FORMAT,
-          demux->offset - 1, GST_TIME_ARGS (time), bytes);
-
-      /* setup for next section */
-      demux->to_offset = demux->from_offset;
-      gst_flv_demux_move_to_offset (demux, bytes, FALSE);
-      ret = GST_FLOW_OK;
-    }
-
-    gst_object_unref (index);
+  pos = demux->from_offset - 1;
+  if (gst_flv_demux_index_lookup (demux, gst_flv_demux_index_compare_pos,
+          GST_SEARCH_MODE_BEFORE, &pos, &entry)) {
+    GST_DEBUG_OBJECT (demux, "found index entry for %" G_GINT64_FORMAT
+        " at %" GST_TIME_FORMAT ", seeking to %" G_GUINT64_FORMAT,
+        demux->offset - 1, GST_TIME_ARGS (entry.time), entry.pos);
+
+    /* setup for next section */
+    demux->to_offset = demux->from_offset;
+    gst_flv_demux_move_to_offset (demux, entry.pos, FALSE);
+    ret = GST_FLOW_OK;
   }
 
 done:
   return ret;
 }
 
+/* Scans the tags from @pos on and adds them to the index, until a tag after
+ * @ts is found or, if @max_tags is not 0, that many tags have been read */
 static GstFlowReturn
-gst_flv_demux_create_index (GstFlvDemux * demux, gint64 pos, GstClockTime ts)
+gst_flv_demux_create_index (GstFlvDemux * demux, gint64 pos, GstClockTime ts,
+    guint max_tags)
 {
   gint64 size;
   size_t tag_size;
@@ -2507,6 +2569,7 @@ gst_flv_demux_create_index (GstFlvDemux * demux, gint64 pos, GstClockTime ts)
   GstBuffer *buffer;
   GstClockTime tag_time;
   GstFlowReturn ret = GST_FLOW_OK;
+  guint n_tags = 0;
 
   if (!gst_pad_peer_query_duration (demux->sinkpad, GST_FORMAT_BYTES, &size))
     return GST_FLOW_OK;
@@ -2526,8 +2589,22 @@ gst_flv_demux_create_index (GstFlvDemux * demux, gint64 pos, GstClockTime ts)
     gst_buffer_unref (buffer);
     buffer = NULL;
 
-    if (G_UNLIKELY (tag_time == GST_CLOCK_TIME_NONE || tag_time > ts))
+    if (G_UNLIKELY (tag_time == GST_CLOCK_TIME_NONE)) {
+      GST_DEBUG_OBJECT (demux, "invalid tag at %" G_GUINT64_FORMAT
+          ", stopping index scan", demux->offset);
+      demux->index_scan_stalled = TRUE;
+      goto exit;
+    }
+
+    if (tag_time > ts)
+      goto exit;
+
+    if (max_tags && ++n_tags >= max_tags) {
+      /* not all tags go into the index, resume from this one next time */
+      if ((gint64) demux->offset > demux->index_max_pos)
+        demux->index_max_pos = demux->offset;
       goto exit;
+    }
 
     demux->offset += tag_size;
   }
@@ -2635,6 +2712,12 @@ gst_flv_demux_loop (GstPad * pad)
       if (G_UNLIKELY (!demux->file_size && !demux->indexed &&
               (demux->has_video || demux->has_audio)))
         demux->file_size = gst_flv_demux_get_metadata (demux);
+      /* stay ahead of playback with the index, so seeking does not need
+       * to scan the file first */
+      if (ret == GST_FLOW_OK && demux->background_index && !demux->indexed &&
+          !demux->index_scan_stalled && demux->upstream_seekable)
+        ret = gst_flv_demux_create_index (demux, demux->index_max_pos,
+            GST_CLOCK_TIME_NONE, INDEX_SCAN_STEP);
       break;
     case FLV_STATE_DONE:
       ret = GST_FLOW_EOS;
@@ -2645,7 +2728,7 @@ gst_flv_demux_loop (GstPad * pad)
        * desired time and then perform seek */
       /* TODO maybe some buffering message or so to indicate scan progress */
       ret = gst_flv_demux_create_index (demux, demux->index_max_pos,
-          demux->seek_time);
+          demux->seek_time, 0);
       if (ret != GST_FLOW_OK)
         goto pause;
       /* position and state arranged by seek,
@@ -2757,47 +2840,36 @@ static guint64
 gst_flv_demux_find_offset (GstFlvDemux * demux, GstSegment * segment,
     GstSeekFlags seek_flags)
 {
-  gint64 bytes = 0;
-  gint64 time = 0;
-  GstIndex *index;
-  GstIndexEntry *entry;
+  GstFlvDemuxIndexEntry entry;
+  GstClockTime time;
 
   g_return_val_if_fail (segment != NULL, 0);
 
   time = segment->position;
 
-  index = gst_flv_demux_get_index (GST_ELEMENT (demux));
-
-  if (index) {
-    /* Let's check if we have an index entry for that seek time */
-    entry = gst_index_get_assoc_entry (index, demux->index_id,
-        seek_flags & GST_SEEK_FLAG_SNAP_AFTER ?
-        GST_INDEX_LOOKUP_AFTER : GST_INDEX_LOOKUP_BEFORE,
-        GST_ASSOCIATION_FLAG_KEY_UNIT, GST_FORMAT_TIME, time);
-
-    if (entry) {
-      gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &bytes);
-      gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
-
-      GST_DEBUG_OBJECT (demux, "found index entry for %" GST_TIME_FORMAT
-          " at %" GST_TIME_FORMAT ", seeking to %" G_GINT64_FORMAT,
-          GST_TIME_ARGS (segment->position), GST_TIME_ARGS (time), bytes);
-
-      /* Key frame seeking */
-      if (seek_flags & GST_SEEK_FLAG_KEY_UNIT) {
-        /* Adjust the segment so that the keyframe fits in */
-        segment->start = segment->time = time;
-        segment->position = time;
-      }
-    } else {
-      GST_DEBUG_OBJECT (demux, "no index entry found for %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (segment->start));
+  /* Let's check if we have an index entry for that seek time */
+  if (gst_flv_demux_index_lookup (demux, gst_flv_demux_index_compare_time,
+          seek_flags & GST_SEEK_FLAG_SNAP_AFTER ?
+          GST_SEARCH_MODE_AFTER : GST_SEARCH_MODE_BEFORE, &time, &entry)) {
+    GST_DEBUG_OBJECT (demux, "found index entry for %" GST_TIME_FORMAT
+        " at %" GST_TIME_FORMAT ", seeking to %" G_GUINT64_FORMAT,
+        GST_TIME_ARGS (segment->position), GST_TIME_ARGS (entry.time),
+        entry.pos);
+
+    /* Key frame seeking */
+    if (seek_flags & GST_SEEK_FLAG_KEY_UNIT) {
+      /* Adjust the segment so that the keyframe fits in */
+      segment->start = segment->time = entry.time;
+      segment->position = entry.time;
     }
 
-    gst_object_unref (index);
+    return entry.pos;
   }
 
-  return bytes;
+  GST_DEBUG_OBJECT (demux, "no index entry found for %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (segment->start));
+
+  return 0;
 }
 
 static gboolean
@@ -3195,18 +3267,8 @@ gst_flv_demux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       break;
     case GST_EVENT_EOS:
     {
-      GstIndex *index;
-
       GST_DEBUG_OBJECT (demux, "received EOS");
 
-      index = gst_flv_demux_get_index (GST_ELEMENT (demux));
-
-      if (index) {
-        GST_DEBUG_OBJECT (demux, "committing index");
-        gst_index_commit (index, demux->index_id);
-        gst_object_unref (index);
-      }
-
       if (!demux->audio_pad && !demux->video_pad) {
         GST_ELEMENT_ERROR (demux, STREAM, FAILED,
             ("Internal data stream error."), ("Got EOS before any data"));
@@ -3368,8 +3430,7 @@ gst_flv_demux_query (GstPad * pad, GstObject * parent, GstQuery * query)
         }
       }
       res = TRUE;
-      /* FIXME, check index this way is not thread safe */
-      if (fmt != GST_FORMAT_TIME || !demux->index) {
+      if (fmt != GST_FORMAT_TIME) {
         gst_query_set_seeking (query, fmt, FALSE, -1, -1);
       } else if (demux->random_access) {
         gst_query_set_seeking (query, GST_FORMAT_TIME, TRUE, 0,
@@ -3430,24 +3491,6 @@ gst_flv_demux_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
-      /* If this is our own index destroy it as the
-       * old entries might be wrong for the new stream */
-      if (demux->own_index) {
-        gst_object_unref (demux->index);
-        demux->index = NULL;
-        demux->own_index = FALSE;
-      }
-
-      /* If no index was created, generate one */
-      if (G_UNLIKELY (!demux->index)) {
-        GST_DEBUG_OBJECT (demux, "no index provided creating our own");
-
-        demux->index = g_object_new (gst_mem_index_get_type (), NULL);
-
-        gst_index_get_writer_id (demux->index, GST_OBJECT (demux),
-            &demux->index_id);
-        demux->own_index = TRUE;
-      }
       gst_flv_demux_cleanup (demux);
       break;
     default:
@@ -3469,53 +3512,36 @@ gst_flv_demux_change_state (GstElement * element, GstStateChange transition)
   return ret;
 }
 
-#if 0
 static void
-gst_flv_demux_set_index (GstElement * element, GstIndex * index)
+gst_flv_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
 {
-  GstFlvDemux *demux = GST_FLV_DEMUX (element);
-  GstIndex *old_index;
-
-  GST_OBJECT_LOCK (demux);
-
-  old_index = demux->index;
-
-  if (index) {
-    demux->index = gst_object_ref (index);
-    demux->own_index = FALSE;
-  } else
-    demux->index = NULL;
-
-  if (old_index)
-    gst_object_unref (demux->index);
-
-  gst_object_ref (index);
-
-  GST_OBJECT_UNLOCK (demux);
-
-  /* object lock might be taken again */
-  if (index)
-    gst_index_get_writer_id (index, GST_OBJECT (element), &demux->index_id);
-
-  GST_DEBUG_OBJECT (demux, "Set index %" GST_PTR_FORMAT, demux->index);
+  GstFlvDemux *demux = GST_FLV_DEMUX (object);
 
-  gst_object_unref (index);
+  switch (prop_id) {
+    case PROP_BACKGROUND_INDEX:
+      demux->background_index = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
-#endif
 
-static GstIndex *
-gst_flv_demux_get_index (GstElement * element)
+static void
+gst_flv_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
 {
-  GstIndex *result = NULL;
-
-  GstFlvDemux *demux = GST_FLV_DEMUX (element);
-
-  GST_OBJECT_LOCK (demux);
-  if (demux->index)
-    result = gst_object_ref (demux->index);
-  GST_OBJECT_UNLOCK (demux);
+  GstFlvDemux *demux = GST_FLV_DEMUX (object);
 
-  return result;
+  switch (prop_id) {
+    case PROP_BACKGROUND_INDEX:
+      g_value_set_boolean (value, demux->background_index);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
 
 static void
@@ -3577,7 +3603,7 @@ gst_flv_demux_dispose (GObject * object)
   }
 
   if (demux->index) {
-    gst_object_unref (demux->index);
+    g_array_free (demux->index, TRUE);
     demux->index = NULL;
   }
 
@@ -3601,15 +3627,27 @@ gst_flv_demux_class_init (GstFlvDemuxClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
   gobject_class->dispose = gst_flv_demux_dispose;
+  gobject_class->set_property = gst_flv_demux_set_property;
+  gobject_class->get_property = gst_flv_demux_get_property;
+
+  /**
+   * GstFlvDemux:background-index:
+   *
+   * If the file has no keyframe index in its metadata, scan ahead of
+   * playback and add the keyframes to the index while playing, so that
+   * seeking does not have to scan the file first. Only used in pull mode.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_BACKGROUND_INDEX,
+      g_param_spec_boolean ("background-index", "Background index",
+          "Build the seek index ahead of playback if the file has none",
+          DEFAULT_BACKGROUND_INDEX,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_flv_demux_change_state);
 
-#if 0
-  gstelement_class->set_index = GST_DEBUG_FUNCPTR (gst_flv_demux_set_index);
-  gstelement_class->get_index = GST_DEBUG_FUNCPTR (gst_flv_demux_get_index);
-#endif
-
   gst_element_class_add_static_pad_template (gstelement_class,
       &flv_sink_template);
   gst_element_class_add_static_pad_template (gstelement_class,
@@ -3641,9 +3679,8 @@ gst_flv_demux_init (GstFlvDemux * demux)
   demux->adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
 
-  demux->own_index = FALSE;
-
-  GST_OBJECT_FLAG_SET (demux, GST_ELEMENT_FLAG_INDEXABLE);
+  demux->index = g_array_new (FALSE, FALSE, sizeof (GstFlvDemuxIndexEntry));
+  demux->background_index = DEFAULT_BACKGROUND_INDEX;
 
   gst_flv_demux_cleanup (demux);
 }
@@ -23,7 +23,6 @@
 #include <gst/gst.h>
 #include <gst/base/gstadapter.h>
 #include <gst/base/gstflowcombiner.h>
-#include "gstindex.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_FLV_DEMUX \
@@ -65,11 +64,10 @@ struct _GstFlvDemux
   guint group_id;
 
   /* <private> */
-  
-  GstIndex *index;
-  gint index_id;
-  gboolean own_index;
-  
+
+  /* keyframe index, sorted by both time and offset */
+  GArray * index;
+
   GArray * times;
   GArray * filepositions;
 
@@ -141,6 +139,8 @@ struct _GstFlvDemux
   gboolean seeking;
   gboolean building_index;
   gboolean indexed; /* TRUE if index is completely built */
+  gboolean background_index; /* scan ahead for the index while playing */
+  gboolean index_scan_stalled; /* TRUE if a scan could not get past a tag */
   gboolean upstream_seekable; /* TRUE if upstream is seekable */
   gint64 file_size;
   GstEvent *seek_event;
@@ -55,6 +55,11 @@ enum
 
 #define DEFAULT_STREAMABLE FALSE
 #define MAX_INDEX_ENTRIES 128
+/* the index kept in memory is thinned out whenever it gets this long */
+#define INDEX_CAPACITY (2 * MAX_INDEX_ENTRIES)
+/* audio tags waiting for the next video tag are pushed once there are
+ * this many, so sparse video doesn't hold them back for long */
+#define MAX_PENDING_TAGS 32
 #define DEFAULT_METADATACREATOR "GStreamer " PACKAGE_VERSION " FLV muxer"
 
 static GstStaticPadTemplate src_templ = GST_STATIC_PAD_TEMPLATE ("src",
@@ -125,12 +130,6 @@ typedef struct
   gdouble time;
 } GstFlvMuxIndexEntry;
 
-static void
-gst_flv_mux_index_entry_free (GstFlvMuxIndexEntry * entry)
-{
-  g_slice_free (GstFlvMuxIndexEntry, entry);
-}
-
 static GstBuffer *
 _gst_buffer_new_wrapped (gpointer mem, gsize size, GFreeFunc free_func)
 {
@@ -231,6 +230,8 @@ gst_flv_mux_init (GstFlvMux * mux)
   mux->metadatacreator = g_strdup (DEFAULT_METADATACREATOR);
 
   mux->new_tags = FALSE;
+  mux->index = g_array_sized_new (FALSE, FALSE, sizeof (GstFlvMuxIndexEntry),
+      INDEX_CAPACITY);
 
   mux->collect = gst_collect_pads_new ();
   gst_collect_pads_set_buffer_function (mux->collect,
@@ -250,6 +251,7 @@ gst_flv_mux_finalize (GObject * object)
 
   gst_object_unref (mux->collect);
   g_free (mux->metadatacreator);
+  g_array_free (mux->index, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -266,9 +268,13 @@ gst_flv_mux_reset (GstElement * element)
     gst_flv_mux_reset_pad (mux, cpad, cpad->video);
   }
 
-  g_list_foreach (mux->index, (GFunc) gst_flv_mux_index_entry_free, NULL);
-  g_list_free (mux->index);
-  mux->index = NULL;
+  g_array_set_size (mux->index, 0);
+  mux->index_stride = 1;
+  mux->index_seen = 0;
+  if (mux->pending) {
+    gst_buffer_list_unref (mux->pending);
+    mux->pending = NULL;
+  }
   mux->byte_count = 0;
 
   mux->have_audio = mux->have_video = FALSE;
@@ -643,6 +649,31 @@ gst_flv_mux_push (GstFlvMux * mux, GstBuffer * buffer)
   return gst_pad_push (mux->srcpad, buffer);
 }
 
+/* Tags are collected until an interleave slot is complete and then pushed
+ * downstream together as one buffer list */
+static void
+gst_flv_mux_queue (GstFlvMux * mux, GstBuffer * buffer)
+{
+  mux->byte_count += gst_buffer_get_size (buffer);
+
+  if (mux->pending == NULL)
+    mux->pending = gst_buffer_list_new ();
+  gst_buffer_list_add (mux->pending, buffer);
+}
+
+static GstFlowReturn
+gst_flv_mux_push_pending (GstFlvMux * mux)
+{
+  GstBufferList *list = mux->pending;
+
+  if (list == NULL)
+    return GST_FLOW_OK;
+
+  mux->pending = NULL;
+
+  return gst_pad_push_list (mux->srcpad, list);
+}
+
 static GstBuffer *
 gst_flv_mux_create_header (GstFlvMux * mux)
 {
@@ -1052,10 +1083,11 @@ gst_flv_mux_buffer_to_tag_internal (GstFlvMux * mux, GstBuffer * buffer,
     GstFlvPad * cpad, gboolean is_codec_data)
 {
   GstBuffer *tag;
+  GstMemory *mem;
   GstMapInfo map;
-  guint size;
+  guint size, header_size;
   guint32 pts, dts, cts;
-  guint8 *data, *bdata = NULL;
+  guint8 *data;
   gsize bsize = 0;
 
   if (!GST_CLOCK_STIME_IS_VALID (cpad->dts)) {
@@ -1079,30 +1111,25 @@ gst_flv_mux_buffer_to_tag_internal (GstFlvMux * mux, GstBuffer * buffer,
 
   GST_LOG_OBJECT (mux, "got pts %i dts %i cts %i\n", pts, dts, cts);
 
-  if (buffer != NULL) {
-    gst_buffer_map (buffer, &map, GST_MAP_READ);
-    bdata = map.data;
-    bsize = map.size;
-  }
+  if (buffer != NULL)
+    bsize = gst_buffer_get_size (buffer);
 
-  size = 11;
+  header_size = 11 + 1;
   if (cpad->video) {
-    size += 1;
     if (cpad->video_codec == 7)
-      size += 4 + bsize;
-    else
-      size += bsize;
+      header_size += 4;
   } else {
-    size += 1;
     if (cpad->audio_codec == 10)
-      size += 1 + bsize;
-    else
-      size += bsize;
+      header_size += 1;
   }
-  size += 4;
+  size = header_size + bsize + 4;
 
-  _gst_buffer_new_and_alloc (size, &tag, &data);
-  memset (data, 0, size);
+  /* the tag header and the trailing tag size share one small allocation,
+   * the payload memory is only referenced and not copied */
+  mem = gst_allocator_alloc (NULL, header_size + 4, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  data = map.data;
+  memset (data, 0, header_size);
 
   data[0] = (cpad->video) ? 9 : 8;
 
@@ -1136,9 +1163,6 @@ gst_flv_mux_buffer_to_tag_internal (GstFlvMux * mux, GstBuffer * buffer,
         data[12] = 1;
         GST_WRITE_UINT24_BE (data + 13, cts);
       }
-      memcpy (data + 11 + 1 + 4, bdata, bsize);
-    } else {
-      memcpy (data + 11 + 1, bdata, bsize);
     }
   } else {
     data[11] |= (cpad->audio_codec << 4) & 0xf0;
@@ -1150,19 +1174,19 @@ gst_flv_mux_buffer_to_tag_internal (GstFlvMux * mux, GstBuffer * buffer,
         "audio_codec:%d, rate:%d, width:%d, channels:%d",
         data[11], cpad->audio_codec, cpad->rate, cpad->width, cpad->channels);
 
-    if (cpad->audio_codec == 10) {
+    if (cpad->audio_codec == 10)
       data[12] = is_codec_data ? 0 : 1;
-
-      memcpy (data + 11 + 1 + 1, bdata, bsize);
-    } else {
-      memcpy (data + 11 + 1, bdata, bsize);
-    }
   }
 
-  if (buffer)
-    gst_buffer_unmap (buffer, &map);
+  GST_WRITE_UINT32_BE (data + header_size, size - 4);
+  gst_memory_unmap (mem, &map);
 
-  GST_WRITE_UINT32_BE (data + size - 4, size - 4);
+  tag = gst_buffer_new ();
+  gst_buffer_append_memory (tag, gst_memory_share (mem, 0, header_size));
+  if (bsize > 0)
+    gst_buffer_copy_into (tag, buffer, GST_BUFFER_COPY_MEMORY, 0, bsize);
+  gst_buffer_append_memory (tag, gst_memory_share (mem, header_size, 4));
+  gst_memory_unref (mem);
 
   GST_BUFFER_PTS (tag) = GST_CLOCK_TIME_NONE;
   GST_BUFFER_DTS (tag) = GST_CLOCK_TIME_NONE;
@@ -1336,37 +1360,14 @@ gst_flv_mux_write_header (GstFlvMux * mux)
   gst_pad_push_event (mux->srcpad, gst_event_new_segment (&segment));
 
   /* push the header buffer, the metadata and the codec info, if any */
-  ret = gst_flv_mux_push (mux, header);
-  if (ret != GST_FLOW_OK)
-    goto failure_header;
-  ret = gst_flv_mux_push (mux, metadata);
-  if (ret != GST_FLOW_OK)
-    goto failure_metadata;
-  if (video_codec_data != NULL) {
-    ret = gst_flv_mux_push (mux, video_codec_data);
-    if (ret != GST_FLOW_OK)
-      goto failure_video_codec_data;
-  }
-  if (audio_codec_data != NULL) {
-    ret = gst_flv_mux_push (mux, audio_codec_data);
-    if (ret != GST_FLOW_OK)
-      goto failure_audio_codec_data;
-  }
-  return GST_FLOW_OK;
-
-failure_header:
-  gst_buffer_unref (metadata);
-
-failure_metadata:
+  gst_flv_mux_queue (mux, header);
+  gst_flv_mux_queue (mux, metadata);
   if (video_codec_data != NULL)
-    gst_buffer_unref (video_codec_data);
-
-failure_video_codec_data:
+    gst_flv_mux_queue (mux, video_codec_data);
   if (audio_codec_data != NULL)
-    gst_buffer_unref (audio_codec_data);
+    gst_flv_mux_queue (mux, audio_codec_data);
 
-failure_audio_codec_data:
-  return ret;
+  return gst_flv_mux_push_pending (mux);
 }
 
 static void
@@ -1383,11 +1384,55 @@ gst_flv_mux_update_index (GstFlvMux * mux, GstBuffer * buffer, GstFlvPad * cpad)
     return;
 
   if (GST_BUFFER_PTS_IS_VALID (buffer)) {
-    GstFlvMuxIndexEntry *entry = g_slice_new (GstFlvMuxIndexEntry);
-    entry->position = mux->byte_count;
-    entry->time = gst_guint64_to_gdouble (GST_BUFFER_PTS (buffer)) / GST_SECOND;
-    mux->index = g_list_prepend (mux->index, entry);
+    GstFlvMuxIndexEntry entry;
+
+    /* only every index_stride-th seek point is kept, and whenever the index
+     * is full every other entry is dropped. That way the index stays evenly
+     * spread over the whole file however long the recording gets */
+    if (mux->index_seen++ % mux->index_stride != 0)
+      return;
+
+    if (mux->index->len == INDEX_CAPACITY) {
+      guint i;
+
+      for (i = 0; i < INDEX_CAPACITY / 2; i++)
+        g_array_index (mux->index, GstFlvMuxIndexEntry, i) =
+            g_array_index (mux->index, GstFlvMuxIndexEntry, 2 * i);
+      g_array_set_size (mux->index, INDEX_CAPACITY / 2);
+      mux->index_stride *= 2;
+
+      GST_DEBUG_OBJECT (mux, "index full, keeping every %u. seek point now",
+          mux->index_stride);
+    }
+
+    entry.position = mux->byte_count;
+    entry.time = gst_guint64_to_gdouble (GST_BUFFER_PTS (buffer)) / GST_SECOND;
+    g_array_append_val (mux->index, entry);
+  }
+}
+
+/* Whether a video pad has a buffer queued in collectpads, i.e. a
+ * video tag is coming next */
+static gboolean
+gst_flv_mux_video_is_queued (GstFlvMux * mux)
+{
+  GSList *l;
+
+  if (!mux->have_video)
+    return FALSE;
+
+  for (l = mux->collect->data; l != NULL; l = l->next) {
+    GstFlvPad *cpad = l->data;
+
+    if (cpad && cpad->video) {
+      GstCollectData *cdata = (GstCollectData *) cpad;
+
+      return !GST_COLLECT_PADS_STATE_IS_SET (cdata,
+          GST_COLLECT_PADS_STATE_EOS) && cdata->buffer != NULL;
+    }
   }
+
+  return FALSE;
 }
 
 static GstFlowReturn
@@ -1406,7 +1451,15 @@ gst_flv_mux_write_buffer (GstFlvMux * mux, GstFlvPad * cpad, GstBuffer * buffer)
 
   gst_buffer_unref (buffer);
 
-  ret = gst_flv_mux_push (mux, tag);
+  gst_flv_mux_queue (mux, tag);
+
+  /* audio tags are sent together with the following video tag, unless
+   * there is none queued or it takes too long to come */
+  if (cpad->video || !gst_flv_mux_video_is_queued (mux) ||
+      gst_buffer_list_length (mux->pending) >= MAX_PENDING_TAGS)
+    ret = gst_flv_mux_push_pending (mux);
+  else
+    ret = GST_FLOW_OK;
 
   if (ret == GST_FLOW_OK && GST_CLOCK_TIME_IS_VALID (dts))
     cpad->last_timestamp = dts;
@@ -1446,7 +1499,7 @@ gst_flv_mux_write_eos (GstFlvMux * mux)
   GSList *l = mux->collect->data;
 
   if (!mux->have_video)
-    return GST_FLOW_OK;
+    return gst_flv_mux_push_pending (mux);
 
   for (; l; l = l->next) {
     GstFlvPad *cpad = l->data;
@@ -1457,8 +1510,9 @@ gst_flv_mux_write_eos (GstFlvMux * mux)
   }
 
   tag = gst_flv_mux_eos_to_tag (mux, video_pad);
+  gst_flv_mux_queue (mux, tag);
 
-  return gst_flv_mux_push (mux, tag);
+  return gst_flv_mux_push_pending (mux);
 }
 
 static GstFlowReturn
@@ -1468,7 +1522,6 @@ gst_flv_mux_rewrite_header (GstFlvMux * mux)
   GstEvent *event;
   guint8 *data;
   gdouble d;
-  GList *l;
   guint32 index_len, allocate_size;
   guint32 i, index_skip;
   GstSegment segment;
@@ -1509,14 +1562,13 @@ gst_flv_mux_rewrite_header (GstFlvMux * mux)
   tmp = gst_flv_mux_create_number_script_value ("filesize", d);
   rewrite = gst_buffer_append (rewrite, tmp);
 
-  if (!mux->index) {
+  if (mux->index->len == 0) {
     /* no index, so push buffer and return */
     return gst_flv_mux_push (mux, rewrite);
   }
 
   /* rewrite the index */
-  mux->index = g_list_reverse (mux->index);
-  index_len = g_list_length (mux->index);
+  index_len = mux->index->len;
 
   /* We write at most MAX_INDEX_ENTRIES elements */
   if (index_len > MAX_INDEX_ENTRIES) {
@@ -1543,8 +1595,9 @@ gst_flv_mux_rewrite_header (GstFlvMux * mux)
   data += 28;
 
   /* the keyframes' times */
-  for (i = 0, l = mux->index; l; l = l->next, i++) {
-    GstFlvMuxIndexEntry *entry = l->data;
+  for (i = 0; i < mux->index->len; i++) {
+    GstFlvMuxIndexEntry *entry =
+        &g_array_index (mux->index, GstFlvMuxIndexEntry, i);
 
     if (i % index_skip != 0)
       continue;
@@ -1560,8 +1613,9 @@ gst_flv_mux_rewrite_header (GstFlvMux * mux)
   data += 20;
 
   /* the keyframes' file positions */
-  for (i = 0, l = mux->index; l; l = l->next, i++) {
-    GstFlvMuxIndexEntry *entry = l->data;
+  for (i = 0; i < mux->index->len; i++) {
+    GstFlvMuxIndexEntry *entry =
+        &g_array_index (mux->index, GstFlvMuxIndexEntry, i);
 
     if (i % index_skip != 0)
       continue;
@@ -1631,7 +1685,7 @@ gst_flv_mux_handle_buffer (GstCollectPads * pads, GstCollectData * cdata,
   if (mux->new_tags) {
     GstBuffer *buf = gst_flv_mux_create_metadata (mux, FALSE);
     if (buf)
-      gst_flv_mux_push (mux, buf);
+      gst_flv_mux_queue (mux, buf);
     mux->new_tags = FALSE;
   }
 
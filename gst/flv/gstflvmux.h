@@ -80,7 +80,10 @@ typedef struct _GstFlvMux {
 
   GstTagList *tags;
   gboolean new_tags;
-  GList *index;
+  GArray *index;
+  guint index_stride;
+  guint64 index_seen;
+  GstBufferList *pending;
   guint64 byte_count;
   guint64 duration;
   gint64 first_timestamp;
@@ -287,6 +287,18 @@ atom_ftyp_free (AtomFTYP * ftyp)
   g_free (ftyp);
 }
 
+/* styp has the same layout as ftyp, and is also freed and serialized
+ * like it */
+AtomFTYP *
+atom_styp_new (AtomsContext * context, guint32 major, guint32 version,
+    GList * brands)
+{
+  AtomFTYP *styp = atom_ftyp_new (context, major, version, brands);
+
+  styp->header.type = FOURCC_styp;
+  return styp;
+}
+
 static void
 atom_esds_init (AtomESDS * esds)
 {
@@ -753,6 +765,7 @@ atom_stsz_init (AtomSTSZ * stsz)
   atom_array_init (&stsz->entries, 1024);
   stsz->sample_size = 0;
   stsz->table_size = 0;
+  stsz->common_size = 0;
 }
 
 static void
@@ -761,6 +774,7 @@ atom_stsz_clear (AtomSTSZ * stsz)
   atom_full_clear (&stsz->header);
   atom_array_clear (&stsz->entries);
   stsz->table_size = 0;
+  stsz->common_size = 0;
 }
 
 static void
@@ -786,6 +800,8 @@ atom_co64_init (AtomSTCO64 * co64)
 
   atom_full_init (&co64->header, FOURCC_stco, 0, 0, 0, flags);
   atom_array_init (&co64->entries, 256);
+  atom_array_init (&co64->large_entries, 4);
+  co64->last_entry = 0;
 }
 
 static void
@@ -793,6 +809,20 @@ atom_stco64_clear (AtomSTCO64 * stco64)
 {
   atom_full_clear (&stco64->header);
   atom_array_clear (&stco64->entries);
+  atom_array_clear (&stco64->large_entries);
+}
+
+/* decodes entry @i, given the value of the previous entry */
+static inline guint64
+atom_stco64_next_entry (AtomSTCO64 * stco64, guint i, guint64 prev,
+    guint * large)
+{
+  guint32 delta = atom_array_index (&stco64->entries, i);
+
+  if (G_UNLIKELY (delta == G_MAXUINT32))
+    return atom_array_index (&stco64->large_entries, (*large)++);
+
+  return prev + delta;
 }
 
 static void
@@ -1954,6 +1984,11 @@ atom_stts_copy_data (AtomSTTS * stts, guint8 ** buffer, guint64 * size,
   }
 
   prop_copy_uint32 (atom_array_get_len (&stts->entries), buffer, size, offset);
+  /* no need to walk the table when only calculating the size */
+  if (buffer == NULL) {
+    *offset += 8 * atom_array_get_len (&stts->entries);
+    goto done;
+  }
   /* minimize realloc */
   prop_copy_ensure_buffer (buffer, size, offset,
       8 * atom_array_get_len (&stts->entries));
@@ -1964,6 +1999,7 @@ atom_stts_copy_data (AtomSTTS * stts, guint8 ** buffer, guint64 * size,
     prop_copy_int32 (entry->sample_delta, buffer, size, offset);
   }
 
+done:
   atom_write_size (buffer, size, offset, original_offset);
   return *offset - original_offset;
 }
@@ -2196,23 +2232,23 @@ atom_stsz_copy_data (AtomSTSZ * stsz, guint8 ** buffer, guint64 * size,
     guint64 * offset)
 {
   guint64 original_offset = *offset;
-  guint i;
+  guint32 sample_size = stsz->sample_size;
 
   if (!atom_full_copy_data (&stsz->header, buffer, size, offset)) {
     return 0;
   }
 
-  prop_copy_uint32 (stsz->sample_size, buffer, size, offset);
+  /* all samples had the same size so far, no table needed */
+  if (sample_size == 0 && atom_array_get_len (&stsz->entries) == 0)
+    sample_size = stsz->common_size;
+
+  prop_copy_uint32 (sample_size, buffer, size, offset);
   prop_copy_uint32 (stsz->table_size, buffer, size, offset);
-  if (stsz->sample_size == 0) {
-    /* minimize realloc */
-    prop_copy_ensure_buffer (buffer, size, offset, 4 * stsz->table_size);
+  if (sample_size == 0) {
     /* entry count must match sample count */
     g_assert (atom_array_get_len (&stsz->entries) == stsz->table_size);
-    for (i = 0; i < atom_array_get_len (&stsz->entries); i++) {
-      prop_copy_uint32 (atom_array_index (&stsz->entries, i), buffer, size,
-          offset);
-    }
+    prop_copy_uint32_array (stsz->entries.data,
+        atom_array_get_len (&stsz->entries), buffer, size, offset);
   }
 
   atom_write_size (buffer, size, offset, original_offset);
@@ -2278,6 +2314,11 @@ atom_ctts_copy_data (AtomCTTS * ctts, guint8 ** buffer, guint64 * size,
   }
 
   prop_copy_uint32 (atom_array_get_len (&ctts->entries), buffer, size, offset);
+  /* no need to walk the table when only calculating the size */
+  if (buffer == NULL) {
+    *offset += 8 * atom_array_get_len (&ctts->entries);
+    goto done;
+  }
   /* minimize realloc */
   prop_copy_ensure_buffer (buffer, size, offset,
       8 * atom_array_get_len (&ctts->entries));
@@ -2288,6 +2329,7 @@ atom_ctts_copy_data (AtomCTTS * ctts, guint8 ** buffer, guint64 * size,
     prop_copy_uint32 (entry->sampleoffset, buffer, size, offset);
   }
 
+done:
   atom_write_size (buffer, size, offset, original_offset);
   return *offset - original_offset;
 }
@@ -2297,7 +2339,8 @@ atom_stco64_copy_data (AtomSTCO64 * stco64, guint8 ** buffer, guint64 * size,
     guint64 * offset)
 {
   guint64 original_offset = *offset;
-  guint i;
+  guint i, large = 0;
+  guint64 entry = 0;
   gboolean trunc_to_32 = stco64->header.header.type == FOURCC_stco;
 
   if (!atom_full_copy_data (&stco64->header, buffer, size, offset)) {
@@ -2307,12 +2350,20 @@ atom_stco64_copy_data (AtomSTCO64 * stco64, guint8 ** buffer, guint64 * size,
   prop_copy_uint32 (atom_array_get_len (&stco64->entries), buffer, size,
       offset);
 
+  /* no need to walk the table when only calculating the size */
+  if (buffer == NULL) {
+    *offset += (trunc_to_32 ? 4 : 8) * atom_array_get_len (&stco64->entries);
+    goto done;
+  }
+
   /* minimize realloc */
   prop_copy_ensure_buffer (buffer, size, offset,
       8 * atom_array_get_len (&stco64->entries));
   for (i = 0; i < atom_array_get_len (&stco64->entries); i++) {
-    guint64 value =
-        atom_array_index (&stco64->entries, i) + stco64->chunk_offset;
+    guint64 value;
+
+    entry = atom_stco64_next_entry (stco64, i, entry, &large);
+    value = entry + stco64->chunk_offset;
 
     if (trunc_to_32) {
       prop_copy_uint32 ((guint32) value, buffer, size, offset);
@@ -2321,6 +2372,8 @@ atom_stco64_copy_data (AtomSTCO64 * stco64, guint8 ** buffer, guint64 * size,
     }
   }
 
+done:
+
   atom_write_size (buffer, size, offset, original_offset);
   return *offset - original_offset;
 }
@@ -2330,7 +2383,6 @@ atom_stss_copy_data (AtomSTSS * stss, guint8 ** buffer, guint64 * size,
     guint64 * offset)
 {
   guint64 original_offset = *offset;
-  guint i;
 
   if (atom_array_get_len (&stss->entries) == 0) {
     /* FIXME not needing this atom might be confused with error while copying */
@@ -2342,13 +2394,8 @@ atom_stss_copy_data (AtomSTSS * stss, guint8 ** buffer, guint64 * size,
   }
 
   prop_copy_uint32 (atom_array_get_len (&stss->entries), buffer, size, offset);
-  /* minimize realloc */
-  prop_copy_ensure_buffer (buffer, size, offset,
-      4 * atom_array_get_len (&stss->entries));
-  for (i = 0; i < atom_array_get_len (&stss->entries); i++) {
-    prop_copy_uint32 (atom_array_index (&stss->entries, i), buffer, size,
-        offset);
-  }
+  prop_copy_uint32_array (stss->entries.data,
+      atom_array_get_len (&stss->entries), buffer, size, offset);
 
   atom_write_size (buffer, size, offset, original_offset);
   return *offset - original_offset;
@@ -3006,6 +3053,19 @@ atom_stsz_add_entry (AtomSTSZ * stsz, guint32 nsamples, guint32 size)
     /* it is constant size, we don't need entries */
     return;
   }
+
+  /* No entries are needed either as long as all samples have the same size.
+   * Only once that changes the list is filled up for the previous samples */
+  if (atom_array_get_len (&stsz->entries) == 0) {
+    if (stsz->table_size == nsamples)
+      stsz->common_size = size;
+    if (size == stsz->common_size && size != 0)
+      return;
+    for (i = 0; i < stsz->table_size - nsamples; i++) {
+      atom_array_append (&stsz->entries, stsz->common_size, 1024);
+    }
+  }
+
   for (i = 0; i < nsamples; i++) {
     atom_array_append (&stsz->entries, size, 1024);
   }
@@ -3021,20 +3081,59 @@ atom_stco64_get_entry_count (AtomSTCO64 * stco64)
 static gboolean
 atom_stco64_add_entry (AtomSTCO64 * stco64, guint64 entry)
 {
-  guint32 len;
-
   /* Only add a new entry if the chunk offset changed */
-  if ((len = atom_array_get_len (&stco64->entries)) &&
-      ((atom_array_index (&stco64->entries, len - 1)) == entry))
+  if (atom_array_get_len (&stco64->entries) && stco64->last_entry == entry)
     return FALSE;
 
-  atom_array_append (&stco64->entries, entry, 256);
+  if (entry >= stco64->last_entry && entry - stco64->last_entry < G_MAXUINT32) {
+    atom_array_append (&stco64->entries,
+        (guint32) (entry - stco64->last_entry), 256);
+  } else {
+    atom_array_append (&stco64->entries, G_MAXUINT32, 256);
+    atom_array_append (&stco64->large_entries, entry, 16);
+  }
+  stco64->last_entry = entry;
+
   if (entry > G_MAXUINT32)
     stco64->header.header.type = FOURCC_co64;
 
   return TRUE;
 }
 
+/* returns the number of entries up to and including @entry,
+ * or 0 if there is no such entry */
+guint32
+atom_stco64_find_entry (AtomSTCO64 * stco64, guint64 entry)
+{
+  guint i, large = 0;
+  guint64 value = 0;
+
+  for (i = 0; i < atom_array_get_len (&stco64->entries); i++) {
+    value = atom_stco64_next_entry (stco64, i, value, &large);
+    if (value == entry)
+      return i + 1;
+  }
+
+  return 0;
+}
+
+/* keeps only the first @n_entries entries */
+void
+atom_stco64_truncate (AtomSTCO64 * stco64, guint32 n_entries)
+{
+  guint i, large = 0;
+  guint64 value = 0;
+
+  g_assert (n_entries <= atom_array_get_len (&stco64->entries));
+
+  for (i = 0; i < n_entries; i++)
+    value = atom_stco64_next_entry (stco64, i, value, &large);
+
+  stco64->entries.len = n_entries;
+  stco64->large_entries.len = large;
+  stco64->last_entry = value;
+}
+
 void
 atom_tref_add_entry (AtomTREF * tref, guint32 sample)
 {
@@ -4999,6 +5098,64 @@ atom_mfra_copy_data (AtomMFRA * mfra, guint8 ** buffer, guint64 * size,
   return *offset - original_offset;
 }
 
+AtomSIDX *
+atom_sidx_new (AtomsContext * context, guint32 reference_ID, guint32 timescale)
+{
+  AtomSIDX *sidx = g_new0 (AtomSIDX, 1);
+  guint8 flags[3] = { 0, 0, 0 };
+
+  atom_full_init (&sidx->header, FOURCC_sidx, 0, 0, 0, flags);
+  sidx->reference_ID = reference_ID;
+  sidx->timescale = timescale;
+
+  return sidx;
+}
+
+void
+atom_sidx_free (AtomSIDX * sidx)
+{
+  atom_full_clear (&sidx->header);
+  g_free (sidx);
+}
+
+guint64
+atom_sidx_copy_data (AtomSIDX * sidx, guint8 ** buffer, guint64 * size,
+    guint64 * offset)
+{
+  guint64 original_offset = *offset;
+
+  /* auto-use 64 bits if needed */
+  if (sidx->earliest_presentation_time > G_MAXUINT32
+      || sidx->first_offset > G_MAXUINT32)
+    sidx->header.version = 1;
+
+  if (!atom_full_copy_data (&sidx->header, buffer, size, offset))
+    return 0;
+
+  prop_copy_uint32 (sidx->reference_ID, buffer, size, offset);
+  prop_copy_uint32 (sidx->timescale, buffer, size, offset);
+  if (sidx->header.version == 1) {
+    prop_copy_uint64 (sidx->earliest_presentation_time, buffer, size, offset);
+    prop_copy_uint64 (sidx->first_offset, buffer, size, offset);
+  } else {
+    prop_copy_uint32 (sidx->earliest_presentation_time, buffer, size, offset);
+    prop_copy_uint32 (sidx->first_offset, buffer, size, offset);
+  }
+  /* reserved and reference count */
+  prop_copy_uint16 (0, buffer, size, offset);
+  prop_copy_uint16 (1, buffer, size, offset);
+
+  /* reference type 0 (media), referenced size */
+  prop_copy_uint32 (sidx->referenced_size & 0x7fffffff, buffer, size, offset);
+  prop_copy_uint32 (sidx->subsegment_duration, buffer, size, offset);
+  /* starts with SAP, of type 1, no SAP delta time */
+  prop_copy_uint32 (sidx->starts_with_sap ? 0x90000000 : 0, buffer, size,
+      offset);
+
+  atom_write_size (buffer, size, offset, original_offset);
+  return *offset - original_offset;
+}
+
 /* some sample description construction helpers */
 
 AtomInfo *
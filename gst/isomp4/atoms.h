@@ -510,6 +510,9 @@ typedef struct _AtomSTSZ
   /* need the size here because when sample_size is constant,
    * the list is empty */
   guint32 table_size;
+  /* size of all samples so far while the list is still empty, the list
+   * is only filled once a sample of another size is added */
+  guint32 common_size;
   ATOM_ARRAY (guint32) entries;
 } AtomSTSZ;
 
@@ -545,7 +548,12 @@ typedef struct _AtomSTCO64
   AtomFull header;
   /* Global offset to add to entries when serialising */
   guint32 chunk_offset;
-  ATOM_ARRAY (guint64) entries;
+  /* entries are stored as the difference to the previous entry. Entries
+   * for which that does not fit are stored as G_MAXUINT32, with the full
+   * value in large_entries */
+  ATOM_ARRAY (guint32) entries;
+  ATOM_ARRAY (guint64) large_entries;
+  guint64 last_entry;
 } AtomSTCO64;
 
 typedef struct _CTTSEntry
@@ -880,6 +888,21 @@ typedef struct _AtomMFRA
   GList *tfras;
 } AtomMFRA;
 
+typedef struct _AtomSIDX
+{
+  AtomFull header;
+
+  guint32 reference_ID;
+  guint32 timescale;
+  guint64 earliest_presentation_time;
+  guint64 first_offset;
+
+  /* a single reference, to the moof and mdat that follow */
+  guint32 referenced_size;
+  guint32 subsegment_duration;
+  gboolean starts_with_sap;
+} AtomSIDX;
+
 /*
  * Function to serialize an atom
  */
@@ -913,6 +936,8 @@ AtomFTYP*  atom_ftyp_new               (AtomsContext *context, guint32 major,
 guint64    atom_ftyp_copy_data         (AtomFTYP *ftyp, guint8 **buffer,
                                         guint64 *size, guint64 *offset);
 void       atom_ftyp_free              (AtomFTYP *ftyp);
+AtomFTYP*  atom_styp_new               (AtomsContext *context, guint32 major,
+                                        guint32 version, GList *brands);
 
 AtomTRAK*  atom_trak_new               (AtomsContext *context);
 void       atom_trak_add_samples       (AtomTRAK * trak, guint32 nsamples, guint32 delta,
@@ -946,6 +971,8 @@ guint      atom_framerate_to_timescale (gint fps_n, gint fps_d);
 guint64    atom_mvhd_copy_data         (AtomMVHD * atom, guint8 ** buffer,
                                         guint64 * size, guint64 * offset);
 void       atom_stco64_chunks_set_offset (AtomSTCO64 * stco64, guint32 offset);
+guint32    atom_stco64_find_entry      (AtomSTCO64 * stco64, guint64 entry);
+void       atom_stco64_truncate        (AtomSTCO64 * stco64, guint32 n_entries);
 guint64    atom_trak_copy_data         (AtomTRAK * atom, guint8 ** buffer,
                                         guint64 * size, guint64 * offset);
 void       atom_stbl_clear             (AtomSTBL * stbl);
@@ -981,6 +1008,10 @@ void       atom_tfra_add_entry         (AtomTFRA *tfra, guint64 dts, guint32 sam
 void       atom_tfra_update_offset     (AtomTFRA * tfra, guint64 offset);
 void       atom_mfra_add_tfra          (AtomMFRA *mfra, AtomTFRA *tfra);
 guint64    atom_mfra_copy_data         (AtomMFRA *mfra, guint8 **buffer, guint64 *size, guint64* offset);
+AtomSIDX*  atom_sidx_new               (AtomsContext *context, guint32 reference_ID,
+                                        guint32 timescale);
+void       atom_sidx_free              (AtomSIDX *sidx);
+guint64    atom_sidx_copy_data         (AtomSIDX *sidx, guint8 **buffer, guint64 *size, guint64* offset);
 
 
 /* media sample description related helpers */
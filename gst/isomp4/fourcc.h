@@ -282,6 +282,8 @@ G_BEGIN_DECLS
 #define FOURCC_isom     GST_MAKE_FOURCC('i','s','o','m')
 #define FOURCC_mp41     GST_MAKE_FOURCC('m','p','4','1')
 #define FOURCC_mp42     GST_MAKE_FOURCC('m','p','4','2')
+#define FOURCC_msdh     GST_MAKE_FOURCC('m','s','d','h')
+#define FOURCC_msix     GST_MAKE_FOURCC('m','s','i','x')
 #define FOURCC_piff     GST_MAKE_FOURCC('p','i','f','f')
 #define FOURCC_titl     GST_MAKE_FOURCC('t','i','t','l')
 
@@ -81,6 +81,13 @@
  * #GstQTMux:streamable allows foregoing to add index metadata (at the end of
  * file).
  *
+ * For low-latency streaming, each fragment can in turn be written as several
+ * smaller moof and mdat pairs ("chunks") of #GstQTMux:chunk-duration or
+ * #GstQTMux:chunk-samples, so that data can be sent out before the fragment
+ * is complete, as in CMAF. #GstQTMux:write-styp then marks the start of each
+ * fragment with a styp atom, and #GstQTMux:write-sidx precedes each chunk by
+ * a sidx atom referencing it.
+ *
  * When the maximum duration to be recorded can be known in advance, #GstQTMux
  * also supports a 'Robust Muxing' mode. In robust muxing mode,  space for the
  * headers are reserved at the start of muxing, and rewritten at a configurable
@@ -96,6 +103,15 @@
  * #GstQTMux::reserved-duration-remaining property to see how close to full
  * the reserved space is becoming.
  *
+ * If #GstQTMux:faststart is combined with #GstQTMux:reserved-max-duration and
+ * the output is seekable, no temporary file is used. Instead, space for the
+ * moov is reserved right after the ftyp, sized from the expected number of
+ * samples and chunks of each track over the reserved duration, and the media
+ * data is written directly behind it. At EOS the final moov is written into
+ * the reserved space. Should the recording run longer than expected and the
+ * moov not fit anymore, it is written at the end of the file instead and a
+ * warning is posted.
+ *
  * <refsect2>
  * <title>Example pipelines</title>
  * |[
@@ -264,6 +280,10 @@ enum
   PROP_MOOV_RECOV_FILE,
   PROP_FRAGMENT_DURATION,
   PROP_STREAMABLE,
+  PROP_CHUNK_DURATION,
+  PROP_CHUNK_SAMPLES,
+  PROP_WRITE_STYP,
+  PROP_WRITE_SIDX,
   PROP_RESERVED_MAX_DURATION,
   PROP_RESERVED_DURATION_REMAINING,
   PROP_RESERVED_MOOV_UPDATE_PERIOD,
@@ -289,6 +309,10 @@ enum
 #define DEFAULT_MOOV_RECOV_FILE         NULL
 #define DEFAULT_FRAGMENT_DURATION       0
 #define DEFAULT_STREAMABLE              TRUE
+#define DEFAULT_CHUNK_DURATION          0
+#define DEFAULT_CHUNK_SAMPLES           0
+#define DEFAULT_WRITE_STYP              FALSE
+#define DEFAULT_WRITE_SIDX              FALSE
 #ifndef GST_REMOVE_DEPRECATED
 #define DEFAULT_DTS_METHOD              DTS_METHOD_REORDER
 #endif
@@ -466,6 +490,63 @@ gst_qt_mux_class_init (GstQTMuxClass * klass)
   g_object_class_install_property (gobject_class, PROP_STREAMABLE,
       g_param_spec_boolean ("streamable", "Streamable", streamable_desc,
           streamable, streamable_flags | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstQTMux:chunk-duration:
+   *
+   * Duration in milliseconds of the moof and mdat pairs a fragment is split
+   * into, so that the start of a fragment can be sent out before the
+   * fragment is complete. Only used when #GstQTMux:fragment-duration is set.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_CHUNK_DURATION,
+      g_param_spec_uint ("chunk-duration", "Chunk duration",
+          "Split fragments into chunks of moof and mdat of this duration "
+          "in ms, for low-latency delivery (0 = disabled)",
+          0, G_MAXUINT32, DEFAULT_CHUNK_DURATION,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstQTMux:chunk-samples:
+   *
+   * Number of samples in each of the moof and mdat pairs a fragment is
+   * split into. A chunk ends as soon as either this or
+   * #GstQTMux:chunk-duration is reached.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_CHUNK_SAMPLES,
+      g_param_spec_uint ("chunk-samples", "Chunk samples",
+          "Split fragments into chunks of moof and mdat of this number of "
+          "samples, for low-latency delivery (0 = disabled)",
+          0, G_MAXUINT32, DEFAULT_CHUNK_SAMPLES,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstQTMux:write-styp:
+   *
+   * Write a styp atom at the start of each fragment, so that every fragment
+   * can be handled as a separate segment.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_WRITE_STYP,
+      g_param_spec_boolean ("write-styp", "Write styp",
+          "Write a segment type atom at the start of each fragment",
+          DEFAULT_WRITE_STYP,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstQTMux:write-sidx:
+   *
+   * Write a sidx atom before each moof. Every sidx only references the
+   * chunk that follows it, not the whole fragment or the rest of the
+   * stream, so it can be written without waiting for later data.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_WRITE_SIDX,
+      g_param_spec_boolean ("write-sidx", "Write sidx",
+          "Write a segment index atom before each moof",
+          DEFAULT_WRITE_SIDX,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
   g_object_class_install_property (gobject_class, PROP_RESERVED_MAX_DURATION,
       g_param_spec_uint64 ("reserved-max-duration",
           "Reserved maximum file duration (ns)",
@@ -2575,6 +2656,71 @@ gst_qt_mux_prefill_samples (GstQTMux * qtmux)
   return TRUE;
 }
 
+/* Room on top of the estimated sample tables, for edit lists and for tags
+ * or extra atoms that only arrive while muxing */
+#define FAST_START_IN_PLACE_SLACK 4096
+
+/* Estimates the size of the moov (and extra atoms) after @duration of
+ * media, from the moov as configured so far and the expected number of
+ * samples and chunks of each track. Tracks whose sample rate is unknown
+ * are accounted with @bytes_per_sec_per_trak, like in robust muxing mode */
+static guint64
+gst_qt_mux_estimate_moov_size (GstQTMux * qtmux, GstClockTime duration,
+    guint bytes_per_sec_per_trak)
+{
+  guint64 size = 0, offset = 0;
+  guint64 chunks;
+  GSList *walk;
+
+  if (!atom_moov_copy_data (qtmux->moov, NULL, &size, &offset))
+    return 0;
+  if (gst_qt_mux_send_extra_atoms (qtmux, FALSE, &offset, FALSE) !=
+      GST_FLOW_OK)
+    return 0;
+
+  /* without interleaving we still end up with roughly a chunk per second */
+  if (qtmux->interleave_time != 0)
+    chunks = duration / qtmux->interleave_time + 1;
+  else
+    chunks = duration / GST_SECOND + 1;
+
+  for (walk = qtmux->sinkpads; walk; walk = g_slist_next (walk)) {
+    GstQTPad *qpad = (GstQTPad *) walk->data;
+    AtomTRAK *trak = qpad->trak;
+    guint64 samples = 0;
+    /* stsz and stts entry */
+    guint sample_bytes = 4 + 8;
+
+    if (!trak)
+      continue;
+
+    if (trak->mdia.minf.vmhd && qpad->expected_sample_duration_n != 0
+        && qpad->expected_sample_duration_d != 0) {
+      samples = gst_util_uint64_scale_ceil (duration,
+          qpad->expected_sample_duration_n,
+          qpad->expected_sample_duration_d * GST_SECOND);
+      /* ctts, in case frames get reordered, and stss */
+      sample_bytes += 8 + (qpad->sync ? 4 : 0);
+    } else if (trak->mdia.minf.smhd) {
+      /* raw audio has constant sized samples, so only the chunks add up.
+       * Compressed audio has at most one sample per 1024 audio samples for
+       * all the codecs we support except some speech codecs */
+      if (qpad->sample_size == 0)
+        samples = gst_util_uint64_scale_ceil (duration,
+            trak->mdia.mdhd.time_info.timescale, 1024 * GST_SECOND);
+    } else {
+      offset += gst_util_uint64_scale (duration, bytes_per_sec_per_trak,
+          GST_SECOND);
+      continue;
+    }
+
+    /* co64 and stsc entry per chunk */
+    offset += samples * sample_bytes + chunks * (8 + 12);
+  }
+
+  return offset + FAST_START_IN_PLACE_SLACK;
+}
+
 static GstFlowReturn
 gst_qt_mux_start_file (GstQTMux * qtmux)
 {
@@ -2620,7 +2766,14 @@ gst_qt_mux_start_file (GstQTMux * qtmux)
     else
       qtmux->mux_mode = GST_QT_MUX_MODE_FRAGMENTED;
   } else if (qtmux->fast_start) {
-    qtmux->mux_mode = GST_QT_MUX_MODE_FAST_START;
+    /* With a known maximum duration and a seekable output, the moov can be
+     * reserved in front of the media data instead of going through a
+     * temporary file */
+    if (reserved_max_duration != GST_CLOCK_TIME_NONE
+        && gst_qt_mux_downstream_is_seekable (qtmux))
+      qtmux->mux_mode = GST_QT_MUX_MODE_FAST_START_IN_PLACE;
+    else
+      qtmux->mux_mode = GST_QT_MUX_MODE_FAST_START;
   } else if (reserved_max_duration != GST_CLOCK_TIME_NONE) {
     if (qtmux->reserved_prefill)
       qtmux->mux_mode = GST_QT_MUX_MODE_ROBUST_RECORDING_PREFILL;
@@ -2645,6 +2798,8 @@ gst_qt_mux_start_file (GstQTMux * qtmux)
     case GST_QT_MUX_MODE_FAST_START:
     case GST_QT_MUX_MODE_FRAGMENTED_STREAMABLE:
       break;                    /* Don't need seekability, ignore */
+    case GST_QT_MUX_MODE_FAST_START_IN_PLACE:
+      break;                    /* Only chosen if downstream is seekable */
     case GST_QT_MUX_MODE_FRAGMENTED:
       if (!gst_qt_mux_downstream_is_seekable (qtmux)) {
         GST_WARNING_OBJECT (qtmux, "downstream is not seekable, but "
@@ -2919,6 +3074,42 @@ gst_qt_mux_start_file (GstQTMux * qtmux)
       }
 
       break;
+    case GST_QT_MUX_MODE_FAST_START_IN_PLACE:{
+      guint64 estimate;
+
+      ret = gst_qt_mux_prepare_and_send_ftyp (qtmux);
+      if (ret != GST_FLOW_OK)
+        break;
+
+      /* The final moov and extra atoms are written here at the end,
+       * followed by a free atom covering what is left */
+      qtmux->moov_pos = qtmux->header_size;
+
+      gst_qt_mux_configure_moov (qtmux);
+      gst_qt_mux_setup_metadata (qtmux);
+
+      estimate = gst_qt_mux_estimate_moov_size (qtmux, reserved_max_duration,
+          reserved_bytes_per_sec_per_trak);
+      if (estimate == 0 || estimate > G_MAXUINT32)
+        goto reserved_moov_too_small;
+      qtmux->reserved_moov_size = (guint32) estimate;
+
+      GST_DEBUG_OBJECT (qtmux, "reserving %u bytes for the moov",
+          qtmux->reserved_moov_size);
+
+      ret = gst_qt_mux_send_free_atom (qtmux, &qtmux->header_size,
+          qtmux->reserved_moov_size, FALSE);
+      if (ret != GST_FLOW_OK)
+        return ret;
+
+      qtmux->mdat_pos = qtmux->header_size;
+      /* extended atom in case we go over 4GB while writing and need
+       * the full 64-bit atom */
+      ret =
+          gst_qt_mux_send_mdat_header (qtmux, &qtmux->header_size, 0, TRUE,
+          FALSE);
+      break;
+    }
     case GST_QT_MUX_MODE_FAST_START:
       GST_OBJECT_LOCK (qtmux);
       qtmux->fast_start_file = g_fopen (qtmux->fast_start_file_path, "wb+");
@@ -3216,6 +3407,7 @@ gst_qt_mux_stop_file (GstQTMux * qtmux)
   gboolean ret = GST_FLOW_OK;
   guint64 offset = 0, size = 0;
   gboolean large_file;
+  guint64 in_place_size = 0;
   GSList *walk;
 
   GST_DEBUG_OBJECT (qtmux, "Updating remaining values and sending last data");
@@ -3333,18 +3525,10 @@ gst_qt_mux_stop_file (GstQTMux * qtmux)
           guint64 nsamples = 0;
           gint chunk_index = 0;
 
-          n = stbl->stco64.entries.len;
-          for (i = 0; i < n; i++) {
-            guint64 *entry = &atom_array_index (&stbl->stco64.entries, i);
-
-            if (*entry == sample_entry->chunk_offset) {
-              stbl->stco64.entries.len = i + 1;
-              chunk_index = i + 1;
-              break;
-            }
-          }
-          g_assert (i < n);
+          chunk_index = atom_stco64_find_entry (&stbl->stco64,
+              sample_entry->chunk_offset);
           g_assert (chunk_index > 0);
+          atom_stco64_truncate (&stbl->stco64, chunk_index);
 
           n = stbl->stsc.entries.len;
           for (i = 0; i < n; i++) {
@@ -3375,7 +3559,7 @@ gst_qt_mux_stop_file (GstQTMux * qtmux)
                   qpad->sample_offset - nsamples);
             } else {
               stbl->stsc.entries.len = i;
-              stbl->stco64.entries.len--;
+              atom_stco64_truncate (&stbl->stco64, chunk_index - 1);
             }
           } else {
             /* Everything in a single chunk */
@@ -3458,7 +3642,7 @@ gst_qt_mux_stop_file (GstQTMux * qtmux)
       break;
   }
 
-  /* Moov-at-end or fast-start mode from here down */
+  /* Moov-at-end or (in-place) fast-start mode from here down */
   gst_qt_mux_configure_moov (qtmux);
 
   gst_qt_mux_update_edit_lists (qtmux);
@@ -3492,6 +3676,43 @@ gst_qt_mux_stop_file (GstQTMux * qtmux)
         return ret;
       break;
     }
+    case GST_QT_MUX_MODE_FAST_START_IN_PLACE:{
+      /* the chunk offsets decide between stco and co64, so set them
+       * before measuring the moov */
+      atom_moov_chunks_set_offset (qtmux->moov, qtmux->header_size);
+
+      offset = size = 0;
+      if (!atom_moov_copy_data (qtmux->moov, NULL, &size, &offset))
+        goto serialize_error;
+      ret = gst_qt_mux_send_extra_atoms (qtmux, FALSE, &offset, FALSE);
+      if (ret != GST_FLOW_OK)
+        return ret;
+
+      GST_DEBUG_OBJECT (qtmux, "moov and extra atoms need %" G_GUINT64_FORMAT
+          " bytes, %u reserved", offset, qtmux->reserved_moov_size);
+
+      /* Anything left over must be able to hold a free atom header */
+      if (offset == qtmux->reserved_moov_size
+          || offset + 8 <= qtmux->reserved_moov_size) {
+        GstSegment segment;
+
+        in_place_size = offset;
+        gst_segment_init (&segment, GST_FORMAT_BYTES);
+        segment.start = qtmux->moov_pos;
+        gst_pad_push_event (qtmux->srcpad, gst_event_new_segment (&segment));
+      } else {
+        /* The media data directly follows the reserved space, so the moov
+         * goes to the end of the file and the reserved space stays free */
+        GST_ELEMENT_WARNING (qtmux, STREAM, MUX,
+            ("Not enough reserved space for the headers, the file will not "
+                "be fast-start"),
+            ("Need %" G_GUINT64_FORMAT " bytes, %u reserved. Increase "
+                "reserved-max-duration", offset, qtmux->reserved_moov_size));
+      }
+
+      offset = qtmux->header_size;
+      break;
+    }
     default:
       offset = qtmux->header_size;
       break;
@@ -3524,6 +3745,21 @@ gst_qt_mux_stop_file (GstQTMux * qtmux)
        * since we no longer write anything anyway */
       break;
     }
+    case GST_QT_MUX_MODE_FAST_START_IN_PLACE:
+    {
+      /* cover the rest of the reserved space */
+      if (in_place_size != 0 && in_place_size < qtmux->reserved_moov_size) {
+        ret = gst_qt_mux_send_free_atom (qtmux, NULL,
+            qtmux->reserved_moov_size - in_place_size, FALSE);
+        if (ret != GST_FLOW_OK)
+          return ret;
+      }
+
+      GST_DEBUG_OBJECT (qtmux, "updating mdat size");
+      ret = gst_qt_mux_update_mdat_size (qtmux, qtmux->mdat_pos,
+          qtmux->mdat_size, NULL, FALSE);
+      break;
+    }
     case GST_QT_MUX_MODE_FAST_START:
     {
       /* send mdat atom and move buffered data into it */
@@ -3558,75 +3794,147 @@ ftyp_error:
 }
 
 static GstFlowReturn
-gst_qt_mux_pad_fragment_add_buffer (GstQTMux * qtmux, GstQTPad * pad,
-    GstBuffer * buf, gboolean force, guint32 nsamples, gint64 dts,
-    guint32 delta, guint32 size, gboolean sync, gint64 pts_offset)
+gst_qt_mux_pad_fragment_flush (GstQTMux * qtmux, GstQTPad * pad)
 {
   GstFlowReturn ret = GST_FLOW_OK;
+  AtomMOOF *moof;
+  guint64 size = 0, offset = 0;
+  guint8 *data = NULL;
+  GstBuffer *buffer, *moof_buffer;
+  guint i, total_size;
 
-  /* setup if needed */
-  if (G_UNLIKELY (!pad->traf || force))
-    goto init;
-
-flush:
-  /* flush pad fragment if threshold reached,
-   * or at new keyframe if we should be minding those in the first place */
-  if (G_UNLIKELY (force || (sync && pad->sync) ||
-          pad->fragment_duration < (gint64) delta)) {
-    AtomMOOF *moof;
-    guint64 size = 0, offset = 0;
-    guint8 *data = NULL;
-    GstBuffer *buffer;
-    guint i, total_size;
-
-    /* now we know where moof ends up, update offset in tfra */
-    if (pad->tfra)
-      atom_tfra_update_offset (pad->tfra, qtmux->header_size);
-
-    moof = atom_moof_new (qtmux->context, qtmux->fragment_sequence);
-    /* takes ownership */
-    atom_moof_add_traf (moof, pad->traf);
-    pad->traf = NULL;
-    atom_moof_copy_data (moof, &data, &size, &offset);
+  moof = atom_moof_new (qtmux->context, qtmux->fragment_sequence);
+  /* takes ownership */
+  atom_moof_add_traf (moof, pad->traf);
+  pad->traf = NULL;
+  atom_moof_copy_data (moof, &data, &size, &offset);
+  moof_buffer = _gst_buffer_new_take_data (data, offset);
+
+  total_size = 0;
+  for (i = 0; i < atom_array_get_len (&pad->fragment_buffers); i++) {
+    total_size +=
+        gst_buffer_get_size (atom_array_index (&pad->fragment_buffers, i));
+  }
+
+  /* a segment starts with each fragment, which may be split into chunks */
+  if (qtmux->write_styp && pad->fragment_start) {
+    GList *brands = NULL;
+    AtomFTYP *styp;
+
+    if (qtmux->write_sidx)
+      brands = g_list_append (brands, GUINT_TO_POINTER (FOURCC_msix));
+    styp = atom_styp_new (qtmux->context, FOURCC_msdh, 0, brands);
+    g_list_free (brands);
+
+    size = offset = 0;
+    data = NULL;
+    atom_ftyp_copy_data (styp, &data, &size, &offset);
+    atom_ftyp_free (styp);
     buffer = _gst_buffer_new_take_data (data, offset);
-    GST_LOG_OBJECT (qtmux, "writing moof size %" G_GSIZE_FORMAT,
+    GST_LOG_OBJECT (qtmux, "writing styp size %" G_GSIZE_FORMAT,
         gst_buffer_get_size (buffer));
     ret = gst_qt_mux_send_buffer (qtmux, buffer, &qtmux->header_size, FALSE);
+  }
 
-    /* and actual data */
-    total_size = 0;
-    for (i = 0; i < atom_array_get_len (&pad->fragment_buffers); i++) {
-      total_size +=
-          gst_buffer_get_size (atom_array_index (&pad->fragment_buffers, i));
-    }
+  if (ret == GST_FLOW_OK && qtmux->write_sidx) {
+    AtomSIDX *sidx;
 
-    GST_LOG_OBJECT (qtmux, "writing %d buffers, total_size %d",
-        atom_array_get_len (&pad->fragment_buffers), total_size);
-    if (ret == GST_FLOW_OK)
-      ret = gst_qt_mux_send_mdat_header (qtmux, &qtmux->header_size, total_size,
-          FALSE, FALSE);
-    for (i = 0; i < atom_array_get_len (&pad->fragment_buffers); i++) {
-      if (G_LIKELY (ret == GST_FLOW_OK))
-        ret = gst_qt_mux_send_buffer (qtmux,
-            atom_array_index (&pad->fragment_buffers, i), &qtmux->header_size,
-            FALSE);
-      else
-        gst_buffer_unref (atom_array_index (&pad->fragment_buffers, i));
-    }
+    sidx = atom_sidx_new (qtmux->context, atom_trak_get_id (pad->trak),
+        atom_trak_get_timescale (pad->trak));
+    sidx->earliest_presentation_time = MAX (pad->chunk_earliest_pts, 0);
+    /* moof, mdat header and payload */
+    sidx->referenced_size = gst_buffer_get_size (moof_buffer) + 8 + total_size;
+    sidx->subsegment_duration = pad->chunk_elapsed;
+    sidx->starts_with_sap = pad->chunk_starts_with_sap;
+
+    size = offset = 0;
+    data = NULL;
+    atom_sidx_copy_data (sidx, &data, &size, &offset);
+    atom_sidx_free (sidx);
+    buffer = _gst_buffer_new_take_data (data, offset);
+    GST_LOG_OBJECT (qtmux, "writing sidx size %" G_GSIZE_FORMAT,
+        gst_buffer_get_size (buffer));
+    ret = gst_qt_mux_send_buffer (qtmux, buffer, &qtmux->header_size, FALSE);
+  }
+
+  /* now we know where moof ends up, update offset in tfra */
+  if (pad->tfra)
+    atom_tfra_update_offset (pad->tfra, qtmux->header_size);
+
+  GST_LOG_OBJECT (qtmux, "writing moof size %" G_GSIZE_FORMAT,
+      gst_buffer_get_size (moof_buffer));
+  if (ret == GST_FLOW_OK)
+    ret = gst_qt_mux_send_buffer (qtmux, moof_buffer, &qtmux->header_size,
+        FALSE);
+  else
+    gst_buffer_unref (moof_buffer);
+
+  /* and actual data */
+  GST_LOG_OBJECT (qtmux, "writing %d buffers, total_size %d",
+      atom_array_get_len (&pad->fragment_buffers), total_size);
+  if (ret == GST_FLOW_OK)
+    ret = gst_qt_mux_send_mdat_header (qtmux, &qtmux->header_size, total_size,
+        FALSE, FALSE);
+  for (i = 0; i < atom_array_get_len (&pad->fragment_buffers); i++) {
+    if (G_LIKELY (ret == GST_FLOW_OK))
+      ret = gst_qt_mux_send_buffer (qtmux,
+          atom_array_index (&pad->fragment_buffers, i), &qtmux->header_size,
+          FALSE);
+    else
+      gst_buffer_unref (atom_array_index (&pad->fragment_buffers, i));
+  }
+
+  atom_array_clear (&pad->fragment_buffers);
+  atom_moof_free (moof);
+  qtmux->fragment_sequence++;
+  pad->fragment_start = FALSE;
+
+  return ret;
+}
 
-    atom_array_clear (&pad->fragment_buffers);
-    atom_moof_free (moof);
-    qtmux->fragment_sequence++;
-    force = FALSE;
+static GstFlowReturn
+gst_qt_mux_pad_fragment_add_buffer (GstQTMux * qtmux, GstQTPad * pad,
+    GstBuffer * buf, gboolean force, guint32 nsamples, gint64 dts,
+    guint32 delta, guint32 size, gboolean sync, gint64 pts_offset)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean new_fragment = (pad->traf == NULL);
+
+  if (pad->traf) {
+    /* flush pad fragment if threshold reached,
+     * or at new keyframe if we should be minding those in the first place */
+    if (G_UNLIKELY ((sync && pad->sync) ||
+            pad->fragment_duration < (gint64) delta)) {
+      ret = gst_qt_mux_pad_fragment_flush (qtmux, pad);
+      new_fragment = TRUE;
+    } else if (G_UNLIKELY ((qtmux->chunk_samples &&
+                pad->chunk_n_samples >= qtmux->chunk_samples) ||
+            (qtmux->chunk_duration && pad->chunk_duration < (gint64) delta))) {
+      /* otherwise, only end the chunk; the fragment goes on in a new
+       * moof and mdat */
+      ret = gst_qt_mux_pad_fragment_flush (qtmux, pad);
+    }
   }
 
-init:
+  /* setup if needed */
   if (G_UNLIKELY (!pad->traf)) {
-    GST_LOG_OBJECT (qtmux, "setting up new fragment");
+    guint32 timescale = atom_trak_get_timescale (pad->trak);
+
+    GST_LOG_OBJECT (qtmux, "setting up new %s",
+        new_fragment ? "fragment" : "chunk");
     pad->traf = atom_traf_new (qtmux->context, atom_trak_get_id (pad->trak));
     atom_array_init (&pad->fragment_buffers, 512);
-    pad->fragment_duration = gst_util_uint64_scale (qtmux->fragment_duration,
-        atom_trak_get_timescale (pad->trak), 1000);
+    if (new_fragment) {
+      pad->fragment_duration =
+          gst_util_uint64_scale (qtmux->fragment_duration, timescale, 1000);
+      pad->fragment_start = TRUE;
+    }
+    pad->chunk_duration =
+        gst_util_uint64_scale (qtmux->chunk_duration, timescale, 1000);
+    pad->chunk_n_samples = 0;
+    pad->chunk_earliest_pts = dts + pts_offset;
+    pad->chunk_elapsed = 0;
+    pad->chunk_starts_with_sap = sync;
 
     if (G_UNLIKELY (qtmux->mfra && !pad->tfra)) {
       pad->tfra = atom_tfra_new (qtmux->context, atom_trak_get_id (pad->trak));
@@ -3640,16 +3948,20 @@ init:
       pad->sync && sync);
   atom_array_append (&pad->fragment_buffers, buf, 256);
   pad->fragment_duration -= delta;
+  pad->chunk_duration -= delta;
+  pad->chunk_n_samples++;
+  pad->chunk_elapsed += delta;
+  pad->chunk_earliest_pts = MIN (pad->chunk_earliest_pts, dts + pts_offset);
 
   if (pad->tfra) {
     guint32 sn = atom_traf_get_sample_num (pad->traf);
 
-    if ((sync && pad->sync) || (sn == 1 && !pad->sync))
+    if ((sync && pad->sync) || (sn == 1 && !pad->sync && pad->fragment_start))
       atom_tfra_add_entry (pad->tfra, dts, sn);
   }
 
-  if (G_UNLIKELY (force))
-    goto flush;
+  if (G_UNLIKELY (force) && ret == GST_FLOW_OK)
+    ret = gst_qt_mux_pad_fragment_flush (qtmux, pad);
 
   return ret;
 }
@@ -3883,6 +4195,7 @@ gst_qt_mux_register_and_push_sample (GstQTMux * qtmux, GstQTPad * pad,
     }
     case GST_QT_MUX_MODE_MOOV_AT_END:
     case GST_QT_MUX_MODE_FAST_START:
+    case GST_QT_MUX_MODE_FAST_START_IN_PLACE:
     case GST_QT_MUX_MODE_ROBUST_RECORDING:
       atom_trak_add_samples (pad->trak, nsamples, (gint32) scaled_duration,
           sample_size, chunk_offset, sync, pts_offset);
@@ -5900,6 +6213,18 @@ gst_qt_mux_get_property (GObject * object,
     case PROP_STREAMABLE:
       g_value_set_boolean (value, qtmux->streamable);
       break;
+    case PROP_CHUNK_DURATION:
+      g_value_set_uint (value, qtmux->chunk_duration);
+      break;
+    case PROP_CHUNK_SAMPLES:
+      g_value_set_uint (value, qtmux->chunk_samples);
+      break;
+    case PROP_WRITE_STYP:
+      g_value_set_boolean (value, qtmux->write_styp);
+      break;
+    case PROP_WRITE_SIDX:
+      g_value_set_boolean (value, qtmux->write_sidx);
+      break;
     case PROP_RESERVED_MAX_DURATION:
       g_value_set_uint64 (value, qtmux->reserved_max_duration);
       break;
@@ -6008,6 +6333,18 @@ gst_qt_mux_set_property (GObject * object,
       }
       break;
     }
+    case PROP_CHUNK_DURATION:
+      qtmux->chunk_duration = g_value_get_uint (value);
+      break;
+    case PROP_CHUNK_SAMPLES:
+      qtmux->chunk_samples = g_value_get_uint (value);
+      break;
+    case PROP_WRITE_STYP:
+      qtmux->write_styp = g_value_get_boolean (value);
+      break;
+    case PROP_WRITE_SIDX:
+      qtmux->write_sidx = g_value_get_boolean (value);
+      break;
     case PROP_RESERVED_MAX_DURATION:
       qtmux->reserved_max_duration = g_value_get_uint64 (value);
       break;
@@ -134,6 +134,15 @@ struct _GstQTPad
   ATOM_ARRAY (GstBuffer *) fragment_buffers;
   /* running fragment duration */
   gint64 fragment_duration;
+  /* set until the first chunk of a fragment is written */
+  gboolean fragment_start;
+  /* running chunk duration and samples */
+  gint64 chunk_duration;
+  guint32 chunk_n_samples;
+  /* sidx book-keeping for the current chunk */
+  gint64 chunk_earliest_pts;
+  guint32 chunk_elapsed;
+  gboolean chunk_starts_with_sap;
   /* optional fragment index book-keeping */
   AtomTFRA *tfra;
 
@@ -175,6 +184,7 @@ typedef enum _GstQtMuxMode {
     GST_QT_MUX_MODE_FAST_START,
     GST_QT_MUX_MODE_ROBUST_RECORDING,
     GST_QT_MUX_MODE_ROBUST_RECORDING_PREFILL,
+    GST_QT_MUX_MODE_FAST_START_IN_PLACE,
 } GstQtMuxMode;
 
 struct _GstQTMux
@@ -252,6 +262,11 @@ struct _GstQTMux
   gchar *fast_start_file_path;
   gchar *moov_recov_file_path;
   guint32 fragment_duration;
+  /* Optional chunking of fragments into several moof + mdat pairs */
+  guint32 chunk_duration;
+  guint32 chunk_samples;
+  gboolean write_styp;
+  gboolean write_sidx;
   /* Whether or not to work in 'streamable' mode and not
    * seek to rewrite headers - only valid for fragmented
    * mode. */
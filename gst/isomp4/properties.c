@@ -77,6 +77,12 @@ guint64 prop_copy_ ## name ## _array (datatype *prop, guint size,	\
     guint8 ** buffer, guint64 * bsize, guint64 * offset) { 		\
   guint i;								\
 									\
+  if (!buffer) {							\
+    *offset += sizeof (datatype) * size;				\
+    return sizeof (datatype) * size;					\
+  }									\
+  prop_copy_ensure_buffer (buffer, bsize, offset,			\
+      sizeof (datatype) * size);					\
   for (i = 0; i < size; i++) {						\
     prop_copy_ ## name (prop[i], buffer, bsize, offset);		\
   }									\
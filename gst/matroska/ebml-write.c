@@ -57,6 +57,7 @@ gst_ebml_write_init (GstEbmlWrite * ebml)
   ebml->last_pos = G_MAXUINT64; /* force segment event */
 
   ebml->cache = NULL;
+  ebml->spare_cache = NULL;
   ebml->streamheader = NULL;
   ebml->streamheader_pos = 0;
   ebml->writing_streamheader = FALSE;
@@ -75,6 +76,11 @@ gst_ebml_write_finalize (GObject * object)
     ebml->cache = NULL;
   }
 
+  if (ebml->spare_cache) {
+    gst_byte_writer_free (ebml->spare_cache);
+    ebml->spare_cache = NULL;
+  }
+
   if (ebml->streamheader) {
     gst_byte_writer_free (ebml->streamheader);
     ebml->streamheader = NULL;
@@ -196,6 +202,9 @@ gst_ebml_stop_streamheader (GstEbmlWrite * ebml)
  * them and they'll be pushed to the next element all
  * at once. This saves memory and time for buffer
  * allocation and init, and it looks better.
+ *
+ * The writer of a flushed cache is reused for the next
+ * cache, its memory goes downstream with the flushed buffer.
  */
 void
 gst_ebml_write_set_cache (GstEbmlWrite * ebml, guint size)
@@ -203,7 +212,13 @@ gst_ebml_write_set_cache (GstEbmlWrite * ebml, guint size)
   g_return_if_fail (ebml->cache == NULL);
 
   GST_DEBUG ("Starting cache at %" G_GUINT64_FORMAT, ebml->pos);
-  ebml->cache = gst_byte_writer_new_with_size (size, FALSE);
+  if (ebml->spare_cache) {
+    ebml->cache = ebml->spare_cache;
+    ebml->spare_cache = NULL;
+    gst_byte_writer_init_with_size (ebml->cache, size, FALSE);
+  } else {
+    ebml->cache = gst_byte_writer_new_with_size (size, FALSE);
+  }
   ebml->cache_pos = ebml->pos;
 }
 
@@ -245,7 +260,8 @@ gst_ebml_write_flush_cache (GstEbmlWrite * ebml, gboolean is_keyframe,
   if (!ebml->cache)
     return;
 
-  buffer = gst_byte_writer_free_and_get_buffer (ebml->cache);
+  buffer = gst_byte_writer_reset_and_get_buffer (ebml->cache);
+  ebml->spare_cache = ebml->cache;
   ebml->cache = NULL;
   GST_DEBUG ("Flushing cache of size %" G_GSIZE_FORMAT,
       gst_buffer_get_size (buffer));
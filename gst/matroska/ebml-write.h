@@ -52,6 +52,8 @@ typedef struct _GstEbmlWrite {
 
   GstByteWriter *cache;
   guint64 cache_pos;
+  /* flushed cache kept around for the next gst_ebml_write_set_cache() */
+  GstByteWriter *spare_cache;
 
   GstFlowReturn last_write_result;
 
@@ -72,7 +72,8 @@ enum
   PROP_STREAMABLE,
   PROP_TIMECODESCALE,
   PROP_MIN_CLUSTER_DURATION,
-  PROP_MAX_CLUSTER_DURATION
+  PROP_MAX_CLUSTER_DURATION,
+  PROP_STREAMABLE_CUES
 };
 
 #define  DEFAULT_DOCTYPE_VERSION         2
@@ -82,6 +83,7 @@ enum
 #define  DEFAULT_TIMECODESCALE           GST_MSECOND
 #define  DEFAULT_MIN_CLUSTER_DURATION    500 * GST_MSECOND
 #define  DEFAULT_MAX_CLUSTER_DURATION    65535 * GST_MSECOND
+#define  DEFAULT_STREAMABLE_CUES         FALSE
 
 /* WAVEFORMATEX is gst_riff_strf_auds + an extra guint16 extension size */
 #define WAVEFORMATEX_SIZE  (2 + sizeof (gst_riff_strf_auds))
@@ -362,6 +364,13 @@ gst_matroska_mux_class_init (GstMatroskaMuxClass * klass)
           "0 means no maximum duration.", 0,
           G_MAXINT64, DEFAULT_MAX_CLUSTER_DURATION,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_STREAMABLE_CUES,
+      g_param_spec_boolean ("streamable-cues", "Write cues when streamable",
+          "If set to true, streamable output still gets an index, which is "
+          "appended at the end of the stream without seeking back. The "
+          "SeekHead is already out by then, so it has no entry for this "
+          "index and readers have to find it at the end of the file.",
+          DEFAULT_STREAMABLE_CUES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_matroska_mux_change_state);
@@ -491,6 +500,7 @@ gst_matroska_mux_init (GstMatroskaMux * mux, gpointer g_class)
   mux->time_scale = DEFAULT_TIMECODESCALE;
   mux->min_cluster_duration = DEFAULT_MIN_CLUSTER_DURATION;
   mux->max_cluster_duration = DEFAULT_MAX_CLUSTER_DURATION;
+  mux->streamable_cues = DEFAULT_STREAMABLE_CUES;
 
   /* initialize internal variables */
   mux->index = NULL;
@@ -3188,6 +3198,47 @@ gst_matroska_mux_write_toc_entry_tags (GstMatroskaMux * mux,
 }
 #endif
 
+/**
+ * gst_matroska_mux_write_cues:
+ * @mux: #GstMatroskaMux
+ *
+ * Write the index at the current position. This does not seek, so it is
+ * also used to append the index to streamable output.
+ */
+static void
+gst_matroska_mux_write_cues (GstMatroskaMux * mux)
+{
+  GstEbmlWrite *ebml = mux->ebml_write;
+  guint n;
+  guint64 master, pointentry_master, trackpos_master;
+
+  if (mux->index == NULL)
+    return;
+
+  mux->cues_pos = ebml->pos;
+  gst_ebml_write_set_cache (ebml, 12 + 41 * mux->num_indexes);
+  master = gst_ebml_write_master_start (ebml, GST_MATROSKA_ID_CUES);
+
+  for (n = 0; n < mux->num_indexes; n++) {
+    GstMatroskaIndex *idx = &mux->index[n];
+
+    pointentry_master = gst_ebml_write_master_start (ebml,
+        GST_MATROSKA_ID_POINTENTRY);
+    gst_ebml_write_uint (ebml, GST_MATROSKA_ID_CUETIME,
+        idx->time / mux->time_scale);
+    trackpos_master = gst_ebml_write_master_start (ebml,
+        GST_MATROSKA_ID_CUETRACKPOSITIONS);
+    gst_ebml_write_uint (ebml, GST_MATROSKA_ID_CUETRACK, idx->track);
+    gst_ebml_write_uint (ebml, GST_MATROSKA_ID_CUECLUSTERPOSITION,
+        idx->pos - mux->segment_master);
+    gst_ebml_write_master_finish (ebml, trackpos_master);
+    gst_ebml_write_master_finish (ebml, pointentry_master);
+  }
+
+  gst_ebml_write_master_finish (ebml, master);
+  gst_ebml_write_flush_cache (ebml, FALSE, GST_CLOCK_TIME_NONE);
+}
+
 /**
  * gst_matroska_mux_finish:
  * @mux: #GstMatroskaMux
@@ -3210,33 +3261,7 @@ gst_matroska_mux_finish (GstMatroskaMux * mux)
   }
 
   /* cues */
-  if (mux->index != NULL) {
-    guint n;
-    guint64 master, pointentry_master, trackpos_master;
-
-    mux->cues_pos = ebml->pos;
-    gst_ebml_write_set_cache (ebml, 12 + 41 * mux->num_indexes);
-    master = gst_ebml_write_master_start (ebml, GST_MATROSKA_ID_CUES);
-
-    for (n = 0; n < mux->num_indexes; n++) {
-      GstMatroskaIndex *idx = &mux->index[n];
-
-      pointentry_master = gst_ebml_write_master_start (ebml,
-          GST_MATROSKA_ID_POINTENTRY);
-      gst_ebml_write_uint (ebml, GST_MATROSKA_ID_CUETIME,
-          idx->time / mux->time_scale);
-      trackpos_master = gst_ebml_write_master_start (ebml,
-          GST_MATROSKA_ID_CUETRACKPOSITIONS);
-      gst_ebml_write_uint (ebml, GST_MATROSKA_ID_CUETRACK, idx->track);
-      gst_ebml_write_uint (ebml, GST_MATROSKA_ID_CUECLUSTERPOSITION,
-          idx->pos - mux->segment_master);
-      gst_ebml_write_master_finish (ebml, trackpos_master);
-      gst_ebml_write_master_finish (ebml, pointentry_master);
-    }
-
-    gst_ebml_write_master_finish (ebml, master);
-    gst_ebml_write_flush_cache (ebml, FALSE, GST_CLOCK_TIME_NONE);
-  }
+  gst_matroska_mux_write_cues (mux);
 
   /* tags */
   tags = gst_tag_setter_get_tag_list (GST_TAG_SETTER (mux));
@@ -3699,7 +3724,8 @@ gst_matroska_mux_write_data (GstMatroskaMux * mux, GstMatroskaPad * collect_pad,
    * the block in the cluster which contains the timestamp, should also work
    * for files with multiple audio tracks.
    */
-  if (!mux->ebml_write->streamable && (is_video_keyframe || is_audio_only)) {
+  if ((!mux->ebml_write->streamable || mux->streamable_cues)
+      && (is_video_keyframe || is_audio_only)) {
     gint last_idx = -1;
 
     if (mux->min_index_interval != 0) {
@@ -3785,7 +3811,8 @@ gst_matroska_mux_write_data (GstMatroskaMux * mux, GstMatroskaPad * collect_pad,
 
     return gst_ebml_last_write_result (ebml);
   } else {
-    gst_ebml_write_set_cache (ebml, gst_buffer_get_size (buf) * 2);
+    /* only the headers go through the cache */
+    gst_ebml_write_set_cache (ebml, 0x40);
     /* write and call order slightly unnatural,
      * but avoids seek and minizes pushing */
     blockgroup = gst_ebml_write_master_start (ebml, GST_MATROSKA_ID_BLOCKGROUP);
@@ -3856,6 +3883,11 @@ gst_matroska_mux_handle_buffer (GstCollectPads * pads, GstCollectData * data,
     GST_DEBUG_OBJECT (mux, "No best pad. Finishing...");
     if (!mux->ebml_write->streamable) {
       gst_matroska_mux_finish (mux);
+    } else if (mux->streamable_cues) {
+      /* the SeekHead can't be rewritten without seeking back, so these
+       * cues stay without a SeekHead entry */
+      GST_DEBUG_OBJECT (mux, "... but streamable, only appending cues");
+      gst_matroska_mux_write_cues (mux);
     } else {
       GST_DEBUG_OBJECT (mux, "... but streamable, nothing to finish");
     }
@@ -3990,6 +4022,9 @@ gst_matroska_mux_set_property (GObject * object,
     case PROP_MAX_CLUSTER_DURATION:
       mux->max_cluster_duration = g_value_get_int64 (value);
       break;
+    case PROP_STREAMABLE_CUES:
+      mux->streamable_cues = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4027,6 +4062,9 @@ gst_matroska_mux_get_property (GObject * object,
     case PROP_MAX_CLUSTER_DURATION:
       g_value_set_int64 (value, mux->max_cluster_duration);
       break;
+    case PROP_STREAMABLE_CUES:
+      g_value_set_boolean (value, mux->streamable_cues);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -104,6 +104,8 @@ struct _GstMatroskaMux {
   GstMatroskaIndex *index;
   guint          num_indexes;
   GstClockTimeDiff min_index_interval;
+  /* whether to append the index to streamable output */
+  gboolean       streamable_cues;
  
   /* timescale in the file */
   guint64        time_scale;
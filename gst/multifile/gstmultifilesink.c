@@ -105,6 +105,15 @@
  * </listitem>
  * </itemizedlist>
  *
+ * If the #GstMultiFileSink:write-behind property is %TRUE, files are opened,
+ * written and closed by a dedicated I/O thread. Buffers are queued up to
+ * #GstMultiFileSink:write-behind-max-bytes and written out in chunks of
+ * #GstMultiFileSink:write-block-size bytes, so that latency spikes of the
+ * storage do not stall the streaming thread. In this mode the messages are
+ * posted when the data is handed over to the I/O thread and write errors are
+ * reported on the next buffer. All pending data is written out before EOS
+ * is forwarded.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -138,6 +147,9 @@ GST_DEBUG_CATEGORY_STATIC (gst_multi_file_sink_debug);
 #define DEFAULT_MAX_FILE_SIZE G_GUINT64_CONSTANT(2*1024*1024*1024)
 #define DEFAULT_MAX_FILE_DURATION GST_CLOCK_TIME_NONE
 #define DEFAULT_AGGREGATE_GOPS FALSE
+#define DEFAULT_WRITE_BEHIND FALSE
+#define DEFAULT_WRITE_BEHIND_MAX_BYTES (32 * 1024 * 1024)
+#define DEFAULT_WRITE_BLOCK_SIZE (1024 * 1024)
 
 enum
 {
@@ -149,9 +161,32 @@ enum
   PROP_MAX_FILES,
   PROP_MAX_FILE_SIZE,
   PROP_MAX_FILE_DURATION,
-  PROP_AGGREGATE_GOPS
+  PROP_AGGREGATE_GOPS,
+  PROP_WRITE_BEHIND,
+  PROP_WRITE_BEHIND_MAX_BYTES,
+  PROP_WRITE_BLOCK_SIZE,
+  PROP_STATS
 };
 
+/* Operations executed in order by the I/O thread in write-behind mode */
+typedef enum
+{
+  IO_OP_OPEN,
+  IO_OP_WRITE,
+  IO_OP_CLOSE,
+  IO_OP_SET_CONTENTS,
+  IO_OP_REMOVE,
+  IO_OP_POST_MESSAGE
+} GstMultiFileSinkIOOp;
+
+typedef struct
+{
+  GstMultiFileSinkIOOp op;
+  gchar *filename;
+  GstBuffer *buffer;
+  GstStructure *structure;
+} GstMultiFileSinkIOCmd;
+
 static void gst_multi_file_sink_finalize (GObject * object);
 
 static void gst_multi_file_sink_set_property (GObject * object, guint prop_id,
@@ -177,6 +212,8 @@ static void gst_multi_file_sink_ensure_max_files (GstMultiFileSink *
     multifilesink);
 static gboolean gst_multi_file_sink_event (GstBaseSink * sink,
     GstEvent * event);
+static gboolean gst_multi_file_sink_unlock (GstBaseSink * sink);
+static gboolean gst_multi_file_sink_unlock_stop (GstBaseSink * sink);
 
 #define GST_TYPE_MULTI_FILE_SINK_NEXT (gst_multi_file_sink_next_get_type ())
 static GType
@@ -306,6 +343,106 @@ gst_multi_file_sink_class_init (GstMultiFileSinkClass * klass)
           "splitting", DEFAULT_AGGREGATE_GOPS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstMultiFileSink:write-behind:
+   *
+   * Open, write and close files from a dedicated I/O thread instead of the
+   * streaming thread. The streaming thread only blocks when more than
+   * #GstMultiFileSink:write-behind-max-bytes are waiting to be written.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_WRITE_BEHIND,
+      g_param_spec_boolean ("write-behind", "Write Behind",
+          "Write files from a dedicated I/O thread", DEFAULT_WRITE_BEHIND,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:write-behind-max-bytes:
+   *
+   * Maximum number of bytes queued for the I/O thread in write-behind mode.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_WRITE_BEHIND_MAX_BYTES,
+      g_param_spec_uint64 ("write-behind-max-bytes", "Write Behind Max Bytes",
+          "Maximum number of bytes queued for writing in write-behind mode",
+          1, G_MAXUINT64, DEFAULT_WRITE_BEHIND_MAX_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:write-block-size:
+   *
+   * Size of the chunks written to disk in write-behind mode. Small buffers
+   * are coalesced and only full blocks are written until the file is closed.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_WRITE_BLOCK_SIZE,
+      g_param_spec_uint ("write-block-size", "Write Block Size",
+          "Size of the chunks written to disk in write-behind mode",
+          512, G_MAXINT, DEFAULT_WRITE_BLOCK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:stats:
+   *
+   * Statistics of the I/O thread in write-behind mode. This property returns
+   * a GstStructure with name application/x-multifilesink-stats with the
+   * following fields:
+   *
+   * <itemizedlist>
+   * <listitem>
+   *   <para>
+   *   #guint64
+   *   <classname>&quot;queued-bytes&quot;</classname>:
+   *   the number of bytes currently waiting to be written.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #guint64
+   *   <classname>&quot;max-queued-bytes&quot;</classname>:
+   *   the highest number of bytes that were waiting to be written.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #guint64
+   *   <classname>&quot;bytes-written&quot;</classname>:
+   *   the number of bytes written by the I/O thread.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #guint64
+   *   <classname>&quot;operations&quot;</classname>:
+   *   the number of open, write, close and remove operations executed.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #GstClockTime
+   *   <classname>&quot;average-latency&quot;</classname>:
+   *   the average time an operation took.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #GstClockTime
+   *   <classname>&quot;max-latency&quot;</classname>:
+   *   the longest time an operation took.
+   *   </para>
+   * </listitem>
+   * </itemizedlist>
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics of the write-behind I/O thread", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->finalize = gst_multi_file_sink_finalize;
 
   gstbasesink_class->start = GST_DEBUG_FUNCPTR (gst_multi_file_sink_start);
@@ -316,6 +453,9 @@ gst_multi_file_sink_class_init (GstMultiFileSinkClass * klass)
   gstbasesink_class->set_caps =
       GST_DEBUG_FUNCPTR (gst_multi_file_sink_set_caps);
   gstbasesink_class->event = GST_DEBUG_FUNCPTR (gst_multi_file_sink_event);
+  gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_multi_file_sink_unlock);
+  gstbasesink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_multi_file_sink_unlock_stop);
 
   GST_DEBUG_CATEGORY_INIT (gst_multi_file_sink_debug, "multifilesink", 0,
       "multifilesink element");
@@ -340,6 +480,13 @@ gst_multi_file_sink_init (GstMultiFileSink * multifilesink)
   multifilesink->aggregate_gops = DEFAULT_AGGREGATE_GOPS;
   multifilesink->gop_adapter = NULL;
 
+  multifilesink->write_behind = DEFAULT_WRITE_BEHIND;
+  multifilesink->write_behind_max_bytes = DEFAULT_WRITE_BEHIND_MAX_BYTES;
+  multifilesink->write_block_size = DEFAULT_WRITE_BLOCK_SIZE;
+  g_mutex_init (&multifilesink->io_lock);
+  g_cond_init (&multifilesink->io_cond);
+  g_queue_init (&multifilesink->io_queue);
+
   gst_base_sink_set_sync (GST_BASE_SINK (multifilesink), FALSE);
 
   multifilesink->next_segment = GST_CLOCK_TIME_NONE;
@@ -352,10 +499,335 @@ gst_multi_file_sink_finalize (GObject * object)
   GstMultiFileSink *sink = GST_MULTI_FILE_SINK (object);
 
   g_free (sink->filename);
+  g_mutex_clear (&sink->io_lock);
+  g_cond_clear (&sink->io_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_multi_file_sink_io_cmd_free (GstMultiFileSinkIOCmd * cmd)
+{
+  g_free (cmd->filename);
+  if (cmd->buffer)
+    gst_buffer_unref (cmd->buffer);
+  if (cmd->structure)
+    gst_structure_free (cmd->structure);
+  g_slice_free (GstMultiFileSinkIOCmd, cmd);
+}
+
+static void
+gst_multi_file_sink_io_error (GstMultiFileSink * sink, const gchar * filename,
+    gint err)
+{
+  switch (err) {
+    case ENOSPC:
+      GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT,
+          ("Error while writing to file \"%s\".", filename),
+          ("%s", g_strerror (err)));
+      break;
+    default:
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+          ("Error while writing to file \"%s\".", filename),
+          ("%s", g_strerror (err)));
+  }
+}
+
+/* Called from the I/O thread without the lock. Only the I/O thread touches
+ * io_file, the filename of the current file is kept for error messages. */
+static gboolean
+gst_multi_file_sink_io_execute (GstMultiFileSink * sink,
+    GstMultiFileSinkIOCmd * cmd, gchar ** cur_filename)
+{
+  GstMapInfo map;
+  GError *error = NULL;
+  gboolean ret = TRUE;
+
+  switch (cmd->op) {
+    case IO_OP_OPEN:
+      g_assert (sink->io_file == NULL);
+
+      GST_INFO_OBJECT (sink, "opening file %s", cmd->filename);
+      sink->io_file = g_fopen (cmd->filename, "wb");
+      if (sink->io_file == NULL) {
+        GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE,
+            ("Could not open file \"%s\" for writing.", cmd->filename),
+            GST_ERROR_SYSTEM);
+        return FALSE;
+      }
+      /* let stdio coalesce the writes so that only full blocks hit the
+       * disk until the file is closed */
+      setvbuf (sink->io_file, NULL, _IOFBF, sink->io_block_size);
+
+      g_free (*cur_filename);
+      *cur_filename = g_strdup (cmd->filename);
+      break;
+    case IO_OP_WRITE:
+      g_assert (sink->io_file != NULL);
+
+      gst_buffer_map (cmd->buffer, &map, GST_MAP_READ);
+      if (map.size > 0 && fwrite (map.data, map.size, 1, sink->io_file) != 1) {
+        gst_multi_file_sink_io_error (sink, *cur_filename, errno);
+        ret = FALSE;
+      }
+      gst_buffer_unmap (cmd->buffer, &map);
+      break;
+    case IO_OP_CLOSE:
+      g_assert (sink->io_file != NULL);
+
+      /* fclose() flushes the last partial block */
+      if (fclose (sink->io_file) != 0) {
+        gst_multi_file_sink_io_error (sink, *cur_filename, errno);
+        ret = FALSE;
+      }
+      sink->io_file = NULL;
+      break;
+    case IO_OP_SET_CONTENTS:
+      gst_buffer_map (cmd->buffer, &map, GST_MAP_READ);
+      if (!g_file_set_contents (cmd->filename, (char *) map.data, map.size,
+              &error)) {
+        if (error->code == G_FILE_ERROR_NOSPC)
+          gst_multi_file_sink_io_error (sink, cmd->filename, ENOSPC);
+        else
+          GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+              ("Error while writing to file \"%s\".", cmd->filename),
+              ("%s", error->message));
+        g_error_free (error);
+        ret = FALSE;
+      }
+      gst_buffer_unmap (cmd->buffer, &map);
+      break;
+    case IO_OP_REMOVE:
+      g_remove (cmd->filename);
+      break;
+    case IO_OP_POST_MESSAGE:
+      /* everything queued before, e.g. closing the file, is done now */
+      gst_element_post_message (GST_ELEMENT_CAST (sink),
+          gst_message_new_element (GST_OBJECT_CAST (sink), cmd->structure));
+      cmd->structure = NULL;
+      break;
+  }
+
+  return ret;
+}
+
+static gpointer
+gst_multi_file_sink_io_thread (GstMultiFileSink * sink)
+{
+  GstMultiFileSinkIOCmd *cmd;
+  gchar *cur_filename = NULL;
+
+  GST_DEBUG_OBJECT (sink, "I/O thread started");
+
+  g_mutex_lock (&sink->io_lock);
+  while (TRUE) {
+    GstMultiFileSinkIOOp op;
+    gboolean failed;
+    gint64 start, latency;
+    gsize size;
+
+    while (g_queue_is_empty (&sink->io_queue) && !sink->io_stop)
+      g_cond_wait (&sink->io_cond, &sink->io_lock);
+
+    /* only exit once everything that was queued has been written */
+    cmd = g_queue_pop_head (&sink->io_queue);
+    if (cmd == NULL)
+      break;
+
+    sink->io_busy = TRUE;
+    failed = sink->io_flow != GST_FLOW_OK;
+    g_mutex_unlock (&sink->io_lock);
+
+    op = cmd->op;
+    size = cmd->buffer ? gst_buffer_get_size (cmd->buffer) : 0;
+
+    start = g_get_monotonic_time ();
+    /* after an error we only drop what is left in the queue */
+    if (!failed && !gst_multi_file_sink_io_execute (sink, cmd, &cur_filename))
+      failed = TRUE;
+    latency = (g_get_monotonic_time () - start) * GST_USECOND;
+
+    gst_multi_file_sink_io_cmd_free (cmd);
+
+    g_mutex_lock (&sink->io_lock);
+    sink->io_busy = FALSE;
+    sink->io_queued_bytes -= size;
+    if (failed) {
+      sink->io_flow = GST_FLOW_ERROR;
+    } else if (op != IO_OP_POST_MESSAGE) {
+      if (op == IO_OP_WRITE || op == IO_OP_SET_CONTENTS)
+        sink->io_bytes_written += size;
+      sink->io_n_ops++;
+      sink->io_total_latency += latency;
+      sink->io_max_latency = MAX (sink->io_max_latency, latency);
+    }
+    g_cond_broadcast (&sink->io_cond);
+  }
+  g_mutex_unlock (&sink->io_lock);
+
+  if (sink->io_file != NULL) {
+    fclose (sink->io_file);
+    sink->io_file = NULL;
+  }
+  g_free (cur_filename);
+
+  GST_DEBUG_OBJECT (sink, "I/O thread stopped");
+
+  return NULL;
+}
+
+static void
+gst_multi_file_sink_io_queue (GstMultiFileSink * sink,
+    GstMultiFileSinkIOCmd * cmd)
+{
+  GstBuffer *buffer = cmd->buffer;
+
+  g_mutex_lock (&sink->io_lock);
+  g_queue_push_tail (&sink->io_queue, cmd);
+  if (buffer) {
+    sink->io_queued_bytes += gst_buffer_get_size (buffer);
+    sink->io_max_queued_bytes =
+        MAX (sink->io_max_queued_bytes, sink->io_queued_bytes);
+  }
+  g_cond_broadcast (&sink->io_cond);
+  g_mutex_unlock (&sink->io_lock);
+}
+
+/* Takes a reference to @buffer, if any. Never blocks, the streaming thread
+ * waits for room in the queue before it starts handling a buffer. */
+static void
+gst_multi_file_sink_io_push (GstMultiFileSink * sink, GstMultiFileSinkIOOp op,
+    const gchar * filename, GstBuffer * buffer)
+{
+  GstMultiFileSinkIOCmd *cmd;
+
+  cmd = g_slice_new0 (GstMultiFileSinkIOCmd);
+  cmd->op = op;
+  cmd->filename = g_strdup (filename);
+  if (buffer)
+    cmd->buffer = gst_buffer_ref (buffer);
+
+  gst_multi_file_sink_io_queue (sink, cmd);
+}
+
+/* Takes ownership of @structure, which is posted as element message once
+ * the commands queued before are done */
+static void
+gst_multi_file_sink_io_push_message (GstMultiFileSink * sink,
+    GstStructure * structure)
+{
+  GstMultiFileSinkIOCmd *cmd;
+
+  cmd = g_slice_new0 (GstMultiFileSinkIOCmd);
+  cmd->op = IO_OP_POST_MESSAGE;
+  cmd->structure = structure;
+
+  gst_multi_file_sink_io_queue (sink, cmd);
+}
+
+/* Wait until @size more bytes fit in the queue. A buffer larger than the
+ * limit is let through once the queue is empty. */
+static GstFlowReturn
+gst_multi_file_sink_io_wait_space (GstMultiFileSink * sink, gsize size)
+{
+  GstFlowReturn ret;
+
+  g_mutex_lock (&sink->io_lock);
+  while (!sink->io_flushing && sink->io_flow == GST_FLOW_OK &&
+      sink->io_queued_bytes > 0 &&
+      sink->io_queued_bytes + size > sink->write_behind_max_bytes) {
+    GST_LOG_OBJECT (sink, "queue full, %" G_GUINT64_FORMAT " bytes pending",
+        sink->io_queued_bytes);
+    g_cond_wait (&sink->io_cond, &sink->io_lock);
+  }
+  ret = sink->io_flushing ? GST_FLOW_FLUSHING : sink->io_flow;
+  g_mutex_unlock (&sink->io_lock);
+
+  return ret;
+}
+
+/* Wait until everything queued has been written. Returns the error of the
+ * I/O thread, which already posted an error message for it */
+static GstFlowReturn
+gst_multi_file_sink_io_drain (GstMultiFileSink * sink)
+{
+  GstFlowReturn ret;
+
+  g_mutex_lock (&sink->io_lock);
+  while (!sink->io_flushing && sink->io_flow == GST_FLOW_OK &&
+      (!g_queue_is_empty (&sink->io_queue) || sink->io_busy))
+    g_cond_wait (&sink->io_cond, &sink->io_lock);
+  ret = sink->io_flushing ? GST_FLOW_FLUSHING : sink->io_flow;
+  g_mutex_unlock (&sink->io_lock);
+
+  return ret;
+}
+
+static gboolean
+gst_multi_file_sink_io_start (GstMultiFileSink * sink)
+{
+  GError *error = NULL;
+
+  sink->io_file_open = FALSE;
+  sink->io_block_size = sink->write_block_size;
+  sink->io_queued_bytes = 0;
+  sink->io_busy = FALSE;
+  sink->io_stop = FALSE;
+  sink->io_flushing = FALSE;
+  sink->io_flow = GST_FLOW_OK;
+  sink->io_max_queued_bytes = 0;
+  sink->io_bytes_written = 0;
+  sink->io_n_ops = 0;
+  sink->io_total_latency = 0;
+  sink->io_max_latency = 0;
+
+  sink->io_thread = g_thread_try_new ("multifilesink-io",
+      (GThreadFunc) gst_multi_file_sink_io_thread, sink, &error);
+  if (sink->io_thread == NULL) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, FAILED,
+        ("Could not create I/O thread."), ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_multi_file_sink_io_stop (GstMultiFileSink * sink)
+{
+  if (sink->io_thread == NULL)
+    return;
+
+  g_mutex_lock (&sink->io_lock);
+  sink->io_stop = TRUE;
+  g_cond_broadcast (&sink->io_cond);
+  g_mutex_unlock (&sink->io_lock);
+
+  g_thread_join (sink->io_thread);
+  sink->io_thread = NULL;
+  sink->io_file_open = FALSE;
+}
+
+static GstStructure *
+gst_multi_file_sink_create_stats (GstMultiFileSink * sink)
+{
+  GstStructure *s;
+
+  g_mutex_lock (&sink->io_lock);
+  s = gst_structure_new ("application/x-multifilesink-stats",
+      "queued-bytes", G_TYPE_UINT64, sink->io_queued_bytes,
+      "max-queued-bytes", G_TYPE_UINT64, sink->io_max_queued_bytes,
+      "bytes-written", G_TYPE_UINT64, sink->io_bytes_written,
+      "operations", G_TYPE_UINT64, sink->io_n_ops,
+      "average-latency", G_TYPE_UINT64, sink->io_n_ops > 0 ?
+      sink->io_total_latency / sink->io_n_ops : (GstClockTime) 0,
+      "max-latency", G_TYPE_UINT64, sink->io_max_latency, NULL);
+  g_mutex_unlock (&sink->io_lock);
+
+  return s;
+}
+
 static gboolean
 gst_multi_file_sink_set_location (GstMultiFileSink * sink,
     const gchar * location)
@@ -398,6 +870,18 @@ gst_multi_file_sink_set_property (GObject * object, guint prop_id,
     case PROP_AGGREGATE_GOPS:
       sink->aggregate_gops = g_value_get_boolean (value);
       break;
+    case PROP_WRITE_BEHIND:
+      sink->write_behind = g_value_get_boolean (value);
+      break;
+    case PROP_WRITE_BEHIND_MAX_BYTES:
+      g_mutex_lock (&sink->io_lock);
+      sink->write_behind_max_bytes = g_value_get_uint64 (value);
+      g_cond_broadcast (&sink->io_cond);
+      g_mutex_unlock (&sink->io_lock);
+      break;
+    case PROP_WRITE_BLOCK_SIZE:
+      sink->write_block_size = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -435,6 +919,18 @@ gst_multi_file_sink_get_property (GObject * object, guint prop_id,
     case PROP_AGGREGATE_GOPS:
       g_value_set_boolean (value, sink->aggregate_gops);
       break;
+    case PROP_WRITE_BEHIND:
+      g_value_set_boolean (value, sink->write_behind);
+      break;
+    case PROP_WRITE_BEHIND_MAX_BYTES:
+      g_value_set_uint64 (value, sink->write_behind_max_bytes);
+      break;
+    case PROP_WRITE_BLOCK_SIZE:
+      g_value_set_uint (value, sink->write_block_size);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_multi_file_sink_create_stats (sink));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -453,6 +949,9 @@ gst_multi_file_sink_start (GstBaseSink * bsink)
 
   g_queue_init (&sink->old_files);
 
+  if (sink->write_behind)
+    return gst_multi_file_sink_io_start (sink);
+
   return TRUE;
 }
 
@@ -464,6 +963,9 @@ gst_multi_file_sink_stop (GstBaseSink * sink)
 
   multifilesink = GST_MULTI_FILE_SINK (sink);
 
+  /* the I/O thread writes out everything still queued and closes its file */
+  gst_multi_file_sink_io_stop (multifilesink);
+
   if (multifilesink->file != NULL) {
     fclose (multifilesink->file);
     multifilesink->file = NULL;
@@ -518,6 +1020,13 @@ gst_multi_file_sink_post_message_full (GstMultiFileSink * multifilesink,
       "offset", G_TYPE_UINT64, offset,
       "offset-end", G_TYPE_UINT64, offset_end, NULL);
 
+  /* in write-behind mode the file is only complete once the I/O thread
+   * got to this point */
+  if (multifilesink->io_thread) {
+    gst_multi_file_sink_io_push_message (multifilesink, s);
+    return;
+  }
+
   gst_element_post_message (GST_ELEMENT_CAST (multifilesink),
       gst_message_new_element (GST_OBJECT_CAST (multifilesink), s));
 }
@@ -575,6 +1084,27 @@ gst_multi_file_sink_post_message (GstMultiFileSink * multifilesink,
       offset, offset_end, running_time, stream_time, filename);
 }
 
+static gboolean
+gst_multi_file_sink_file_is_open (GstMultiFileSink * sink)
+{
+  return sink->file != NULL || sink->io_file_open;
+}
+
+/* Writes @map, the mapped contents of @buffer, to the current file. In
+ * write-behind mode the buffer is queued instead and errors are reported
+ * asynchronously. */
+static gboolean
+gst_multi_file_sink_write_data (GstMultiFileSink * sink, GstBuffer * buffer,
+    GstMapInfo * map)
+{
+  if (sink->io_thread) {
+    gst_multi_file_sink_io_push (sink, IO_OP_WRITE, NULL, buffer);
+    return TRUE;
+  }
+
+  return fwrite (map->data, map->size, 1, sink->file) == 1;
+}
+
 static gboolean
 gst_multi_file_sink_write_stream_headers (GstMultiFileSink * sink)
 {
@@ -589,14 +1119,14 @@ gst_multi_file_sink_write_stream_headers (GstMultiFileSink * sink)
   for (i = 0; i < sink->n_streamheaders; i++) {
     GstBuffer *hdr;
     GstMapInfo map;
-    int ret;
+    gboolean ret;
 
     hdr = sink->streamheaders[i];
     gst_buffer_map (hdr, &map, GST_MAP_READ);
-    ret = fwrite (map.data, map.size, 1, sink->file);
+    ret = gst_multi_file_sink_write_data (sink, hdr, &map);
     gst_buffer_unmap (hdr, &map);
 
-    if (ret != 1)
+    if (!ret)
       return FALSE;
 
     sink->cur_file_size += map.size;
@@ -615,6 +1145,15 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
   GError *error = NULL;
   gboolean first_file = TRUE;
 
+  if (multifilesink->io_thread) {
+    GstFlowReturn flow;
+
+    flow = gst_multi_file_sink_io_wait_space (multifilesink,
+        gst_buffer_get_size (buffer));
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+
   gst_buffer_map (buffer, &map, GST_MAP_READ);
 
   switch (multifilesink->next_file) {
@@ -623,9 +1162,15 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
 
       filename = g_strdup_printf (multifilesink->filename,
           multifilesink->index);
-      ret = g_file_set_contents (filename, (char *) map.data, map.size, &error);
-      if (!ret)
-        goto write_error;
+      if (multifilesink->io_thread) {
+        gst_multi_file_sink_io_push (multifilesink, IO_OP_SET_CONTENTS,
+            filename, buffer);
+      } else {
+        ret = g_file_set_contents (filename, (char *) map.data, map.size,
+            &error);
+        if (!ret)
+          goto write_error;
+      }
 
       gst_multi_file_sink_post_message (multifilesink, buffer, filename);
 
@@ -636,17 +1181,17 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
       break;
     case GST_MULTI_FILE_SINK_NEXT_DISCONT:
       if (GST_BUFFER_IS_DISCONT (buffer)) {
-        if (multifilesink->file)
+        if (gst_multi_file_sink_file_is_open (multifilesink))
           gst_multi_file_sink_close_file (multifilesink, buffer);
       }
 
-      if (multifilesink->file == NULL) {
+      if (!gst_multi_file_sink_file_is_open (multifilesink)) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
       }
 
-      ret = fwrite (map.data, map.size, 1, multifilesink->file);
-      if (ret != 1)
+      ret = gst_multi_file_sink_write_data (multifilesink, buffer, &map);
+      if (!ret)
         goto stdio_write_error;
 
       break;
@@ -661,14 +1206,14 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
       if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer) &&
           GST_BUFFER_TIMESTAMP (buffer) >= multifilesink->next_segment &&
           !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
-        if (multifilesink->file) {
+        if (gst_multi_file_sink_file_is_open (multifilesink)) {
           first_file = FALSE;
           gst_multi_file_sink_close_file (multifilesink, buffer);
         }
         multifilesink->next_segment += 10 * GST_SECOND;
       }
 
-      if (multifilesink->file == NULL) {
+      if (!gst_multi_file_sink_file_is_open (multifilesink)) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
 
@@ -676,13 +1221,13 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
           gst_multi_file_sink_write_stream_headers (multifilesink);
       }
 
-      ret = fwrite (map.data, map.size, 1, multifilesink->file);
-      if (ret != 1)
+      ret = gst_multi_file_sink_write_data (multifilesink, buffer, &map);
+      if (!ret)
         goto stdio_write_error;
 
       break;
     case GST_MULTI_FILE_SINK_NEXT_KEY_UNIT_EVENT:
-      if (multifilesink->file == NULL) {
+      if (!gst_multi_file_sink_file_is_open (multifilesink)) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
 
@@ -692,9 +1237,9 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
          */
       }
 
-      ret = fwrite (map.data, map.size, 1, multifilesink->file);
+      ret = gst_multi_file_sink_write_data (multifilesink, buffer, &map);
 
-      if (ret != 1)
+      if (!ret)
         goto stdio_write_error;
 
       break;
@@ -709,13 +1254,13 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
             multifilesink->cur_file_size, new_size,
             multifilesink->max_file_size);
 
-        if (multifilesink->file != NULL) {
+        if (gst_multi_file_sink_file_is_open (multifilesink)) {
           first_file = FALSE;
           gst_multi_file_sink_close_file (multifilesink, buffer);
         }
       }
 
-      if (multifilesink->file == NULL) {
+      if (!gst_multi_file_sink_file_is_open (multifilesink)) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
 
@@ -723,9 +1268,9 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
           gst_multi_file_sink_write_stream_headers (multifilesink);
       }
 
-      ret = fwrite (map.data, map.size, 1, multifilesink->file);
+      ret = gst_multi_file_sink_write_data (multifilesink, buffer, &map);
 
-      if (ret != 1)
+      if (!ret)
         goto stdio_write_error;
 
       multifilesink->cur_file_size += map.size;
@@ -749,13 +1294,13 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
             "new_duration: %" G_GUINT64_FORMAT ", max. duration %"
             G_GUINT64_FORMAT, new_duration, multifilesink->max_file_duration);
 
-        if (multifilesink->file != NULL) {
+        if (gst_multi_file_sink_file_is_open (multifilesink)) {
           first_file = FALSE;
           gst_multi_file_sink_close_file (multifilesink, buffer);
         }
       }
 
-      if (multifilesink->file == NULL) {
+      if (!gst_multi_file_sink_file_is_open (multifilesink)) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
 
@@ -764,9 +1309,9 @@ gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
           gst_multi_file_sink_write_stream_headers (multifilesink);
       }
 
-      ret = fwrite (map.data, map.size, 1, multifilesink->file);
+      ret = gst_multi_file_sink_write_data (multifilesink, buffer, &map);
 
-      if (ret != 1)
+      if (!ret)
         goto stdio_write_error;
 
       break;
@@ -991,7 +1536,11 @@ gst_multi_file_sink_ensure_max_files (GstMultiFileSink * multifilesink)
     gchar *filename;
 
     filename = g_queue_pop_head (&multifilesink->old_files);
-    g_remove (filename);
+    if (multifilesink->io_thread)
+      gst_multi_file_sink_io_push (multifilesink, IO_OP_REMOVE, filename,
+          NULL);
+    else
+      g_remove (filename);
     g_free (filename);
   }
 }
@@ -1026,7 +1575,7 @@ gst_multi_file_sink_event (GstBaseSink * sink, GstEvent * event)
 
       multifilesink->force_key_unit_count = count;
 
-      if (multifilesink->file) {
+      if (gst_multi_file_sink_file_is_open (multifilesink)) {
         duration = GST_CLOCK_TIME_NONE;
         offset = offset_end = -1;
         filename = g_strdup_printf (multifilesink->filename,
@@ -1039,7 +1588,7 @@ gst_multi_file_sink_event (GstBaseSink * sink, GstEvent * event)
         g_free (filename);
       }
 
-      if (multifilesink->file == NULL) {
+      if (!gst_multi_file_sink_file_is_open (multifilesink)) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
       }
@@ -1056,7 +1605,7 @@ gst_multi_file_sink_event (GstBaseSink * sink, GstEvent * event)
         gst_multi_file_sink_render (sink, buf);
         gst_buffer_unref (buf);
       }
-      if (multifilesink->file) {
+      if (gst_multi_file_sink_file_is_open (multifilesink)) {
         gchar *filename;
 
         filename = g_strdup_printf (multifilesink->filename,
@@ -1068,6 +1617,17 @@ gst_multi_file_sink_event (GstBaseSink * sink, GstEvent * event)
             GST_BASE_SINK (multifilesink)->segment.position, -1, filename);
         g_free (filename);
       }
+      /* everything must be on disk before EOS goes out */
+      if (multifilesink->io_thread) {
+        GstFlowReturn flow = gst_multi_file_sink_io_drain (multifilesink);
+
+        if (flow != GST_FLOW_OK) {
+          GST_DEBUG_OBJECT (multifilesink, "not forwarding EOS: %s",
+              gst_flow_get_name (flow));
+          gst_event_unref (event);
+          return FALSE;
+        }
+      }
       break;
     default:
       break;
@@ -1086,23 +1646,54 @@ stdio_write_error:
   }
 }
 
+static gboolean
+gst_multi_file_sink_unlock (GstBaseSink * sink)
+{
+  GstMultiFileSink *multifilesink = GST_MULTI_FILE_SINK (sink);
+
+  g_mutex_lock (&multifilesink->io_lock);
+  multifilesink->io_flushing = TRUE;
+  g_cond_broadcast (&multifilesink->io_cond);
+  g_mutex_unlock (&multifilesink->io_lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_file_sink_unlock_stop (GstBaseSink * sink)
+{
+  GstMultiFileSink *multifilesink = GST_MULTI_FILE_SINK (sink);
+
+  g_mutex_lock (&multifilesink->io_lock);
+  multifilesink->io_flushing = FALSE;
+  g_mutex_unlock (&multifilesink->io_lock);
+
+  return TRUE;
+}
+
 static gboolean
 gst_multi_file_sink_open_next_file (GstMultiFileSink * multifilesink)
 {
   char *filename;
 
-  g_return_val_if_fail (multifilesink->file == NULL, FALSE);
+  g_return_val_if_fail (!gst_multi_file_sink_file_is_open (multifilesink),
+      FALSE);
 
   gst_multi_file_sink_ensure_max_files (multifilesink);
 
   filename = g_strdup_printf (multifilesink->filename, multifilesink->index);
-  multifilesink->file = g_fopen (filename, "wb");
-  if (multifilesink->file == NULL) {
-    g_free (filename);
-    return FALSE;
-  }
+  if (multifilesink->io_thread) {
+    gst_multi_file_sink_io_push (multifilesink, IO_OP_OPEN, filename, NULL);
+    multifilesink->io_file_open = TRUE;
+  } else {
+    multifilesink->file = g_fopen (filename, "wb");
+    if (multifilesink->file == NULL) {
+      g_free (filename);
+      return FALSE;
+    }
 
-  GST_INFO_OBJECT (multifilesink, "opening file %s", filename);
+    GST_INFO_OBJECT (multifilesink, "opening file %s", filename);
+  }
 
   gst_multi_file_sink_add_old_file (multifilesink, filename);
 
@@ -1116,8 +1707,13 @@ gst_multi_file_sink_close_file (GstMultiFileSink * multifilesink,
 {
   char *filename;
 
-  fclose (multifilesink->file);
-  multifilesink->file = NULL;
+  if (multifilesink->io_thread) {
+    gst_multi_file_sink_io_push (multifilesink, IO_OP_CLOSE, NULL, NULL);
+    multifilesink->io_file_open = FALSE;
+  } else {
+    fclose (multifilesink->file);
+    multifilesink->file = NULL;
+  }
 
   if (buffer) {
     filename = g_strdup_printf (multifilesink->filename, multifilesink->index);
@@ -104,6 +104,29 @@ struct _GstMultiFileSink
   gboolean aggregate_gops;
   GstAdapter *gop_adapter;  /* to aggregate GOPs */
   GList *potential_next_gop;	/* To detect false-positives */
+
+  /* write-behind mode, the queue and the stats are protected by io_lock */
+  gboolean write_behind;
+  guint64 write_behind_max_bytes;
+  guint write_block_size;
+  gboolean io_file_open;    /* streaming thread view of the current file */
+  GThread *io_thread;
+  GMutex io_lock;
+  GCond io_cond;
+  GQueue io_queue;
+  guint64 io_queued_bytes;
+  gboolean io_busy;
+  gboolean io_stop;
+  gboolean io_flushing;
+  GstFlowReturn io_flow;
+  FILE *io_file;            /* owned by the I/O thread */
+  guint io_block_size;
+
+  guint64 io_max_queued_bytes;
+  guint64 io_bytes_written;
+  guint64 io_n_ops;
+  GstClockTime io_total_latency;
+  GstClockTime io_max_latency;
 };
 
 struct _GstMultiFileSinkClass
@@ -30,6 +30,11 @@
  *
  * File names are created by replacing "\%d" with the index using printf().
  *
+ * When #GstMultiFileSrc:prefetch-files is non-zero, the following files are
+ * loaded ahead of time by a background thread, as long as they fit in
+ * #GstMultiFileSrc:prefetch-max-bytes. With #GstMultiFileSrc:use-mmap the
+ * files are mapped read-only and pushed without copying the data.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -52,6 +57,7 @@ static GstFlowReturn gst_multi_file_src_create (GstPushSrc * src,
     GstBuffer ** buffer);
 
 static void gst_multi_file_src_dispose (GObject * object);
+static void gst_multi_file_src_finalize (GObject * object);
 
 static void gst_multi_file_src_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
@@ -59,6 +65,10 @@ static void gst_multi_file_src_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static GstCaps *gst_multi_file_src_getcaps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_multi_file_src_query (GstBaseSrc * src, GstQuery * query);
+static gboolean gst_multi_file_src_start (GstBaseSrc * src);
+static gboolean gst_multi_file_src_stop (GstBaseSrc * src);
+static gboolean gst_multi_file_src_unlock (GstBaseSrc * src);
+static gboolean gst_multi_file_src_unlock_stop (GstBaseSrc * src);
 
 
 static GstStaticPadTemplate gst_multi_file_src_pad_template =
@@ -78,11 +88,25 @@ enum
   PROP_START_INDEX,
   PROP_STOP_INDEX,
   PROP_CAPS,
-  PROP_LOOP
+  PROP_LOOP,
+  PROP_PREFETCH_FILES,
+  PROP_PREFETCH_MAX_BYTES,
+  PROP_USE_MMAP
 };
 
 #define DEFAULT_LOCATION "%05d"
 #define DEFAULT_INDEX 0
+#define DEFAULT_PREFETCH_FILES 0
+#define DEFAULT_PREFETCH_MAX_BYTES (64 * 1024 * 1024)
+#define DEFAULT_USE_MMAP FALSE
+
+/* A file loaded by the prefetch thread, @memory is NULL if loading failed */
+typedef struct
+{
+  gint index;
+  GstMemory *memory;
+  GError *error;
+} GstMultiFileSrcEntry;
 
 #define gst_multi_file_src_parent_class parent_class
 G_DEFINE_TYPE (GstMultiFileSrc, gst_multi_file_src, GST_TYPE_PUSH_SRC);
@@ -176,10 +200,57 @@ gst_multi_file_src_class_init (GstMultiFileSrcClass * klass)
           "Whether to repeat from the beginning when all files have been read.",
           FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstMultiFileSrc:prefetch-files:
+   *
+   * Number of files to load ahead of time from a background thread. 0
+   * disables prefetching and files are read from the streaming thread.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_PREFETCH_FILES,
+      g_param_spec_uint ("prefetch-files", "Prefetch Files",
+          "Number of files to load ahead of time (0 = disabled)",
+          0, G_MAXINT, DEFAULT_PREFETCH_FILES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSrc:prefetch-max-bytes:
+   *
+   * Maximum amount of file data held by the prefetch thread. At least one
+   * file is always loaded ahead, whatever its size.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_PREFETCH_MAX_BYTES,
+      g_param_spec_uint64 ("prefetch-max-bytes", "Prefetch Max Bytes",
+          "Maximum number of bytes loaded ahead of time",
+          0, G_MAXUINT64, DEFAULT_PREFETCH_MAX_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSrc:use-mmap:
+   *
+   * Map the files read-only instead of reading them into memory. The
+   * buffers then reference the mapping directly.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_USE_MMAP,
+      g_param_spec_boolean ("use-mmap", "Use mmap",
+          "Map the files read-only instead of reading them",
+          DEFAULT_USE_MMAP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->dispose = gst_multi_file_src_dispose;
+  gobject_class->finalize = gst_multi_file_src_finalize;
 
   gstbasesrc_class->get_caps = gst_multi_file_src_getcaps;
   gstbasesrc_class->query = gst_multi_file_src_query;
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_multi_file_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_multi_file_src_stop);
+  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_multi_file_src_unlock);
+  gstbasesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_multi_file_src_unlock_stop);
   gstbasesrc_class->is_seekable = is_seekable;
   gstbasesrc_class->do_seek = do_seek;
 
@@ -205,6 +276,12 @@ gst_multi_file_src_init (GstMultiFileSrc * multifilesrc)
   multifilesrc->successful_read = FALSE;
   multifilesrc->fps_n = multifilesrc->fps_d = -1;
 
+  multifilesrc->prefetch_files = DEFAULT_PREFETCH_FILES;
+  multifilesrc->prefetch_max_bytes = DEFAULT_PREFETCH_MAX_BYTES;
+  multifilesrc->use_mmap = DEFAULT_USE_MMAP;
+  g_mutex_init (&multifilesrc->prefetch_lock);
+  g_cond_init (&multifilesrc->prefetch_cond);
+  g_queue_init (&multifilesrc->prefetched);
 }
 
 static void
@@ -220,6 +297,17 @@ gst_multi_file_src_dispose (GObject * object)
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gst_multi_file_src_finalize (GObject * object)
+{
+  GstMultiFileSrc *src = GST_MULTI_FILE_SRC (object);
+
+  g_mutex_clear (&src->prefetch_lock);
+  g_cond_clear (&src->prefetch_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static GstCaps *
 gst_multi_file_src_getcaps (GstBaseSrc * src, GstCaps * filter)
 {
@@ -343,6 +431,18 @@ gst_multi_file_src_set_property (GObject * object, guint prop_id,
     case PROP_LOOP:
       src->loop = g_value_get_boolean (value);
       break;
+    case PROP_PREFETCH_FILES:
+      src->prefetch_files = g_value_get_uint (value);
+      break;
+    case PROP_PREFETCH_MAX_BYTES:
+      g_mutex_lock (&src->prefetch_lock);
+      src->prefetch_max_bytes = g_value_get_uint64 (value);
+      g_cond_broadcast (&src->prefetch_cond);
+      g_mutex_unlock (&src->prefetch_lock);
+      break;
+    case PROP_USE_MMAP:
+      src->use_mmap = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -374,6 +474,15 @@ gst_multi_file_src_get_property (GObject * object, guint prop_id,
     case PROP_LOOP:
       g_value_set_boolean (value, src->loop);
       break;
+    case PROP_PREFETCH_FILES:
+      g_value_set_uint (value, src->prefetch_files);
+      break;
+    case PROP_PREFETCH_MAX_BYTES:
+      g_value_set_uint64 (value, src->prefetch_max_bytes);
+      break;
+    case PROP_USE_MMAP:
+      g_value_set_boolean (value, src->use_mmap);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -391,15 +500,265 @@ gst_multi_file_src_get_filename (GstMultiFileSrc * multifilesrc)
   return filename;
 }
 
+static GstMemory *
+gst_multi_file_src_load_file (GstMultiFileSrc * src, const gchar * filename,
+    gboolean fault_in, GError ** error)
+{
+  gchar *data;
+  gsize size;
+
+  if (src->use_mmap) {
+    GMappedFile *mapped;
+
+    mapped = g_mapped_file_new (filename, FALSE, error);
+    if (mapped == NULL)
+      return NULL;
+
+    /* empty files have no mapping, read them the normal way */
+    size = g_mapped_file_get_length (mapped);
+    if (size > 0) {
+      data = g_mapped_file_get_contents (mapped);
+
+      /* when prefetching, take the page faults here and not in the
+       * elements downstream */
+      if (fault_in) {
+        volatile guint8 dummy;
+        gsize i;
+
+        for (i = 0; i < size; i += 4096)
+          dummy = ((guint8 *) data)[i];
+        (void) dummy;
+      }
+
+      return gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, data, size, 0,
+          size, mapped, (GDestroyNotify) g_mapped_file_unref);
+    }
+    g_mapped_file_unref (mapped);
+  }
+
+  if (!g_file_get_contents (filename, &data, &size, error))
+    return NULL;
+
+  return gst_memory_new_wrapped (0, data, size, 0, size, data, g_free);
+}
+
+static void
+gst_multi_file_src_entry_free (GstMultiFileSrcEntry * entry)
+{
+  if (entry->memory)
+    gst_memory_unref (entry->memory);
+  if (entry->error)
+    g_error_free (entry->error);
+  g_slice_free (GstMultiFileSrcEntry, entry);
+}
+
+/* with prefetch_lock */
+static void
+gst_multi_file_src_prefetch_flush (GstMultiFileSrc * src)
+{
+  g_queue_foreach (&src->prefetched, (GFunc) gst_multi_file_src_entry_free,
+      NULL);
+  g_queue_clear (&src->prefetched);
+  src->prefetched_bytes = 0;
+}
+
+/* with prefetch_lock. Drops everything loaded so far and continues loading
+ * from @index, a file being loaded right now is discarded once done. */
+static void
+gst_multi_file_src_prefetch_restart (GstMultiFileSrc * src, gint index)
+{
+  GST_DEBUG_OBJECT (src, "prefetching from index %d", index);
+
+  gst_multi_file_src_prefetch_flush (src);
+  src->prefetch_next = index;
+  src->prefetch_cookie++;
+  g_cond_broadcast (&src->prefetch_cond);
+}
+
+static gpointer
+gst_multi_file_src_prefetch_thread (GstMultiFileSrc * src)
+{
+  g_mutex_lock (&src->prefetch_lock);
+  while (!src->prefetch_stop) {
+    GstMultiFileSrcEntry *entry;
+    gchar *filename;
+    guint cookie;
+    gint index;
+
+    if (src->prefetch_next >= 0 && src->stop_index != -1 &&
+        src->prefetch_next > src->stop_index)
+      src->prefetch_next = src->loop ? src->start_index : -1;
+
+    if (src->prefetch_next < 0 ||
+        g_queue_get_length (&src->prefetched) >= src->prefetch_files ||
+        (src->prefetched_bytes >= src->prefetch_max_bytes &&
+            !g_queue_is_empty (&src->prefetched))) {
+      g_cond_wait (&src->prefetch_cond, &src->prefetch_lock);
+      continue;
+    }
+
+    index = src->prefetch_next++;
+    src->prefetch_loading = index;
+    cookie = src->prefetch_cookie;
+    g_mutex_unlock (&src->prefetch_lock);
+
+    filename = g_strdup_printf (src->filename, index);
+    GST_LOG_OBJECT (src, "prefetching file \"%s\".", filename);
+
+    entry = g_slice_new0 (GstMultiFileSrcEntry);
+    entry->index = index;
+    entry->memory = gst_multi_file_src_load_file (src, filename, TRUE,
+        &entry->error);
+    g_free (filename);
+
+    g_mutex_lock (&src->prefetch_lock);
+    src->prefetch_loading = -1;
+    if (cookie != src->prefetch_cookie) {
+      gst_multi_file_src_entry_free (entry);
+    } else {
+      g_queue_push_tail (&src->prefetched, entry);
+      if (entry->memory)
+        src->prefetched_bytes += entry->memory->size;
+      else
+        /* probably the end of the sequence, let the streaming thread decide
+         * where to go from here */
+        src->prefetch_next = -1;
+    }
+    g_cond_broadcast (&src->prefetch_cond);
+  }
+  g_mutex_unlock (&src->prefetch_lock);
+
+  return NULL;
+}
+
+/* Returns the contents of file @index in @memory, or NULL and @error if it
+ * could not be read. Only fails when flushing. */
+static GstFlowReturn
+gst_multi_file_src_read (GstMultiFileSrc * src, gint index,
+    const gchar * filename, GstMemory ** memory, GError ** error)
+{
+  GstMultiFileSrcEntry *entry;
+
+  *memory = NULL;
+
+  if (src->prefetch_thread == NULL) {
+    *memory = gst_multi_file_src_load_file (src, filename, FALSE, error);
+    return GST_FLOW_OK;
+  }
+
+  g_mutex_lock (&src->prefetch_lock);
+  while (TRUE) {
+    entry = g_queue_peek_head (&src->prefetched);
+    if (entry != NULL && entry->index == index)
+      break;
+
+    if (src->flushing) {
+      g_mutex_unlock (&src->prefetch_lock);
+      return GST_FLOW_FLUSHING;
+    }
+
+    /* after a seek or a loop the prefetched files are not the ones we want */
+    if (entry != NULL || (src->prefetch_loading != index &&
+            src->prefetch_next != index))
+      gst_multi_file_src_prefetch_restart (src, index);
+
+    g_cond_wait (&src->prefetch_cond, &src->prefetch_lock);
+  }
+  g_queue_pop_head (&src->prefetched);
+  if (entry->memory)
+    src->prefetched_bytes -= entry->memory->size;
+  g_cond_broadcast (&src->prefetch_cond);
+  g_mutex_unlock (&src->prefetch_lock);
+
+  *memory = entry->memory;
+  if (entry->error)
+    g_propagate_error (error, entry->error);
+  g_slice_free (GstMultiFileSrcEntry, entry);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_multi_file_src_start (GstBaseSrc * bsrc)
+{
+  GstMultiFileSrc *src = GST_MULTI_FILE_SRC (bsrc);
+  GError *error = NULL;
+
+  if (src->prefetch_files == 0)
+    return TRUE;
+
+  src->flushing = FALSE;
+  src->prefetch_stop = FALSE;
+  src->prefetch_next = MAX (src->index, src->start_index);
+  src->prefetch_loading = -1;
+
+  src->prefetch_thread = g_thread_try_new ("multifilesrc-prefetch",
+      (GThreadFunc) gst_multi_file_src_prefetch_thread, src, &error);
+  if (src->prefetch_thread == NULL) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Could not create prefetch thread."), ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_file_src_stop (GstBaseSrc * bsrc)
+{
+  GstMultiFileSrc *src = GST_MULTI_FILE_SRC (bsrc);
+
+  if (src->prefetch_thread == NULL)
+    return TRUE;
+
+  g_mutex_lock (&src->prefetch_lock);
+  src->prefetch_stop = TRUE;
+  g_cond_broadcast (&src->prefetch_cond);
+  g_mutex_unlock (&src->prefetch_lock);
+
+  g_thread_join (src->prefetch_thread);
+  src->prefetch_thread = NULL;
+
+  gst_multi_file_src_prefetch_flush (src);
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_file_src_unlock (GstBaseSrc * bsrc)
+{
+  GstMultiFileSrc *src = GST_MULTI_FILE_SRC (bsrc);
+
+  g_mutex_lock (&src->prefetch_lock);
+  src->flushing = TRUE;
+  g_cond_broadcast (&src->prefetch_cond);
+  g_mutex_unlock (&src->prefetch_lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_file_src_unlock_stop (GstBaseSrc * bsrc)
+{
+  GstMultiFileSrc *src = GST_MULTI_FILE_SRC (bsrc);
+
+  g_mutex_lock (&src->prefetch_lock);
+  src->flushing = FALSE;
+  g_mutex_unlock (&src->prefetch_lock);
+
+  return TRUE;
+}
+
 static GstFlowReturn
 gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
 {
   GstMultiFileSrc *multifilesrc;
   gsize size;
-  gchar *data;
+  GstMemory *mem;
   gchar *filename;
   GstBuffer *buf;
-  gboolean ret;
+  GstFlowReturn flow;
   GError *error = NULL;
 
   multifilesrc = GST_MULTI_FILE_SRC (src);
@@ -420,8 +779,14 @@ gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
 
   GST_DEBUG_OBJECT (multifilesrc, "reading from file \"%s\".", filename);
 
-  ret = g_file_get_contents (filename, &data, &size, &error);
-  if (!ret) {
+  flow = gst_multi_file_src_read (multifilesrc, multifilesrc->index, filename,
+      &mem, &error);
+  if (flow != GST_FLOW_OK) {
+    g_free (filename);
+    return flow;
+  }
+
+  if (mem == NULL) {
     if (multifilesrc->successful_read) {
       /* If we've read at least one buffer successfully, not finding the
        * next file is EOS. */
@@ -434,13 +799,14 @@ gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
         multifilesrc->index = multifilesrc->start_index;
 
         filename = gst_multi_file_src_get_filename (multifilesrc);
-        ret = g_file_get_contents (filename, &data, &size, &error);
-        if (!ret) {
+        flow = gst_multi_file_src_read (multifilesrc, multifilesrc->index,
+            filename, &mem, &error);
+        if (mem == NULL) {
           g_free (filename);
           if (error != NULL)
             g_error_free (error);
 
-          return GST_FLOW_EOS;
+          return flow == GST_FLOW_OK ? GST_FLOW_EOS : flow;
         }
       } else {
         return GST_FLOW_EOS;
@@ -453,9 +819,9 @@ gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
   multifilesrc->successful_read = TRUE;
   multifilesrc->index++;
 
+  size = mem->size;
   buf = gst_buffer_new ();
-  gst_buffer_append_memory (buf,
-      gst_memory_new_wrapped (0, data, size, 0, size, data, g_free));
+  gst_buffer_append_memory (buf, mem);
   GST_BUFFER_OFFSET (buf) = multifilesrc->offset;
   GST_BUFFER_OFFSET_END (buf) = multifilesrc->offset + size;
   multifilesrc->offset += size;
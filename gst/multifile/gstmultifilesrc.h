@@ -58,6 +58,22 @@ struct _GstMultiFileSrc
   gboolean successful_read;
 
   gint fps_n, fps_d;
+
+  guint prefetch_files;
+  guint64 prefetch_max_bytes;
+  gboolean use_mmap;
+
+  /* prefetching, protected by prefetch_lock */
+  GThread *prefetch_thread;
+  GMutex prefetch_lock;
+  GCond prefetch_cond;
+  GQueue prefetched;
+  guint64 prefetched_bytes;
+  gint prefetch_next;       /* next index to load, -1 when idle */
+  gint prefetch_loading;    /* index being loaded, -1 if none */
+  guint prefetch_cookie;
+  gboolean prefetch_stop;
+  gboolean flushing;
 };
 
 struct _GstMultiFileSrcClass
@@ -87,6 +87,9 @@ static gboolean splitmux_data_queue_is_full_cb (GstDataQueue * queue,
 static void type_found (GstElement * typefind, guint probability,
     GstCaps * caps, GstSplitMuxPartReader * reader);
 static void check_if_pads_collected (GstSplitMuxPartReader * reader);
+static GstClockTime
+gst_splitmux_part_reader_get_end_offset_locked (GstSplitMuxPartReader *
+    reader);
 
 /* Called with reader lock held */
 static gboolean
@@ -632,6 +635,7 @@ gst_splitmux_part_reader_init (GstSplitMuxPartReader * reader)
 
   reader->active = FALSE;
   reader->duration = GST_CLOCK_TIME_NONE;
+  reader->length = GST_CLOCK_TIME_NONE;
 
   g_cond_init (&reader->inactive_cond);
   g_mutex_init (&reader->lock);
@@ -693,6 +697,7 @@ static void
 splitmux_part_reader_reset (GstSplitMuxPartReader * reader)
 {
   GList *cur;
+  GstElement *demux;
 
   SPLITMUX_PART_LOCK (reader);
   for (cur = g_list_first (reader->pads); cur != NULL; cur = g_list_next (cur)) {
@@ -703,7 +708,17 @@ splitmux_part_reader_reset (GstSplitMuxPartReader * reader)
 
   g_list_free (reader->pads);
   reader->pads = NULL;
+  reader->no_more_pads = FALSE;
+  demux = reader->demux;
+  reader->demux = NULL;
   SPLITMUX_PART_UNLOCK (reader);
+
+  /* Remove the demuxer so a new one gets plugged if the
+   * part is prepared again */
+  if (demux != NULL) {
+    gst_element_set_state (demux, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN_CAST (reader), demux);
+  }
 }
 
 static GstSplitMuxPartPad *
@@ -865,6 +880,13 @@ gst_splitmux_part_reader_measure_streams (GstSplitMuxPartReader * reader)
     SPLITMUX_PART_WAIT (reader);
 
   if (reader->prep_state == PART_STATE_PREPARING_RESET_FOR_READY) {
+    GstClockTime end = gst_splitmux_part_reader_get_end_offset_locked (reader);
+
+    /* Remember the measured length so the end offset stays known after
+     * the part is unprepared, and follows changes of the start offset */
+    if (GST_CLOCK_TIME_IS_VALID (end) && end >= reader->start_offset)
+      reader->length = end - reader->start_offset;
+
     /* Fire the prepared signal and go to READY state */
     GST_DEBUG_OBJECT (reader,
         "Stream measuring complete. File %s is now ready. Firing prepared signal",
@@ -1231,19 +1253,31 @@ gst_splitmux_part_reader_set_callbacks (GstSplitMuxPartReader * reader,
   reader->get_pad_cb = get_pad_cb;
 }
 
-GstClockTime
-gst_splitmux_part_reader_get_end_offset (GstSplitMuxPartReader * reader)
+static GstClockTime
+gst_splitmux_part_reader_get_end_offset_locked (GstSplitMuxPartReader * reader)
 {
   GList *cur;
   GstClockTime ret = GST_CLOCK_TIME_NONE;
 
-  SPLITMUX_PART_LOCK (reader);
+  if (GST_CLOCK_TIME_IS_VALID (reader->length))
+    return reader->start_offset + reader->length;
+
   for (cur = g_list_first (reader->pads); cur != NULL; cur = g_list_next (cur)) {
     GstSplitMuxPartPad *part_pad = SPLITMUX_PART_PAD_CAST (cur->data);
     if (!part_pad->is_sparse && part_pad->max_ts < ret)
       ret = part_pad->max_ts;
   }
 
+  return ret;
+}
+
+GstClockTime
+gst_splitmux_part_reader_get_end_offset (GstSplitMuxPartReader * reader)
+{
+  GstClockTime ret;
+
+  SPLITMUX_PART_LOCK (reader);
+  ret = gst_splitmux_part_reader_get_end_offset_locked (reader);
   SPLITMUX_PART_UNLOCK (reader);
 
   return ret;
@@ -1284,6 +1318,30 @@ gst_splitmux_part_reader_get_duration (GstSplitMuxPartReader * reader)
   return dur;
 }
 
+/* Set the duration and length of a part that doesn't
+ * need to be measured, e.g. from an index file */
+void
+gst_splitmux_part_reader_set_measurement (GstSplitMuxPartReader * reader,
+    GstClockTime duration, GstClockTime length)
+{
+  SPLITMUX_PART_LOCK (reader);
+  reader->duration = duration;
+  reader->length = length;
+  SPLITMUX_PART_UNLOCK (reader);
+}
+
+gboolean
+gst_splitmux_part_reader_is_measured (GstSplitMuxPartReader * reader)
+{
+  gboolean ret;
+
+  SPLITMUX_PART_LOCK (reader);
+  ret = GST_CLOCK_TIME_IS_VALID (reader->length);
+  SPLITMUX_PART_UNLOCK (reader);
+
+  return ret;
+}
+
 GstPad *
 gst_splitmux_part_reader_lookup_pad (GstSplitMuxPartReader * reader,
     GstPad * target)
@@ -72,6 +72,8 @@ struct _GstSplitMuxPartReader
 
   GstClockTime duration;
   GstClockTime start_offset;
+  /* End offset relative to start_offset, kept after unpreparing */
+  GstClockTime length;
 
   GList *pads;
 
@@ -110,6 +112,8 @@ void gst_splitmux_part_reader_set_start_offset (GstSplitMuxPartReader *part, Gst
 GstClockTime gst_splitmux_part_reader_get_start_offset (GstSplitMuxPartReader *part);
 GstClockTime gst_splitmux_part_reader_get_end_offset (GstSplitMuxPartReader *part);
 GstClockTime gst_splitmux_part_reader_get_duration (GstSplitMuxPartReader * reader);
+void gst_splitmux_part_reader_set_measurement (GstSplitMuxPartReader *reader, GstClockTime duration, GstClockTime length);
+gboolean gst_splitmux_part_reader_is_measured (GstSplitMuxPartReader *reader);
 
 GstPad *gst_splitmux_part_reader_lookup_pad (GstSplitMuxPartReader *reader, GstPad *target);
 GstFlowReturn gst_splitmux_part_reader_pop (GstSplitMuxPartReader *reader, GstPad *part_pad, GstDataQueueItem ** item);
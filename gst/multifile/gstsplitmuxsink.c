@@ -46,6 +46,21 @@
  * Records a video stream captured from a v4l2 device and muxes it into
  * ISO mp4 files, splitting as needed to limit size/duration to 10 seconds
  * and 1MB maximum size.
+ * |[
+ * gst-launch-1.0 -e v4l2src ! videoconvert ! queue ! x264enc key-int-max=60 ! h264parse ! splitmuxsink location=video%02d.mp4 max-size-time=30000000000 async-finalize=true muxer-factory=mp4mux
+ * ]|
+ * Records into 30 second fragments. With #GstSplitMuxSink:async-finalize,
+ * every fragment gets its own muxer and sink, created from
+ * #GstSplitMuxSink:muxer-factory and #GstSplitMuxSink:sink-factory. When a
+ * fragment ends, its muxer finishes the file (e.g. writes the moov atom) and
+ * the sink closes it on a background thread, while the next fragment is
+ * already receiving data. At most #GstSplitMuxSink:max-finalizing-fragments
+ * fragments are finalized at the same time.
+ * |[
+ * gst-launch-1.0 -e v4l2src ! videoconvert ! queue ! x264enc key-int-max=60 ! h264parse ! splitmuxsink location=video%05d.mp4 max-size-time=10000000000 index-location=video.idx
+ * ]|
+ * Also writes the duration of each fragment to video.idx, which lets
+ * splitmuxsrc skip measuring the files when reading them back.
  * </refsect2>
  */
 
@@ -53,6 +68,7 @@
 #include "config.h"
 #endif
 
+#include <stdio.h>
 #include <string.h>
 #include <glib/gstdio.h>
 #include <gst/video/video.h>
@@ -82,7 +98,14 @@ enum
   PROP_USE_ROBUST_MUXING,
   PROP_ALIGNMENT_THRESHOLD,
   PROP_MUXER,
-  PROP_SINK
+  PROP_SINK,
+  PROP_ASYNC_FINALIZE,
+  PROP_MUXER_FACTORY,
+  PROP_MUXER_PROPERTIES,
+  PROP_SINK_FACTORY,
+  PROP_SINK_PROPERTIES,
+  PROP_MAX_FINALIZING_FRAGMENTS,
+  PROP_INDEX_LOCATION
 };
 
 #define DEFAULT_MAX_SIZE_TIME       0
@@ -94,6 +117,8 @@ enum
 #define DEFAULT_MUXER "mp4mux"
 #define DEFAULT_SINK "filesink"
 #define DEFAULT_USE_ROBUST_MUXING FALSE
+#define DEFAULT_ASYNC_FINALIZE FALSE
+#define DEFAULT_MAX_FINALIZING_FRAGMENTS 2
 
 enum
 {
@@ -184,6 +209,32 @@ out_cmd_buf_free (SplitMuxOutputCommand * data)
   g_slice_free (SplitMuxOutputCommand, data);
 }
 
+/* Muxer and sink of a fragment that was ended in async-finalize mode and
+ * still has to finish writing */
+typedef struct _SplitMuxFinalizingFragment
+{
+  GstElement *muxer;
+  GstElement *active_sink;
+  gchar *location;
+  GstClockTimeDiff running_time;
+  GstClockTimeDiff start_time;
+  GstClockTimeDiff end_time;
+  /* EOS of the sink, held back while the elements are not swapped out
+   * yet. Posted before that, the bin could take it for its own EOS */
+  GstMessage *eos;
+} SplitMuxFinalizingFragment;
+
+static void
+finalizing_fragment_free (SplitMuxFinalizingFragment * f)
+{
+  gst_object_unref (f->muxer);
+  gst_object_unref (f->active_sink);
+  if (f->eos)
+    gst_message_unref (f->eos);
+  g_free (f->location);
+  g_slice_free (SplitMuxFinalizingFragment, f);
+}
+
 static void
 gst_splitmux_sink_class_init (GstSplitMuxSinkClass * klass)
 {
@@ -281,6 +332,45 @@ gst_splitmux_sink_class_init (GstSplitMuxSinkClass * klass)
           DEFAULT_USE_ROBUST_MUXING,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_ASYNC_FINALIZE,
+      g_param_spec_boolean ("async-finalize",
+          "Finalize fragments asynchronously",
+          "Finalize each fragment asynchronously and start a new one. The "
+          "muxer and sink are then created from muxer-factory and "
+          "sink-factory for every fragment, and the muxer and sink "
+          "properties are ignored",
+          DEFAULT_ASYNC_FINALIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MUXER_FACTORY,
+      g_param_spec_string ("muxer-factory", "Muxer factory",
+          "The muxer element factory to use in async-finalize mode",
+          DEFAULT_MUXER, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MUXER_PROPERTIES,
+      g_param_spec_boxed ("muxer-properties", "Muxer properties",
+          "The muxer element properties to use in async-finalize mode",
+          GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_SINK_FACTORY,
+      g_param_spec_string ("sink-factory", "Sink factory",
+          "The sink element factory to use in async-finalize mode",
+          DEFAULT_SINK, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_SINK_PROPERTIES,
+      g_param_spec_boxed ("sink-properties", "Sink properties",
+          "The sink element properties to use in async-finalize mode",
+          GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class,
+      PROP_MAX_FINALIZING_FRAGMENTS,
+      g_param_spec_uint ("max-finalizing-fragments",
+          "Max. finalizing fragments",
+          "Maximum number of fragments being finalized at the same time in "
+          "async-finalize mode. Starting a new fragment waits until one of "
+          "them is done (0 = unlimited)", 0, G_MAXUINT,
+          DEFAULT_MAX_FINALIZING_FRAGMENTS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index Location",
+          "File to write the duration of each fragment to, for use with the "
+          "splitmuxsrc index-location property (NULL = no index)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstSplitMuxSink::format-location:
    * @splitmux: the #GstSplitMuxSink
@@ -323,6 +413,10 @@ gst_splitmux_sink_init (GstSplitMuxSink * splitmux)
   splitmux->next_max_tc_time = GST_CLOCK_TIME_NONE;
   splitmux->alignment_threshold = DEFAULT_ALIGNMENT_THRESHOLD;
   splitmux->use_robust_muxing = DEFAULT_USE_ROBUST_MUXING;
+  splitmux->async_finalize = DEFAULT_ASYNC_FINALIZE;
+  splitmux->muxer_factory = g_strdup (DEFAULT_MUXER);
+  splitmux->sink_factory = g_strdup (DEFAULT_SINK);
+  splitmux->max_finalizing = DEFAULT_MAX_FINALIZING_FRAGMENTS;
 
   splitmux->threshold_timecode_str = NULL;
 
@@ -332,6 +426,32 @@ gst_splitmux_sink_init (GstSplitMuxSink * splitmux)
 static void
 gst_splitmux_reset (GstSplitMuxSink * splitmux)
 {
+  GList *l;
+
+  /* Fragments that never finished, the async-finalize callback only gets
+   * the ones that received EOS */
+  for (l = splitmux->finalizing; l; l = l->next) {
+    SplitMuxFinalizingFragment *f = l->data;
+
+    /* still the current fragment, removed below */
+    if (f->muxer == splitmux->muxer) {
+      finalizing_fragment_free (f);
+      splitmux->n_finalizing--;
+      continue;
+    }
+
+    gst_element_set_locked_state (f->muxer, TRUE);
+    gst_element_set_state (f->muxer, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (splitmux), f->muxer);
+    gst_element_set_locked_state (f->active_sink, TRUE);
+    gst_element_set_state (f->active_sink, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (splitmux), f->active_sink);
+    finalizing_fragment_free (f);
+    splitmux->n_finalizing--;
+  }
+  g_list_free (splitmux->finalizing);
+  splitmux->finalizing = NULL;
+
   if (splitmux->muxer) {
     gst_element_set_locked_state (splitmux->muxer, TRUE);
     gst_element_set_state (splitmux->muxer, GST_STATE_NULL);
@@ -376,6 +496,13 @@ gst_splitmux_sink_finalize (GObject * object)
     g_free (splitmux->threshold_timecode_str);
 
   g_free (splitmux->location);
+  g_free (splitmux->muxer_factory);
+  g_free (splitmux->sink_factory);
+  g_free (splitmux->index_location);
+  if (splitmux->muxer_properties)
+    gst_structure_free (splitmux->muxer_properties);
+  if (splitmux->sink_properties)
+    gst_structure_free (splitmux->sink_properties);
 
   /* Make sure to free any un-released contexts */
   g_list_foreach (splitmux->contexts, (GFunc) mq_stream_ctx_unref, NULL);
@@ -491,6 +618,48 @@ gst_splitmux_sink_set_property (GObject * object, guint prop_id,
       gst_object_ref_sink (splitmux->provided_muxer);
       GST_OBJECT_UNLOCK (splitmux);
       break;
+    case PROP_ASYNC_FINALIZE:
+      GST_OBJECT_LOCK (splitmux);
+      splitmux->async_finalize = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_MUXER_FACTORY:
+      GST_OBJECT_LOCK (splitmux);
+      g_free (splitmux->muxer_factory);
+      splitmux->muxer_factory = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_MUXER_PROPERTIES:
+      GST_OBJECT_LOCK (splitmux);
+      if (splitmux->muxer_properties)
+        gst_structure_free (splitmux->muxer_properties);
+      splitmux->muxer_properties = g_value_dup_boxed (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_SINK_FACTORY:
+      GST_OBJECT_LOCK (splitmux);
+      g_free (splitmux->sink_factory);
+      splitmux->sink_factory = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_SINK_PROPERTIES:
+      GST_OBJECT_LOCK (splitmux);
+      if (splitmux->sink_properties)
+        gst_structure_free (splitmux->sink_properties);
+      splitmux->sink_properties = g_value_dup_boxed (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_MAX_FINALIZING_FRAGMENTS:
+      GST_OBJECT_LOCK (splitmux);
+      splitmux->max_finalizing = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (splitmux);
+      g_free (splitmux->index_location);
+      splitmux->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -559,6 +728,41 @@ gst_splitmux_sink_get_property (GObject * object, guint prop_id,
       g_value_set_object (value, splitmux->provided_muxer);
       GST_OBJECT_UNLOCK (splitmux);
       break;
+    case PROP_ASYNC_FINALIZE:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_boolean (value, splitmux->async_finalize);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_MUXER_FACTORY:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_string (value, splitmux->muxer_factory);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_MUXER_PROPERTIES:
+      GST_OBJECT_LOCK (splitmux);
+      gst_value_set_structure (value, splitmux->muxer_properties);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_SINK_FACTORY:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_string (value, splitmux->sink_factory);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_SINK_PROPERTIES:
+      GST_OBJECT_LOCK (splitmux);
+      gst_value_set_structure (value, splitmux->sink_properties);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_MAX_FINALIZING_FRAGMENTS:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_uint (value, splitmux->max_finalizing);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_string (value, splitmux->index_location);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -642,22 +846,68 @@ _pad_block_destroy_src_notify (MqStreamCtx * ctx)
   mq_stream_ctx_unref (ctx);
 }
 
+static void
+post_fragment_msg (GstSplitMuxSink * splitmux, const gchar * msg_name,
+    const gchar * location, GstClockTimeDiff running_time)
+{
+  GstMessage *msg;
+
+  msg = gst_message_new_element (GST_OBJECT (splitmux),
+      gst_structure_new (msg_name,
+          "location", G_TYPE_STRING, location,
+          "running-time", GST_TYPE_CLOCK_TIME, running_time, NULL));
+  gst_element_post_message (GST_ELEMENT_CAST (splitmux), msg);
+}
+
+/* Appends a line with the start running time and the duration of a
+ * closed fragment, followed by its basename, to the index file */
+static void
+write_index_entry (GstSplitMuxSink * splitmux, const gchar * location,
+    GstClockTimeDiff start, GstClockTimeDiff end)
+{
+  gchar *index_location, *name;
+  FILE *f;
+
+  GST_OBJECT_LOCK (splitmux);
+  index_location = g_strdup (splitmux->index_location);
+  GST_OBJECT_UNLOCK (splitmux);
+
+  if (index_location == NULL || location == NULL ||
+      !GST_CLOCK_STIME_IS_VALID (start) || !GST_CLOCK_STIME_IS_VALID (end) ||
+      end < start)
+    goto done;
+
+  f = g_fopen (index_location, "a");
+  if (f == NULL) {
+    GST_WARNING_OBJECT (splitmux, "Could not open index %s", index_location);
+    goto done;
+  }
+
+  name = g_path_get_basename (location);
+  fprintf (f, "%" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %s\n", start,
+      end - start, name);
+  fclose (f);
+  g_free (name);
+
+done:
+  g_free (index_location);
+}
+
 static void
 send_fragment_opened_closed_msg (GstSplitMuxSink * splitmux, gboolean opened)
 {
   gchar *location = NULL;
-  GstMessage *msg;
   const gchar *msg_name = opened ?
       "splitmuxsink-fragment-opened" : "splitmuxsink-fragment-closed";
 
   g_object_get (splitmux->sink, "location", &location, NULL);
 
-  msg = gst_message_new_element (GST_OBJECT (splitmux),
-      gst_structure_new (msg_name,
-          "location", G_TYPE_STRING, location,
-          "running-time", GST_TYPE_CLOCK_TIME,
-          splitmux->reference_ctx->out_running_time, NULL));
-  gst_element_post_message (GST_ELEMENT_CAST (splitmux), msg);
+  if (!opened)
+    write_index_entry (splitmux, location, splitmux->fragment_out_start,
+        splitmux->fragment_out_end);
+
+  post_fragment_msg (splitmux, msg_name, location,
+      splitmux->reference_ctx->out_running_time);
 
   g_free (location);
 }
@@ -684,6 +934,80 @@ send_eos (GstSplitMuxSink * splitmux, MqStreamCtx * ctx)
   gst_object_unref (pad);
 }
 
+static SplitMuxFinalizingFragment *
+find_finalizing_fragment (GstSplitMuxSink * splitmux, GstElement * muxer)
+{
+  GList *l;
+
+  for (l = splitmux->finalizing; l; l = l->next) {
+    SplitMuxFinalizingFragment *f = l->data;
+
+    if (f->muxer == muxer)
+      return f;
+  }
+  return NULL;
+}
+
+/* Called with lock held in async-finalize mode, when the current fragment
+ * is about to be ended and a finalizing slot is free */
+static void
+add_finalizing_fragment (GstSplitMuxSink * splitmux)
+{
+  SplitMuxFinalizingFragment *f;
+
+  f = g_slice_new0 (SplitMuxFinalizingFragment);
+  f->muxer = gst_object_ref (splitmux->muxer);
+  f->active_sink = gst_object_ref (splitmux->active_sink);
+  g_object_get (splitmux->sink, "location", &f->location, NULL);
+  f->running_time = splitmux->reference_ctx->out_running_time;
+  f->start_time = splitmux->fragment_out_start;
+  f->end_time = splitmux->fragment_out_end;
+
+  splitmux->finalizing = g_list_prepend (splitmux->finalizing, f);
+  splitmux->n_finalizing++;
+}
+
+static void
+do_send_eos_async (GstElement * element, GstPad * pad)
+{
+  GST_INFO_OBJECT (element, "Sending EOS on %" GST_PTR_FORMAT, pad);
+  gst_pad_send_event (pad, gst_event_new_eos ());
+}
+
+/* Called with lock held. In async-finalize mode the EOS is sent to the
+ * muxer from another thread, because the muxer finishes the file while
+ * handling it and the output must not wait for that. The pad of the old
+ * muxer is kept so the context can be relinked to the next muxer in the
+ * meantime */
+static void
+send_eos_async (GstSplitMuxSink * splitmux, MqStreamCtx * ctx)
+{
+  GstPad *pad = gst_pad_get_peer (ctx->srcpad);
+
+  ctx->out_eos = TRUE;
+
+  if (pad == NULL)
+    return;
+
+  gst_element_call_async (GST_ELEMENT_CAST (splitmux),
+      (GstElementCallAsyncFunc) do_send_eos_async, pad,
+      (GDestroyNotify) gst_object_unref);
+}
+
+static gboolean
+all_contexts_are_eos (GstSplitMuxSink * splitmux)
+{
+  GList *l;
+
+  for (l = splitmux->contexts; l; l = l->next) {
+    MqStreamCtx *ctx = l->data;
+
+    if (!ctx->out_eos)
+      return FALSE;
+  }
+  return TRUE;
+}
+
 /* Called with splitmux lock held to check if this output
  * context needs to sleep to wait for the release of the
  * next GOP, or to send EOS to close out the current file
@@ -738,7 +1062,31 @@ complete_or_wait_on_out (GstSplitMuxSink * splitmux, MqStreamCtx * ctx)
         case SPLITMUX_OUTPUT_STATE_ENDING_FILE:
           /* We've reached the max out running_time to get here, so end this file now */
           if (ctx->out_eos == FALSE) {
-            send_eos (splitmux, ctx);
+            if (splitmux->async_finalize) {
+              /* The fragment is recorded before the first EOS goes out, so
+               * the EOS of its sink is recognized whenever it arrives */
+              if (find_finalizing_fragment (splitmux, splitmux->muxer) == NULL) {
+                if (splitmux->max_finalizing > 0 &&
+                    splitmux->n_finalizing >= splitmux->max_finalizing) {
+                  GST_LOG_OBJECT (splitmux,
+                      "Waiting for %u fragments to be finalized",
+                      splitmux->n_finalizing);
+                  GST_SPLITMUX_WAIT_OUTPUT (splitmux);
+                  continue;
+                }
+                add_finalizing_fragment (splitmux);
+              }
+              send_eos_async (splitmux, ctx);
+              /* Don't wait for the EOS to come out of the sink, the next
+               * fragment can start as soon as all streams are done with
+               * this one */
+              if (all_contexts_are_eos (splitmux)) {
+                splitmux->output_state = SPLITMUX_OUTPUT_STATE_START_NEXT_FILE;
+                GST_SPLITMUX_BROADCAST_OUTPUT (splitmux);
+              }
+            } else {
+              send_eos (splitmux, ctx);
+            }
             continue;
           }
           break;
@@ -1077,6 +1425,17 @@ handle_mq_output (GstPad * pad, GstPadProbeInfo * info, MqStreamCtx * ctx)
 
   splitmux->muxed_out_bytes += buf_info->buf_size;
 
+  /* Track where the current fragment ends for the index */
+  if (ctx->is_reference && GST_CLOCK_STIME_IS_VALID (buf_info->run_ts)) {
+    GstClockTimeDiff end = buf_info->run_ts;
+
+    if (GST_CLOCK_TIME_IS_VALID (buf_info->duration))
+      end += buf_info->duration;
+    if (!GST_CLOCK_STIME_IS_VALID (splitmux->fragment_out_end) ||
+        end > splitmux->fragment_out_end)
+      splitmux->fragment_out_end = end;
+  }
+
 #ifndef GST_DISABLE_GST_DEBUG
   {
     GstBuffer *buf = gst_pad_probe_info_get_buffer (info);
@@ -1132,6 +1491,123 @@ restart_context (MqStreamCtx * ctx, GstSplitMuxSink * splitmux)
   gst_object_unref (peer);
 }
 
+/* Move the output of a context from the muxer of the previous
+ * fragment to an equivalent request pad on the new muxer */
+static void
+relink_context (MqStreamCtx * ctx, GstSplitMuxSink * splitmux)
+{
+  GstPad *sinkpad, *peer;
+  GstPadTemplate *templ;
+  gchar *name;
+
+  peer = gst_pad_get_peer (ctx->srcpad);
+  if (peer == NULL)
+    return;
+
+  templ = GST_PAD_PAD_TEMPLATE (peer);
+  name = gst_pad_get_name (peer);
+  sinkpad = gst_element_request_pad (splitmux->muxer, templ, name, NULL);
+  g_free (name);
+
+  gst_pad_unlink (ctx->srcpad, peer);
+  gst_object_unref (peer);
+
+  if (sinkpad == NULL) {
+    GST_ELEMENT_ERROR (splitmux, CORE, PAD, (NULL),
+        ("Could not request a new pad on the muxer"));
+    return;
+  }
+
+  if (gst_pad_link (ctx->srcpad, sinkpad) != GST_PAD_LINK_OK) {
+    GST_ELEMENT_ERROR (splitmux, CORE, PAD, (NULL),
+        ("Could not link to the new muxer"));
+  }
+  gst_object_unref (sinkpad);
+}
+
+/* Called from a separate thread once the sink of a fragment
+ * handed to the finalizing list in async-finalize mode got EOS */
+static void
+finalize_fragment (GstSplitMuxSink * splitmux, SplitMuxFinalizingFragment * f)
+{
+  GST_DEBUG_OBJECT (splitmux, "Finalizing fragment %s", f->location);
+
+  /* the sink of the next fragment is in the bin by now */
+  if (f->eos) {
+    GST_BIN_CLASS (parent_class)->handle_message (GST_BIN_CAST (splitmux),
+        f->eos);
+    f->eos = NULL;
+  }
+
+  GST_STATE_LOCK (splitmux);
+  gst_element_set_locked_state (f->muxer, TRUE);
+  gst_element_set_locked_state (f->active_sink, TRUE);
+  gst_element_set_state (f->muxer, GST_STATE_NULL);
+  gst_element_set_state (f->active_sink, GST_STATE_NULL);
+  gst_bin_remove (GST_BIN (splitmux), f->muxer);
+  gst_bin_remove (GST_BIN (splitmux), f->active_sink);
+  GST_STATE_UNLOCK (splitmux);
+
+  finalizing_fragment_free (f);
+
+  GST_SPLITMUX_LOCK (splitmux);
+  splitmux->n_finalizing--;
+  GST_SPLITMUX_BROADCAST_OUTPUT (splitmux);
+  GST_SPLITMUX_UNLOCK (splitmux);
+}
+
+/* Called with lock held once the sink of a fragment in the finalizing
+ * list got EOS and the fragment's elements have been swapped out */
+static void
+fragment_finished (GstSplitMuxSink * splitmux, SplitMuxFinalizingFragment * f)
+{
+  GST_DEBUG_OBJECT (splitmux, "Fragment %s finished writing", f->location);
+  write_index_entry (splitmux, f->location, f->start_time, f->end_time);
+  post_fragment_msg (splitmux, "splitmuxsink-fragment-closed",
+      f->location, f->running_time);
+  splitmux->finalizing = g_list_remove (splitmux->finalizing, f);
+  gst_element_call_async (GST_ELEMENT_CAST (splitmux),
+      (GstElementCallAsyncFunc) finalize_fragment, f, NULL);
+}
+
+/* Called with lock held in async-finalize mode, after all streams got EOS.
+ * The muxer and sink of the fragment are already in the finalizing list,
+ * this creates new ones for the next fragment. Returns FALSE on error */
+static gboolean
+swap_fragment_elements (GstSplitMuxSink * splitmux)
+{
+  SplitMuxFinalizingFragment *f;
+
+  f = find_finalizing_fragment (splitmux, splitmux->muxer);
+  if (f == NULL) {
+    add_finalizing_fragment (splitmux);
+    f = splitmux->finalizing->data;
+  }
+
+  /* all streams are done with the fragment now */
+  f->running_time = splitmux->reference_ctx->out_running_time;
+  f->end_time = splitmux->fragment_out_end;
+
+  splitmux->muxer = NULL;
+  splitmux->sink = NULL;
+  splitmux->active_sink = NULL;
+
+  if (!create_muxer (splitmux) || !create_sink (splitmux)) {
+    GST_ELEMENT_ERROR (splitmux, RESOURCE, SETTINGS, (NULL),
+        ("Could not create the muxer or sink for the next fragment"));
+    splitmux->output_state = SPLITMUX_OUTPUT_STATE_STOPPED;
+    return FALSE;
+  }
+  gst_element_set_locked_state (splitmux->muxer, TRUE);
+
+  g_list_foreach (splitmux->contexts, (GFunc) relink_context, splitmux);
+
+  if (f->eos)
+    fragment_finished (splitmux, f);
+
+  return TRUE;
+}
+
 /* Called with lock held when a fragment
  * reaches EOS and it is time to restart
  * a new fragment
@@ -1141,6 +1617,11 @@ start_next_fragment (GstSplitMuxSink * splitmux, MqStreamCtx * ctx)
 {
   GstElement *muxer, *sink;
 
+  if (splitmux->async_finalize && splitmux->ready_for_output) {
+    if (!swap_fragment_elements (splitmux))
+      return;
+  }
+
   /* 1 change to new file */
   splitmux->switching_fragment = TRUE;
 
@@ -1180,6 +1661,8 @@ start_next_fragment (GstSplitMuxSink * splitmux, MqStreamCtx * ctx)
 
   g_list_foreach (splitmux->contexts, (GFunc) restart_context, splitmux);
 
+  splitmux->fragment_out_start = splitmux->reference_ctx->out_running_time;
+  splitmux->fragment_out_end = GST_CLOCK_STIME_NONE;
   send_fragment_opened_closed_msg (splitmux, TRUE);
 
   /* FIXME: Is this always the correct next state? */
@@ -1193,10 +1676,33 @@ bus_handler (GstBin * bin, GstMessage * message)
   GstSplitMuxSink *splitmux = GST_SPLITMUX_SINK (bin);
 
   switch (GST_MESSAGE_TYPE (message)) {
-    case GST_MESSAGE_EOS:
+    case GST_MESSAGE_EOS:{
+      GList *l;
+
       /* If the state is draining out the current file, drop this EOS */
       GST_SPLITMUX_LOCK (splitmux);
 
+      for (l = splitmux->finalizing; l; l = l->next) {
+        SplitMuxFinalizingFragment *f = l->data;
+
+        if (GST_MESSAGE_SRC (message) != (GstObject *) f->active_sink)
+          continue;
+
+        /* A fragment finalized in the background is done. Its EOS still
+         * goes to the bin so it doesn't hold back the EOS of the last
+         * fragment. If the other streams are still ending the fragment,
+         * the sink of the next one isn't in the bin yet, so hold the EOS
+         * until the swap finishes the fragment */
+        if (f->muxer == splitmux->muxer) {
+          f->eos = message;
+          GST_SPLITMUX_UNLOCK (splitmux);
+          return;
+        }
+        fragment_finished (splitmux, f);
+        GST_SPLITMUX_UNLOCK (splitmux);
+        goto forward;
+      }
+
       send_fragment_opened_closed_msg (splitmux, FALSE);
 
       if (splitmux->output_state == SPLITMUX_OUTPUT_STATE_ENDING_FILE) {
@@ -1215,6 +1721,7 @@ bus_handler (GstBin * bin, GstMessage * message)
       }
       GST_SPLITMUX_UNLOCK (splitmux);
       break;
+    }
     case GST_MESSAGE_ASYNC_START:
     case GST_MESSAGE_ASYNC_DONE:
       /* Ignore state changes from our children while switching */
@@ -1233,6 +1740,7 @@ bus_handler (GstBin * bin, GstMessage * message)
       break;
   }
 
+forward:
   GST_BIN_CLASS (parent_class)->handle_message (bin, message);
 }
 
@@ -2096,6 +2604,41 @@ create_element (GstSplitMuxSink * splitmux,
   return ret;
 }
 
+static gboolean
+_set_property_from_structure (GQuark field_id, const GValue * value,
+    gpointer user_data)
+{
+  const gchar *property = g_quark_to_string (field_id);
+  GObject *element = G_OBJECT (user_data);
+
+  g_object_set_property (element, property, value);
+
+  return TRUE;
+}
+
+/* In async-finalize mode every fragment gets a fresh element from the
+ * factory, so they need unique names in the bin */
+static GstElement *
+create_element_from_factory (GstSplitMuxSink * splitmux,
+    const gchar * factory, const gchar * prefix,
+    const GstStructure * properties, gboolean locked)
+{
+  GstElement *ret;
+  gchar *name;
+
+  GST_OBJECT_LOCK (splitmux);
+  name = g_strdup_printf ("%s_%u", prefix, splitmux->element_id++);
+  GST_OBJECT_UNLOCK (splitmux);
+
+  ret = create_element (splitmux, factory, name, locked);
+  g_free (name);
+
+  if (ret != NULL && properties != NULL)
+    gst_structure_foreach (properties, _set_property_from_structure, ret);
+
+  return ret;
+}
+
 static gboolean
 create_muxer (GstSplitMuxSink * splitmux)
 {
@@ -2108,7 +2651,17 @@ create_muxer (GstSplitMuxSink * splitmux)
       provided_muxer = gst_object_ref (splitmux->provided_muxer);
     GST_OBJECT_UNLOCK (splitmux);
 
-    if (provided_muxer == NULL) {
+    if (splitmux->async_finalize) {
+      if (provided_muxer != NULL) {
+        GST_WARNING_OBJECT (splitmux,
+            "Ignoring the muxer property in async-finalize mode");
+        gst_object_unref (provided_muxer);
+      }
+      if ((splitmux->muxer = create_element_from_factory (splitmux,
+                  splitmux->muxer_factory, "muxer",
+                  splitmux->muxer_properties, FALSE)) == NULL)
+        goto fail;
+    } else if (provided_muxer == NULL) {
       if ((splitmux->muxer =
               create_element (splitmux, "mp4mux", "muxer", FALSE)) == NULL)
         goto fail;
@@ -2192,7 +2745,24 @@ create_sink (GstSplitMuxSink * splitmux)
       provided_sink = gst_object_ref (splitmux->provided_sink);
     GST_OBJECT_UNLOCK (splitmux);
 
-    if (provided_sink == NULL) {
+    if (splitmux->async_finalize) {
+      if (provided_sink != NULL) {
+        GST_WARNING_OBJECT (splitmux,
+            "Ignoring the sink property in async-finalize mode");
+        gst_object_unref (provided_sink);
+      }
+      if ((splitmux->active_sink = create_element_from_factory (splitmux,
+                  splitmux->sink_factory, "sink",
+                  splitmux->sink_properties, TRUE)) == NULL)
+        goto fail;
+
+      splitmux->sink = find_sink (splitmux->active_sink);
+      if (splitmux->sink == NULL) {
+        g_warning
+            ("Could not locate sink element in sink-factory element - splitmuxsink will not work");
+        goto fail;
+      }
+    } else if (provided_sink == NULL) {
       if ((splitmux->sink =
               create_element (splitmux, DEFAULT_SINK, "sink", TRUE)) == NULL)
         goto fail;
@@ -2350,7 +2920,22 @@ gst_splitmux_sink_change_state (GstElement * element, GstStateChange transition)
           GST_CLOCK_STIME_NONE;
       splitmux->muxed_out_bytes = 0;
       splitmux->ready_for_output = FALSE;
+      splitmux->fragment_out_start = splitmux->fragment_out_end =
+          GST_CLOCK_STIME_NONE;
       GST_SPLITMUX_UNLOCK (splitmux);
+
+      /* Start a new index */
+      GST_OBJECT_LOCK (splitmux);
+      if (splitmux->index_location != NULL) {
+        FILE *f = g_fopen (splitmux->index_location, "w");
+
+        if (f != NULL)
+          fclose (f);
+        else
+          GST_WARNING_OBJECT (splitmux, "Could not create index %s",
+              splitmux->index_location);
+      }
+      GST_OBJECT_UNLOCK (splitmux);
       break;
     }
     case GST_STATE_CHANGE_PAUSED_TO_READY:
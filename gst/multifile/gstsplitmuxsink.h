@@ -147,6 +147,9 @@ struct _GstSplitMuxSink
   GstClockTimeDiff fragment_start_time;
   /* Start time of the current GOP */
   GstClockTimeDiff gop_start_time;
+  /* Output running time range of the current fragment */
+  GstClockTimeDiff fragment_out_start;
+  GstClockTimeDiff fragment_out_end;
 
   GQueue out_cmd_q;             /* Queue of commands for output thread */
 
@@ -168,6 +171,21 @@ struct _GstSplitMuxSink
 
   gboolean use_robust_muxing;
   gboolean muxer_has_reserved_props;
+
+  /* Finalize fragments in the background, with a new
+   * muxer / sink pair created for each fragment */
+  gboolean async_finalize;
+  gchar *muxer_factory;
+  GstStructure *muxer_properties;
+  gchar *sink_factory;
+  GstStructure *sink_properties;
+  guint max_finalizing;
+  /* Fragments still being finalized */
+  GList *finalizing;
+  guint n_finalizing;
+  guint element_id;
+
+  gchar *index_location;
 };
 
 struct _GstSplitMuxSinkClass
@@ -39,6 +39,15 @@
  * |[
  * gst-launch-1.0 playbin uri="splitmux://path/to/foo.mp4.*"
  * ]| Play back a set of files created by splitmuxsink
+ * |[
+ * gst-launch-1.0 splitmuxsrc location=video*.mov index-location=video.idx ! decodebin ! xvimagesink
+ * ]| Take the durations of the parts from the index written by splitmuxsink
+ * instead of measuring each file on startup
+ *
+ * On startup, every part that is not listed in the
+ * #GstSplitMuxSrc:index-location file is measured, using up to
+ * #GstSplitMuxSrc:probe-threads parts in parallel. Afterwards only the
+ * parts around the current playback position are kept open.
  * </refsect2>
  */
 
@@ -46,6 +55,7 @@
 #include "config.h"
 #endif
 
+#include <stdio.h>
 #include <string.h>
 #include "gstsplitmuxsrc.h"
 #include "gstsplitutils.h"
@@ -55,12 +65,29 @@
 GST_DEBUG_CATEGORY (splitmux_debug);
 #define GST_CAT_DEFAULT splitmux_debug
 
+#define DEFAULT_PROBE_THREADS 4
+
 enum
 {
   PROP_0,
-  PROP_LOCATION
+  PROP_LOCATION,
+  PROP_INDEX_LOCATION,
+  PROP_PROBE_THREADS
 };
 
+typedef enum
+{
+  PART_JOB_PREPARE,             /* prepare ahead of playback */
+  PART_JOB_PROBE,               /* measure on startup */
+  PART_JOB_RELEASE              /* unprepare if not in use any more */
+} SplitMuxPartJobType;
+
+typedef struct
+{
+  guint part;
+  SplitMuxPartJobType type;
+} SplitMuxPartJob;
+
 enum
 {
   SIGNAL_FORMAT_LOCATION,
@@ -221,6 +248,18 @@ gst_splitmux_src_class_init (GstSplitMuxSrcClass * klass)
           "Glob pattern for the location of the files to read", NULL,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index Location",
+          "Index file written by splitmuxsink with the durations of the "
+          "files, so they don't need to be measured (NULL = no index)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PROBE_THREADS,
+      g_param_spec_uint ("probe-threads", "Probe threads",
+          "Maximum number of files measured in parallel on startup "
+          "(0 = number of processors)", 0, 64, DEFAULT_PROBE_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstSplitMuxSrc::format-location:
    * @splitmux: the #GstSplitMuxSrc
@@ -241,6 +280,8 @@ gst_splitmux_src_init (GstSplitMuxSrc * splitmux)
 {
   g_mutex_init (&splitmux->lock);
   g_mutex_init (&splitmux->pads_lock);
+  g_cond_init (&splitmux->part_cond);
+  splitmux->probe_threads = DEFAULT_PROBE_THREADS;
   splitmux->total_duration = GST_CLOCK_TIME_NONE;
   gst_segment_init (&splitmux->play_segment, GST_FORMAT_TIME);
 }
@@ -271,7 +312,9 @@ gst_splitmux_src_finalize (GObject * object)
   GstSplitMuxSrc *splitmux = GST_SPLITMUX_SRC (object);
   g_mutex_clear (&splitmux->lock);
   g_mutex_clear (&splitmux->pads_lock);
+  g_cond_clear (&splitmux->part_cond);
   g_free (splitmux->location);
+  g_free (splitmux->index_location);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -290,6 +333,17 @@ gst_splitmux_src_set_property (GObject * object, guint prop_id,
       GST_OBJECT_UNLOCK (splitmux);
       break;
     }
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (splitmux);
+      g_free (splitmux->index_location);
+      splitmux->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_PROBE_THREADS:
+      GST_OBJECT_LOCK (splitmux);
+      splitmux->probe_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -308,6 +362,16 @@ gst_splitmux_src_get_property (GObject * object, guint prop_id,
       g_value_set_string (value, splitmux->location);
       GST_OBJECT_UNLOCK (splitmux);
       break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_string (value, splitmux->index_location);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
+    case PROP_PROBE_THREADS:
+      GST_OBJECT_LOCK (splitmux);
+      g_value_set_uint (value, splitmux->probe_threads);
+      GST_OBJECT_UNLOCK (splitmux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -574,6 +638,163 @@ flushing:
   return;
 }
 
+/* Called with lock held, which is released while preparing */
+static gboolean
+gst_splitmux_src_prepare_part_locked (GstSplitMuxSrc * splitmux, guint part)
+{
+  GstSplitMuxPartReader *reader = splitmux->parts[part];
+  gboolean ret;
+
+  GST_DEBUG_OBJECT (splitmux, "Preparing part %u", part);
+
+  splitmux->part_states[part] = SPLITMUX_PART_PREPARING;
+  SPLITMUX_SRC_UNLOCK (splitmux);
+
+  ret = gst_splitmux_part_reader_prepare (reader);
+  if (!ret)
+    gst_splitmux_part_reader_unprepare (reader);
+
+  SPLITMUX_SRC_LOCK (splitmux);
+  splitmux->part_states[part] =
+      ret ? SPLITMUX_PART_PREPARED : SPLITMUX_PART_FAILED;
+  g_cond_broadcast (&splitmux->part_cond);
+
+  return ret;
+}
+
+/* Called with lock held, which is released while unpreparing */
+static void
+gst_splitmux_src_release_part_locked (GstSplitMuxSrc * splitmux, guint part)
+{
+  GST_DEBUG_OBJECT (splitmux, "Releasing part %u", part);
+
+  splitmux->part_states[part] = SPLITMUX_PART_RELEASING;
+  SPLITMUX_SRC_UNLOCK (splitmux);
+
+  gst_splitmux_part_reader_unprepare (splitmux->parts[part]);
+
+  SPLITMUX_SRC_LOCK (splitmux);
+  splitmux->part_states[part] = SPLITMUX_PART_UNPREPARED;
+  g_cond_broadcast (&splitmux->part_cond);
+}
+
+/* Called with lock held. Makes sure a part is prepared before it gets
+ * activated, either by waiting for a background job that is already
+ * working on it or by preparing it right away */
+static gboolean
+gst_splitmux_src_ensure_part_prepared (GstSplitMuxSrc * splitmux, guint part)
+{
+  while (splitmux->running) {
+    switch (splitmux->part_states[part]) {
+      case SPLITMUX_PART_PREPARED:
+        return TRUE;
+      case SPLITMUX_PART_FAILED:
+        return FALSE;
+      case SPLITMUX_PART_UNPREPARED:
+        gst_splitmux_src_prepare_part_locked (splitmux, part);
+        break;
+      default:
+        g_cond_wait (&splitmux->part_cond, &splitmux->lock);
+        break;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Called with lock held */
+static gboolean
+gst_splitmux_src_part_in_use (GstSplitMuxSrc * splitmux, guint part)
+{
+  gboolean ret = (part == splitmux->cur_part);
+  GList *cur;
+
+  SPLITMUX_SRC_PADS_LOCK (splitmux);
+  for (cur = g_list_first (splitmux->pads);
+      cur != NULL && !ret; cur = g_list_next (cur)) {
+    SplitMuxSrcPad *splitpad = (SplitMuxSrcPad *) (cur->data);
+    if (splitpad->cur_part == part)
+      ret = TRUE;
+  }
+  SPLITMUX_SRC_PADS_UNLOCK (splitmux);
+
+  return ret || gst_splitmux_part_reader_is_active (splitmux->parts[part]);
+}
+
+static void
+gst_splitmux_src_part_job (SplitMuxPartJob * job, GstSplitMuxSrc * splitmux)
+{
+  guint part = job->part;
+
+  SPLITMUX_SRC_LOCK (splitmux);
+  if (!splitmux->running)
+    goto done;
+
+  switch (job->type) {
+    case PART_JOB_PREPARE:
+      if (splitmux->part_states[part] == SPLITMUX_PART_UNPREPARED)
+        gst_splitmux_src_prepare_part_locked (splitmux, part);
+      break;
+    case PART_JOB_PROBE:
+      /* Measure the part, then close it again unless it is one of the
+       * first two, which are needed right away */
+      if (splitmux->part_states[part] == SPLITMUX_PART_UNPREPARED &&
+          gst_splitmux_src_prepare_part_locked (splitmux, part) && part > 1)
+        gst_splitmux_src_release_part_locked (splitmux, part);
+      break;
+    case PART_JOB_RELEASE:
+      if (splitmux->part_states[part] == SPLITMUX_PART_PREPARED &&
+          !gst_splitmux_src_part_in_use (splitmux, part))
+        gst_splitmux_src_release_part_locked (splitmux, part);
+      break;
+  }
+
+done:
+  if (job->type == PART_JOB_PROBE) {
+    splitmux->pending_probes--;
+    g_cond_broadcast (&splitmux->part_cond);
+  }
+  SPLITMUX_SRC_UNLOCK (splitmux);
+
+  g_slice_free (SplitMuxPartJob, job);
+}
+
+static void
+gst_splitmux_src_push_part_job (GstSplitMuxSrc * splitmux, guint part,
+    SplitMuxPartJobType type)
+{
+  SplitMuxPartJob *job = g_slice_new (SplitMuxPartJob);
+
+  job->part = part;
+  job->type = type;
+  g_thread_pool_push (splitmux->part_pool, job, NULL);
+}
+
+/* Called with lock held when playback moved to a new part. Prepares
+ * the part that comes next in the playback direction and closes the
+ * ones that are further away */
+static void
+gst_splitmux_src_schedule_parts (GstSplitMuxSrc * splitmux, guint part)
+{
+  guint i;
+
+  if (splitmux->play_segment.rate >= 0.0) {
+    if (part + 1 < splitmux->num_parts &&
+        splitmux->part_states[part + 1] == SPLITMUX_PART_UNPREPARED)
+      gst_splitmux_src_push_part_job (splitmux, part + 1, PART_JOB_PREPARE);
+  } else {
+    if (part > 0 && splitmux->part_states[part - 1] == SPLITMUX_PART_UNPREPARED)
+      gst_splitmux_src_push_part_job (splitmux, part - 1, PART_JOB_PREPARE);
+  }
+
+  for (i = 0; i < splitmux->num_parts; i++) {
+    if (splitmux->part_states[i] == SPLITMUX_PART_PREPARED &&
+        (i + 1 < part || i > part + 1))
+      gst_splitmux_src_push_part_job (splitmux, i, PART_JOB_RELEASE);
+  }
+}
+
+/* Called with lock held */
 static gboolean
 gst_splitmux_src_activate_part (GstSplitMuxSrc * splitmux, guint part,
     GstSeekFlags extra_flags)
@@ -582,6 +803,9 @@ gst_splitmux_src_activate_part (GstSplitMuxSrc * splitmux, guint part,
 
   GST_DEBUG_OBJECT (splitmux, "Activating part %d", part);
 
+  if (!gst_splitmux_src_ensure_part_prepared (splitmux, part))
+    return FALSE;
+
   splitmux->cur_part = part;
   if (!gst_splitmux_part_reader_activate (splitmux->parts[part],
           &splitmux->play_segment, extra_flags))
@@ -608,9 +832,53 @@ gst_splitmux_src_activate_part (GstSplitMuxSrc * splitmux, guint part,
   }
   SPLITMUX_SRC_PADS_UNLOCK (splitmux);
 
+  gst_splitmux_src_schedule_parts (splitmux, part);
+
   return TRUE;
 }
 
+/* Parses the index written by splitmuxsink. Each line holds the start
+ * running time and the duration of a file in nanoseconds, followed by
+ * its basename */
+static GHashTable *
+gst_splitmux_src_load_index (GstSplitMuxSrc * splitmux, const gchar * location)
+{
+  GHashTable *index;
+  GError *err = NULL;
+  gchar *contents;
+  gchar **lines;
+  guint i;
+
+  if (!g_file_get_contents (location, &contents, NULL, &err)) {
+    GST_WARNING_OBJECT (splitmux, "Could not read index %s: %s", location,
+        err->message);
+    g_clear_error (&err);
+    return NULL;
+  }
+
+  index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++) {
+    guint64 start, duration;
+    gint n = 0;
+
+    if (sscanf (lines[i], "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %n",
+            &start, &duration, &n) < 2 || n == 0 || lines[i][n] == '\0')
+      continue;
+
+    g_hash_table_replace (index, g_strdup (lines[i] + n),
+        g_memdup (&duration, sizeof (duration)));
+  }
+  g_strfreev (lines);
+  g_free (contents);
+
+  GST_INFO_OBJECT (splitmux, "Loaded %u entries from index %s",
+      g_hash_table_size (index), location);
+
+  return index;
+}
+
 static gboolean
 gst_splitmux_src_start (GstSplitMuxSrc * splitmux)
 {
@@ -622,6 +890,9 @@ gst_splitmux_src_start (GstSplitMuxSrc * splitmux)
   GstClockTime next_offset = 0;
   guint i;
   GstClockTime total_duration = 0;
+  gchar *index_location;
+  GHashTable *index = NULL;
+  guint probe_threads;
 
   GST_DEBUG_OBJECT (splitmux, "Starting");
 
@@ -650,25 +921,87 @@ gst_splitmux_src_start (GstSplitMuxSrc * splitmux)
   splitmux->num_parts = g_strv_length (files);
 
   splitmux->parts = g_new0 (GstSplitMuxPartReader *, splitmux->num_parts);
+  splitmux->part_states = g_new0 (SplitMuxSrcPartState, splitmux->num_parts);
+
+  GST_OBJECT_LOCK (splitmux);
+  index_location = g_strdup (splitmux->index_location);
+  probe_threads = splitmux->probe_threads;
+  GST_OBJECT_UNLOCK (splitmux);
+
+  if (probe_threads == 0)
+    probe_threads = g_get_num_processors ();
+
+  if (index_location != NULL) {
+    index = gst_splitmux_src_load_index (splitmux, index_location);
+    g_free (index_location);
+  }
 
   for (i = 0; i < splitmux->num_parts; i++) {
     splitmux->parts[i] = gst_splitmux_part_create (splitmux, files[i]);
-    if (splitmux->parts[i] == NULL)
+
+    if (index != NULL) {
+      gchar *name = g_path_get_basename (files[i]);
+      guint64 *duration = g_hash_table_lookup (index, name);
+
+      if (duration != NULL)
+        gst_splitmux_part_reader_set_measurement (splitmux->parts[i],
+            *duration, *duration);
+      g_free (name);
+    }
+  }
+
+  if (index != NULL)
+    g_hash_table_unref (index);
+
+  splitmux->part_pool =
+      g_thread_pool_new ((GFunc) gst_splitmux_src_part_job, splitmux,
+      probe_threads, FALSE, NULL);
+
+  /* The first part is prepared right away, it provides the output pads.
+   * The others that are not in the index are measured in parallel */
+  SPLITMUX_SRC_LOCK (splitmux);
+  if (!gst_splitmux_src_ensure_part_prepared (splitmux, 0)) {
+    SPLITMUX_SRC_UNLOCK (splitmux);
+    i = 0;
+    goto part_failed;
+  }
+
+  for (i = 1; i < splitmux->num_parts; i++) {
+    if (gst_splitmux_part_reader_is_measured (splitmux->parts[i]))
+      continue;
+    splitmux->pending_probes++;
+    gst_splitmux_src_push_part_job (splitmux, i, PART_JOB_PROBE);
+  }
+  while (splitmux->pending_probes > 0)
+    g_cond_wait (&splitmux->part_cond, &splitmux->lock);
+
+  for (i = 1; i < splitmux->num_parts; i++) {
+    if (splitmux->part_states[i] == SPLITMUX_PART_FAILED)
       break;
+  }
+  SPLITMUX_SRC_UNLOCK (splitmux);
+
+part_failed:
+  if (i < splitmux->num_parts) {
+    guint j;
+
+    GST_WARNING_OBJECT (splitmux,
+        "Failed to prepare file part %s. Cannot play past there.", files[i]);
+    GST_ELEMENT_WARNING (splitmux, RESOURCE, READ, (NULL),
+        ("Failed to prepare file part %s. Cannot play past there.",
+            files[i]));
 
+    for (j = i; j < splitmux->num_parts; j++) {
+      gst_splitmux_part_reader_unprepare (splitmux->parts[j]);
+      g_object_unref (splitmux->parts[j]);
+      splitmux->parts[j] = NULL;
+    }
+  }
+
+  /* Lay the parts out one after the other */
+  for (i = 0; i < splitmux->num_parts && splitmux->parts[i] != NULL; i++) {
     /* Figure out the next offset - the smallest one */
     gst_splitmux_part_reader_set_start_offset (splitmux->parts[i], next_offset);
-    if (!gst_splitmux_part_reader_prepare (splitmux->parts[i])) {
-      GST_WARNING_OBJECT (splitmux,
-          "Failed to prepare file part %s. Cannot play past there.", files[i]);
-      GST_ELEMENT_WARNING (splitmux, RESOURCE, READ, (NULL),
-          ("Failed to prepare file part %s. Cannot play past there.",
-              files[i]));
-      gst_splitmux_part_reader_unprepare (splitmux->parts[i]);
-      g_object_unref (splitmux->parts[i]);
-      splitmux->parts[i] = NULL;
-      break;
-    }
 
     /* Extend our total duration to cover this part */
     total_duration =
@@ -694,7 +1027,9 @@ gst_splitmux_src_start (GstSplitMuxSrc * splitmux)
   GST_INFO_OBJECT (splitmux,
       "All parts prepared. Total duration %" GST_TIME_FORMAT
       " Activating first part", GST_TIME_ARGS (total_duration));
+  SPLITMUX_SRC_LOCK (splitmux);
   ret = gst_splitmux_src_activate_part (splitmux, 0, GST_SEEK_FLAG_NONE);
+  SPLITMUX_SRC_UNLOCK (splitmux);
   if (ret == FALSE)
     goto failed_first_part;
 done:
@@ -734,6 +1069,7 @@ gst_splitmux_src_stop (GstSplitMuxSrc * splitmux)
   gboolean ret = TRUE;
   guint i;
   GList *cur, *pads_list;
+  GThreadPool *pool;
 
   SPLITMUX_SRC_LOCK (splitmux);
   if (!splitmux->running)
@@ -741,6 +1077,23 @@ gst_splitmux_src_stop (GstSplitMuxSrc * splitmux)
 
   GST_DEBUG_OBJECT (splitmux, "Stopping");
 
+  /* Let the part jobs run out, and wait for any part that is still
+   * being prepared from a pad task */
+  splitmux->running = FALSE;
+  g_cond_broadcast (&splitmux->part_cond);
+  pool = splitmux->part_pool;
+  splitmux->part_pool = NULL;
+  SPLITMUX_SRC_UNLOCK (splitmux);
+  if (pool != NULL)
+    g_thread_pool_free (pool, FALSE, TRUE);
+  SPLITMUX_SRC_LOCK (splitmux);
+
+  for (i = 0; i < splitmux->num_parts; i++) {
+    while (splitmux->part_states[i] == SPLITMUX_PART_PREPARING ||
+        splitmux->part_states[i] == SPLITMUX_PART_RELEASING)
+      g_cond_wait (&splitmux->part_cond, &splitmux->lock);
+  }
+
   /* Stop and destroy all parts  */
   for (i = 0; i < splitmux->num_parts; i++) {
     if (splitmux->parts[i] == NULL)
@@ -766,8 +1119,9 @@ gst_splitmux_src_stop (GstSplitMuxSrc * splitmux)
 
   g_free (splitmux->parts);
   splitmux->parts = NULL;
+  g_free (splitmux->part_states);
+  splitmux->part_states = NULL;
   splitmux->num_parts = 0;
-  splitmux->running = FALSE;
   splitmux->total_duration = GST_CLOCK_TIME_NONE;
   /* Reset playback segment */
   gst_segment_init (&splitmux->play_segment, GST_FORMAT_TIME);
@@ -977,6 +1331,9 @@ gst_splitmux_end_of_part (GstSplitMuxSrc * splitmux, SplitMuxSrcPad * splitpad)
   if (next_part != -1) {
     GST_DEBUG_OBJECT (splitmux, "At EOS on pad %" GST_PTR_FORMAT
         " moving to part %d", splitpad, next_part);
+    if (!gst_splitmux_src_ensure_part_prepared (splitmux, next_part))
+      goto error;
+
     splitpad->cur_part = next_part;
     splitpad->reader = splitmux->parts[splitpad->cur_part];
     if (splitpad->part_pad)
@@ -1004,6 +1361,7 @@ gst_splitmux_end_of_part (GstSplitMuxSrc * splitmux, SplitMuxSrcPad * splitpad)
           goto error;
       }
       splitmux->cur_part = next_part;
+      gst_splitmux_src_schedule_parts (splitmux, next_part);
     }
     res = TRUE;
   }
@@ -1011,9 +1369,13 @@ gst_splitmux_end_of_part (GstSplitMuxSrc * splitmux, SplitMuxSrcPad * splitpad)
   SPLITMUX_SRC_UNLOCK (splitmux);
   return res;
 error:
-  SPLITMUX_SRC_UNLOCK (splitmux);
-  GST_ELEMENT_ERROR (splitmux, RESOURCE, READ, (NULL),
-      ("Failed to activate part %d", splitmux->cur_part));
+  if (splitmux->running) {
+    SPLITMUX_SRC_UNLOCK (splitmux);
+    GST_ELEMENT_ERROR (splitmux, RESOURCE, READ, (NULL),
+        ("Failed to activate part %d", next_part));
+  } else {
+    SPLITMUX_SRC_UNLOCK (splitmux);
+  }
   return FALSE;
 }
 
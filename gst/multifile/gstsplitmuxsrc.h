@@ -39,6 +39,15 @@ G_BEGIN_DECLS
 typedef struct _GstSplitMuxSrc GstSplitMuxSrc;
 typedef struct _GstSplitMuxSrcClass GstSplitMuxSrcClass;
 
+typedef enum
+{
+  SPLITMUX_PART_UNPREPARED,
+  SPLITMUX_PART_PREPARING,
+  SPLITMUX_PART_PREPARED,
+  SPLITMUX_PART_RELEASING,
+  SPLITMUX_PART_FAILED
+} SplitMuxSrcPartState;
+
 struct _GstSplitMuxSrc
 {
   GstBin parent;
@@ -47,11 +56,19 @@ struct _GstSplitMuxSrc
   gboolean     running;
 
   gchar       *location;  /* OBJECT_LOCK */
+  gchar       *index_location;  /* OBJECT_LOCK */
+  guint        probe_threads;  /* OBJECT_LOCK */
 
   GstSplitMuxPartReader **parts;
   guint        num_parts;
   guint        cur_part;
 
+  /* Only parts around the playback position are kept prepared */
+  SplitMuxSrcPartState *part_states; /* lock */
+  GCond        part_cond;
+  GThreadPool *part_pool;
+  guint        pending_probes; /* lock */
+
   gboolean pads_complete;
   GMutex pads_lock;
   GList  *pads; /* pads_lock */
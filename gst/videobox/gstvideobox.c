@@ -46,6 +46,10 @@
  * If you use autocrop there is little point in setting the other
  * properties manually because they will be overriden if the caps change,
  * but nothing stops you from doing so.
+ *
+ * If only cropping is done, without format conversion, and downstream
+ * supports #GstVideoCropMeta, no copy is made. Instead the crop region is
+ * attached to the input buffers as metadata.
  * 
  * Sample pipeline:
  * |[
@@ -2419,6 +2423,10 @@ static GstCaps *gst_video_box_transform_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * from, GstCaps * filter);
 static void gst_video_box_before_transform (GstBaseTransform * trans,
     GstBuffer * in);
+static gboolean gst_video_box_decide_allocation (GstBaseTransform * trans,
+    GstQuery * query);
+static GstFlowReturn gst_video_box_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
 static gboolean gst_video_box_src_event (GstBaseTransform * trans,
     GstEvent * event);
 
@@ -2518,6 +2526,9 @@ gst_video_box_class_init (GstVideoBoxClass * klass)
   trans_class->transform_caps =
       GST_DEBUG_FUNCPTR (gst_video_box_transform_caps);
   trans_class->src_event = GST_DEBUG_FUNCPTR (gst_video_box_src_event);
+  trans_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_video_box_decide_allocation);
+  trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_video_box_transform_ip);
 
   vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_video_box_set_info);
   vfilter_class->transform_frame =
@@ -2984,11 +2995,50 @@ bail:
   }
 }
 
+/* Cropping can be done by only attaching a GstVideoCropMeta if nothing but
+ * the visible region of the picture changes */
+static gboolean
+gst_video_box_can_crop_meta (GstVideoBox * video_box)
+{
+  const GstVideoFormatInfo *finfo;
+  guint i;
+
+  if (video_box->in_format != video_box->out_format ||
+      video_box->in_sdtv != video_box->out_sdtv)
+    return FALSE;
+
+  if (video_box->border_left != 0 || video_box->border_right != 0 ||
+      video_box->border_top != 0 || video_box->border_bottom != 0)
+    return FALSE;
+
+  finfo = gst_video_format_get_info (video_box->in_format);
+  if (finfo == NULL)
+    return FALSE;
+
+  /* the copy functions apply the alpha property to the alpha channel */
+  if (GST_VIDEO_FORMAT_INFO_HAS_ALPHA (finfo))
+    return FALSE;
+
+  /* the crop origin must not split subsampled chroma */
+  for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); i++) {
+    if (video_box->crop_left % (1 << GST_VIDEO_FORMAT_INFO_W_SUB (finfo, i))
+        || video_box->crop_top % (1 << GST_VIDEO_FORMAT_INFO_H_SUB (finfo,
+                i)))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
 static gboolean
 gst_video_box_recalc_transform (GstVideoBox * video_box)
 {
   gboolean res = TRUE;
 
+  /* decide_allocation switches to in-place cropping with GstVideoCropMeta
+   * if downstream supports it, which happens after every (re)negotiation */
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM_CAST (video_box), FALSE);
+
   /* if we have the same format in and out and we don't need to perform any
    * cropping at all, we can just operate in passthrough mode */
   if (video_box->in_format == video_box->out_format &&
@@ -3317,6 +3367,69 @@ gst_video_box_before_transform (GstBaseTransform * trans, GstBuffer * in)
     gst_object_sync_values (GST_OBJECT (video_box), stream_time);
 }
 
+static gboolean
+gst_video_box_decide_allocation (GstBaseTransform * trans, GstQuery * query)
+{
+  GstVideoBox *video_box = GST_VIDEO_BOX (trans);
+
+  g_mutex_lock (&video_box->mutex);
+  video_box->use_crop_meta =
+      gst_query_find_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE,
+      NULL)
+      && gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  if (video_box->use_crop_meta && gst_video_box_can_crop_meta (video_box)) {
+    GST_DEBUG_OBJECT (video_box, "cropping in-place using GstVideoCropMeta");
+    gst_base_transform_set_in_place (trans, TRUE);
+  }
+  g_mutex_unlock (&video_box->mutex);
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->decide_allocation (trans,
+      query);
+}
+
+static GstFlowReturn
+gst_video_box_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstVideoBox *video_box = GST_VIDEO_BOX (trans);
+  GstVideoInfo *in_info = &GST_VIDEO_FILTER (trans)->in_info;
+  GstVideoCropMeta *crop_meta;
+
+  /* only used for cropping with GstVideoCropMeta, nothing to do in
+   * passthrough mode */
+  if (gst_base_transform_is_passthrough (trans))
+    return GST_FLOW_OK;
+
+  g_mutex_lock (&video_box->mutex);
+
+  /* the caps now describe the cropped size, so downstream needs to know
+   * the layout of the complete picture */
+  if (gst_buffer_get_video_meta (buf) == NULL) {
+    gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (in_info), GST_VIDEO_INFO_WIDTH (in_info),
+        GST_VIDEO_INFO_HEIGHT (in_info), GST_VIDEO_INFO_N_PLANES (in_info),
+        in_info->offset, in_info->stride);
+  }
+
+  crop_meta = gst_buffer_get_video_crop_meta (buf);
+  if (crop_meta == NULL) {
+    crop_meta = gst_buffer_add_video_crop_meta (buf);
+    crop_meta->x = 0;
+    crop_meta->y = 0;
+  }
+  crop_meta->x += video_box->crop_left;
+  crop_meta->y += video_box->crop_top;
+  crop_meta->width = video_box->out_width;
+  crop_meta->height = video_box->out_height;
+
+  GST_LOG_OBJECT (video_box, "cropped to %ux%u at %u,%u", crop_meta->width,
+      crop_meta->height, crop_meta->x, crop_meta->y);
+
+  g_mutex_unlock (&video_box->mutex);
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_video_box_transform_frame (GstVideoFilter * vfilter,
     GstVideoFrame * in_frame, GstVideoFrame * out_frame)
@@ -187,25 +187,33 @@ gst_gamma_get_property (GObject * object, guint prop_id, GValue * value,
   }
 }
 
-static void
-gst_gamma_calculate_tables (GstGamma * gamma)
+/* Also used by videobalance to fold gamma correction into its luma table */
+void
+gst_gamma_fill_table (guint8 table[256], gdouble gamma)
 {
   gint n;
   gdouble val;
   gdouble exp;
+
+  exp = 1.0 / gamma;
+  for (n = 0; n < 256; n++) {
+    val = n / 255.0;
+    val = pow (val, exp);
+    val = 255.0 * val;
+    table[n] = (guint8) floor (val + 0.5);
+  }
+}
+
+static void
+gst_gamma_calculate_tables (GstGamma * gamma)
+{
   gboolean passthrough = FALSE;
 
   GST_OBJECT_LOCK (gamma);
   if (gamma->gamma == 1.0) {
     passthrough = TRUE;
   } else {
-    exp = 1.0 / gamma->gamma;
-    for (n = 0; n < 256; n++) {
-      val = n / 255.0;
-      val = pow (val, exp);
-      val = 255.0 * val;
-      gamma->gamma_table[n] = (guint8) floor (val + 0.5);
-    }
+    gst_gamma_fill_table (gamma->gamma_table, gamma->gamma);
   }
   GST_OBJECT_UNLOCK (gamma);
 
@@ -70,6 +70,8 @@ struct _GstGammaClass
 
 GType gst_gamma_get_type(void);
 
+void gst_gamma_fill_table (guint8 table[256], gdouble gamma);
+
 G_END_DECLS
 
 #endif /* __GST_VIDEO_GAMMA_H__ */
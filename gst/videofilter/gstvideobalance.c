@@ -35,6 +35,16 @@
  * gst-launch-1.0 videotestsrc ! videobalance saturation=0.0 ! videoconvert ! ximagesink
  * ]| This pipeline converts the image to black and white by setting the
  * saturation to 0.0.
+ * |[
+ * gst-launch-1.0 videotestsrc ! videobalance gamma=2.0 contrast=1.2 ! videoconvert ! ximagesink
+ * ]| This pipeline applies gamma correction followed by a contrast change.
+ * The gamma curve is folded into the same lookup table as the other
+ * adjustments, so this produces the same result as
+ * "gamma gamma=2.0 ! videobalance contrast=1.2" for YUV formats with a
+ * single pass over the frame.
+ *
+ * When the combined adjustments leave every value unchanged the element
+ * operates in passthrough mode.
  * </refsect2>
  */
 
@@ -45,6 +55,7 @@
 #include <gst/math-compat.h>
 
 #include "gstvideobalance.h"
+#include "gstgamma.h"
 #include <string.h>
 
 #include <gst/video/colorbalance.h>
@@ -57,6 +68,7 @@ GST_DEBUG_CATEGORY_STATIC (videobalance_debug);
 #define DEFAULT_PROP_BRIGHTNESS		0.0
 #define DEFAULT_PROP_HUE		0.0
 #define DEFAULT_PROP_SATURATION		1.0
+#define DEFAULT_PROP_GAMMA		1.0
 
 enum
 {
@@ -64,7 +76,8 @@ enum
   PROP_CONTRAST,
   PROP_BRIGHTNESS,
   PROP_HUE,
-  PROP_SATURATION
+  PROP_SATURATION,
+  PROP_GAMMA
 };
 
 #define PROCESSING_CAPS \
@@ -110,10 +123,18 @@ gst_video_balance_update_tables (GstVideoBalance * vb)
 {
   gint i, j;
   gdouble y, u, v, hue_cos, hue_sin;
+  guint8 gamma_table[256];
+
+  /* Y, with the gamma correction applied before contrast and brightness */
+  if (vb->gamma != 1.0) {
+    gst_gamma_fill_table (gamma_table, vb->gamma);
+  } else {
+    for (i = 0; i < 256; i++)
+      gamma_table[i] = i;
+  }
 
-  /* Y */
   for (i = 0; i < 256; i++) {
-    y = 16 + ((i - 16) * vb->contrast + vb->brightness * 255);
+    y = 16 + ((gamma_table[i] - 16) * vb->contrast + vb->brightness * 255);
     if (y < 0)
       y = 0;
     else if (y > 255)
@@ -144,12 +165,35 @@ gst_video_balance_update_tables (GstVideoBalance * vb)
   }
 }
 
+/* Whether the tables map every value to itself, which can happen for
+ * non-default settings that are too small to change any value */
+static gboolean
+gst_video_balance_tables_are_identity (GstVideoBalance * vb)
+{
+  gint i, j;
+
+  for (i = 0; i < 256; i++) {
+    if (vb->tabley[i] != i)
+      return FALSE;
+  }
+
+  for (i = 0; i < 256; i++) {
+    for (j = 0; j < 256; j++) {
+      if (vb->tableu[i][j] != i || vb->tablev[i][j] != j)
+        return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 static gboolean
 gst_video_balance_is_passthrough (GstVideoBalance * videobalance)
 {
   return videobalance->contrast == 1.0 &&
       videobalance->brightness == 0.0 &&
-      videobalance->hue == 0.0 && videobalance->saturation == 1.0;
+      videobalance->hue == 0.0 && videobalance->saturation == 1.0 &&
+      videobalance->gamma == 1.0;
 }
 
 static void
@@ -160,8 +204,12 @@ gst_video_balance_update_properties (GstVideoBalance * videobalance)
 
   GST_OBJECT_LOCK (videobalance);
   passthrough = gst_video_balance_is_passthrough (videobalance);
-  if (!passthrough)
+  if (!passthrough) {
     gst_video_balance_update_tables (videobalance);
+    passthrough = gst_video_balance_tables_are_identity (videobalance);
+    if (passthrough)
+      GST_DEBUG_OBJECT (videobalance, "combined tables are the identity");
+  }
   GST_OBJECT_UNLOCK (videobalance);
 
   gst_base_transform_set_passthrough (base, passthrough);
@@ -592,6 +640,11 @@ gst_video_balance_class_init (GstVideoBalanceClass * klass)
       g_param_spec_double ("saturation", "Saturation", "saturation", 0.0, 2.0,
           DEFAULT_PROP_SATURATION,
           GST_PARAM_CONTROLLABLE | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_GAMMA,
+      g_param_spec_double ("gamma", "Gamma",
+          "Gamma correction applied before the other adjustments", 0.01, 10,
+          DEFAULT_PROP_GAMMA,
+          GST_PARAM_CONTROLLABLE | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class, "Video balance",
       "Filter/Effect/Video",
@@ -627,6 +680,7 @@ gst_video_balance_init (GstVideoBalance * videobalance)
   videobalance->brightness = DEFAULT_PROP_BRIGHTNESS;
   videobalance->hue = DEFAULT_PROP_HUE;
   videobalance->saturation = DEFAULT_PROP_SATURATION;
+  videobalance->gamma = DEFAULT_PROP_GAMMA;
 
   videobalance->tableu[0] = g_new (guint8, 256 * 256 * 2);
   for (i = 0; i < 256; i++) {
@@ -800,6 +854,12 @@ gst_video_balance_set_property (GObject * object, guint prop_id,
         label = "SATURATION";
       balance->saturation = d;
       break;
+    case PROP_GAMMA:
+      d = g_value_get_double (value);
+      GST_DEBUG_OBJECT (balance, "Changing gamma from %lf to %lf",
+          balance->gamma, d);
+      balance->gamma = d;
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -835,6 +895,9 @@ gst_video_balance_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_SATURATION:
       g_value_set_double (value, balance->saturation);
       break;
+    case PROP_GAMMA:
+      g_value_set_double (value, balance->gamma);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
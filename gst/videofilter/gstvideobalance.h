@@ -59,6 +59,7 @@ struct _GstVideoBalance {
   gdouble brightness;
   gdouble hue;
   gdouble saturation;
+  gdouble gamma;
 
   /* tables */
   guint8 tabley[256];
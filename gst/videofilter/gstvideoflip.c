@@ -53,11 +53,16 @@ enum
 {
   PROP_0,
   PROP_METHOD,
-  PROP_VIDEO_DIRECTION
+  PROP_VIDEO_DIRECTION,
+  PROP_N_THREADS
       /* FILL ME */
 };
 
 #define PROP_METHOD_DEFAULT GST_VIDEO_FLIP_METHOD_IDENTITY
+#define PROP_N_THREADS_DEFAULT 1
+
+/* Maximum number of slices a plane is split into for threaded processing */
+#define GST_VIDEO_FLIP_MAX_SLICES 16
 
 GST_DEBUG_CATEGORY_STATIC (video_flip_debug);
 #define GST_CAT_DEFAULT video_flip_debug
@@ -195,554 +200,265 @@ gst_video_flip_transform_caps (GstBaseTransform * trans,
   return ret;
 }
 
-static void
-gst_video_flip_planar_yuv (GstVideoFlip * videoflip, GstVideoFrame * dest,
-    const GstVideoFrame * src)
+/* Edge length of the square tiles the transposing methods are processed in.
+ * The source lines touched by one tile stay in the cache, instead of every
+ * destination pixel touching a new source line */
+#define TILE_SIZE 32
+
+typedef struct
 {
-  gint x, y;
-  guint8 const *s;
-  guint8 *d;
-  gint src_y_stride, src_u_stride, src_v_stride;
-  gint src_y_height, src_u_height, src_v_height;
-  gint src_y_width, src_u_width, src_v_width;
-  gint dest_y_stride, dest_u_stride, dest_v_stride;
-  gint dest_y_height, dest_u_height, dest_v_height;
-  gint dest_y_width, dest_u_width, dest_v_width;
+  guint8 v[1];
+} FlipPixel1;
 
-  src_y_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 0);
-  src_u_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 1);
-  src_v_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 2);
+typedef struct
+{
+  guint8 v[2];
+} FlipPixel2;
 
-  dest_y_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, 0);
-  dest_u_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, 1);
-  dest_v_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, 2);
+typedef struct
+{
+  guint8 v[3];
+} FlipPixel3;
 
-  src_y_width = GST_VIDEO_FRAME_COMP_WIDTH (src, 0);
-  src_u_width = GST_VIDEO_FRAME_COMP_WIDTH (src, 1);
-  src_v_width = GST_VIDEO_FRAME_COMP_WIDTH (src, 2);
+typedef struct
+{
+  guint8 v[4];
+} FlipPixel4;
+
+typedef void (*FlipPlaneFunc) (guint8 * d, gint d_stride, const guint8 * s,
+    gint s_stride, gint dw, gint y_start, gint y_end, gint sw, gint sh,
+    gboolean flip_rows, gboolean flip_cols);
+
+/* Destination line y is taken from source column y (or sw - 1 - y if
+ * flip_cols) and destination column x from source line x (or sh - 1 - x if
+ * flip_rows) */
+#define FLIP_PLANE_TRANSPOSE(bpp) \
+static void \
+flip_plane_transpose_##bpp (guint8 * d, gint d_stride, const guint8 * s, \
+    gint s_stride, gint dw, gint y_start, gint y_end, gint sw, gint sh, \
+    gboolean flip_rows, gboolean flip_cols) \
+{ \
+  gint x, y, tx, ty, x_end, y_tile_end; \
+  gint s_step = flip_rows ? -s_stride : s_stride; \
+  \
+  for (ty = y_start; ty < y_end; ty += TILE_SIZE) { \
+    y_tile_end = MIN (ty + TILE_SIZE, y_end); \
+    for (tx = 0; tx < dw; tx += TILE_SIZE) { \
+      x_end = MIN (tx + TILE_SIZE, dw); \
+      for (y = ty; y < y_tile_end; y++) { \
+        FlipPixel##bpp *dp = (FlipPixel##bpp *) (d + y * d_stride); \
+        const guint8 *sp = s + (flip_cols ? sw - 1 - y : y) * bpp + \
+            (flip_rows ? sh - 1 - tx : tx) * s_stride; \
+        \
+        for (x = tx; x < x_end; x++) { \
+          dp[x] = *(const FlipPixel##bpp *) sp; \
+          sp += s_step; \
+        } \
+      } \
+    } \
+  } \
+}
 
-  dest_y_width = GST_VIDEO_FRAME_COMP_WIDTH (dest, 0);
-  dest_u_width = GST_VIDEO_FRAME_COMP_WIDTH (dest, 1);
-  dest_v_width = GST_VIDEO_FRAME_COMP_WIDTH (dest, 2);
+/* Destination line y is taken from source line y (or sh - 1 - y if
+ * flip_rows), optionally mirrored */
+#define FLIP_PLANE_MIRROR(bpp) \
+static void \
+flip_plane_mirror_##bpp (guint8 * d, gint d_stride, const guint8 * s, \
+    gint s_stride, gint dw, gint y_start, gint y_end, gint sw, gint sh, \
+    gboolean flip_rows, gboolean flip_cols) \
+{ \
+  gint x, y; \
+  \
+  for (y = y_start; y < y_end; y++) { \
+    FlipPixel##bpp *dp = (FlipPixel##bpp *) (d + y * d_stride); \
+    const FlipPixel##bpp *sp = (const FlipPixel##bpp *) (s + \
+        (flip_rows ? sh - 1 - y : y) * s_stride); \
+    \
+    if (flip_cols) { \
+      for (x = 0; x < dw; x++) \
+        dp[x] = sp[sw - 1 - x]; \
+    } else { \
+      memcpy (dp, sp, dw * bpp); \
+    } \
+  } \
+}
 
-  src_y_height = GST_VIDEO_FRAME_COMP_HEIGHT (src, 0);
-  src_u_height = GST_VIDEO_FRAME_COMP_HEIGHT (src, 1);
-  src_v_height = GST_VIDEO_FRAME_COMP_HEIGHT (src, 2);
+FLIP_PLANE_TRANSPOSE (1);
+FLIP_PLANE_TRANSPOSE (2);
+FLIP_PLANE_TRANSPOSE (3);
+FLIP_PLANE_TRANSPOSE (4);
+FLIP_PLANE_MIRROR (1);
+FLIP_PLANE_MIRROR (2);
+FLIP_PLANE_MIRROR (3);
+FLIP_PLANE_MIRROR (4);
+
+static const FlipPlaneFunc flip_plane_transpose[] = {
+  flip_plane_transpose_1, flip_plane_transpose_2,
+  flip_plane_transpose_3, flip_plane_transpose_4
+};
 
-  dest_y_height = GST_VIDEO_FRAME_COMP_HEIGHT (dest, 0);
-  dest_u_height = GST_VIDEO_FRAME_COMP_HEIGHT (dest, 1);
-  dest_v_height = GST_VIDEO_FRAME_COMP_HEIGHT (dest, 2);
+static const FlipPlaneFunc flip_plane_mirror[] = {
+  flip_plane_mirror_1, flip_plane_mirror_2,
+  flip_plane_mirror_3, flip_plane_mirror_4
+};
 
-  switch (videoflip->active_method) {
-    case GST_VIDEO_ORIENTATION_90R:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - x) * src_y_stride + y];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] =
-              s[(src_u_height - 1 - x) * src_u_stride + y];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_v_height; y++) {
-        for (x = 0; x < dest_v_width; x++) {
-          d[y * dest_v_stride + x] =
-              s[(src_v_height - 1 - x) * src_v_stride + y];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_90L:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[x * src_y_stride + (src_y_width - 1 - y)];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] =
-              s[x * src_u_stride + (src_u_width - 1 - y)];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_v_height; y++) {
-        for (x = 0; x < dest_v_width; x++) {
-          d[y * dest_v_stride + x] =
-              s[x * src_v_stride + (src_v_width - 1 - y)];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_180:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - y) * src_y_stride + (src_y_width - 1 - x)];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] =
-              s[(src_u_height - 1 - y) * src_u_stride + (src_u_width - 1 - x)];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_v_height; y++) {
-        for (x = 0; x < dest_v_width; x++) {
-          d[y * dest_v_stride + x] =
-              s[(src_v_height - 1 - y) * src_v_stride + (src_v_width - 1 - x)];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_HORIZ:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[y * src_y_stride + (src_y_width - 1 - x)];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] =
-              s[y * src_u_stride + (src_u_width - 1 - x)];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_v_height; y++) {
-        for (x = 0; x < dest_v_width; x++) {
-          d[y * dest_v_stride + x] =
-              s[y * src_v_stride + (src_v_width - 1 - x)];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_VERT:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - y) * src_y_stride + x];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] =
-              s[(src_u_height - 1 - y) * src_u_stride + x];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_v_height; y++) {
-        for (x = 0; x < dest_v_width; x++) {
-          d[y * dest_v_stride + x] =
-              s[(src_v_height - 1 - y) * src_v_stride + x];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_UL_LR:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] = s[x * src_y_stride + y];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] = s[x * src_u_stride + y];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_v_stride + x] = s[x * src_v_stride + y];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_UR_LL:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - x) * src_y_stride + (src_y_width - 1 - y)];
-        }
-      }
-      /* Flip U */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_u_height; y++) {
-        for (x = 0; x < dest_u_width; x++) {
-          d[y * dest_u_stride + x] =
-              s[(src_u_height - 1 - x) * src_u_stride + (src_u_width - 1 - y)];
-        }
-      }
-      /* Flip V */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 2);
-      for (y = 0; y < dest_v_height; y++) {
-        for (x = 0; x < dest_v_width; x++) {
-          d[y * dest_v_stride + x] =
-              s[(src_v_height - 1 - x) * src_v_stride + (src_v_width - 1 - y)];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_IDENTITY:
-      g_assert_not_reached ();
-      break;
-    default:
-      g_assert_not_reached ();
-      break;
+typedef struct
+{
+  FlipPlaneFunc func;
+  guint8 *d;
+  gint d_stride;
+  const guint8 *s;
+  gint s_stride;
+  gint dw;
+  gint y_start, y_end;
+  gint sw, sh;
+  gboolean flip_rows, flip_cols;
+} GstVideoFlipTask;
+
+static void
+gst_video_flip_run_task (gpointer data, gpointer user_data)
+{
+  GstVideoFlipTask *task = data;
+  GstVideoFlip *videoflip = user_data;
+
+  task->func (task->d, task->d_stride, task->s, task->s_stride, task->dw,
+      task->y_start, task->y_end, task->sw, task->sh, task->flip_rows,
+      task->flip_cols);
+
+  if (videoflip) {
+    g_mutex_lock (&videoflip->task_lock);
+    if (--videoflip->tasks_pending == 0)
+      g_cond_signal (&videoflip->task_cond);
+    g_mutex_unlock (&videoflip->task_lock);
   }
 }
 
+/* Handles all formats where every plane consists of pixels of up to 4 bytes
+ * that can be moved as a whole, i.e. planar, semi-planar and non-subsampled
+ * packed formats */
 static void
-gst_video_flip_semi_planar_yuv (GstVideoFlip * videoflip, GstVideoFrame * dest,
+gst_video_flip_planes (GstVideoFlip * videoflip, GstVideoFrame * dest,
     const GstVideoFrame * src)
 {
-  gint x, y;
-  guint8 const *s;
-  guint8 *d;
-  gint s_off, d_off;
-  gint src_y_stride, src_uv_stride;
-  gint src_y_height, src_uv_height;
-  gint src_y_width, src_uv_width;
-  gint dest_y_stride, dest_uv_stride;
-  gint dest_y_height, dest_uv_height;
-  gint dest_y_width, dest_uv_width;
-
-
-  src_y_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 0);
-  src_uv_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 1);
-
-  dest_y_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, 0);
-  dest_uv_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, 1);
-
-  src_y_width = GST_VIDEO_FRAME_COMP_WIDTH (src, 0);
-  src_uv_width = GST_VIDEO_FRAME_COMP_WIDTH (src, 1);
-
-  dest_y_width = GST_VIDEO_FRAME_COMP_WIDTH (dest, 0);
-  dest_uv_width = GST_VIDEO_FRAME_COMP_WIDTH (dest, 1);
-
-  src_y_height = GST_VIDEO_FRAME_COMP_HEIGHT (src, 0);
-  src_uv_height = GST_VIDEO_FRAME_COMP_HEIGHT (src, 1);
-
-  dest_y_height = GST_VIDEO_FRAME_COMP_HEIGHT (dest, 0);
-  dest_uv_height = GST_VIDEO_FRAME_COMP_HEIGHT (dest, 1);
+  const GstVideoFormatInfo *finfo = dest->info.finfo;
+  GstVideoFlipTask tasks[GST_VIDEO_MAX_PLANES * GST_VIDEO_FLIP_MAX_SLICES];
+  gboolean transpose, flip_rows, flip_cols;
+  guint n_tasks = 0, n_slices, n_planes, i, j;
+  gint plane_comp[GST_VIDEO_MAX_PLANES];
 
   switch (videoflip->active_method) {
     case GST_VIDEO_ORIENTATION_90R:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - x) * src_y_stride + y];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = (src_uv_height - 1 - x) * src_uv_stride + y * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
+      transpose = TRUE;
+      flip_rows = TRUE;
+      flip_cols = FALSE;
       break;
     case GST_VIDEO_ORIENTATION_90L:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[x * src_y_stride + (src_y_width - 1 - y)];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = x * src_uv_stride + (src_uv_width - 1 - y) * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
+      transpose = TRUE;
+      flip_rows = FALSE;
+      flip_cols = TRUE;
+      break;
+    case GST_VIDEO_ORIENTATION_UL_LR:
+      transpose = TRUE;
+      flip_rows = FALSE;
+      flip_cols = FALSE;
+      break;
+    case GST_VIDEO_ORIENTATION_UR_LL:
+      transpose = TRUE;
+      flip_rows = TRUE;
+      flip_cols = TRUE;
       break;
     case GST_VIDEO_ORIENTATION_180:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - y) * src_y_stride + (src_y_width - 1 - x)];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = (src_uv_height - 1 - y) * src_uv_stride + (src_uv_width - 1 -
-              x) * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
+      transpose = FALSE;
+      flip_rows = TRUE;
+      flip_cols = TRUE;
       break;
     case GST_VIDEO_ORIENTATION_HORIZ:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[y * src_y_stride + (src_y_width - 1 - x)];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = y * src_uv_stride + (src_uv_width - 1 - x) * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
+      transpose = FALSE;
+      flip_rows = FALSE;
+      flip_cols = TRUE;
       break;
     case GST_VIDEO_ORIENTATION_VERT:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - y) * src_y_stride + x];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = (src_uv_height - 1 - y) * src_uv_stride + x * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_UL_LR:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] = s[x * src_y_stride + y];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = x * src_uv_stride + y * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_UR_LL:
-      /* Flip Y */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
-      for (y = 0; y < dest_y_height; y++) {
-        for (x = 0; x < dest_y_width; x++) {
-          d[y * dest_y_stride + x] =
-              s[(src_y_height - 1 - x) * src_y_stride + (src_y_width - 1 - y)];
-        }
-      }
-      /* Flip UV */
-      s = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
-      d = GST_VIDEO_FRAME_PLANE_DATA (dest, 1);
-      for (y = 0; y < dest_uv_height; y++) {
-        for (x = 0; x < dest_uv_width; x++) {
-          d_off = y * dest_uv_stride + x * 2;
-          s_off = (src_uv_height - 1 - x) * src_uv_stride + (src_uv_width - 1 -
-              y) * 2;
-          d[d_off] = s[s_off];
-          d[d_off + 1] = s[s_off + 1];
-        }
-      }
+      transpose = FALSE;
+      flip_rows = TRUE;
+      flip_cols = FALSE;
       break;
     case GST_VIDEO_ORIENTATION_IDENTITY:
-      g_assert_not_reached ();
-      break;
     default:
       g_assert_not_reached ();
-      break;
+      return;
   }
-}
 
-static void
-gst_video_flip_packed_simple (GstVideoFlip * videoflip, GstVideoFrame * dest,
-    const GstVideoFrame * src)
-{
-  gint x, y, z;
-  guint8 const *s;
-  guint8 *d;
-  gint sw = GST_VIDEO_FRAME_WIDTH (src);
-  gint sh = GST_VIDEO_FRAME_HEIGHT (src);
-  gint dw = GST_VIDEO_FRAME_WIDTH (dest);
-  gint dh = GST_VIDEO_FRAME_HEIGHT (dest);
-  gint src_stride, dest_stride;
-  gint bpp;
+  /* the first component of each plane describes its pixels */
+  n_planes = GST_VIDEO_FRAME_N_PLANES (dest);
+  for (i = 0; i < n_planes; i++)
+    plane_comp[i] = -1;
+  for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); i++) {
+    j = GST_VIDEO_FORMAT_INFO_PLANE (finfo, i);
+    if (plane_comp[j] == -1)
+      plane_comp[j] = i;
+  }
 
-  s = GST_VIDEO_FRAME_PLANE_DATA (src, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dest, 0);
+  n_slices = videoflip->n_threads;
+  if (n_slices == 0)
+    n_slices = g_get_num_processors ();
+  n_slices = CLAMP (n_slices, 1, GST_VIDEO_FLIP_MAX_SLICES);
+
+  for (i = 0; i < n_planes; i++) {
+    gint comp = plane_comp[i];
+    gint dh = GST_VIDEO_FRAME_COMP_HEIGHT (dest, comp);
+    gint bpp = GST_VIDEO_FRAME_COMP_PSTRIDE (src, comp);
+    gint lines;
+
+    g_assert (bpp >= 1 && bpp <= 4);
+
+    lines = (dh + n_slices - 1) / n_slices;
+    if (transpose)
+      lines = GST_ROUND_UP_N (lines, TILE_SIZE);
+
+    for (j = 0; j * lines < dh; j++) {
+      GstVideoFlipTask *task = &tasks[n_tasks++];
+
+      task->func = transpose ? flip_plane_transpose[bpp - 1] :
+          flip_plane_mirror[bpp - 1];
+      task->d = GST_VIDEO_FRAME_PLANE_DATA (dest, i);
+      task->d_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, i);
+      task->s = GST_VIDEO_FRAME_PLANE_DATA (src, i);
+      task->s_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, i);
+      task->dw = GST_VIDEO_FRAME_COMP_WIDTH (dest, comp);
+      task->y_start = j * lines;
+      task->y_end = MIN ((j + 1) * lines, dh);
+      task->sw = GST_VIDEO_FRAME_COMP_WIDTH (src, comp);
+      task->sh = GST_VIDEO_FRAME_COMP_HEIGHT (src, comp);
+      task->flip_rows = flip_rows;
+      task->flip_cols = flip_cols;
+    }
+  }
 
-  src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 0);
-  dest_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, 0);
-  /* This is only true for non-subsampled formats! */
-  bpp = GST_VIDEO_FRAME_COMP_PSTRIDE (src, 0);
+  if (n_slices == 1 || n_tasks == 1) {
+    for (i = 0; i < n_tasks; i++)
+      gst_video_flip_run_task (&tasks[i], NULL);
+    return;
+  }
 
-  switch (videoflip->active_method) {
-    case GST_VIDEO_ORIENTATION_90R:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] =
-                s[(sh - 1 - x) * src_stride + y * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_90L:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] =
-                s[x * src_stride + (sw - 1 - y) * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_180:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] =
-                s[(sh - 1 - y) * src_stride + (sw - 1 - x) * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_HORIZ:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] =
-                s[y * src_stride + (sw - 1 - x) * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_VERT:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] =
-                s[(sh - 1 - y) * src_stride + x * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_UL_LR:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] = s[x * src_stride + y * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_UR_LL:
-      for (y = 0; y < dh; y++) {
-        for (x = 0; x < dw; x++) {
-          for (z = 0; z < bpp; z++) {
-            d[y * dest_stride + x * bpp + z] =
-                s[(sh - 1 - x) * src_stride + (sw - 1 - y) * bpp + z];
-          }
-        }
-      }
-      break;
-    case GST_VIDEO_ORIENTATION_IDENTITY:
-      g_assert_not_reached ();
-      break;
-    default:
-      g_assert_not_reached ();
-      break;
+  if (videoflip->pool == NULL) {
+    videoflip->pool = g_thread_pool_new (gst_video_flip_run_task, videoflip,
+        n_slices - 1, FALSE, NULL);
+  } else if (g_thread_pool_get_max_threads (videoflip->pool) < n_slices - 1) {
+    g_thread_pool_set_max_threads (videoflip->pool, n_slices - 1, NULL);
   }
-}
 
+  videoflip->tasks_pending = n_tasks - 1;
+  for (i = 1; i < n_tasks; i++)
+    g_thread_pool_push (videoflip->pool, &tasks[i], NULL);
+
+  /* the streaming thread takes part in the work too */
+  gst_video_flip_run_task (&tasks[0], NULL);
+
+  g_mutex_lock (&videoflip->task_lock);
+  while (videoflip->tasks_pending > 0)
+    g_cond_wait (&videoflip->task_cond, &videoflip->task_lock);
+  g_mutex_unlock (&videoflip->task_lock);
+}
 
 static void
 gst_video_flip_y422 (GstVideoFlip * videoflip, GstVideoFrame * dest,
@@ -1011,13 +727,8 @@ gst_video_flip_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
     case GST_VIDEO_FORMAT_I420:
     case GST_VIDEO_FORMAT_YV12:
     case GST_VIDEO_FORMAT_Y444:
-      vf->process = gst_video_flip_planar_yuv;
-      break;
-    case GST_VIDEO_FORMAT_YUY2:
-    case GST_VIDEO_FORMAT_UYVY:
-    case GST_VIDEO_FORMAT_YVYU:
-      vf->process = gst_video_flip_y422;
-      break;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV21:
     case GST_VIDEO_FORMAT_AYUV:
     case GST_VIDEO_FORMAT_ARGB:
     case GST_VIDEO_FORMAT_ABGR:
@@ -1032,11 +743,12 @@ gst_video_flip_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
     case GST_VIDEO_FORMAT_GRAY8:
     case GST_VIDEO_FORMAT_GRAY16_BE:
     case GST_VIDEO_FORMAT_GRAY16_LE:
-      vf->process = gst_video_flip_packed_simple;
+      vf->process = gst_video_flip_planes;
       break;
-    case GST_VIDEO_FORMAT_NV12:
-    case GST_VIDEO_FORMAT_NV21:
-      vf->process = gst_video_flip_semi_planar_yuv;
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+    case GST_VIDEO_FORMAT_YVYU:
+      vf->process = gst_video_flip_y422;
       break;
     default:
       break;
@@ -1271,6 +983,11 @@ gst_video_flip_set_property (GObject * object, guint prop_id,
     case PROP_VIDEO_DIRECTION:
       gst_video_flip_set_method (videoflip, g_value_get_enum (value), FALSE);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (videoflip);
+      videoflip->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (videoflip);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1288,12 +1005,30 @@ gst_video_flip_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_VIDEO_DIRECTION:
       g_value_set_enum (value, videoflip->method);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (videoflip);
+      g_value_set_uint (value, videoflip->n_threads);
+      GST_OBJECT_UNLOCK (videoflip);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+gst_video_flip_finalize (GObject * object)
+{
+  GstVideoFlip *videoflip = GST_VIDEO_FLIP (object);
+
+  if (videoflip->pool)
+    g_thread_pool_free (videoflip->pool, FALSE, TRUE);
+  g_mutex_clear (&videoflip->task_lock);
+  g_cond_clear (&videoflip->task_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_video_flip_class_init (GstVideoFlipClass * klass)
 {
@@ -1306,6 +1041,7 @@ gst_video_flip_class_init (GstVideoFlipClass * klass)
 
   gobject_class->set_property = gst_video_flip_set_property;
   gobject_class->get_property = gst_video_flip_get_property;
+  gobject_class->finalize = gst_video_flip_finalize;
 
   g_object_class_install_property (gobject_class, PROP_METHOD,
       g_param_spec_enum ("method", "method",
@@ -1315,6 +1051,11 @@ gst_video_flip_class_init (GstVideoFlipClass * klass)
           G_PARAM_STATIC_STRINGS));
   g_object_class_override_property (gobject_class, PROP_VIDEO_DIRECTION,
       "video-direction");
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Threads",
+          "Maximum number of threads to use (0 = number of CPUs)", 0,
+          GST_VIDEO_FLIP_MAX_SLICES, PROP_N_THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class, "Video flipper",
       "Filter/Effect/Video",
@@ -1343,4 +1084,8 @@ gst_video_flip_init (GstVideoFlip * videoflip)
   /* AUTO is not valid for active method, this is just to ensure we setup the
    * method in gst_video_flip_set_method() */
   videoflip->active_method = GST_VIDEO_ORIENTATION_AUTO;
+  videoflip->n_threads = PROP_N_THREADS_DEFAULT;
+
+  g_mutex_init (&videoflip->task_lock);
+  g_cond_init (&videoflip->task_cond);
 }
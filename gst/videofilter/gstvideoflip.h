@@ -79,6 +79,12 @@ struct _GstVideoFlip {
   GstVideoOrientationMethod tag_method;
   GstVideoOrientationMethod active_method;
   void (*process) (GstVideoFlip *videoflip, GstVideoFrame *dest, const GstVideoFrame *src);
+
+  guint n_threads;
+  GThreadPool *pool;
+  GMutex task_lock;
+  GCond task_cond;
+  guint tasks_pending;
 };
 
 struct _GstVideoFlipClass {
@@ -59,6 +59,8 @@ enum
 static const GEnumValue video_median_sizes[] = {
   {GST_VIDEO_MEDIAN_SIZE_5, "Median of 5 neighbour pixels", "5"},
   {GST_VIDEO_MEDIAN_SIZE_9, "Median of 9 neighbour pixels", "9"},
+  {GST_VIDEO_MEDIAN_SIZE_25, "Median of 5x5 neighbour pixels", "25"},
+  {GST_VIDEO_MEDIAN_SIZE_49, "Median of 7x7 neighbour pixels", "49"},
   {0, NULL, NULL},
 };
 
@@ -80,6 +82,11 @@ G_DEFINE_TYPE (GstVideoMedian, gst_video_median, GST_TYPE_VIDEO_FILTER);
 static GstFlowReturn gst_video_median_transform_frame (GstVideoFilter * filter,
     GstVideoFrame * in_frame, GstVideoFrame * out_frame);
 
+static gboolean gst_video_median_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static void gst_video_median_finalize (GObject * object);
+
 static void gst_video_median_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_video_median_get_property (GObject * object, guint prop_id,
@@ -98,6 +105,7 @@ gst_video_median_class_init (GstVideoMedianClass * klass)
 
   gobject_class->set_property = gst_video_median_set_property;
   gobject_class->get_property = gst_video_median_get_property;
+  gobject_class->finalize = gst_video_median_finalize;
 
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_FILTERSIZE,
       g_param_spec_enum ("filtersize", "Filtersize", "The size of the filter",
@@ -117,6 +125,7 @@ gst_video_median_class_init (GstVideoMedianClass * klass)
       "Filter/Effect/Video", "Apply a median filter to an image",
       "Wim Taymans <wim.taymans@gmail.com>");
 
+  vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_video_median_set_info);
   vfilter_class->transform_frame =
       GST_DEBUG_FUNCPTR (gst_video_median_transform_frame);
 }
@@ -128,15 +137,17 @@ gst_video_median_init (GstVideoMedian * median)
   median->lum_only = DEFAULT_LUM_ONLY;
 }
 
-#define PIX_SORT(a,b) { if ((a)>(b)) PIX_SWAP((a),(b)); }
-#define PIX_SWAP(a,b) { unsigned char temp=(a);(a)=(b);(b)=temp; }
+/* Branchless compare-and-swap, so that the compiler can vectorize the loops
+ * over a line below */
+#define PIX_SORT(a,b) \
+  { guint8 temp = MIN ((a), (b)); (b) = MAX ((a), (b)); (a) = temp; }
 
 static void
 median_5 (guint8 * dest, gint dstride, const guint8 * src, gint sstride,
     gint width, gint height)
 {
-  unsigned char p[5];
-  int i, j, k;
+  guint8 p0, p1, p2, p3, p4;
+  gint i, k;
 
   /* copy the top and bottom rows into the result array */
   for (i = 0; i < width; i++) {
@@ -146,26 +157,34 @@ median_5 (guint8 * dest, gint dstride, const guint8 * src, gint sstride,
 
   /* process the interior pixels */
   for (k = 2; k < height; k++) {
+    const guint8 *up, *mid, *down;
+    guint8 *d;
+
     dest += dstride;
     src += sstride;
 
-    dest[0] = src[0];
-    for (j = 2, i = 1; j < width; j++, i++) {
-      p[0] = src[i - sstride];
-      p[1] = src[i - 1];
-      p[2] = src[i];
-      p[3] = src[i + 1];
-      p[4] = src[i + sstride];
-      PIX_SORT (p[0], p[1]);
-      PIX_SORT (p[3], p[4]);
-      PIX_SORT (p[0], p[3]);
-      PIX_SORT (p[1], p[4]);
-      PIX_SORT (p[1], p[2]);
-      PIX_SORT (p[2], p[3]);
-      PIX_SORT (p[1], p[2]);
-      dest[i] = p[2];
+    up = src - sstride;
+    mid = src;
+    down = src + sstride;
+    d = dest;
+
+    d[0] = mid[0];
+    for (i = 1; i < width - 1; i++) {
+      p0 = up[i];
+      p1 = mid[i - 1];
+      p2 = mid[i];
+      p3 = mid[i + 1];
+      p4 = down[i];
+      PIX_SORT (p0, p1);
+      PIX_SORT (p3, p4);
+      PIX_SORT (p0, p3);
+      PIX_SORT (p1, p4);
+      PIX_SORT (p1, p2);
+      PIX_SORT (p2, p3);
+      PIX_SORT (p1, p2);
+      d[i] = p2;
     }
-    dest[i] = src[i];
+    d[i] = mid[i];
   }
 }
 
@@ -173,8 +192,8 @@ static void
 median_9 (guint8 * dest, gint dstride, const guint8 * src, gint sstride,
     gint width, gint height)
 {
-  unsigned char p[9];
-  int i, j, k;
+  guint8 p0, p1, p2, p3, p4, p5, p6, p7, p8;
+  gint i, k;
 
   /*copy the top and bottom rows into the result array */
   for (i = 0; i < width; i++) {
@@ -183,99 +202,247 @@ median_9 (guint8 * dest, gint dstride, const guint8 * src, gint sstride,
   }
   /* process the interior pixels */
   for (k = 2; k < height; k++) {
+    const guint8 *up, *mid, *down;
+    guint8 *d;
+
     dest += dstride;
     src += sstride;
 
-    dest[0] = src[0];
-    for (j = 2, i = 1; j < width; j++, i++) {
-      p[0] = src[i - sstride - 1];
-      p[1] = src[i - sstride];
-      p[2] = src[i - sstride + 1];
-      p[3] = src[i - 1];
-      p[4] = src[i];
-      p[5] = src[i + 1];
-      p[6] = src[i + sstride - 1];
-      p[7] = src[i + sstride];
-      p[8] = src[i + sstride + 1];
-      PIX_SORT (p[1], p[2]);
-      PIX_SORT (p[4], p[5]);
-      PIX_SORT (p[7], p[8]);
-      PIX_SORT (p[0], p[1]);
-      PIX_SORT (p[3], p[4]);
-      PIX_SORT (p[6], p[7]);
-      PIX_SORT (p[1], p[2]);
-      PIX_SORT (p[4], p[5]);
-      PIX_SORT (p[7], p[8]);
-      PIX_SORT (p[0], p[3]);
-      PIX_SORT (p[5], p[8]);
-      PIX_SORT (p[4], p[7]);
-      PIX_SORT (p[3], p[6]);
-      PIX_SORT (p[1], p[4]);
-      PIX_SORT (p[2], p[5]);
-      PIX_SORT (p[4], p[7]);
-      PIX_SORT (p[4], p[2]);
-      PIX_SORT (p[6], p[4]);
-      PIX_SORT (p[4], p[2]);
-      dest[i] = p[4];
+    up = src - sstride;
+    mid = src;
+    down = src + sstride;
+    d = dest;
+
+    d[0] = mid[0];
+    for (i = 1; i < width - 1; i++) {
+      p0 = up[i - 1];
+      p1 = up[i];
+      p2 = up[i + 1];
+      p3 = mid[i - 1];
+      p4 = mid[i];
+      p5 = mid[i + 1];
+      p6 = down[i - 1];
+      p7 = down[i];
+      p8 = down[i + 1];
+      PIX_SORT (p1, p2);
+      PIX_SORT (p4, p5);
+      PIX_SORT (p7, p8);
+      PIX_SORT (p0, p1);
+      PIX_SORT (p3, p4);
+      PIX_SORT (p6, p7);
+      PIX_SORT (p1, p2);
+      PIX_SORT (p4, p5);
+      PIX_SORT (p7, p8);
+      PIX_SORT (p0, p3);
+      PIX_SORT (p5, p8);
+      PIX_SORT (p4, p7);
+      PIX_SORT (p3, p6);
+      PIX_SORT (p1, p4);
+      PIX_SORT (p2, p5);
+      PIX_SORT (p4, p7);
+      PIX_SORT (p4, p2);
+      PIX_SORT (p6, p4);
+      PIX_SORT (p4, p2);
+      d[i] = p4;
     }
-    dest[i] = src[i];
+    d[i] = mid[i];
+  }
+}
+
+/* Histograms for the box medians have 256 fine bins and 16 coarse bins
+ * holding the sum of 16 fine bins each. Counts never exceed 7x7 so they
+ * fit in 8 bits */
+#define FINE_BINS   256
+#define COARSE_BINS 16
+#define FINE_PER_COARSE (FINE_BINS / COARSE_BINS)
+
+/* Constant time median over a (2 * radius + 1) square box: every column
+ * keeps a histogram of the pixels of the box height around the current
+ * line, and the box histogram is moved along the line by adding the
+ * column entering on the right and removing the one leaving on the left.
+ *
+ * Only the coarse bins of the box are updated for every pixel. The 16 fine
+ * bins below a coarse bin are brought up to date when the median falls
+ * into it, either incrementally from the column they were last updated
+ * for or, if that is a whole box away, from scratch. Neighbouring pixels
+ * mostly hit the same coarse bin, so the cost per pixel does not depend
+ * on the radius. Pixels closer than radius to the border are copied like
+ * for the other sizes */
+static void
+median_box (guint8 * dest, gint dstride, const guint8 * src, gint sstride,
+    gint width, gint height, gint radius, guint8 * col_fine,
+    guint8 * col_coarse)
+{
+  gint size = 2 * radius + 1;
+  gint rank = size * size / 2;
+  guint8 fine[FINE_BINS], coarse[COARSE_BINS];
+  /* the fine bins of a coarse bin cover the columns up to this one */
+  gint fine_end[COARSE_BINS];
+  const guint8 *s;
+  guint8 *d;
+  gint x, y, i, b, c, v, sum;
+
+  if (width < size || height < size) {
+    for (y = 0; y < height; y++)
+      memcpy (dest + y * dstride, src + y * sstride, width);
+    return;
+  }
+
+  /* copy the top and bottom rows into the result array */
+  for (y = 0; y < radius; y++) {
+    memcpy (dest + y * dstride, src + y * sstride, width);
+    memcpy (dest + (height - 1 - y) * dstride,
+        src + (height - 1 - y) * sstride, width);
+  }
+
+  memset (col_fine, 0, width * FINE_BINS);
+  memset (col_coarse, 0, width * COARSE_BINS);
+
+  for (y = 0; y < size - 1; y++) {
+    s = src + y * sstride;
+    for (x = 0; x < width; x++) {
+      col_fine[x * FINE_BINS + s[x]]++;
+      col_coarse[x * COARSE_BINS + (s[x] >> 4)]++;
+    }
+  }
+
+  for (y = radius; y < height - radius; y++) {
+    /* add the line entering the box at the bottom */
+    s = src + (y + radius) * sstride;
+    for (x = 0; x < width; x++) {
+      col_fine[x * FINE_BINS + s[x]]++;
+      col_coarse[x * COARSE_BINS + (s[x] >> 4)]++;
+    }
+
+    s = src + y * sstride;
+    d = dest + y * dstride;
+
+    for (x = 0; x < radius; x++) {
+      d[x] = s[x];
+      d[width - 1 - x] = s[width - 1 - x];
+    }
+
+    memset (coarse, 0, sizeof (coarse));
+    for (b = 0; b < COARSE_BINS; b++)
+      fine_end[b] = 0;
+    for (x = 0; x < size - 1; x++)
+      for (i = 0; i < COARSE_BINS; i++)
+        coarse[i] += col_coarse[x * COARSE_BINS + i];
+
+    for (x = radius; x < width - radius; x++) {
+      const guint8 *cc = col_coarse + (x + radius) * COARSE_BINS;
+      guint8 *f;
+
+      for (i = 0; i < COARSE_BINS; i++)
+        coarse[i] += cc[i];
+
+      sum = 0;
+      for (b = 0; sum + coarse[b] <= rank; b++)
+        sum += coarse[b];
+
+      f = fine + b * FINE_PER_COARSE;
+      c = fine_end[b];
+      if (c <= x - radius) {
+        /* no column in common with the box, start over */
+        memset (f, 0, FINE_PER_COARSE);
+        c = x - radius;
+        for (; c <= x + radius; c++) {
+          const guint8 *cf = col_fine + c * FINE_BINS + b * FINE_PER_COARSE;
+
+          for (i = 0; i < FINE_PER_COARSE; i++)
+            f[i] += cf[i];
+        }
+      } else {
+        for (; c <= x + radius; c++) {
+          const guint8 *cf = col_fine + c * FINE_BINS + b * FINE_PER_COARSE;
+          const guint8 *of = cf - size * FINE_BINS;
+
+          for (i = 0; i < FINE_PER_COARSE; i++)
+            f[i] += cf[i] - of[i];
+        }
+      }
+      fine_end[b] = c;
+
+      for (v = 0; sum + f[v] <= rank; v++)
+        sum += f[v];
+      d[x] = b * FINE_PER_COARSE + v;
+
+      cc = col_coarse + (x - radius) * COARSE_BINS;
+      for (i = 0; i < COARSE_BINS; i++)
+        coarse[i] -= cc[i];
+    }
+
+    /* remove the line leaving the box at the top */
+    s = src + (y - radius) * sstride;
+    for (x = 0; x < width; x++) {
+      col_fine[x * FINE_BINS + s[x]]--;
+      col_coarse[x * COARSE_BINS + (s[x] >> 4)]--;
+    }
+  }
+}
+
+static void
+gst_video_median_plane (GstVideoMedian * median, GstVideoFrame * out_frame,
+    GstVideoFrame * in_frame, gint plane)
+{
+  guint8 *dest = GST_VIDEO_FRAME_PLANE_DATA (out_frame, plane);
+  gint dstride = GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, plane);
+  const guint8 *src = GST_VIDEO_FRAME_PLANE_DATA (in_frame, plane);
+  gint sstride = GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, plane);
+  gint width = GST_VIDEO_FRAME_COMP_WIDTH (in_frame, plane);
+  gint height = GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, plane);
+
+  switch (median->filtersize) {
+    case GST_VIDEO_MEDIAN_SIZE_5:
+      median_5 (dest, dstride, src, sstride, width, height);
+      break;
+    case GST_VIDEO_MEDIAN_SIZE_9:
+      median_9 (dest, dstride, src, sstride, width, height);
+      break;
+    case GST_VIDEO_MEDIAN_SIZE_25:
+      median_box (dest, dstride, src, sstride, width, height, 2,
+          median->col_fine, median->col_coarse);
+      break;
+    case GST_VIDEO_MEDIAN_SIZE_49:
+      median_box (dest, dstride, src, sstride, width, height, 3,
+          median->col_fine, median->col_coarse);
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
   }
 }
 
+static gboolean
+gst_video_median_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstVideoMedian *median = GST_VIDEO_MEDIAN (filter);
+  gint width = GST_VIDEO_INFO_WIDTH (in_info);
+
+  /* the luma plane is the widest one */
+  g_free (median->col_fine);
+  g_free (median->col_coarse);
+  median->col_fine = g_malloc (width * FINE_BINS);
+  median->col_coarse = g_malloc (width * COARSE_BINS);
+
+  return TRUE;
+}
+
 static GstFlowReturn
 gst_video_median_transform_frame (GstVideoFilter * filter,
     GstVideoFrame * in_frame, GstVideoFrame * out_frame)
 {
   GstVideoMedian *median = GST_VIDEO_MEDIAN (filter);
 
-  if (median->filtersize == 5) {
-    median_5 (GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0),
-        GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 0),
-        GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0),
-        GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 0),
-        GST_VIDEO_FRAME_WIDTH (in_frame), GST_VIDEO_FRAME_HEIGHT (in_frame));
-
-    if (median->lum_only) {
-      gst_video_frame_copy_plane (out_frame, in_frame, 1);
-      gst_video_frame_copy_plane (out_frame, in_frame, 2);
-    } else {
-      median_5 (GST_VIDEO_FRAME_PLANE_DATA (out_frame, 1),
-          GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 1),
-          GST_VIDEO_FRAME_PLANE_DATA (in_frame, 1),
-          GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 1),
-          GST_VIDEO_FRAME_WIDTH (in_frame) / 2,
-          GST_VIDEO_FRAME_HEIGHT (in_frame) / 2);
-      median_5 (GST_VIDEO_FRAME_PLANE_DATA (out_frame, 2),
-          GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 2),
-          GST_VIDEO_FRAME_PLANE_DATA (in_frame, 2),
-          GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 2),
-          GST_VIDEO_FRAME_WIDTH (in_frame) / 2,
-          GST_VIDEO_FRAME_HEIGHT (in_frame) / 2);
-    }
+  gst_video_median_plane (median, out_frame, in_frame, 0);
+
+  if (median->lum_only) {
+    gst_video_frame_copy_plane (out_frame, in_frame, 1);
+    gst_video_frame_copy_plane (out_frame, in_frame, 2);
   } else {
-    median_9 (GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0),
-        GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 0),
-        GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0),
-        GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 0),
-        GST_VIDEO_FRAME_WIDTH (in_frame), GST_VIDEO_FRAME_HEIGHT (in_frame));
-
-    if (median->lum_only) {
-      gst_video_frame_copy_plane (out_frame, in_frame, 1);
-      gst_video_frame_copy_plane (out_frame, in_frame, 2);
-    } else {
-      median_9 (GST_VIDEO_FRAME_PLANE_DATA (out_frame, 1),
-          GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 1),
-          GST_VIDEO_FRAME_PLANE_DATA (in_frame, 1),
-          GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 1),
-          GST_VIDEO_FRAME_WIDTH (in_frame) / 2,
-          GST_VIDEO_FRAME_HEIGHT (in_frame) / 2);
-      median_9 (GST_VIDEO_FRAME_PLANE_DATA (out_frame, 2),
-          GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 2),
-          GST_VIDEO_FRAME_PLANE_DATA (in_frame, 2),
-          GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 2),
-          GST_VIDEO_FRAME_WIDTH (in_frame) / 2,
-          GST_VIDEO_FRAME_HEIGHT (in_frame) / 2);
-    }
+    gst_video_median_plane (median, out_frame, in_frame, 1);
+    gst_video_median_plane (median, out_frame, in_frame, 2);
   }
 
   return GST_FLOW_OK;
@@ -301,6 +468,17 @@ gst_video_median_set_property (GObject * object, guint prop_id,
   }
 }
 
+static void
+gst_video_median_finalize (GObject * object)
+{
+  GstVideoMedian *median = GST_VIDEO_MEDIAN (object);
+
+  g_free (median->col_fine);
+  g_free (median->col_coarse);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_video_median_get_property (GObject * object, guint prop_id, GValue * value,
     GParamSpec * pspec)
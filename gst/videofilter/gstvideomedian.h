@@ -45,7 +45,9 @@ typedef struct _GstVideoMedianClass GstVideoMedianClass;
 typedef enum
 {
   GST_VIDEO_MEDIAN_SIZE_5 = 5,
-  GST_VIDEO_MEDIAN_SIZE_9 = 9
+  GST_VIDEO_MEDIAN_SIZE_9 = 9,
+  GST_VIDEO_MEDIAN_SIZE_25 = 25,
+  GST_VIDEO_MEDIAN_SIZE_49 = 49
 } GstVideoMedianSize;
 
 struct _GstVideoMedian {
@@ -53,6 +55,10 @@ struct _GstVideoMedian {
 
   GstVideoMedianSize filtersize;
   gboolean lum_only;
+
+  /* column histograms of the box medians, sized for the widest plane */
+  guint8 *col_fine;
+  guint8 *col_coarse;
 };
 
 struct _GstVideoMedianClass {
@@ -94,11 +94,13 @@ static void gst_wavparse_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
 #define DEFAULT_IGNORE_LENGTH FALSE
+#define DEFAULT_BUFFER_DURATION (40 * GST_MSECOND)
 
 enum
 {
   PROP_0,
   PROP_IGNORE_LENGTH,
+  PROP_BUFFER_DURATION,
 };
 
 static GstStaticPadTemplate sink_template_factory =
@@ -176,6 +178,22 @@ gst_wavparse_class_init (GstWavParseClass * klass)
           DEFAULT_IGNORE_LENGTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
       );
 
+  /**
+   * GstWavParse:buffer-duration:
+   *
+   * The duration of audio in each output buffer. Longer buffers mean
+   * fewer, bigger reads from upstream and less per-buffer overhead for
+   * high sample rate multi-channel files. The buffer size is always a whole
+   * number of frames and, once it is big enough, of memory pages.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (object_class, PROP_BUFFER_DURATION,
+      g_param_spec_uint64 ("buffer-duration", "Buffer duration",
+          "Target duration of the output buffers in nanoseconds", 0,
+          G_MAXUINT64, DEFAULT_BUFFER_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state = gst_wavparse_change_state;
   gstelement_class->send_event = gst_wavparse_send_event;
 
@@ -277,6 +295,8 @@ gst_wavparse_dispose (GObject * object)
 static void
 gst_wavparse_init (GstWavParse * wavparse)
 {
+  wavparse->buffer_duration = DEFAULT_BUFFER_DURATION;
+
   gst_wavparse_reset (wavparse);
 
   /* sink */
@@ -1064,6 +1084,7 @@ gst_wavparse_create_toc (GstWavParse * wav)
 }
 
 #define MAX_BUFFER_SIZE 4096
+#define WAVPARSE_PAGE_SIZE 4096
 
 static gboolean
 parse_ds64 (GstWavParse * wav, GstBuffer * buf)
@@ -1712,13 +1733,22 @@ gst_wavparse_stream_headers (GstWavParse * wav)
    * that is, buffers not too small either size or time wise
    * so we do not end up with too many of them */
   /* var abuse */
-  if (gst_wavparse_time_to_bytepos (wav, 40 * GST_MSECOND, &upstream_size))
-    wav->max_buf_size = upstream_size;
+  if (gst_wavparse_time_to_bytepos (wav, wav->buffer_duration, &upstream_size))
+    wav->max_buf_size = MIN (upstream_size, G_MAXINT32);
   else
     wav->max_buf_size = 0;
   wav->max_buf_size = MAX (wav->max_buf_size, MAX_BUFFER_SIZE);
-  if (wav->blockalign > 0)
-    wav->max_buf_size -= (wav->max_buf_size % wav->blockalign);
+  if (wav->blockalign > 0) {
+    guint align;
+
+    /* whole frames, and a multiple of the page size too if the buffers are
+     * big enough, so upstream reads and allocates whole pages */
+    align = wav->blockalign / gst_util_greatest_common_divisor (wav->blockalign,
+        WAVPARSE_PAGE_SIZE) * WAVPARSE_PAGE_SIZE;
+    if (wav->max_buf_size < align)
+      align = wav->blockalign;
+    wav->max_buf_size -= (wav->max_buf_size % align);
+  }
 
   GST_DEBUG_OBJECT (wav, "max buffer size %u", wav->max_buf_size);
 
@@ -2053,7 +2083,9 @@ iterate_adapter:
       return GST_FLOW_OK;
     }
 
-    buf = gst_adapter_take_buffer (wav->adapter, desired);
+    /* the output may span several input buffers, reference their memory
+     * instead of merging it */
+    buf = gst_adapter_take_buffer_fast (wav->adapter, desired);
   } else {
     if ((res = gst_pad_pull_range (wav->sinkpad, wav->offset,
                 desired, &buf)) != GST_FLOW_OK)
@@ -2929,6 +2961,9 @@ gst_wavparse_set_property (GObject * object, guint prop_id,
     case PROP_IGNORE_LENGTH:
       self->ignore_length = g_value_get_boolean (value);
       break;
+    case PROP_BUFFER_DURATION:
+      self->buffer_duration = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -2948,6 +2983,9 @@ gst_wavparse_get_property (GObject * object, guint prop_id,
     case PROP_IGNORE_LENGTH:
       g_value_set_boolean (value, self->ignore_length);
       break;
+    case PROP_BUFFER_DURATION:
+      g_value_set_uint64 (value, self->buffer_duration);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -122,6 +122,8 @@ struct _GstWavParse {
   gboolean discont;
 
   gboolean ignore_length;
+  /* target duration of the output buffers */
+  GstClockTime buffer_duration;
 
   /* Size of the data as written in the chunk size */
   guint32 chunk_size;
@@ -0,0 +1,104 @@
+/* GStreamer
+ *
+ * gstv4l2capturemeta.c: capture timing of v4l2src buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstv4l2capturemeta.h"
+
+GType
+gst_v4l2_capture_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstV4l2CaptureMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+static gboolean
+gst_v4l2_capture_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  GstV4l2CaptureMeta *cmeta = (GstV4l2CaptureMeta *) meta;
+
+  cmeta->capture_time = GST_CLOCK_TIME_NONE;
+  cmeta->dequeue_time = GST_CLOCK_TIME_NONE;
+  cmeta->sequence = 0;
+  cmeta->queue_depth = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_v4l2_capture_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstV4l2CaptureMeta *cmeta = (GstV4l2CaptureMeta *) meta;
+
+  /* the timing describes the whole frame, keep it on any copy */
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    gst_buffer_add_v4l2_capture_meta (dest, cmeta->capture_time,
+        cmeta->dequeue_time, cmeta->sequence, cmeta->queue_depth);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+const GstMetaInfo *
+gst_v4l2_capture_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter (&meta_info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_V4L2_CAPTURE_META_API_TYPE,
+        "GstV4l2CaptureMeta", sizeof (GstV4l2CaptureMeta),
+        gst_v4l2_capture_meta_init, (GstMetaFreeFunction) NULL,
+        gst_v4l2_capture_meta_transform);
+    g_once_init_leave (&meta_info, meta);
+  }
+  return meta_info;
+}
+
+GstV4l2CaptureMeta *
+gst_buffer_add_v4l2_capture_meta (GstBuffer * buffer,
+    GstClockTime capture_time, GstClockTime dequeue_time, guint32 sequence,
+    guint queue_depth)
+{
+  GstV4l2CaptureMeta *cmeta;
+
+  cmeta = (GstV4l2CaptureMeta *) gst_buffer_add_meta (buffer,
+      GST_V4L2_CAPTURE_META_INFO, NULL);
+  if (cmeta == NULL)
+    return NULL;
+
+  cmeta->capture_time = capture_time;
+  cmeta->dequeue_time = dequeue_time;
+  cmeta->sequence = sequence;
+  cmeta->queue_depth = queue_depth;
+
+  return cmeta;
+}
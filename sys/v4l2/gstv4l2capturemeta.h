@@ -0,0 +1,71 @@
+/* GStreamer
+ *
+ * gstv4l2capturemeta.h: capture timing of v4l2src buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_V4L2_CAPTURE_META_H__
+#define __GST_V4L2_CAPTURE_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstV4l2CaptureMeta GstV4l2CaptureMeta;
+
+/**
+ * GstV4l2CaptureMeta:
+ * @meta: parent #GstMeta
+ * @capture_time: timestamp the driver put on the frame, or
+ *   %GST_CLOCK_TIME_NONE if the driver timestamps are not usable
+ * @dequeue_time: time the frame was dequeued, on the same clock as
+ *   @capture_time (CLOCK_MONOTONIC, or the system time for drivers using it)
+ * @sequence: frame sequence number reported by the driver
+ * @queue_depth: number of buffers left queued in the driver after dequeuing
+ *   this one
+ *
+ * Capture timing attached by v4l2src. The API is registered as
+ * "GstV4l2CaptureMetaAPI" so that tools can look it up without linking to
+ * the plugin; the layout of this structure will not change.
+ */
+struct _GstV4l2CaptureMeta {
+  GstMeta meta;
+
+  GstClockTime capture_time;
+  GstClockTime dequeue_time;
+  guint32 sequence;
+  guint queue_depth;
+};
+
+GType gst_v4l2_capture_meta_api_get_type (void);
+#define GST_V4L2_CAPTURE_META_API_TYPE (gst_v4l2_capture_meta_api_get_type())
+
+const GstMetaInfo * gst_v4l2_capture_meta_get_info (void);
+#define GST_V4L2_CAPTURE_META_INFO (gst_v4l2_capture_meta_get_info())
+
+#define gst_buffer_get_v4l2_capture_meta(b) \
+  ((GstV4l2CaptureMeta*)gst_buffer_get_meta((b),GST_V4L2_CAPTURE_META_API_TYPE))
+
+GstV4l2CaptureMeta * gst_buffer_add_v4l2_capture_meta (GstBuffer * buffer,
+                                                       GstClockTime capture_time,
+                                                       GstClockTime dequeue_time,
+                                                       guint32 sequence,
+                                                       guint queue_depth);
+
+G_END_DECLS
+
+#endif /* __GST_V4L2_CAPTURE_META_H__ */
@@ -4126,6 +4126,28 @@ gst_v4l2_object_get_caps (GstV4l2Object * v4l2object, GstCaps * filter)
   return ret;
 }
 
+static void
+gst_v4l2_object_post_allocation_message (GstV4l2Object * obj,
+    gboolean zero_copy, gboolean copy_threshold, const gchar * reason)
+{
+  GstStructure *s;
+
+  if (zero_copy)
+    GST_INFO_OBJECT (obj->element, "pushing from our own pool%s",
+        copy_threshold ? ", copying when running low on buffers" : "");
+  else
+    GST_INFO_OBJECT (obj->element, "copying buffers: %s", reason);
+
+  s = gst_structure_new ("GstV4l2Allocation",
+      "io-mode", GST_TYPE_V4L2_IO_MODE, obj->mode,
+      "zero-copy", G_TYPE_BOOLEAN, zero_copy,
+      "copy-threshold", G_TYPE_BOOLEAN, copy_threshold,
+      "reason", G_TYPE_STRING, reason, NULL);
+
+  gst_element_post_message (obj->element,
+      gst_message_new_element (GST_OBJECT_CAST (obj->element), s));
+}
+
 gboolean
 gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
 {
@@ -4136,6 +4158,8 @@ gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
   gboolean update;
   gboolean has_video_meta;
   gboolean can_share_own_pool, pushing_from_our_pool = FALSE;
+  gboolean too_many_buffers, copy_threshold = FALSE;
+  const gchar *copy_reason = NULL;
   GstAllocator *allocator = NULL;
   GstAllocationParams params = { 0 };
 
@@ -4171,11 +4195,13 @@ gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
       gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
 
   can_share_own_pool = (has_video_meta || !obj->need_video_meta);
+  if (!can_share_own_pool)
+    copy_reason = "downstream does not support GstVideoMeta, which the "
+        "driver's stride or plane offsets require";
 
   gst_v4l2_get_driver_min_buffers (obj);
-  /* We can't share our own pool, if it exceed V4L2 capacity */
-  if (min + obj->min_buffers + 1 > VIDEO_MAX_FRAME)
-    can_share_own_pool = FALSE;
+  /* Our own pool can't hold all the buffers downstream wants to keep */
+  too_many_buffers = (min + obj->min_buffers + 1 > VIDEO_MAX_FRAME);
 
   /* select a pool */
   switch (obj->mode) {
@@ -4189,7 +4215,7 @@ gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
          * other size than what the hardware gives us but for downstream pools
          * we can try */
         size = MAX (size, obj->info.size);
-      } else if (can_share_own_pool) {
+      } else if (can_share_own_pool && !too_many_buffers) {
         /* no downstream pool, use our own then */
         GST_DEBUG_OBJECT (obj->element,
             "read/write mode: no downstream pool, using our own");
@@ -4218,6 +4244,15 @@ gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
       /* in streaming mode, prefer our own pool */
       /* Check if we can use it ... */
       if (can_share_own_pool) {
+        /* If downstream wants to hold more buffers than the driver can
+         * have, still push our own buffers and only copy once the driver
+         * is about to run dry, rather than copying every frame */
+        if (too_many_buffers) {
+          GST_DEBUG_OBJECT (obj->element, "downstream wants %u buffers, "
+              "enabling copy threshold", min);
+          min = MAX ((gint) VIDEO_MAX_FRAME - (gint) obj->min_buffers - 2, 0);
+          copy_threshold = TRUE;
+        }
         if (pool)
           gst_object_unref (pool);
         pool = gst_object_ref (obj->pool);
@@ -4259,12 +4294,12 @@ gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
      * buffers and enable copy threshold */
     if (!update) {
       own_min += 2;
-      gst_v4l2_buffer_pool_copy_at_threshold (GST_V4L2_BUFFER_POOL (pool),
-          TRUE);
-    } else {
-      gst_v4l2_buffer_pool_copy_at_threshold (GST_V4L2_BUFFER_POOL (pool),
-          FALSE);
+      copy_threshold = TRUE;
     }
+    own_min = MIN (own_min, VIDEO_MAX_FRAME);
+
+    gst_v4l2_buffer_pool_copy_at_threshold (GST_V4L2_BUFFER_POOL (pool),
+        copy_threshold);
 
   } else {
     /* In this case we'll have to configure two buffer pool. For our buffer
@@ -4359,6 +4394,16 @@ gst_v4l2_object_decide_allocation (GstV4l2Object * obj, GstQuery * query)
   else
     gst_query_add_allocation_pool (query, pool, size, min, max);
 
+  /* Tell the application whether frames reach downstream without a copy,
+   * importing userptr or dmabuf from the other pool is zero-copy as well */
+  if (obj->mode == GST_V4L2_IO_RW)
+    copy_reason = "the read/write io-mode copies every frame";
+  else if (pushing_from_our_pool || obj->mode == GST_V4L2_IO_USERPTR ||
+      obj->mode == GST_V4L2_IO_DMABUF_IMPORT)
+    copy_reason = NULL;
+  gst_v4l2_object_post_allocation_message (obj, copy_reason == NULL,
+      copy_threshold, copy_reason);
+
   if (allocator)
     gst_object_unref (allocator);
 
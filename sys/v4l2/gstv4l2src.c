@@ -42,6 +42,23 @@
  * Since 1.14, the use of libv4l2 has been disabled due to major bugs in the
  * emulation layer. To enable usage of this library, set the environment
  * variable GST_V4L2_USE_LIBV4L2=1.
+ *
+ * Setting #GstV4l2Src:capture-meta attaches a #GstV4l2CaptureMeta to every
+ * buffer. It holds the driver capture timestamp, the sequence number, the
+ * dequeue time and the number of buffers still queued in the driver. With
+ * #GstV4l2Src:post-latency-messages, the same information is posted for each
+ * frame as an element message named
+ * <classname>&quot;GstV4l2SrcLatency&quot;</classname>. Its "latency" field
+ * holds the time between capture and dequeue. The
+ * #GstV4l2Src:stats property sums up the captured frames, the frames lost
+ * according to gaps in the sequence numbers, and the capture latency.
+ *
+ * Once the allocation is negotiated, an element message named
+ * <classname>&quot;GstV4l2Allocation&quot;</classname> is posted. Its
+ * "io-mode" field holds the selected #GstV4l2IOMode. The "zero-copy" field
+ * tells whether the captured buffers are pushed without a copy. If they are
+ * not, "reason" explains why. The "copy-threshold" field is %TRUE when
+ * frames are only copied while the driver is running low on buffers.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -56,6 +73,7 @@
 #include <gst/video/gstvideopool.h>
 
 #include "gstv4l2src.h"
+#include "gstv4l2capturemeta.h"
 
 #include "gstv4l2colorbalance.h"
 #include "gstv4l2tuner.h"
@@ -67,11 +85,16 @@ GST_DEBUG_CATEGORY (v4l2src_debug);
 #define GST_CAT_DEFAULT v4l2src_debug
 
 #define DEFAULT_PROP_DEVICE   "/dev/video0"
+#define DEFAULT_PROP_CAPTURE_META FALSE
+#define DEFAULT_PROP_POST_LATENCY_MESSAGES FALSE
 
 enum
 {
   PROP_0,
   V4L2_STD_OBJECT_PROPS,
+  PROP_CAPTURE_META,
+  PROP_POST_LATENCY_MESSAGES,
+  PROP_STATS,
   PROP_LAST
 };
 
@@ -147,6 +170,78 @@ gst_v4l2src_class_init (GstV4l2SrcClass * klass)
   gst_v4l2_object_install_properties_helper (gobject_class,
       DEFAULT_PROP_DEVICE);
 
+  /**
+   * GstV4l2Src:capture-meta:
+   *
+   * Attach a #GstV4l2CaptureMeta with the capture timing to each buffer.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_CAPTURE_META,
+      g_param_spec_boolean ("capture-meta", "Capture Meta",
+          "Attach the driver capture timestamp, sequence number, dequeue time "
+          "and queue depth to each buffer", DEFAULT_PROP_CAPTURE_META,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstV4l2Src:post-latency-messages:
+   *
+   * Post a "GstV4l2SrcLatency" element message for each captured frame.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_POST_LATENCY_MESSAGES,
+      g_param_spec_boolean ("post-latency-messages", "Post Latency Messages",
+          "Post a message with the capture timing of each frame",
+          DEFAULT_PROP_POST_LATENCY_MESSAGES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstV4l2Src:stats:
+   *
+   * Capture statistics. This property returns a GstStructure with name
+   * application/x-v4l2src-stats with the following fields:
+   *
+   * <itemizedlist>
+   * <listitem>
+   *   <para>
+   *   #guint64
+   *   <classname>&quot;frames-captured&quot;</classname>:
+   *   the number of frames dequeued from the driver.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #guint64
+   *   <classname>&quot;frames-dropped&quot;</classname>:
+   *   the number of frames lost according to gaps in the driver sequence
+   *   numbers.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #GstClockTime
+   *   <classname>&quot;average-latency&quot;</classname>:
+   *   the average time between capture and dequeue.
+   *   </para>
+   * </listitem>
+   * <listitem>
+   *   <para>
+   *   #GstClockTime
+   *   <classname>&quot;max-latency&quot;</classname>:
+   *   the longest time between capture and dequeue.
+   *   </para>
+   * </listitem>
+   * </itemizedlist>
+   *
+   * The latencies are only known when the driver timestamps are usable.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics", "Capture statistics",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstV4l2Src::prepare-format:
    * @v4l2src: the v4l2src instance
@@ -207,6 +302,9 @@ gst_v4l2src_init (GstV4l2Src * v4l2src)
 
   gst_base_src_set_format (GST_BASE_SRC (v4l2src), GST_FORMAT_TIME);
   gst_base_src_set_live (GST_BASE_SRC (v4l2src), TRUE);
+
+  v4l2src->capture_meta = DEFAULT_PROP_CAPTURE_META;
+  v4l2src->post_latency_messages = DEFAULT_PROP_POST_LATENCY_MESSAGES;
 }
 
 
@@ -228,6 +326,12 @@ gst_v4l2src_set_property (GObject * object,
   if (!gst_v4l2_object_set_property_helper (v4l2src->v4l2object,
           prop_id, value, pspec)) {
     switch (prop_id) {
+      case PROP_CAPTURE_META:
+        v4l2src->capture_meta = g_value_get_boolean (value);
+        break;
+      case PROP_POST_LATENCY_MESSAGES:
+        v4l2src->post_latency_messages = g_value_get_boolean (value);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -235,6 +339,24 @@ gst_v4l2src_set_property (GObject * object,
   }
 }
 
+static GstStructure *
+gst_v4l2src_create_stats (GstV4l2Src * v4l2src)
+{
+  GstStructure *s;
+
+  GST_OBJECT_LOCK (v4l2src);
+  s = gst_structure_new ("application/x-v4l2src-stats",
+      "frames-captured", G_TYPE_UINT64, v4l2src->frames_captured,
+      "frames-dropped", G_TYPE_UINT64, v4l2src->frames_dropped,
+      "average-latency", G_TYPE_UINT64, v4l2src->n_latencies > 0 ?
+      v4l2src->total_latency / v4l2src->n_latencies : GST_CLOCK_TIME_NONE,
+      "max-latency", G_TYPE_UINT64, v4l2src->n_latencies > 0 ?
+      v4l2src->max_latency : GST_CLOCK_TIME_NONE, NULL);
+  GST_OBJECT_UNLOCK (v4l2src);
+
+  return s;
+}
+
 static void
 gst_v4l2src_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec)
@@ -244,6 +366,15 @@ gst_v4l2src_get_property (GObject * object,
   if (!gst_v4l2_object_get_property_helper (v4l2src->v4l2object,
           prop_id, value, pspec)) {
     switch (prop_id) {
+      case PROP_CAPTURE_META:
+        g_value_set_boolean (value, v4l2src->capture_meta);
+        break;
+      case PROP_POST_LATENCY_MESSAGES:
+        g_value_set_boolean (value, v4l2src->post_latency_messages);
+        break;
+      case PROP_STATS:
+        g_value_take_boxed (value, gst_v4l2src_create_stats (v4l2src));
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -707,6 +838,14 @@ gst_v4l2src_start (GstBaseSrc * src)
   v4l2src->has_bad_timestamp = FALSE;
   v4l2src->last_timestamp = 0;
 
+  GST_OBJECT_LOCK (v4l2src);
+  v4l2src->frames_captured = 0;
+  v4l2src->frames_dropped = 0;
+  v4l2src->n_latencies = 0;
+  v4l2src->total_latency = 0;
+  v4l2src->max_latency = 0;
+  GST_OBJECT_UNLOCK (v4l2src);
+
   return TRUE;
 }
 
@@ -786,6 +925,9 @@ gst_v4l2src_create (GstPushSrc * src, GstBuffer ** buf)
   GstClock *clock;
   GstClockTime abs_time, base_time, timestamp, duration;
   GstClockTime delay;
+  GstClockTime capture_time = GST_CLOCK_TIME_NONE, dequeue_time;
+  guint64 lost_frame_count = 0;
+  guint queue_depth;
   GstMessage *qos_msg;
 
   do {
@@ -802,6 +944,8 @@ gst_v4l2src_create (GstPushSrc * src, GstBuffer ** buf)
   if (G_UNLIKELY (ret != GST_FLOW_OK))
     goto error;
 
+  queue_depth = g_atomic_int_get (&pool->num_queued);
+
   timestamp = GST_BUFFER_TIMESTAMP (*buf);
   duration = obj->duration;
 
@@ -878,10 +1022,18 @@ retry:
     /* Save last timestamp for sanity checks */
     v4l2src->last_timestamp = timestamp;
 
+    capture_time = timestamp;
+    dequeue_time = gstnow;
+
     GST_DEBUG_OBJECT (v4l2src, "ts: %" GST_TIME_FORMAT " now %" GST_TIME_FORMAT
         " delay %" GST_TIME_FORMAT, GST_TIME_ARGS (timestamp),
         GST_TIME_ARGS (gstnow), GST_TIME_ARGS (delay));
   } else {
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    dequeue_time = GST_TIMESPEC_TO_TIME (now);
+
     /* we assume 1 frame latency otherwise */
     if (GST_CLOCK_TIME_IS_VALID (duration))
       delay = duration;
@@ -932,7 +1084,7 @@ retry:
     /* check for frame loss with given (from v4l2 device) buffer offset */
     if ((v4l2src->offset != 0)
         && (GST_BUFFER_OFFSET (*buf) != (v4l2src->offset + 1))) {
-      guint64 lost_frame_count = GST_BUFFER_OFFSET (*buf) - v4l2src->offset - 1;
+      lost_frame_count = GST_BUFFER_OFFSET (*buf) - v4l2src->offset - 1;
       GST_WARNING_OBJECT (v4l2src,
           "lost frames detected: count = %" G_GUINT64_FORMAT " - ts: %"
           GST_TIME_FORMAT, lost_frame_count, GST_TIME_ARGS (timestamp));
@@ -950,6 +1102,35 @@ retry:
   GST_BUFFER_TIMESTAMP (*buf) = timestamp;
   GST_BUFFER_DURATION (*buf) = duration;
 
+  GST_OBJECT_LOCK (v4l2src);
+  v4l2src->frames_captured++;
+  v4l2src->frames_dropped += lost_frame_count;
+  if (GST_CLOCK_TIME_IS_VALID (capture_time)) {
+    v4l2src->n_latencies++;
+    v4l2src->total_latency += delay;
+    v4l2src->max_latency = MAX (v4l2src->max_latency, delay);
+  }
+  GST_OBJECT_UNLOCK (v4l2src);
+
+  if (v4l2src->capture_meta)
+    gst_buffer_add_v4l2_capture_meta (*buf, capture_time, dequeue_time,
+        GST_BUFFER_OFFSET (*buf), queue_depth);
+
+  if (v4l2src->post_latency_messages) {
+    GstStructure *s;
+
+    s = gst_structure_new ("GstV4l2SrcLatency",
+        "sequence", G_TYPE_UINT64, GST_BUFFER_OFFSET (*buf),
+        "capture-time", G_TYPE_UINT64, capture_time,
+        "dequeue-time", G_TYPE_UINT64, dequeue_time,
+        "latency", G_TYPE_UINT64, GST_CLOCK_TIME_IS_VALID (capture_time) ?
+        delay : GST_CLOCK_TIME_NONE,
+        "queue-depth", G_TYPE_UINT, queue_depth,
+        "timestamp", G_TYPE_UINT64, timestamp, NULL);
+    gst_element_post_message (GST_ELEMENT_CAST (v4l2src),
+        gst_message_new_element (GST_OBJECT_CAST (v4l2src), s));
+  }
+
   return ret;
 
   /* ERROR */
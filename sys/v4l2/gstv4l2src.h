@@ -67,6 +67,16 @@ struct _GstV4l2Src
   /* Timestamp sanity check */
   GstClockTime last_timestamp;
   gboolean has_bad_timestamp;
+
+  gboolean capture_meta;
+  gboolean post_latency_messages;
+
+  /* capture statistics, protected by the object lock */
+  guint64 frames_captured;
+  guint64 frames_dropped;
+  guint64 n_latencies;
+  GstClockTime total_latency;
+  GstClockTime max_latency;
 };
 
 struct _GstV4l2SrcClass
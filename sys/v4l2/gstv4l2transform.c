@@ -61,6 +61,8 @@ typedef struct
 G_DEFINE_ABSTRACT_TYPE (GstV4l2Transform, gst_v4l2_transform,
     GST_TYPE_BASE_TRANSFORM);
 
+static void gst_v4l2_transform_stop_loop (GstV4l2Transform * self);
+
 static void
 gst_v4l2_transform_set_property (GObject * object,
     guint prop_id, const GValue * value, GParamSpec * pspec)
@@ -183,6 +185,8 @@ gst_v4l2_transform_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (self, "Stop");
 
+  gst_v4l2_transform_stop_loop (self);
+
   gst_v4l2_object_stop (self->v4l2output);
   gst_v4l2_object_stop (self->v4l2capture);
   gst_caps_replace (&self->incaps, NULL);
@@ -873,21 +877,159 @@ done:
   return othercaps;
 }
 
+/* Runs on the src pad task. Capture buffers are dequeued here while the
+ * streaming thread keeps queuing input, so the device always has work. */
+static void
+gst_v4l2_transform_loop (GstV4l2Transform * self)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (self);
+  GstBaseTransformClass *bclass = GST_BASE_TRANSFORM_GET_CLASS (self);
+  GstBufferPool *pool;
+  GstBuffer *buffer = NULL, *meta;
+  GstFlowReturn ret;
+
+  /* Only wait on the device once a frame has been queued to it */
+  g_mutex_lock (&self->pending_lock);
+  while (g_queue_is_empty (&self->pending) && !self->flushing)
+    g_cond_wait (&self->pending_cond, &self->pending_lock);
+  ret = self->flushing ? GST_FLOW_FLUSHING : GST_FLOW_OK;
+  g_mutex_unlock (&self->pending_lock);
+
+  if (ret != GST_FLOW_OK)
+    goto beach;
+
+  do {
+    pool = gst_base_transform_get_buffer_pool (trans);
+
+    if (!pool || !gst_buffer_pool_set_active (pool, TRUE))
+      goto activate_failed;
+
+    GST_LOG_OBJECT (self, "Dequeue output buffer");
+    ret = gst_buffer_pool_acquire_buffer (pool, &buffer, NULL);
+    gst_object_unref (pool);
+
+    if (ret != GST_FLOW_OK)
+      goto beach;
+
+    ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL
+        (self->v4l2capture->pool), &buffer);
+  } while (ret == GST_V4L2_FLOW_CORRUPTED_BUFFER);
+
+  if (ret != GST_FLOW_OK)
+    goto beach;
+
+  /* drain() only returns once the frame has been pushed */
+  g_mutex_lock (&self->pending_lock);
+  meta = g_queue_pop_head (&self->pending);
+  self->in_flight++;
+  g_mutex_unlock (&self->pending_lock);
+
+  if (meta) {
+    if (bclass->copy_metadata && !bclass->copy_metadata (trans, meta, buffer)) {
+      /* something failed, post a warning */
+      GST_ELEMENT_WARNING (self, STREAM, NOT_IMPLEMENTED,
+          ("could not copy metadata"), (NULL));
+    }
+    gst_buffer_unref (meta);
+  } else {
+    GST_WARNING_OBJECT (self, "Device produced more buffers than queued");
+  }
+
+  ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (trans), buffer);
+  buffer = NULL;
+
+  g_mutex_lock (&self->pending_lock);
+  self->in_flight--;
+  g_cond_broadcast (&self->pending_cond);
+  g_mutex_unlock (&self->pending_lock);
+
+  if (ret != GST_FLOW_OK)
+    goto beach;
+
+  return;
+
+activate_failed:
+  GST_ELEMENT_ERROR (self, RESOURCE, SETTINGS,
+      ("failed to activate bufferpool"), ("failed to activate bufferpool"));
+  if (pool)
+    gst_object_unref (pool);
+  ret = GST_FLOW_ERROR;
+
+beach:
+  GST_DEBUG_OBJECT (self, "Leaving output thread: %s", gst_flow_get_name (ret));
+
+  gst_buffer_replace (&buffer, NULL);
+
+  g_mutex_lock (&self->pending_lock);
+  self->output_flow = ret;
+  g_cond_broadcast (&self->pending_cond);
+  g_mutex_unlock (&self->pending_lock);
+
+  /* unblock the streaming thread if it waits for a free input buffer */
+  gst_v4l2_object_unlock (self->v4l2output);
+  gst_pad_pause_task (GST_BASE_TRANSFORM_SRC_PAD (trans));
+}
+
+static void
+gst_v4l2_transform_stop_loop (GstV4l2Transform * self)
+{
+  g_mutex_lock (&self->pending_lock);
+  self->flushing = TRUE;
+  g_cond_broadcast (&self->pending_cond);
+  g_mutex_unlock (&self->pending_lock);
+
+  gst_v4l2_object_unlock (self->v4l2output);
+  gst_v4l2_object_unlock (self->v4l2capture);
+  gst_pad_stop_task (GST_BASE_TRANSFORM_SRC_PAD (self));
+
+  g_mutex_lock (&self->pending_lock);
+  g_queue_foreach (&self->pending, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (&self->pending);
+  g_mutex_unlock (&self->pending_lock);
+}
+
+/* Waits until every queued frame came out of the device */
+static void
+gst_v4l2_transform_drain (GstV4l2Transform * self)
+{
+  if (gst_pad_get_task_state (GST_BASE_TRANSFORM_SRC_PAD (self)) !=
+      GST_TASK_STARTED)
+    return;
+
+  GST_DEBUG_OBJECT (self, "Draining");
+
+  g_mutex_lock (&self->pending_lock);
+  while ((!g_queue_is_empty (&self->pending) || self->in_flight > 0) &&
+      self->output_flow == GST_FLOW_OK && !self->flushing)
+    g_cond_wait (&self->pending_cond, &self->pending_lock);
+  g_mutex_unlock (&self->pending_lock);
+
+  GST_DEBUG_OBJECT (self, "Done draining");
+}
+
 static GstFlowReturn
-gst_v4l2_transform_prepare_output_buffer (GstBaseTransform * trans,
-    GstBuffer * inbuf, GstBuffer ** outbuf)
+gst_v4l2_transform_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf)
 {
   GstV4l2Transform *self = GST_V4L2_TRANSFORM (trans);
   GstBufferPool *pool = GST_BUFFER_POOL (self->v4l2output->pool);
   GstFlowReturn ret = GST_FLOW_OK;
-  GstBaseTransformClass *bclass = GST_BASE_TRANSFORM_CLASS (parent_class);
+  GstBuffer *inbuf, *meta;
 
   if (gst_base_transform_is_passthrough (trans)) {
     GST_DEBUG_OBJECT (self, "Passthrough, no need to do anything");
-    *outbuf = inbuf;
-    goto beach;
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->generate_output (trans,
+        outbuf);
   }
 
+  /* Output buffers are pushed from the capture thread */
+  *outbuf = NULL;
+  inbuf = trans->queued_buf;
+  trans->queued_buf = NULL;
+
+  if (inbuf == NULL)
+    return GST_FLOW_OK;
+
   /* Ensure input internal pool is active */
   if (!gst_buffer_pool_is_active (pool)) {
     GstStructure *config = gst_buffer_pool_get_config (pool);
@@ -904,53 +1046,65 @@ gst_v4l2_transform_prepare_output_buffer (GstBaseTransform * trans,
       goto activate_failed;
   }
 
-  GST_DEBUG_OBJECT (self, "Queue input buffer");
-  ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (pool), &inbuf);
-  if (G_UNLIKELY (ret != GST_FLOW_OK))
-    goto beach;
+  if (gst_pad_get_task_state (GST_BASE_TRANSFORM_SRC_PAD (trans)) !=
+      GST_TASK_STARTED) {
+    /* It's possible that the processing thread stopped due to an error */
+    if (self->output_flow != GST_FLOW_OK &&
+        self->output_flow != GST_FLOW_FLUSHING) {
+      GST_DEBUG_OBJECT (self, "Processing loop stopped with error, leaving");
+      ret = self->output_flow;
+      goto done;
+    }
 
-  do {
-    pool = gst_base_transform_get_buffer_pool (trans);
+    GST_DEBUG_OBJECT (self, "Starting capture thread");
 
-    if (!gst_buffer_pool_set_active (pool, TRUE))
-      goto activate_failed;
+    g_mutex_lock (&self->pending_lock);
+    self->output_flow = GST_FLOW_OK;
+    self->flushing = FALSE;
+    g_mutex_unlock (&self->pending_lock);
 
-    GST_DEBUG_OBJECT (self, "Dequeue output buffer");
-    ret = gst_buffer_pool_acquire_buffer (pool, outbuf, NULL);
-    g_object_unref (pool);
+    if (!gst_pad_start_task (GST_BASE_TRANSFORM_SRC_PAD (trans),
+            (GstTaskFunction) gst_v4l2_transform_loop, self, NULL))
+      goto start_task_failed;
+  }
 
-    if (ret != GST_FLOW_OK)
-      goto alloc_failed;
+  /* Record the metadata before queuing, the capture thread may dequeue the
+   * result before process() returns */
+  meta = gst_buffer_new ();
+  gst_buffer_copy_into (meta, inbuf, GST_BUFFER_COPY_METADATA, 0, -1);
 
-    pool = self->v4l2capture->pool;
-    ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (pool), outbuf);
+  g_mutex_lock (&self->pending_lock);
+  g_queue_push_tail (&self->pending, meta);
+  g_cond_broadcast (&self->pending_cond);
+  g_mutex_unlock (&self->pending_lock);
 
-  } while (ret == GST_V4L2_FLOW_CORRUPTED_BUFFER);
+  GST_LOG_OBJECT (self, "Queue input buffer");
+  ret = gst_v4l2_buffer_pool_process (GST_V4L2_BUFFER_POOL (pool), &inbuf);
 
-  if (ret != GST_FLOW_OK) {
-    gst_buffer_unref (*outbuf);
-    *outbuf = NULL;
+  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
+    g_mutex_lock (&self->pending_lock);
+    if (g_queue_remove (&self->pending, meta))
+      gst_buffer_unref (meta);
+    if (ret == GST_FLOW_FLUSHING && self->output_flow != GST_FLOW_OK)
+      ret = self->output_flow;
+    g_mutex_unlock (&self->pending_lock);
   }
 
-  if (bclass->copy_metadata)
-    if (!bclass->copy_metadata (trans, inbuf, *outbuf)) {
-      /* something failed, post a warning */
-      GST_ELEMENT_WARNING (self, STREAM, NOT_IMPLEMENTED,
-          ("could not copy metadata"), (NULL));
-    }
-
-beach:
+done:
+  gst_buffer_unref (inbuf);
   return ret;
 
 activate_failed:
   GST_ELEMENT_ERROR (self, RESOURCE, SETTINGS,
       ("failed to activate bufferpool"), ("failed to activate bufferpool"));
-  g_object_unref (pool);
-  return GST_FLOW_ERROR;
-
-alloc_failed:
-  GST_DEBUG_OBJECT (self, "could not allocate buffer from pool");
-  return ret;
+  ret = GST_FLOW_ERROR;
+  goto done;
+
+start_task_failed:
+  GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+      ("failed to start processing thread"), (NULL));
+  ret = GST_FLOW_ERROR;
+  goto done;
 }
 
 static GstFlowReturn
@@ -974,16 +1128,31 @@ gst_v4l2_transform_sink_event (GstBaseTransform * trans, GstEvent * event)
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_START:
       GST_DEBUG_OBJECT (self, "flush start");
+      g_mutex_lock (&self->pending_lock);
+      self->flushing = TRUE;
+      g_cond_broadcast (&self->pending_cond);
+      g_mutex_unlock (&self->pending_lock);
       gst_v4l2_object_unlock (self->v4l2output);
       gst_v4l2_object_unlock (self->v4l2capture);
       break;
+    case GST_EVENT_FLUSH_STOP:
+      break;
     default:
+      /* Keep serialized events in order with the frames still owned by the
+       * device */
+      if (GST_EVENT_IS_SERIALIZED (event))
+        gst_v4l2_transform_drain (self);
       break;
   }
 
   ret = GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
 
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      /* The processing thread should stop now, wait for it */
+      gst_v4l2_transform_stop_loop (self);
+      GST_DEBUG_OBJECT (self, "flush start done");
+      break;
     case GST_EVENT_FLUSH_STOP:
       /* Buffer should be back now */
       GST_DEBUG_OBJECT (self, "flush stop");
@@ -991,6 +1160,7 @@ gst_v4l2_transform_sink_event (GstBaseTransform * trans, GstEvent * event)
       gst_v4l2_object_unlock_stop (self->v4l2output);
       gst_v4l2_buffer_pool_flush (self->v4l2output->pool);
       gst_v4l2_buffer_pool_flush (self->v4l2capture->pool);
+      self->output_flow = GST_FLOW_OK;
       break;
     default:
       break;
@@ -1012,6 +1182,10 @@ gst_v4l2_transform_change_state (GstElement * element,
         return GST_STATE_CHANGE_FAILURE;
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      g_mutex_lock (&self->pending_lock);
+      self->flushing = TRUE;
+      g_cond_broadcast (&self->pending_cond);
+      g_mutex_unlock (&self->pending_lock);
       gst_v4l2_object_unlock (self->v4l2output);
       gst_v4l2_object_unlock (self->v4l2capture);
       break;
@@ -1051,6 +1225,9 @@ gst_v4l2_transform_finalize (GObject * object)
   gst_v4l2_object_destroy (self->v4l2capture);
   gst_v4l2_object_destroy (self->v4l2output);
 
+  g_mutex_clear (&self->pending_lock);
+  g_cond_clear (&self->pending_cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -1060,6 +1237,11 @@ gst_v4l2_transform_init (GstV4l2Transform * self)
   /* V4L2 object are created in subinstance_init */
   /* enable QoS */
   gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (self), TRUE);
+
+  g_mutex_init (&self->pending_lock);
+  g_cond_init (&self->pending_cond);
+  g_queue_init (&self->pending);
+  self->output_flow = GST_FLOW_OK;
 }
 
 static void
@@ -1122,8 +1304,8 @@ gst_v4l2_transform_class_init (GstV4l2TransformClass * klass)
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_transform_caps);
   base_transform_class->fixate_caps =
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_fixate_caps);
-  base_transform_class->prepare_output_buffer =
-      GST_DEBUG_FUNCPTR (gst_v4l2_transform_prepare_output_buffer);
+  base_transform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_v4l2_transform_generate_output);
   base_transform_class->transform =
       GST_DEBUG_FUNCPTR (gst_v4l2_transform_transform);
 
@@ -61,6 +61,16 @@ struct _GstV4l2Transform
   /* Selected caps */
   GstCaps *incaps;
   GstCaps *outcaps;
+
+  /* Capture thread, the pending queue holds the metadata of the frames
+   * queued to the device, in order. in_flight counts the frames dequeued
+   * but not pushed yet. */
+  GMutex pending_lock;
+  GCond pending_cond;
+  GQueue pending;
+  guint in_flight;
+  gboolean flushing;
+  GstFlowReturn output_flow;
 };
 
 struct _GstV4l2TransformClass
@@ -358,16 +358,15 @@ gst_v4l2_video_enc_flush (GstVideoEncoder * encoder)
   GST_DEBUG_OBJECT (self, "Flushing");
 
   /* Ensure the processing thread has stopped for the reverse playback
-   * iscount case */
-  if (g_atomic_int_get (&self->processing)) {
+   * discont case */
+  if (gst_pad_get_task_state (encoder->srcpad) == GST_TASK_STARTED) {
     GST_VIDEO_ENCODER_STREAM_UNLOCK (encoder);
 
-    gst_v4l2_object_unlock_stop (self->v4l2output);
-    gst_v4l2_object_unlock_stop (self->v4l2capture);
+    gst_v4l2_object_unlock (self->v4l2output);
+    gst_v4l2_object_unlock (self->v4l2capture);
     gst_pad_stop_task (encoder->srcpad);
 
-    GST_VIDEO_ENCODER_STREAM_UNLOCK (encoder);
-
+    GST_VIDEO_ENCODER_STREAM_LOCK (encoder);
   }
 
   self->output_flow = GST_FLOW_OK;
@@ -375,6 +374,11 @@ gst_v4l2_video_enc_flush (GstVideoEncoder * encoder)
   gst_v4l2_object_unlock_stop (self->v4l2output);
   gst_v4l2_object_unlock_stop (self->v4l2capture);
 
+  if (self->v4l2output->pool)
+    gst_v4l2_buffer_pool_flush (self->v4l2output->pool);
+  if (self->v4l2capture->pool)
+    gst_v4l2_buffer_pool_flush (self->v4l2capture->pool);
+
   return TRUE;
 }
 
@@ -749,6 +753,7 @@ gst_v4l2_video_enc_handle_frame (GstVideoEncoder * encoder,
 
     /* Start the processing task, when it quits, the task will disable input
      * processing to unlock input if draining, or prevent potential block */
+    g_atomic_int_set (&self->processing, TRUE);
     if (!gst_pad_start_task (encoder->srcpad,
             (GstTaskFunction) gst_v4l2_video_enc_loop, self,
             (GDestroyNotify) gst_v4l2_video_enc_loop_stopped))
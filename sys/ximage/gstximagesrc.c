@@ -23,7 +23,10 @@
  *
  * This element captures your X Display and creates raw RGB video.  It uses
  * the XDamage extension if available to only capture areas of the screen that
- * have changed since the last frame.  It uses the XFixes extension if
+ * have changed since the last frame.  With #GstXImageSrc:damage-tile-size,
+ * the changed areas are kept in a persistent frame and only the tiles that
+ * changed are copied into the output buffers, which also carry the changed
+ * areas as region of interest metadata.  It uses the XFixes extension if
  * available to also capture your mouse pointer.  By default it will fixate to
  * 25 frames per second.
  *
@@ -75,6 +78,7 @@ enum
   PROP_REMOTE,
   PROP_XID,
   PROP_XNAME,
+  PROP_DAMAGE_TILE_SIZE,
 };
 
 #define gst_ximage_src_parent_class parent_class
@@ -82,6 +86,9 @@ G_DEFINE_TYPE (GstXImageSrc, gst_ximage_src, GST_TYPE_PUSH_SRC);
 
 static GstCaps *gst_ximage_src_fixate (GstBaseSrc * bsrc, GstCaps * caps);
 static void gst_ximage_src_clear_bufpool (GstXImageSrc * ximagesrc);
+#ifdef HAVE_XDAMAGE
+static void gst_ximage_src_free_damage_frame (GstXImageSrc * ximagesrc);
+#endif
 
 /* Called when a buffer is returned from the pipeline */
 static gboolean
@@ -248,6 +255,7 @@ use_root_window:
     s->damage = None;
     s->damage_copy_gc = None;
     s->damage_region = None;
+    s->damage_accum = None;
 
     if (XDamageQueryExtension (s->xcontext->disp, &s->damage_event_base,
             &error_base)) {
@@ -255,7 +263,8 @@ use_root_window:
           XDamageCreate (s->xcontext->disp, s->xwindow, XDamageReportNonEmpty);
       if (s->damage != None) {
         s->damage_region = XFixesCreateRegion (s->xcontext->disp, NULL, 0);
-        if (s->damage_region != None) {
+        s->damage_accum = XFixesCreateRegion (s->xcontext->disp, NULL, 0);
+        if (s->damage_region != None && s->damage_accum != None) {
           XGCValues values;
 
           GST_DEBUG_OBJECT (s, "Using XDamage extension");
@@ -266,6 +275,11 @@ use_root_window:
 
           s->have_xdamage = TRUE;
         } else {
+          if (s->damage_region != None)
+            XFixesDestroyRegion (s->xcontext->disp, s->damage_region);
+          if (s->damage_accum != None)
+            XFixesDestroyRegion (s->xcontext->disp, s->damage_accum);
+          s->damage_region = s->damage_accum = None;
           XDamageDestroy (s->xcontext->disp, s->damage);
           s->damage = None;
         }
@@ -296,6 +310,7 @@ gst_ximage_src_start (GstBaseSrc * basesrc)
   if (s->last_ximage)
     gst_buffer_unref (GST_BUFFER_CAST (s->last_ximage));
   s->last_ximage = NULL;
+  s->damage_generation = 0;
 #endif
   return gst_ximage_src_open_display (s, s->display_name);
 }
@@ -309,6 +324,8 @@ gst_ximage_src_stop (GstBaseSrc * basesrc)
   if (src->last_ximage)
     gst_buffer_unref (GST_BUFFER_CAST (src->last_ximage));
   src->last_ximage = NULL;
+
+  gst_ximage_src_free_damage_frame (src);
 #endif
 
   gst_ximage_src_clear_bufpool (src);
@@ -331,6 +348,10 @@ gst_ximage_src_stop (GstBaseSrc * basesrc)
       XFixesDestroyRegion (src->xcontext->disp, src->damage_region);
       src->damage_region = None;
     }
+    if (src->damage_accum != None) {
+      XFixesDestroyRegion (src->xcontext->disp, src->damage_accum);
+      src->damage_accum = None;
+    }
     if (src->damage != None) {
       XDamageDestroy (src->xcontext->disp, src->damage);
       src->damage = None;
@@ -481,8 +502,316 @@ copy_buffer (GstBuffer * dest, GstBuffer * src)
   gst_buffer_fill (dest, 0, map.data, map.size);
   gst_buffer_unmap (src, &map);
 }
+
+/* Above that many changed runs of tiles, a single region covering all of
+ * them is attached instead */
+#define MAX_DAMAGE_REGIONS 32
+
+static void
+gst_ximage_src_free_damage_frame (GstXImageSrc * ximagesrc)
+{
+  if (ximagesrc->damage_frame)
+    gst_ximage_buffer_free (ximagesrc->damage_frame);
+  ximagesrc->damage_frame = NULL;
+
+  g_free (ximagesrc->tile_generation);
+  ximagesrc->tile_generation = NULL;
+  ximagesrc->cursor_drawn = FALSE;
+}
+
+/* Marks the tiles covering an area of the output as changed in the current
+ * generation */
+static void
+gst_ximage_src_mark_tiles (GstXImageSrc * ximagesrc, gint x, gint y,
+    gint width, gint height)
+{
+  guint ts = ximagesrc->tile_size;
+  gint tx, ty;
+
+  if (x < 0) {
+    width += x;
+    x = 0;
+  }
+  if (y < 0) {
+    height += y;
+    y = 0;
+  }
+  width = MIN (width, ximagesrc->width - x);
+  height = MIN (height, ximagesrc->height - y);
+  if (width <= 0 || height <= 0)
+    return;
+
+  for (ty = y / ts; ty <= (y + height - 1) / ts; ty++)
+    for (tx = x / ts; tx <= (x + width - 1) / ts; tx++)
+      ximagesrc->tile_generation[ty * ximagesrc->tiles_x + tx] =
+          ximagesrc->damage_generation;
+}
+
+/* Grabs an area of the window into the persistent frame, in output
+ * coordinates */
+static void
+gst_ximage_src_grab_area (GstXImageSrc * ximagesrc, XImage * ximage, gint x,
+    gint y, gint width, gint height)
+{
+  GST_LOG_OBJECT (ximagesrc, "Retrieving damaged sub-region @ %d,%d size %dx%d",
+      x, y, width, height);
+
+  XGetSubImage (ximagesrc->xcontext->disp, ximagesrc->xwindow,
+      ximagesrc->startx + x, ximagesrc->starty + y, width, height, AllPlanes,
+      ZPixmap, ximage, x, y);
+}
+
+static void
+gst_ximage_src_grab_frame (GstXImageSrc * ximagesrc, XImage * ximage)
+{
+#ifdef HAVE_XSHM
+  if (ximagesrc->xcontext->use_xshm) {
+    XShmGetImage (ximagesrc->xcontext->disp, ximagesrc->xwindow, ximage,
+        ximagesrc->startx, ximagesrc->starty, AllPlanes);
+  } else
+#endif /* HAVE_XSHM */
+  {
+    gst_ximage_src_grab_area (ximagesrc, ximage, 0, 0, ximagesrc->width,
+        ximagesrc->height);
+  }
+}
+
+/* Brings the persistent frame up to date with the damage reported since the
+ * last call, and records which tiles changed */
+static gboolean
+gst_ximage_src_update_damage_frame (GstXImageSrc * ximagesrc)
+{
+  Display *disp = ximagesrc->xcontext->disp;
+  GstMetaXImage *fmeta;
+  gboolean have_damage = FALSE, full_frame = FALSE;
+  XRectangle *rects = NULL;
+  int nrects = 0, i;
+
+  if (ximagesrc->damage_frame) {
+    fmeta = GST_META_XIMAGE_GET (ximagesrc->damage_frame);
+
+    if (fmeta->width != ximagesrc->width || fmeta->height != ximagesrc->height
+        || ximagesrc->tile_size != ximagesrc->damage_tile_size)
+      gst_ximage_src_free_damage_frame (ximagesrc);
+  }
+
+  if (ximagesrc->damage_frame == NULL) {
+    GST_DEBUG_OBJECT (ximagesrc, "creating damage frame (%dx%d), %u tiles",
+        ximagesrc->width, ximagesrc->height, ximagesrc->damage_tile_size);
+
+    g_mutex_lock (&ximagesrc->x_lock);
+    ximagesrc->damage_frame = gst_ximageutil_ximage_new (ximagesrc->xcontext,
+        GST_ELEMENT (ximagesrc), ximagesrc->width, ximagesrc->height,
+        (BufferReturnFunc) (gst_ximage_src_return_buf));
+    g_mutex_unlock (&ximagesrc->x_lock);
+
+    if (ximagesrc->damage_frame == NULL) {
+      GST_ELEMENT_ERROR (ximagesrc, RESOURCE, WRITE, (NULL),
+          ("could not create a %dx%d ximage", ximagesrc->width,
+              ximagesrc->height));
+      return FALSE;
+    }
+
+    ximagesrc->tile_size = ximagesrc->damage_tile_size;
+    ximagesrc->tiles_x =
+        (ximagesrc->width + ximagesrc->tile_size - 1) / ximagesrc->tile_size;
+    ximagesrc->tiles_y =
+        (ximagesrc->height + ximagesrc->tile_size - 1) / ximagesrc->tile_size;
+    ximagesrc->tile_generation =
+        g_new0 (guint64, ximagesrc->tiles_x * ximagesrc->tiles_y);
+    full_frame = TRUE;
+  }
+
+  fmeta = GST_META_XIMAGE_GET (ximagesrc->damage_frame);
+  ximagesrc->damage_generation++;
+
+  /* Collect the damage without blocking, an unchanged screen simply repeats
+   * the persistent frame. Every subtract replaces the contents of
+   * damage_region, so the damage of all events is merged in damage_accum */
+  XFixesSetRegion (disp, ximagesrc->damage_accum, NULL, 0);
+  while (XPending (disp)) {
+    XEvent ev;
+    XDamageNotifyEvent *damage_ev = (XDamageNotifyEvent *) (&ev);
+
+    XNextEvent (disp, &ev);
+
+    if (ev.type == ximagesrc->damage_event_base + XDamageNotify &&
+        damage_ev->level == XDamageReportNonEmpty) {
+      XDamageSubtract (disp, ximagesrc->damage, None,
+          ximagesrc->damage_region);
+      XFixesUnionRegion (disp, ximagesrc->damage_accum,
+          ximagesrc->damage_accum, ximagesrc->damage_region);
+      have_damage = TRUE;
+    }
+  }
+
+  if (have_damage && !full_frame) {
+    gint64 area = 0;
+
+    rects = XFixesFetchRegion (disp, ximagesrc->damage_accum, &nrects);
+
+    /* Clip to the captured area, in output coordinates */
+    for (i = 0; rects != NULL && i < nrects; i++) {
+      gint x0 = MAX (rects[i].x - (gint) ximagesrc->startx, 0);
+      gint y0 = MAX (rects[i].y - (gint) ximagesrc->starty, 0);
+      gint x1 = MIN (rects[i].x + rects[i].width - (gint) ximagesrc->startx,
+          ximagesrc->width);
+      gint y1 = MIN (rects[i].y + rects[i].height - (gint) ximagesrc->starty,
+          ximagesrc->height);
+
+      rects[i].x = x0;
+      rects[i].y = y0;
+      rects[i].width = MAX (x1 - x0, 0);
+      rects[i].height = MAX (y1 - y0, 0);
+      area += (gint64) rects[i].width * rects[i].height;
+    }
+
+#ifdef HAVE_XSHM
+    /* One shared memory transfer beats many small requests once most of the
+     * frame changed */
+    if (ximagesrc->xcontext->use_xshm &&
+        area * 2 > (gint64) ximagesrc->width * ximagesrc->height)
+      full_frame = TRUE;
+#endif
+  }
+
+  if (full_frame) {
+    GST_LOG_OBJECT (ximagesrc, "Retrieving full damage frame");
+    gst_ximage_src_grab_frame (ximagesrc, fmeta->ximage);
+    gst_ximage_src_mark_tiles (ximagesrc, 0, 0, ximagesrc->width,
+        ximagesrc->height);
+  } else {
+    for (i = 0; rects != NULL && i < nrects; i++) {
+      if (rects[i].width == 0 || rects[i].height == 0)
+        continue;
+
+      gst_ximage_src_grab_area (ximagesrc, fmeta->ximage, rects[i].x,
+          rects[i].y, rects[i].width, rects[i].height);
+      gst_ximage_src_mark_tiles (ximagesrc, rects[i].x, rects[i].y,
+          rects[i].width, rects[i].height);
+    }
+  }
+
+  if (rects)
+    XFree (rects);
+
+  /* The pointer is only drawn on the output buffers, restore the tiles it
+   * covered from the clean frame */
+  if (ximagesrc->cursor_drawn) {
+    gst_ximage_src_mark_tiles (ximagesrc, ximagesrc->cursor_x,
+        ximagesrc->cursor_y, ximagesrc->cursor_width, ximagesrc->cursor_height);
+    ximagesrc->cursor_drawn = FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Copies the tiles that changed since @ximage was last filled from the
+ * persistent frame. Runs of adjacent tiles are copied with one memcpy per
+ * line. */
+static void
+gst_ximage_src_copy_damage_tiles (GstXImageSrc * ximagesrc, GstBuffer * ximage)
+{
+  GstMetaXImage *meta = GST_META_XIMAGE_GET (ximage);
+  GstMetaXImage *fmeta = GST_META_XIMAGE_GET (ximagesrc->damage_frame);
+  guint ts = ximagesrc->tile_size;
+  gint pixel_stride = ximagesrc->xcontext->bpp / 8;
+  gint stride = fmeta->ximage->bytes_per_line;
+  guint tx, ty, run, copied = 0;
+
+  for (ty = 0; ty < ximagesrc->tiles_y; ty++) {
+    const guint64 *gens = &ximagesrc->tile_generation[ty * ximagesrc->tiles_x];
+    gint y0 = ty * ts;
+    gint y1 = MIN (y0 + ts, ximagesrc->height);
+
+    for (tx = 0; tx < ximagesrc->tiles_x; tx += run) {
+      gint x0, x1, y;
+
+      for (run = 0; tx + run < ximagesrc->tiles_x &&
+          gens[tx + run] > meta->damage_generation; run++);
+
+      if (run == 0) {
+        run = 1;
+        continue;
+      }
+
+      x0 = tx * ts * pixel_stride;
+      x1 = MIN ((tx + run) * ts, ximagesrc->width) * pixel_stride;
+
+      for (y = y0; y < y1; y++)
+        memcpy (meta->ximage->data + y * stride + x0,
+            fmeta->ximage->data + y * stride + x0, x1 - x0);
+
+      copied += run;
+    }
+  }
+
+  GST_LOG_OBJECT (ximagesrc, "copied %u of %u tiles", copied,
+      ximagesrc->tiles_x * ximagesrc->tiles_y);
+
+  meta->damage_generation = ximagesrc->damage_generation;
+}
+
+/* Attaches the areas that changed since the previous frame as region of
+ * interest metas of type "damage" */
+static void
+gst_ximage_src_add_damage_meta (GstXImageSrc * ximagesrc, GstBuffer * ximage)
+{
+  GstVideoRectangle regions[MAX_DAMAGE_REGIONS];
+  gint x0 = G_MAXINT, y0 = G_MAXINT, x1 = 0, y1 = 0;
+  guint ts = ximagesrc->tile_size;
+  guint tx, ty, run, n_regions = 0, i;
+
+  for (ty = 0; ty < ximagesrc->tiles_y; ty++) {
+    const guint64 *gens = &ximagesrc->tile_generation[ty * ximagesrc->tiles_x];
+
+    for (tx = 0; tx < ximagesrc->tiles_x; tx += run) {
+      GstVideoRectangle r;
+
+      for (run = 0; tx + run < ximagesrc->tiles_x &&
+          gens[tx + run] == ximagesrc->damage_generation; run++);
+
+      if (run == 0) {
+        run = 1;
+        continue;
+      }
+
+      r.x = tx * ts;
+      r.y = ty * ts;
+      r.w = MIN ((tx + run) * ts, ximagesrc->width) - r.x;
+      r.h = MIN ((ty + 1) * ts, ximagesrc->height) - r.y;
+
+      if (n_regions < MAX_DAMAGE_REGIONS)
+        regions[n_regions] = r;
+      n_regions++;
+
+      x0 = MIN (x0, r.x);
+      y0 = MIN (y0, r.y);
+      x1 = MAX (x1, r.x + r.w);
+      y1 = MAX (y1, r.y + r.h);
+    }
+  }
+
+  if (n_regions > MAX_DAMAGE_REGIONS) {
+    gst_buffer_add_video_region_of_interest_meta (ximage, "damage", x0, y0,
+        x1 - x0, y1 - y0);
+  } else {
+    for (i = 0; i < n_regions; i++)
+      gst_buffer_add_video_region_of_interest_meta (ximage, "damage",
+          regions[i].x, regions[i].y, regions[i].w, regions[i].h);
+  }
+}
 #endif
 
+static gboolean
+remove_roi_meta (GstBuffer * buffer, GstMeta ** meta, gpointer user_data)
+{
+  if ((*meta)->info->api == GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE)
+    *meta = NULL;
+
+  return TRUE;
+}
+
 /* Retrieve an XImageSrcBuffer, preferably from our
  * pool of existing images and populate it from the window */
 static GstBuffer *
@@ -501,8 +830,11 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
         ximagesrc->buffer_pool);
 
     if ((meta->width == ximagesrc->width) ||
-        (meta->height == ximagesrc->height))
+        (meta->height == ximagesrc->height)) {
+      /* drop the damage regions of the previous use */
+      gst_buffer_foreach_meta (ximage, remove_roi_meta, NULL);
       break;
+    }
 
     gst_ximage_buffer_free (ximage);
     ximage = NULL;
@@ -534,6 +866,15 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
 
 #ifdef HAVE_XDAMAGE
   if (ximagesrc->have_xdamage && ximagesrc->use_damage &&
+      ximagesrc->damage_tile_size > 0) {
+    GST_DEBUG_OBJECT (ximagesrc, "Retrieving screen using XDamage tiles");
+
+    if (!gst_ximage_src_update_damage_frame (ximagesrc)) {
+      gst_buffer_unref (ximage);
+      return NULL;
+    }
+    gst_ximage_src_copy_damage_tiles (ximagesrc, ximage);
+  } else if (ximagesrc->have_xdamage && ximagesrc->use_damage &&
       ximagesrc->last_ximage != NULL) {
     XEvent ev;
     gboolean have_damage = FALSE;
@@ -805,12 +1146,36 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
                 (guint8 *) src);
           }
         }
+#ifdef HAVE_XDAMAGE
+        if (ximagesrc->tile_generation) {
+          ximagesrc->cursor_drawn = TRUE;
+          ximagesrc->cursor_x = startx - ximagesrc->startx;
+          ximagesrc->cursor_y = starty - ximagesrc->starty;
+          ximagesrc->cursor_width = iwidth;
+          ximagesrc->cursor_height = iheight;
+        }
+#endif
       }
     }
   }
 #endif
 #ifdef HAVE_XDAMAGE
-  if (ximagesrc->have_xdamage && ximagesrc->use_damage) {
+  if (ximagesrc->have_xdamage && ximagesrc->use_damage &&
+      ximagesrc->damage_tile_size > 0) {
+    /* the area under the pointer changed as well */
+    if (ximagesrc->cursor_drawn)
+      gst_ximage_src_mark_tiles (ximagesrc, ximagesrc->cursor_x,
+          ximagesrc->cursor_y, ximagesrc->cursor_width,
+          ximagesrc->cursor_height);
+    gst_ximage_src_add_damage_meta (ximagesrc, ximage);
+
+    /* the damage is not accumulated in last_ximage anymore */
+    gst_buffer_replace (&ximagesrc->last_ximage, NULL);
+  } else if (ximagesrc->have_xdamage && ximagesrc->use_damage) {
+    /* the persistent frame misses the damage consumed here */
+    if (ximagesrc->damage_frame)
+      gst_ximage_src_free_damage_frame (ximagesrc);
+
     /* need to ref ximage to put in last_ximage */
     gst_buffer_ref (ximage);
     if (ximagesrc->last_ximage) {
@@ -937,6 +1302,9 @@ gst_ximage_src_set_property (GObject * object, guint prop_id,
     case PROP_USE_DAMAGE:
       src->use_damage = g_value_get_boolean (value);
       break;
+    case PROP_DAMAGE_TILE_SIZE:
+      src->damage_tile_size = g_value_get_uint (value);
+      break;
     case PROP_STARTX:
       src->startx = g_value_get_uint (value);
       break;
@@ -992,6 +1360,9 @@ gst_ximage_src_get_property (GObject * object, guint prop_id,
     case PROP_USE_DAMAGE:
       g_value_set_boolean (value, src->use_damage);
       break;
+    case PROP_DAMAGE_TILE_SIZE:
+      g_value_set_uint (value, src->damage_tile_size);
+      break;
     case PROP_STARTX:
       g_value_set_uint (value, src->startx);
       break;
@@ -1211,6 +1582,22 @@ gst_ximage_src_class_init (GstXImageSrcClass * klass)
       g_param_spec_boolean ("use-damage", "Use XDamage",
           "Use XDamage (if XDamage extension enabled)", TRUE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstXImageSrc:damage-tile-size:
+   *
+   * When non-zero and XDamage is in use, the damaged areas are grabbed into
+   * a persistent frame split in tiles of this size. Output buffers then only
+   * receive the tiles that changed since they were last filled. Each buffer
+   * carries #GstVideoRegionOfInterestMeta of type "damage" for the areas
+   * that changed since the previous frame.
+   *
+   * Since: 1.14
+   */
+  g_object_class_install_property (gc, PROP_DAMAGE_TILE_SIZE,
+      g_param_spec_uint ("damage-tile-size", "Damage tile size",
+          "Size in pixels of the tiles tracked for incremental XDamage "
+          "capture (0 = copy the whole previous frame)", 0, 4096, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
   /**
    * GstXImageSrc:startx:
    *
@@ -81,6 +81,7 @@ struct _GstXImageSrc
   gboolean have_xdamage;
   gboolean show_pointer;
   gboolean use_damage;
+  guint damage_tile_size;
 
   /* co-ordinates for start and end */
   guint startx;
@@ -101,6 +102,20 @@ struct _GstXImageSrc
   XserverRegion damage_region;
   GC damage_copy_gc;
   GstBuffer *last_ximage;
+
+  /* Tile mode: a persistent frame kept up to date with the damaged areas,
+   * and the generation each tile last changed in */
+  GstBuffer *damage_frame;
+  /* the damage of all events handled for one frame */
+  XserverRegion damage_accum;
+  guint64 damage_generation;
+  guint64 *tile_generation;
+  guint tile_size;
+  guint tiles_x, tiles_y;
+
+  /* Area of the frame the cursor was last drawn on, in output coordinates */
+  gboolean cursor_drawn;
+  gint cursor_x, cursor_y, cursor_width, cursor_height;
 #endif
 };
 
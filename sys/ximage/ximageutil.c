@@ -49,6 +49,7 @@ gst_meta_ximage_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   emeta->SHMInfo.readOnly = TRUE;
 #endif
   emeta->width = emeta->height = emeta->size = 0;
+  emeta->damage_generation = 0;
   emeta->return_func = NULL;
 
   return TRUE;
@@ -159,6 +159,9 @@ struct _GstMetaXImage {
   gint width, height;
   size_t size;
 
+  /* Damage generation of the content, used by ximagesrc's tile mode */
+  guint64 damage_generation;
+
   BufferReturnFunc return_func;
 };
 
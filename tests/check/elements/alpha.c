@@ -19,8 +19,12 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 #include <gst/video/video.h>
 
+#include <stdlib.h>
+#include <math.h>
+
 
 GstPad *srcpad, *sinkpad;
 
@@ -248,6 +252,223 @@ GST_START_TEST (test_alpha)
 
 GST_END_TEST;
 
+/* Reference implementation of the chroma keying for AYUV input and output
+ * with the same colorimetry, as in the original per-pixel C code */
+typedef struct
+{
+  gint8 cb, cr, kg;
+  guint8 accept_angle_tg, accept_angle_ctg, one_over_kc, kfgy_scale;
+  guint noise_level2;
+} ChromaKeyParams;
+
+static void
+chroma_key_params_init (ChromaKeyParams * p, gint target_r, gint target_g,
+    gint target_b, gfloat angle, gfloat noise_level)
+{
+  static const gint matrix[] = {
+    66, 129, 25, 4096,
+    -38, -74, 112, 32768,
+    112, -94, -18, 32768,
+  };
+  gfloat kgl, tmp, tmp1, tmp2, y;
+
+  y = (matrix[0] * target_r + matrix[1] * target_g +
+      matrix[2] * target_b + matrix[3]) >> 8;
+  tmp1 = (matrix[4] * target_r + matrix[5] * target_g +
+      matrix[6] * target_b) >> 8;
+  tmp2 = (matrix[8] * target_r + matrix[9] * target_g +
+      matrix[10] * target_b) >> 8;
+
+  kgl = sqrt (tmp1 * tmp1 + tmp2 * tmp2);
+  p->cb = 127 * (tmp1 / kgl);
+  p->cr = 127 * (tmp2 / kgl);
+
+  tmp = 15 * tan (G_PI * angle / 180);
+  tmp = MIN (tmp, 255);
+  p->accept_angle_tg = tmp;
+  tmp = 15 / tan (G_PI * angle / 180);
+  tmp = MIN (tmp, 255);
+  p->accept_angle_ctg = tmp;
+  tmp = 1 / (kgl);
+  p->one_over_kc = 255 * 2 * tmp - 255;
+  tmp = 15 * y / kgl;
+  tmp = MIN (tmp, 255);
+  p->kfgy_scale = tmp;
+  p->kg = MIN (kgl, 127);
+  p->noise_level2 = noise_level * noise_level;
+}
+
+static void
+chroma_key_reference_ayuv (const ChromaKeyParams * p, const guint8 * src,
+    guint8 * dest, gint n_pixels, gint smin, gint smax)
+{
+  gint i, a, y, u, v, tmp, tmp1, x, z, x1, y1, b_alpha;
+
+  for (i = 0; i < n_pixels; i++, src += 4, dest += 4) {
+    a = src[0];
+    y = src[1];
+    u = src[2] - 128;
+    v = src[3] - 128;
+
+    if (y < smin || y > smax)
+      goto done;
+
+    tmp = (u * p->cb + v * p->cr) >> 7;
+    x = CLAMP (tmp, -128, 127);
+    tmp = (v * p->cb - u * p->cr) >> 7;
+    z = CLAMP (tmp, -128, 127);
+
+    tmp = (x * p->accept_angle_tg) >> 4;
+    tmp = MIN (tmp, 127);
+    if (abs (z) > tmp)
+      goto done;
+
+    tmp = (z * p->accept_angle_ctg) >> 4;
+    tmp = CLAMP (tmp, -128, 127);
+    x1 = abs (tmp);
+    y1 = z;
+
+    tmp1 = x - x1;
+    tmp1 = MAX (tmp1, 0);
+    b_alpha = (tmp1 * p->one_over_kc) / 2;
+    b_alpha = 255 - CLAMP (b_alpha, 0, 255);
+    b_alpha = (a * b_alpha) >> 8;
+
+    tmp = (tmp1 * p->kfgy_scale) >> 4;
+    tmp1 = MIN (tmp, 255);
+    y = (y < tmp1) ? 0 : y - tmp1;
+
+    tmp = (x1 * p->cb - y1 * p->cr) >> 7;
+    u = CLAMP (tmp, -128, 127);
+    tmp = (x1 * p->cr + y1 * p->cb) >> 7;
+    v = CLAMP (tmp, -128, 127);
+
+    tmp = z * z + (x - p->kg) * (x - p->kg);
+    tmp = MIN (tmp, 0xffff);
+    if (tmp < p->noise_level2)
+      b_alpha = 0;
+
+    a = b_alpha;
+
+  done:
+    dest[0] = a;
+    dest[1] = y;
+    dest[2] = u + 128;
+    dest[3] = v + 128;
+  }
+}
+
+#define KEY_WIDTH 64
+#define KEY_HEIGHT 64
+
+static GstBuffer *
+run_chroma_key (const gchar * format, GstBuffer * inbuf, guint n_threads)
+{
+  GstHarness *h;
+  GstBuffer *outbuf;
+  gchar *launch;
+
+  launch = g_strdup_printf ("alpha method=green n-threads=%u ! "
+      "capsfilter caps=video/x-raw,format=AYUV,colorimetry=bt601", n_threads);
+  h = gst_harness_new_parse (launch);
+  g_free (launch);
+
+  gst_harness_set_src_caps (h, gst_caps_new_simple ("video/x-raw",
+          "format", G_TYPE_STRING, format,
+          "width", G_TYPE_INT, KEY_WIDTH,
+          "height", G_TYPE_INT, KEY_HEIGHT,
+          "framerate", GST_TYPE_FRACTION, 0, 1,
+          "colorimetry", G_TYPE_STRING, "bt601", NULL));
+
+  outbuf = gst_harness_push_and_pull (h, gst_buffer_ref (inbuf));
+  fail_unless (outbuf != NULL);
+
+  gst_harness_teardown (h);
+
+  return outbuf;
+}
+
+static GstBuffer *
+create_random_buffer (gsize size)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  GRand *rand;
+  gsize i;
+
+  rand = g_rand_new_with_seed (0xa1fa);
+  buf = gst_buffer_new_and_alloc (size);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  for (i = 0; i < size; i++)
+    map.data[i] = g_rand_int_range (rand, 0, 256);
+  gst_buffer_unmap (buf, &map);
+  g_rand_free (rand);
+
+  return buf;
+}
+
+GST_START_TEST (test_chromakeying_bitexact)
+{
+  ChromaKeyParams params;
+  GstBuffer *inbuf, *outbuf;
+  GstMapInfo in_map, out_map;
+  guint8 *expected;
+  guint n_threads;
+
+  chroma_key_params_init (&params, 0, 255, 0, 20.0, 2.0);
+
+  inbuf = create_random_buffer (KEY_WIDTH * KEY_HEIGHT * 4);
+  gst_buffer_map (inbuf, &in_map, GST_MAP_READ);
+  expected = g_malloc (in_map.size);
+  chroma_key_reference_ayuv (&params, in_map.data, expected,
+      KEY_WIDTH * KEY_HEIGHT, 128 - 100, 128 + 100);
+  gst_buffer_unmap (inbuf, &in_map);
+
+  for (n_threads = 1; n_threads <= 4; n_threads++) {
+    outbuf = run_chroma_key ("AYUV", inbuf, n_threads);
+    gst_buffer_map (outbuf, &out_map, GST_MAP_READ);
+    fail_unless_equals_int (out_map.size, KEY_WIDTH * KEY_HEIGHT * 4);
+    fail_unless (memcmp (out_map.data, expected, out_map.size) == 0,
+        "output with %u threads differs from reference", n_threads);
+    gst_buffer_unmap (outbuf, &out_map);
+    gst_buffer_unref (outbuf);
+  }
+
+  g_free (expected);
+  gst_buffer_unref (inbuf);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_chromakeying_sliced)
+{
+  static const gchar *formats[] = { "I420", "YUY2", "ARGB", "RGB" };
+  GstBuffer *inbuf, *outbuf, *outbuf_sliced;
+  GstVideoInfo info;
+  GstMapInfo map;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    gst_video_info_set_format (&info, gst_video_format_from_string (formats[i]),
+        KEY_WIDTH, KEY_HEIGHT);
+    inbuf = create_random_buffer (GST_VIDEO_INFO_SIZE (&info));
+
+    outbuf = run_chroma_key (formats[i], inbuf, 1);
+    outbuf_sliced = run_chroma_key (formats[i], inbuf, 4);
+    fail_unless_equals_int (gst_buffer_get_size (outbuf),
+        gst_buffer_get_size (outbuf_sliced));
+    gst_buffer_map (outbuf, &map, GST_MAP_READ);
+    fail_unless (gst_buffer_memcmp (outbuf_sliced, 0, map.data,
+            map.size) == 0, "sliced %s output differs", formats[i]);
+    gst_buffer_unmap (outbuf, &map);
+
+    gst_buffer_unref (outbuf_sliced);
+    gst_buffer_unref (outbuf);
+    gst_buffer_unref (inbuf);
+  }
+}
+
+GST_END_TEST;
 
 static Suite *
 alpha_suite (void)
@@ -258,6 +479,8 @@ alpha_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_alpha);
   tcase_add_test (tc_chain, test_chromakeying);
+  tcase_add_test (tc_chain, test_chromakeying_bitexact);
+  tcase_add_test (tc_chain, test_chromakeying_sliced);
 
   return s;
 }
@@ -0,0 +1,314 @@
+/* GStreamer unit tests for avidemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbytewriter.h>
+
+/* one video stream at 25 fps, indexed by N_SUBINDEXES OpenDML subindexes
+ * of FRAMES_PER_SUBINDEX frames each */
+#define N_SUBINDEXES 4
+#define FRAMES_PER_SUBINDEX 25
+#define N_FRAMES (N_SUBINDEXES * FRAMES_PER_SUBINDEX)
+#define KEYFRAME_INTERVAL 5
+#define FRAME_SIZE 16
+#define FRAME_DURATION (GST_SECOND / 25)
+
+static guint
+chunk_start (GstByteWriter * bw, const gchar * fourcc)
+{
+  guint pos;
+
+  gst_byte_writer_put_data (bw, (const guint8 *) fourcc, 4);
+  pos = gst_byte_writer_get_pos (bw);
+  gst_byte_writer_put_uint32_le (bw, 0);
+
+  return pos;
+}
+
+static void
+chunk_end (GstByteWriter * bw, guint size_pos)
+{
+  guint pos = gst_byte_writer_get_pos (bw);
+
+  gst_byte_writer_set_pos (bw, size_pos);
+  gst_byte_writer_put_uint32_le (bw, pos - size_pos - 4);
+  gst_byte_writer_set_pos (bw, pos);
+}
+
+static guint
+list_start (GstByteWriter * bw, const gchar * id, const gchar * fourcc)
+{
+  guint pos = chunk_start (bw, id);
+
+  gst_byte_writer_put_data (bw, (const guint8 *) fourcc, 4);
+
+  return pos;
+}
+
+/* Writes an OpenDML file without idx1, so only the superindex in the
+ * stream header and the ix00 chunks in front of each group of frames
+ * index it. Returns the file name */
+static gchar *
+write_odml_file (void)
+{
+  GstByteWriter bw;
+  guint riff, hdrl, strl, chunk, movi;
+  guint indx_entries, sub, frame;
+  guint64 sub_offsets[N_SUBINDEXES];
+  guint sub_sizes[N_SUBINDEXES];
+  guint8 *data;
+  gsize size;
+  gchar *location;
+  gint fd;
+
+  gst_byte_writer_init (&bw);
+
+  riff = list_start (&bw, "RIFF", "AVI ");
+  hdrl = list_start (&bw, "LIST", "hdrl");
+
+  chunk = chunk_start (&bw, "avih");
+  gst_byte_writer_put_uint32_le (&bw, FRAME_DURATION / GST_USECOND);
+  gst_byte_writer_fill (&bw, 0, 12);    /* max_bps, pad_gran, flags */
+  gst_byte_writer_put_uint32_le (&bw, N_FRAMES);
+  gst_byte_writer_put_uint32_le (&bw, 0);       /* init_frames */
+  gst_byte_writer_put_uint32_le (&bw, 1);       /* streams */
+  gst_byte_writer_put_uint32_le (&bw, 0);       /* bufsize */
+  gst_byte_writer_put_uint32_le (&bw, 16);
+  gst_byte_writer_put_uint32_le (&bw, 16);
+  gst_byte_writer_fill (&bw, 0, 16);    /* scale, rate, start, length */
+  chunk_end (&bw, chunk);
+
+  strl = list_start (&bw, "LIST", "strl");
+
+  chunk = chunk_start (&bw, "strh");
+  gst_byte_writer_put_data (&bw, (const guint8 *) "vidsMJPG", 8);
+  gst_byte_writer_fill (&bw, 0, 12);    /* flags, priority, init_frames */
+  gst_byte_writer_put_uint32_le (&bw, 1);       /* scale */
+  gst_byte_writer_put_uint32_le (&bw, 25);      /* rate */
+  gst_byte_writer_put_uint32_le (&bw, 0);       /* start */
+  gst_byte_writer_put_uint32_le (&bw, N_FRAMES);
+  gst_byte_writer_put_uint32_le (&bw, FRAME_SIZE);
+  gst_byte_writer_put_uint32_le (&bw, G_MAXUINT32);     /* quality */
+  gst_byte_writer_put_uint32_le (&bw, 0);       /* samplesize */
+  gst_byte_writer_fill (&bw, 0, 8);     /* frame rectangle */
+  chunk_end (&bw, chunk);
+
+  chunk = chunk_start (&bw, "strf");
+  gst_byte_writer_put_uint32_le (&bw, 40);
+  gst_byte_writer_put_uint32_le (&bw, 16);
+  gst_byte_writer_put_uint32_le (&bw, 16);
+  gst_byte_writer_put_uint16_le (&bw, 1);       /* planes */
+  gst_byte_writer_put_uint16_le (&bw, 24);      /* bit_cnt */
+  gst_byte_writer_put_data (&bw, (const guint8 *) "MJPG", 4);
+  gst_byte_writer_fill (&bw, 0, 20);
+  chunk_end (&bw, chunk);
+
+  /* superindex, the entries are filled in once the subindexes are
+   * written */
+  chunk = chunk_start (&bw, "indx");
+  gst_byte_writer_put_uint16_le (&bw, 4);       /* longs per entry */
+  gst_byte_writer_put_uint8 (&bw, 0);   /* sub type */
+  gst_byte_writer_put_uint8 (&bw, 0);   /* AVI_INDEX_OF_INDEXES */
+  gst_byte_writer_put_uint32_le (&bw, N_SUBINDEXES);
+  gst_byte_writer_put_data (&bw, (const guint8 *) "00dc", 4);
+  gst_byte_writer_fill (&bw, 0, 12);
+  indx_entries = gst_byte_writer_get_pos (&bw);
+  gst_byte_writer_fill (&bw, 0, 16 * N_SUBINDEXES);
+  chunk_end (&bw, chunk);
+
+  chunk_end (&bw, strl);
+  chunk_end (&bw, hdrl);
+
+  movi = list_start (&bw, "LIST", "movi");
+  for (sub = 0; sub < N_SUBINDEXES; sub++) {
+    guint64 first_data;
+
+    /* the frames follow the subindex, their data starts after the
+     * 8 byte chunk header */
+    sub_offsets[sub] = gst_byte_writer_get_pos (&bw);
+    sub_sizes[sub] = 8 + 24 + 8 * FRAMES_PER_SUBINDEX;
+    first_data = sub_offsets[sub] + sub_sizes[sub] + 8;
+
+    chunk = chunk_start (&bw, "ix00");
+    gst_byte_writer_put_uint16_le (&bw, 2);     /* longs per entry */
+    gst_byte_writer_put_uint8 (&bw, 0); /* sub type */
+    gst_byte_writer_put_uint8 (&bw, 1); /* AVI_INDEX_OF_CHUNKS */
+    gst_byte_writer_put_uint32_le (&bw, FRAMES_PER_SUBINDEX);
+    gst_byte_writer_put_data (&bw, (const guint8 *) "00dc", 4);
+    gst_byte_writer_put_uint64_le (&bw, 0);     /* base offset */
+    gst_byte_writer_put_uint32_le (&bw, 0);
+    for (frame = 0; frame < FRAMES_PER_SUBINDEX; frame++) {
+      guint32 flags = (frame % KEYFRAME_INTERVAL) ? 0x80000000 : 0;
+
+      gst_byte_writer_put_uint32_le (&bw, first_data + frame * (8 +
+              FRAME_SIZE));
+      gst_byte_writer_put_uint32_le (&bw, FRAME_SIZE | flags);
+    }
+    chunk_end (&bw, chunk);
+
+    for (frame = 0; frame < FRAMES_PER_SUBINDEX; frame++) {
+      chunk = chunk_start (&bw, "00dc");
+      gst_byte_writer_fill (&bw, sub * FRAMES_PER_SUBINDEX + frame,
+          FRAME_SIZE);
+      chunk_end (&bw, chunk);
+    }
+  }
+  chunk_end (&bw, movi);
+  chunk_end (&bw, riff);
+
+  gst_byte_writer_set_pos (&bw, indx_entries);
+  for (sub = 0; sub < N_SUBINDEXES; sub++) {
+    gst_byte_writer_put_uint64_le (&bw, sub_offsets[sub]);
+    gst_byte_writer_put_uint32_le (&bw, sub_sizes[sub]);
+    gst_byte_writer_put_uint32_le (&bw, FRAMES_PER_SUBINDEX);
+  }
+
+  size = gst_byte_writer_get_size (&bw);
+  data = gst_byte_writer_reset_and_get_data (&bw);
+
+  fd = g_file_open_tmp ("avidemux-odml-XXXXXX.avi", &location, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (location, (const gchar *) data, size,
+          NULL));
+  g_free (data);
+
+  return location;
+}
+
+static void
+handoff_cb (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    GArray * timestamps)
+{
+  GstClockTime ts = GST_BUFFER_PTS (buf);
+
+  g_array_append_val (timestamps, ts);
+}
+
+static void
+wait_for (GstElement * pipeline, GstMessageType type)
+{
+  GstMessage *msg;
+
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipeline), type | GST_MESSAGE_ERROR,
+      -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), type);
+  gst_message_unref (msg);
+}
+
+/* Plays @location from a seek to @position to EOS. In pull mode avidemux
+ * only loads the first subindex up front, through a queue it runs in push
+ * mode, which reads all of them before playing */
+static GArray *
+play_from (const gchar * location, gboolean pull, GstClockTime position,
+    gint64 * duration)
+{
+  GstElement *pipeline, *sink;
+  GArray *timestamps;
+  gchar *desc;
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" ! %s avidemux ! "
+      "fakesink name=sink signal-handoffs=true sync=false", location,
+      pull ? "" : "queue !");
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  timestamps = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff_cb), timestamps);
+  gst_object_unref (sink);
+
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  wait_for (pipeline, GST_MESSAGE_ASYNC_DONE);
+
+  fail_unless (gst_element_query_duration (pipeline, GST_FORMAT_TIME,
+          duration));
+
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, position));
+  wait_for (pipeline, GST_MESSAGE_ASYNC_DONE);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  wait_for (pipeline, GST_MESSAGE_EOS);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return timestamps;
+}
+
+GST_START_TEST (test_odml_seek_past_first_subindex)
+{
+  GArray *pull_ts, *push_ts;
+  gint64 pull_duration, push_duration;
+  GstClockTime position;
+  gchar *location;
+  guint i;
+
+  location = write_odml_file ();
+
+  /* into the third subindex, between two keyframes */
+  position = (2 * FRAMES_PER_SUBINDEX + 7) * FRAME_DURATION;
+  pull_ts = play_from (location, TRUE, position, &pull_duration);
+  push_ts = play_from (location, FALSE, position, &push_duration);
+
+  fail_unless_equals_uint64 (pull_duration, N_FRAMES * FRAME_DURATION);
+  fail_unless_equals_uint64 (pull_duration, push_duration);
+
+  /* the last frame was reached through the subindexes loaded on demand,
+   * from the keyframe before the seek position */
+  fail_unless (pull_ts->len > 0);
+  fail_unless_equals_uint64 (g_array_index (pull_ts, GstClockTime, 0),
+      (2 * FRAMES_PER_SUBINDEX + 5) * FRAME_DURATION);
+  fail_unless_equals_uint64 (g_array_index (pull_ts, GstClockTime,
+          pull_ts->len - 1), (N_FRAMES - 1) * FRAME_DURATION);
+
+  fail_unless_equals_int (pull_ts->len, push_ts->len);
+  for (i = 0; i < pull_ts->len; i++)
+    fail_unless_equals_uint64 (g_array_index (pull_ts, GstClockTime, i),
+        g_array_index (push_ts, GstClockTime, i));
+
+  g_array_free (pull_ts, TRUE);
+  g_array_free (push_ts, TRUE);
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+static Suite *
+avidemux_suite (void)
+{
+  Suite *s = suite_create ("avidemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_odml_seek_past_first_subindex);
+
+  return s;
+}
+
+GST_CHECK_MAIN (avidemux)
@@ -0,0 +1,224 @@
+/* GStreamer unit tests for dvdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "dvframe.h"
+
+#define N_FRAMES 24
+#define FLUSH_AFTER 7
+#define FRAME_DURATION (GST_SECOND / 25)
+
+static GstBuffer *frames[N_FRAMES];
+
+static void
+make_frames (void)
+{
+  GRand *rand;
+  gint i;
+
+  rand = g_rand_new_with_seed (0xdec);
+  for (i = 0; i < N_FRAMES; i++) {
+    frames[i] = make_frame (TRUE, SMP_48000, 24, rand);
+    GST_BUFFER_PTS (frames[i]) = i * FRAME_DURATION;
+    GST_BUFFER_DURATION (frames[i]) = FRAME_DURATION;
+  }
+  g_rand_free (rand);
+}
+
+static void
+free_frames (void)
+{
+  gint i;
+
+  for (i = 0; i < N_FRAMES; i++)
+    gst_buffer_replace (&frames[i], NULL);
+}
+
+static GstHarness *
+setup_dvdec (guint n_threads)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("dvdec");
+  g_object_set (h->element, "n-threads", n_threads, NULL);
+  gst_harness_set_src_caps_str (h, "video/x-dv, systemstream=(boolean)false, "
+      "framerate=(fraction)25/1");
+
+  return h;
+}
+
+static void
+push_frames (GstHarness * h, gint first, gint last)
+{
+  gint i;
+
+  for (i = first; i < last; i++)
+    fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (frames[i])),
+        GST_FLOW_OK);
+}
+
+/* Decodes all frames one by one, as the reference for the threaded runs */
+static GstBuffer **
+decode_reference (void)
+{
+  GstBuffer **decoded = g_new0 (GstBuffer *, N_FRAMES);
+  GstHarness *h;
+  gint i;
+
+  h = setup_dvdec (1);
+  push_frames (h, 0, N_FRAMES);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), N_FRAMES);
+  for (i = 0; i < N_FRAMES; i++)
+    decoded[i] = gst_harness_pull (h);
+  gst_harness_teardown (h);
+
+  return decoded;
+}
+
+static void
+free_reference (GstBuffer ** decoded)
+{
+  gint i;
+
+  for (i = 0; i < N_FRAMES; i++)
+    gst_buffer_unref (decoded[i]);
+  g_free (decoded);
+}
+
+/* Pulls the next output frame and checks it is the decoded frame @i */
+static void
+check_output (GstHarness * h, GstBuffer ** decoded, gint i)
+{
+  GstBuffer *buf;
+  GstMapInfo ref_map;
+
+  buf = gst_harness_pull (h);
+  fail_unless (buf != NULL);
+
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * FRAME_DURATION);
+  fail_unless_equals_uint64 (GST_BUFFER_DURATION (buf), FRAME_DURATION);
+
+  gst_buffer_map (decoded[i], &ref_map, GST_MAP_READ);
+  fail_unless_equals_int (gst_buffer_get_size (buf), ref_map.size);
+  fail_unless (gst_buffer_memcmp (buf, 0, ref_map.data, ref_map.size) == 0,
+      "frame %d differs from the single-threaded output", i);
+  gst_buffer_unmap (decoded[i], &ref_map);
+
+  gst_buffer_unref (buf);
+}
+
+/* The frames decoded in parallel come out in input order, with their
+ * timestamps and the same pixels as with a single thread. The EOS right
+ * after the last frame finds most of them still decoding */
+GST_START_TEST (test_threads_match_single_thread)
+{
+  GstBuffer **decoded;
+  GstHarness *h;
+  GstEvent *event;
+  gboolean got_eos = FALSE;
+  gint i;
+
+  make_frames ();
+  decoded = decode_reference ();
+
+  h = setup_dvdec (4);
+  push_frames (h, 0, N_FRAMES);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), N_FRAMES);
+  for (i = 0; i < N_FRAMES; i++)
+    check_output (h, decoded, i);
+
+  /* the EOS followed the frames */
+  while ((event = gst_harness_try_pull_event (h))) {
+    got_eos = GST_EVENT_TYPE (event) == GST_EVENT_EOS;
+    gst_event_unref (event);
+  }
+  fail_unless (got_eos);
+
+  gst_harness_teardown (h);
+  free_reference (decoded);
+  free_frames ();
+}
+
+GST_END_TEST;
+
+/* A flush drops the frames still decoding, the ones already pushed and
+ * the ones after the flush are unaffected */
+GST_START_TEST (test_threads_flush)
+{
+  GstBuffer **decoded;
+  GstHarness *h;
+  GstSegment segment;
+  guint n_before;
+  gint i;
+
+  make_frames ();
+  decoded = decode_reference ();
+
+  h = setup_dvdec (4);
+  push_frames (h, 0, FLUSH_AFTER);
+
+  /* with up to 8 frames in flight, some are still pending here */
+  n_before = gst_harness_buffers_in_queue (h);
+  fail_unless (n_before < FLUSH_AFTER);
+  for (i = 0; i < n_before; i++)
+    check_output (h, decoded, i);
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+
+  push_frames (h, FLUSH_AFTER, N_FRAMES);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h),
+      N_FRAMES - FLUSH_AFTER);
+  for (i = FLUSH_AFTER; i < N_FRAMES; i++)
+    check_output (h, decoded, i);
+
+  gst_harness_teardown (h);
+  free_reference (decoded);
+  free_frames ();
+}
+
+GST_END_TEST;
+
+static Suite *
+dvdec_suite (void)
+{
+  Suite *s = suite_create ("dvdec");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_threads_match_single_thread);
+  tcase_add_test (tc_chain, test_threads_flush);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dvdec)
@@ -0,0 +1,142 @@
+/* GStreamer unit tests for dvdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include <libdv/dv.h>
+
+#include "dvframe.h"
+
+/* Demuxes one frame and compares the audio with what libdv decodes from
+ * the same frame */
+static void
+check_audio (gboolean pal, guint smp, guint af_size, gint rate,
+    gint num_samples)
+{
+  GstHarness *h;
+  GstBuffer *frame, *outbuf;
+  GstMapInfo in_map, out_map;
+  GstCaps *caps;
+  GstStructure *s;
+  dv_decoder_t *decoder;
+  gint16 *ref[4];
+  const guint8 *out;
+  GRand *rand;
+  gint i, value;
+
+  rand = g_rand_new_with_seed (0xd1f);
+  frame = make_frame (pal, smp, af_size, rand);
+  g_rand_free (rand);
+
+  h = gst_harness_new_with_padnames ("dvdemux", "sink", "audio");
+  gst_harness_set_src_caps_str (h, "video/x-dv, systemstream=(boolean)true");
+  fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (frame)),
+      GST_FLOW_OK);
+  outbuf = gst_harness_pull (h);
+  fail_unless (outbuf != NULL);
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless (gst_structure_get_int (s, "rate", &value));
+  fail_unless_equals_int (value, rate);
+  fail_unless (gst_structure_get_int (s, "channels", &value));
+  fail_unless_equals_int (value, 2);
+  gst_caps_unref (caps);
+
+  for (i = 0; i < 4; i++)
+    ref[i] = g_new0 (gint16, DV_AUDIO_MAX_SAMPLES);
+
+  gst_buffer_map (frame, &in_map, GST_MAP_READ);
+  decoder = dv_decoder_new (0, FALSE, FALSE);
+  fail_unless (dv_parse_header (decoder, in_map.data) >= 0);
+  fail_unless (dv_decode_full_audio (decoder, in_map.data, ref));
+  fail_unless_equals_int (dv_get_num_samples (decoder), num_samples);
+  fail_unless_equals_int (dv_get_num_channels (decoder), 2);
+  dv_decoder_free (decoder);
+  gst_buffer_unmap (frame, &in_map);
+
+  gst_buffer_map (outbuf, &out_map, GST_MAP_READ);
+  fail_unless_equals_int (out_map.size, num_samples * 2 * sizeof (gint16));
+  out = out_map.data;
+  for (i = 0; i < num_samples; i++) {
+    fail_unless_equals_int ((gint16) GST_READ_UINT16_LE (out + 4 * i),
+        ref[0][i]);
+    fail_unless_equals_int ((gint16) GST_READ_UINT16_LE (out + 4 * i + 2),
+        ref[1][i]);
+  }
+  gst_buffer_unmap (outbuf, &out_map);
+
+  for (i = 0; i < 4; i++)
+    g_free (ref[i]);
+  gst_buffer_unref (outbuf);
+  gst_buffer_unref (frame);
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_audio_pal_48000)
+{
+  /* 1896 + 24 samples, the length of most PAL frames */
+  check_audio (TRUE, SMP_48000, 24, 48000, 1920);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_audio_pal_32000)
+{
+  check_audio (TRUE, SMP_32000, 16, 32000, 1280);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_audio_ntsc_48000)
+{
+  /* the longest of the NTSC frames, 1580 + 22 samples */
+  check_audio (FALSE, SMP_48000, 22, 48000, 1602);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_audio_ntsc_32000)
+{
+  check_audio (FALSE, SMP_32000, 15, 32000, 1068);
+}
+
+GST_END_TEST;
+
+static Suite *
+dvdemux_suite (void)
+{
+  Suite *s = suite_create ("dvdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_audio_pal_48000);
+  tcase_add_test (tc_chain, test_audio_pal_32000);
+  tcase_add_test (tc_chain, test_audio_ntsc_48000);
+  tcase_add_test (tc_chain, test_audio_ntsc_32000);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dvdemux)
@@ -0,0 +1,134 @@
+/* GStreamer
+ *
+ * Synthetic DV frames for the dvdemux and dvdec tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+#include <string.h>
+
+#define DIF_BLOCK_SIZE 80
+#define DIF_BLOCKS_PER_SEQUENCE 150
+
+/* section types of the DIF block IDs */
+#define DIF_SCT_HEADER 0
+#define DIF_SCT_SUBCODE 1
+#define DIF_SCT_VAUX 2
+#define DIF_SCT_AUDIO 3
+#define DIF_SCT_VIDEO 4
+
+/* AAUX sampling frequency codes */
+#define SMP_48000 0
+#define SMP_32000 2
+
+static guint8 *
+write_block_id (guint8 * block, guint sct, guint dseq, guint dbn)
+{
+  memset (block, 0xff, DIF_BLOCK_SIZE);
+  block[0] = (sct << 5) | 0x1f;
+  block[1] = (dseq << 4) | 0x07;
+  block[2] = dbn;
+
+  return block + 3;
+}
+
+/* Builds a 25 Mbit/s DV frame with random 16 bit stereo audio and the AAUX
+ * source and source control packs of a recording at the given sampling
+ * frequency. Every DCT block of the video has a random DC coefficient
+ * followed by the end of block code */
+static GstBuffer *
+make_frame (gboolean pal, guint smp, guint af_size, GRand * rand)
+{
+  guint n_sequences = pal ? 12 : 10;
+  gsize size = n_sequences * DIF_BLOCKS_PER_SEQUENCE * DIF_BLOCK_SIZE;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint8 *block, *data;
+  guint dseq, i, v, j, b, dc;
+
+  buf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  block = map.data;
+
+  for (dseq = 0; dseq < n_sequences; dseq++) {
+    /* the second half of the sequences has the second channel */
+    gboolean second = dseq >= n_sequences / 2;
+
+    /* header: DSF bit, APT = 0 and all areas transmitted */
+    data = write_block_id (block, DIF_SCT_HEADER, dseq, 0);
+    data[0] = pal ? 0xbf : 0x3f;
+    data[1] = 0xf8;
+    data[2] = data[3] = data[4] = 0x78;
+    block += DIF_BLOCK_SIZE;
+
+    for (i = 0; i < 2; i++, block += DIF_BLOCK_SIZE)
+      write_block_id (block, DIF_SCT_SUBCODE, dseq, i);
+    for (i = 0; i < 3; i++, block += DIF_BLOCK_SIZE)
+      write_block_id (block, DIF_SCT_VAUX, dseq, i);
+
+    for (i = 0; i < 9; i++) {
+      data = write_block_id (block, DIF_SCT_AUDIO, dseq, i);
+
+      /* the packs are in blocks 3 and 4 of even and 0 and 1 of odd
+       * sequences */
+      if (i == ((dseq & 1) ? 0 : 3)) {
+        /* source: locked, 2 channels per block group, no emphasis, 16 bit */
+        data[0] = 0x50;
+        data[1] = 0xc0 | af_size;
+        data[2] = second ? 0x01 : 0x00;
+        data[3] = 0xc0 | (pal ? 0x20 : 0x00);
+        data[4] = 0x80 | (smp << 3);
+      } else if (i == ((dseq & 1) ? 1 : 4)) {
+        /* source control: digital input, original recording, forward at
+         * normal speed */
+        data[0] = 0x51;
+        data[1] = 0x1c;
+        data[2] = 0xcf;
+        data[3] = 0x80 | (pal ? 0x20 : 0x78);
+        data[4] = 0xff;
+      }
+
+      /* 36 big endian samples, 0x8000 marks an error sample */
+      for (j = 5; j < DIF_BLOCK_SIZE - 3; j += 2) {
+        data[j] = g_rand_int_range (rand, 0, 256);
+        data[j + 1] = g_rand_int_range (rand, 0, 256);
+        if (data[j] == 0x80 && data[j + 1] == 0x00)
+          data[j + 1] = 0x01;
+      }
+      block += DIF_BLOCK_SIZE;
+
+      for (v = 0; v < 15; v++, block += DIF_BLOCK_SIZE) {
+        data = write_block_id (block, DIF_SCT_VIDEO, dseq, i * 15 + v);
+        *data++ = 0x0f;
+        memset (data, 0, DIF_BLOCK_SIZE - 4);
+
+        /* four 14 byte luma and two 10 byte chroma blocks: 9 bits DC,
+         * mode, class and the 4 bit EOB code */
+        for (b = 0; b < 6; b++) {
+          dc = g_rand_int_range (rand, 0, 0x200);
+          data[0] = dc >> 1;
+          data[1] = ((dc & 1) << 7) | 0x06;
+          data += b < 4 ? 14 : 10;
+        }
+      }
+    }
+  }
+
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
@@ -169,6 +169,119 @@ GST_START_TEST (test_reuse_push)
 
 GST_END_TEST;
 
+typedef struct
+{
+  GHashTable *scanned;          /* tag offsets read by the index scan */
+  guint scans;
+  guint tag_reads;
+  guint tag_reads_scanned;
+} PullCheck;
+
+/* The index scan reads the first 12 bytes of a tag, playback first reads
+ * the 4 bytes with its type and size */
+static GstPadProbeReturn
+pull_probe_cb (GstPad * pad, GstPadProbeInfo * info, PullCheck * check)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  gpointer offset = GSIZE_TO_POINTER (GST_PAD_PROBE_INFO_OFFSET (info));
+
+  if (gst_buffer_get_size (buf) == 12) {
+    g_hash_table_add (check->scanned, offset);
+    check->scans++;
+  } else if (gst_buffer_get_size (buf) == 4) {
+    check->tag_reads++;
+    if (g_hash_table_contains (check->scanned, offset))
+      check->tag_reads_scanned++;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* The index is built ahead of playback, seeking only needs a lookup then */
+GST_START_TEST (test_seek_background_index)
+{
+  GstElement *pipeline, *src, *flvdemux, *sink;
+  GstStateChangeReturn state_ret;
+  PullCheck check = { NULL, };
+  GstMessage *msg;
+  GstPad *pad;
+  GstBus *bus;
+  gint64 duration = -1;
+  gint counter = 0;
+  gchar *path;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("filesrc", "filesrc");
+  flvdemux = gst_element_factory_make ("flvdemux", "flvdemux");
+  sink = gst_element_factory_make ("fakesink", "fakesink");
+  fail_unless (src != NULL && flvdemux != NULL && sink != NULL);
+
+  g_object_set (flvdemux, "background-index", TRUE, NULL);
+  g_object_set (sink, "signal-handoffs", TRUE, "sync", FALSE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff_cb), &counter);
+
+  check.scanned = g_hash_table_new (g_direct_hash, g_direct_equal);
+  pad = gst_element_get_static_pad (flvdemux, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_PULL | GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) pull_probe_cb, &check, NULL);
+  gst_object_unref (pad);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, flvdemux, sink, NULL);
+  fail_unless (gst_element_link (src, flvdemux));
+  g_signal_connect (flvdemux, "pad-added", G_CALLBACK (pad_added_cb), pipeline);
+
+  path = g_build_filename (GST_TEST_FILES_PATH, "pcm16sine.flv", NULL);
+  g_object_set (src, "location", path, NULL);
+
+  bus = gst_element_get_bus (pipeline);
+  gst_bus_set_sync_handler (bus, error_cb, (gpointer) "pcm16sine.flv", NULL);
+
+  state_ret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  fail_unless (state_ret != GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_poll (bus, GST_MESSAGE_EOS, -1);
+  fail_unless (msg != NULL);
+  gst_message_unref (msg);
+  fail_unless_equals_int (counter, 129);
+
+  /* every tag but the first was in the index before playback read it */
+  fail_unless (check.tag_reads > 1);
+  fail_unless (check.tag_reads_scanned >= check.tag_reads - 1,
+      "only %u of %u tags were indexed ahead of playback",
+      check.tag_reads_scanned, check.tag_reads);
+
+  fail_unless (gst_element_query_duration (pipeline, GST_FORMAT_TIME,
+          &duration));
+  fail_unless (duration > 0);
+
+  /* the index is complete, the seek must not scan the file again */
+  check.scans = 0;
+  counter = 0;
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, duration / 2));
+  state_ret = gst_element_get_state (pipeline, NULL, NULL, -1);
+  fail_unless_equals_int (state_ret, GST_STATE_CHANGE_SUCCESS);
+
+  msg = gst_bus_poll (bus, GST_MESSAGE_EOS, -1);
+  fail_unless (msg != NULL);
+  gst_message_unref (msg);
+
+  fail_unless_equals_int (check.scans, 0);
+
+  /* only the second half of the file was played */
+  fail_unless (counter > 0);
+  fail_unless (counter < 129);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  g_hash_table_unref (check.scanned);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+  g_free (path);
+}
+
+GST_END_TEST;
+
 static GstBuffer *
 create_buffer (guint8 * data, gsize size)
 {
@@ -533,6 +646,7 @@ flvdemux_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_reuse_push);
   tcase_add_test (tc_chain, test_reuse_pull);
+  tcase_add_test (tc_chain, test_seek_background_index);
 
   tcase_add_test (tc_chain, test_speex);
   tcase_add_test (tc_chain, test_aac);
@@ -32,6 +32,7 @@
 #include <gst/check/gstharness.h>
 
 #include <gst/gst.h>
+#include <glib/gstdio.h>
 
 static GstBusSyncReply
 error_cb (GstBus * bus, GstMessage * msg, gpointer user_data)
@@ -155,6 +156,91 @@ GST_START_TEST (test_index_writing)
 
 GST_END_TEST;
 
+static const guint8 *
+find_bytes (const guint8 * data, gsize size, const gchar * needle, gsize len)
+{
+  gsize i;
+
+  for (i = 0; i + len <= size; i++) {
+    if (memcmp (data + i, needle, len) == 0)
+      return data + i;
+  }
+
+  return NULL;
+}
+
+/* The index written at EOS covers the whole file, even with far more seek
+ * points than it can hold */
+GST_START_TEST (test_index_bounded)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  const guint8 *data, *times, *positions;
+  gchar *location, *desc, *contents;
+  gdouble last_time = -1.0;
+  guint32 i, n;
+  gsize size;
+  gint fd;
+
+  fd = g_file_open_tmp ("flvmux-XXXXXX.flv", &location, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+
+  desc = g_strdup_printf ("audiotestsrc num-buffers=2000 ! audioconvert ! "
+      "flvmux ! filesink location=\"%s\"", location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  gst_bus_set_sync_handler (GST_ELEMENT_BUS (pipeline), error_cb, NULL, NULL);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipeline), GST_MESSAGE_EOS, -1);
+  fail_unless (msg != NULL);
+  gst_message_unref (msg);
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+
+  fail_unless (g_file_get_contents (location, &contents, &size, NULL));
+  data = (const guint8 *) contents;
+
+  times = find_bytes (data, size, "\x00\x05" "times" "\x0a", 8);
+  fail_unless (times != NULL);
+  n = GST_READ_UINT32_BE (times + 8);
+  fail_unless (n > 64 && n <= 128, "unexpected index length %u", n);
+  times += 12;
+
+  positions = find_bytes (times, size - (times - data),
+      "\x00\x0d" "filepositions" "\x0a", 16);
+  fail_unless (positions != NULL);
+  fail_unless_equals_int (GST_READ_UINT32_BE (positions + 16), n);
+  positions += 20;
+
+  for (i = 0; i < n; i++) {
+    gdouble time = GST_READ_DOUBLE_BE (times + i * 9 + 1);
+    guint64 pos = GST_READ_DOUBLE_BE (positions + i * 9 + 1);
+
+    fail_unless (time > last_time);
+    last_time = time;
+
+    /* every entry points at an audio tag */
+    fail_unless (pos < size);
+    fail_unless_equals_int (data[pos], 8);
+
+    /* and the last one is near the end of the file */
+    if (i == n - 1)
+      fail_unless (pos > size / 10 * 9);
+  }
+
+  g_free (contents);
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
 static GstBuffer *
 create_buffer (guint8 * data, gsize size,
     GstClockTime timestamp, GstClockTime duration)
@@ -438,6 +524,7 @@ flvmux_suite (void)
 #endif
 
   tcase_add_loop_test (tc_chain, test_index_writing, 1, loop);
+  tcase_add_test (tc_chain, test_index_bounded);
 
   tcase_add_test (tc_chain, test_speex_streamable);
   tcase_add_test (tc_chain, test_increasing_timestamp_when_pts_none);
@@ -438,6 +438,44 @@ GST_START_TEST (test_reset)
 
 GST_END_TEST;
 
+GST_START_TEST (test_streamable_cues)
+{
+  GstElement *matroskamux;
+  GstBuffer *inbuffer, *outbuffer;
+  GstCaps *caps;
+  guint8 cues_id[] = { 0x1c, 0x53, 0xbb, 0x6b };
+  int i;
+
+  matroskamux = setup_matroskamux (&srcac3template);
+  g_object_set (matroskamux, "streamable", TRUE, "streamable-cues", TRUE,
+      NULL);
+
+  caps = gst_caps_from_string (AC3_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, matroskamux, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  for (i = 0; i < 3; i++) {
+    inbuffer = gst_buffer_new_allocate (NULL, 1, 0);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND;
+    fail_unless_equals_int (gst_pad_push (mysrcpad, inbuffer), GST_FLOW_OK);
+  }
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* the index is appended as the last buffer, without a seek back */
+  outbuffer = GST_BUFFER (g_list_last (buffers)->data);
+  fail_unless (gst_buffer_get_size (outbuffer) > sizeof (cues_id));
+  fail_unless (gst_buffer_memcmp (outbuffer, 0, cues_id,
+          sizeof (cues_id)) == 0);
+  fail_unless_equals_int (GST_BUFFER_OFFSET (outbuffer),
+      GST_BUFFER_OFFSET_END (g_list_last (buffers)->prev->data));
+
+  gst_check_drop_buffers ();
+  cleanup_matroskamux (matroskamux);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_link_webmmux_webm_sink)
 {
   static GstStaticPadTemplate webm_sinktemplate =
@@ -474,6 +512,7 @@ matroskamux_suite (void)
   tcase_add_test (tc_chain, test_vorbis_header);
   tcase_add_test (tc_chain, test_block_group);
   tcase_add_test (tc_chain, test_reset);
+  tcase_add_test (tc_chain, test_streamable_cues);
   tcase_add_test (tc_chain, test_link_webmmux_webm_sink);
 
   return s;
@@ -31,6 +31,8 @@
 #include <unistd.h>
 
 static GList *mfs_messages = NULL;
+/* when set, every file must have this size once its message is posted */
+static gsize mfs_complete_size = 0;
 
 static void
 mfs_check_next_message (const gchar * filename)
@@ -73,9 +75,21 @@ run_pipeline (GstElement * pipeline)
     fail_unless (msg != NULL);
     if (msg) {
       if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ELEMENT) {
-        if (gst_message_has_name (msg, "GstMultiFileSink"))
+        if (gst_message_has_name (msg, "GstMultiFileSink")) {
+          if (mfs_complete_size > 0) {
+            const gchar *filename;
+            gchar *contents;
+            gsize length;
+
+            filename = gst_structure_get_string (gst_message_get_structure
+                (msg), "filename");
+            fail_unless (g_file_get_contents (filename, &contents, &length,
+                    NULL));
+            fail_unless_equals_uint64 (length, mfs_complete_size);
+            g_free (contents);
+          }
           mfs_messages = g_list_append (mfs_messages, msg);
-        else
+        } else
           gst_message_unref (msg);
 
         continue;
@@ -272,6 +286,75 @@ GST_START_TEST (test_multifilesink_key_unit)
 
 GST_END_TEST;
 
+GST_START_TEST (test_multifilesink_write_behind)
+{
+  GstElement *pipeline;
+  GstElement *mfs;
+  GstStructure *stats;
+  guint64 bytes_written, max_queued;
+  int i;
+  const gchar *tmpdir;
+  gchar *my_tmpdir;
+  gchar *template;
+  gchar *mfs_pattern;
+
+  tmpdir = g_get_tmp_dir ();
+  template = g_build_filename (tmpdir, "multifile-test-XXXXXX", NULL);
+  my_tmpdir = g_mkdtemp (template);
+  fail_if (my_tmpdir == NULL);
+
+  /* 115200 bytes per frame, two frames per file */
+  pipeline =
+      gst_parse_launch
+      ("videotestsrc num-buffers=10 ! video/x-raw,format=(string)I420,width=320,height=240 ! multifilesink name=mfs next-file=max-size max-file-size=300000",
+      NULL);
+  fail_if (pipeline == NULL);
+  mfs = gst_bin_get_by_name (GST_BIN (pipeline), "mfs");
+  fail_if (mfs == NULL);
+  mfs_pattern = g_build_filename (my_tmpdir, "%05d", NULL);
+  g_object_set (G_OBJECT (mfs), "location", mfs_pattern, "post-messages", TRUE,
+      "write-behind", TRUE, "write-behind-max-bytes", (guint64) 200000,
+      "write-block-size", 4096, NULL);
+  /* the file is written and closed before its message is posted */
+  mfs_complete_size = 2 * 115200;
+  run_pipeline (pipeline);
+  mfs_complete_size = 0;
+  gst_object_unref (pipeline);
+
+  g_object_get (mfs, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "bytes-written",
+          &bytes_written));
+  fail_unless (gst_structure_get_uint64 (stats, "max-queued-bytes",
+          &max_queued));
+  fail_unless_equals_uint64 (bytes_written, 10 * 115200);
+  fail_unless (max_queued > 0 && max_queued <= 200000);
+  gst_structure_free (stats);
+  g_object_unref (mfs);
+
+  for (i = 0; i < 5; i++) {
+    char *s;
+    gchar *contents;
+    gsize length;
+
+    s = g_strdup_printf (mfs_pattern, i);
+    fail_unless (g_file_get_contents (s, &contents, &length, NULL));
+    fail_unless_equals_uint64 (length, 2 * 115200);
+    g_free (contents);
+    fail_if (g_remove (s) != 0);
+
+    mfs_check_next_message (s);
+
+    g_free (s);
+  }
+  fail_if (g_remove (my_tmpdir) != 0);
+
+  fail_unless (mfs_messages == NULL);
+  g_free (mfs_pattern);
+  g_free (my_tmpdir);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_multifilesrc)
 {
   GstElement *pipeline;
@@ -378,6 +461,60 @@ GST_START_TEST (test_multifilesrc_stop_index)
 
 GST_END_TEST;
 
+/* same as above, with the files mapped and loaded ahead of time */
+GST_START_TEST (test_multifilesrc_prefetch)
+{
+  GstElement *src;
+  GstEvent *event;
+  GstPad *sinkpad;
+  GList *l;
+  gchar *fn, *contents;
+  gsize length;
+
+  src = gst_check_setup_element ("multifilesrc");
+  fail_unless (src != NULL);
+
+  fn = g_build_filename (GST_TEST_FILES_PATH, "image.jpg", NULL);
+  fail_unless (g_file_get_contents (fn, &contents, &length, NULL));
+  g_object_set (src, "location", fn, NULL);
+  g_free (fn);
+
+  /* a budget smaller than a file still loads one file ahead */
+  g_object_set (src, "stop-index", 5, "prefetch-files", 3,
+      "prefetch-max-bytes", (guint64) 1, "use-mmap", TRUE, NULL);
+
+  sinkpad = gst_check_setup_sink_pad_by_name (src, &sinktemplate, "src");
+  fail_unless (sinkpad != NULL);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  gst_element_set_state (src, GST_STATE_PLAYING);
+
+  gst_element_get_state (src, NULL, NULL, -1);
+
+  /* busy-loop for EOS */
+  do {
+    g_usleep (G_USEC_PER_SEC / 10);
+    event = gst_pad_get_sticky_event (sinkpad, GST_EVENT_EOS, 0);
+  } while (event == NULL);
+  gst_event_unref (event);
+
+  fail_unless_equals_int (g_list_length (buffers), 5 + 1);
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buf = l->data;
+
+    fail_unless_equals_int (gst_buffer_get_size (buf), length);
+    fail_unless (gst_buffer_memcmp (buf, 0, contents, length) == 0);
+  }
+  g_free (contents);
+
+  gst_element_set_state (src, GST_STATE_NULL);
+
+  gst_check_drop_buffers ();
+  gst_check_teardown_pad_by_name (src, "src");
+  gst_check_teardown_element (src);
+}
+
+GST_END_TEST;
 
 static Suite *
 multifile_suite (void)
@@ -390,8 +527,10 @@ multifile_suite (void)
   tcase_add_test (tc_chain, test_multifilesink_key_frame);
   tcase_add_test (tc_chain, test_multifilesink_max_files);
   tcase_add_test (tc_chain, test_multifilesink_key_unit);
+  tcase_add_test (tc_chain, test_multifilesink_write_behind);
   tcase_add_test (tc_chain, test_multifilesrc);
   tcase_add_test (tc_chain, test_multifilesrc_stop_index);
+  tcase_add_test (tc_chain, test_multifilesrc_prefetch);
 
   return s;
 }
@@ -546,6 +546,251 @@ GST_START_TEST (test_audio_pad_frag_asc_streamable)
 
 GST_END_TEST;
 
+/* faststart with a reserved duration writes the moov into space reserved
+ * after the ftyp instead of going through a temporary file */
+GST_START_TEST (test_faststart_in_place)
+{
+  GstElement *qtmux;
+  GstBuffer *inbuffer, *outbuffer;
+  GstCaps *caps;
+  GstSegment segment;
+  guint32 reserved = 0, moov_size = 0;
+  int num_buffers;
+  int i;
+  guint8 data0[4] = "ftyp";
+  guint8 data1[4] = "free";
+  guint8 data2[16] = "\000\000\000\010free\000\000\000\000mdat";
+  guint8 data3[4] = "moov";
+
+  qtmux = setup_qtmux (&srcvideotemplate, "video_%u", TRUE);
+  g_object_set (qtmux, "faststart", TRUE, "reserved-max-duration",
+      (guint64) 10 * GST_SECOND, NULL);
+  fail_unless (gst_element_set_state (qtmux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+
+  caps = gst_pad_get_pad_template_caps (mysrcpad);
+  gst_pad_set_caps (mysrcpad, caps);
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+
+  inbuffer = gst_buffer_new_and_alloc (1);
+  gst_buffer_memset (inbuffer, 0, 0, 1);
+  GST_BUFFER_TIMESTAMP (inbuffer) = 0;
+  GST_BUFFER_DURATION (inbuffer) = 40 * GST_MSECOND;
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  num_buffers = g_list_length (buffers);
+  /* ftyp, reserved free atom, mdat header, buffer chunk, moov, free atom
+   * for the rest of the reserved space and the mdat header update */
+  fail_unless_equals_int (num_buffers, 7);
+
+  cleanup_qtmux (qtmux, "video_%u");
+
+  for (i = 0; i < num_buffers; ++i) {
+    outbuffer = GST_BUFFER (buffers->data);
+    fail_if (outbuffer == NULL);
+    buffers = g_list_remove (buffers, outbuffer);
+
+    switch (i) {
+      case 0:                  /* ftyp */
+        fail_unless (gst_buffer_memcmp (outbuffer, 4, data0,
+                sizeof (data0)) == 0);
+        break;
+      case 1:                  /* reserved space */
+        fail_unless (gst_buffer_get_size (outbuffer) == 8);
+        fail_unless (gst_buffer_memcmp (outbuffer, 4, data1,
+                sizeof (data1)) == 0);
+        gst_buffer_extract (outbuffer, 0, &reserved, 4);
+        reserved = GUINT32_FROM_BE (reserved);
+        break;
+      case 2:                  /* mdat header */
+        fail_unless (gst_buffer_get_size (outbuffer) == 16);
+        fail_unless (gst_buffer_memcmp (outbuffer, 0, data2,
+                sizeof (data2)) == 0);
+        break;
+      case 3:                  /* buffer we put in */
+        fail_unless (gst_buffer_get_size (outbuffer) == 1);
+        break;
+      case 4:                  /* moov, at the start of the reserved space */
+        fail_unless (gst_buffer_memcmp (outbuffer, 4, data3,
+                sizeof (data3)) == 0);
+        moov_size = gst_buffer_get_size (outbuffer);
+        break;
+      case 5:                  /* free atom covering the rest */
+      {
+        guint32 free_size;
+
+        fail_unless (gst_buffer_memcmp (outbuffer, 4, data1,
+                sizeof (data1)) == 0);
+        gst_buffer_extract (outbuffer, 0, &free_size, 4);
+        fail_unless_equals_int (moov_size + GUINT32_FROM_BE (free_size),
+            reserved);
+        break;
+      }
+      default:
+        break;
+    }
+
+    gst_buffer_unref (outbuffer);
+  }
+
+  g_list_free (buffers);
+  buffers = NULL;
+}
+
+GST_END_TEST;
+
+/* samples that all have the same size need no sample size table */
+GST_START_TEST (test_constant_sample_size)
+{
+  GstElement *qtmux;
+  GstBuffer *inbuffer, *moov = NULL;
+  GstCaps *caps;
+  GstSegment segment;
+  GstMapInfo map;
+  GList *l;
+  guint8 *stsz;
+  int i;
+
+  qtmux = setup_qtmux (&srcaudiotemplate, "audio_%u", TRUE);
+  fail_unless (gst_element_set_state (qtmux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+
+  caps = gst_pad_get_pad_template_caps (mysrcpad);
+  gst_pad_set_caps (mysrcpad, caps);
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+
+  for (i = 0; i < 5; i++) {
+    inbuffer = gst_buffer_new_and_alloc (100);
+    gst_buffer_memset (inbuffer, 0, 0, 100);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * 40 * GST_MSECOND;
+    GST_BUFFER_DURATION (inbuffer) = 40 * GST_MSECOND;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  cleanup_qtmux (qtmux, "audio_%u");
+
+  for (l = buffers; l; l = l->next) {
+    if (gst_buffer_get_size (l->data) > 8
+        && gst_buffer_memcmp (l->data, 4, "moov", 4) == 0)
+      moov = l->data;
+  }
+  fail_unless (moov != NULL);
+
+  fail_unless (gst_buffer_map (moov, &map, GST_MAP_READ));
+  stsz = NULL;
+  for (i = 4; i + 16 <= map.size && stsz == NULL; i++) {
+    if (memcmp (map.data + i, "stsz", 4) == 0)
+      stsz = map.data + i;
+  }
+  fail_unless (stsz != NULL);
+  /* box size, no table */
+  fail_unless_equals_int (GST_READ_UINT32_BE (stsz - 4), 20);
+  /* sample size and count, after version and flags */
+  fail_unless_equals_int (GST_READ_UINT32_BE (stsz + 8), 100);
+  fail_unless_equals_int (GST_READ_UINT32_BE (stsz + 12), 5);
+  gst_buffer_unmap (moov, &map);
+
+  gst_check_drop_buffers ();
+}
+
+GST_END_TEST;
+
+/* fragments split into chunks, each with its own sidx, moof and mdat */
+GST_START_TEST (test_fragment_chunks)
+{
+  GstElement *qtmux;
+  GstBuffer *inbuffer;
+  GstCaps *caps;
+  GstSegment segment;
+  GString *atoms;
+  guint32 referenced_size = 0, moof_size = 0;
+  GList *l;
+  int i;
+
+  qtmux = setup_qtmux (&srcaudiotemplate, "audio_%u", FALSE);
+  g_object_set (qtmux, "fragment-duration", 2000, "chunk-samples", 2,
+      "write-styp", TRUE, "write-sidx", TRUE, NULL);
+  fail_unless (gst_element_set_state (qtmux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+
+  caps = gst_pad_get_pad_template_caps (mysrcpad);
+  gst_pad_set_caps (mysrcpad, caps);
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+
+  for (i = 0; i < 5; i++) {
+    inbuffer = gst_buffer_new_and_alloc (1);
+    gst_buffer_memset (inbuffer, 0, 0, 1);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * 40 * GST_MSECOND;
+    GST_BUFFER_DURATION (inbuffer) = 40 * GST_MSECOND;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  cleanup_qtmux (qtmux, "audio_%u");
+
+  /* the 1 byte sample buffers are skipped */
+  atoms = g_string_new (NULL);
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buf = l->data;
+    GstMapInfo map;
+
+    if (gst_buffer_get_size (buf) < 8)
+      continue;
+
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    g_string_append_len (atoms, (const gchar *) map.data + 4, 4);
+    g_string_append_c (atoms, ' ');
+
+    if (memcmp (map.data + 4, "styp", 4) == 0) {
+      fail_unless (memcmp (map.data + 8, "msdh", 4) == 0);
+    } else if (memcmp (map.data + 4, "sidx", 4) == 0) {
+      fail_unless_equals_int (map.size, 44);
+      /* one reference, starting with a SAP */
+      fail_unless_equals_int (GST_READ_UINT16_BE (map.data + 30), 1);
+      fail_unless (GST_READ_UINT32_BE (map.data + 40) == 0x90000000);
+      referenced_size = GST_READ_UINT32_BE (map.data + 32);
+    } else if (memcmp (map.data + 4, "moof", 4) == 0) {
+      moof_size = map.size;
+    } else if (memcmp (map.data + 4, "mdat", 4) == 0) {
+      /* referenced size covers moof, mdat header and samples */
+      fail_unless_equals_int (referenced_size,
+          moof_size + GST_READ_UINT32_BE (map.data));
+    }
+    gst_buffer_unmap (buf, &map);
+  }
+
+  fail_unless (g_str_has_prefix (atoms->str, "ftyp moov styp "
+          "sidx moof mdat sidx moof mdat sidx moof mdat "), atoms->str);
+  g_string_free (atoms, TRUE);
+
+  gst_check_drop_buffers ();
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_reuse)
 {
   GstElement *qtmux = setup_qtmux (&srcvideotemplate, "video_%u", TRUE);
@@ -1610,6 +1855,10 @@ qtmux_suite (void)
   tcase_add_test (tc_chain, test_video_pad_frag_asc_streamable);
   tcase_add_test (tc_chain, test_audio_pad_frag_asc_streamable);
 
+  tcase_add_test (tc_chain, test_faststart_in_place);
+  tcase_add_test (tc_chain, test_constant_sample_size);
+  tcase_add_test (tc_chain, test_fragment_chunks);
+
   tcase_add_test (tc_chain, test_average_bitrate);
 
   tcase_add_test (tc_chain, test_reuse);
@@ -52,6 +52,11 @@ static const char *realm = "SOUPHTTPSRC_REALM";
 static const char *basic_auth_path = "/basic_auth";
 static const char *digest_auth_path = "/digest_auth";
 
+/* Served by the "/large" path, with Range support */
+#define LARGE_SIZE (1024 * 1024 + 123)
+#define LARGE_BYTE(offset) ((guint8) ((offset) % 251))
+static gint large_requests = 0;
+
 static const char *ssl_cert_file = GST_TEST_FILES_PATH "/test-cert.pem";
 static const char *ssl_key_file = GST_TEST_FILES_PATH "/test-key.pem";
 
@@ -445,6 +450,186 @@ GST_START_TEST (test_icy_stream)
 
 GST_END_TEST;
 
+typedef struct
+{
+  guint64 offset;
+  gboolean data_ok;
+} RangeCheck;
+
+static void
+range_handoff_cb (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    RangeCheck * check)
+{
+  GstMapInfo map;
+  gsize i;
+
+  fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buf), check->offset);
+
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  for (i = 0; i < map.size; i++) {
+    if (map.data[i] != LARGE_BYTE (check->offset + i))
+      check->data_ok = FALSE;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  check->offset += map.size;
+}
+
+GST_START_TEST (test_parallel_range_requests)
+{
+  GstElement *pipe, *src, *sink;
+  RangeCheck check = { 0, TRUE };
+  GstStructure *stats;
+  const GValue *connections;
+  SoupServer *server;
+  GstMessage *msg;
+  guint64 bytes;
+  gchar *url;
+
+  server = run_server (FALSE);
+  fail_unless (server != NULL);
+
+  pipe = gst_parse_launch ("souphttpsrc name=src parallel-requests=4 "
+      "range-chunk-size=65536 ! fakesink name=sink signal-handoffs=true",
+      NULL);
+  fail_unless (pipe != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipe), "src");
+  url = g_strdup_printf ("http://127.0.0.1:%u/large",
+      get_port_from_server (server));
+  g_object_set (src, "location", url, NULL);
+  g_free (url);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (range_handoff_cb), &check);
+  gst_object_unref (sink);
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  /* The ranges arrive in order and complete */
+  fail_unless_equals_uint64 (check.offset, LARGE_SIZE);
+  fail_unless (check.data_ok);
+
+  g_object_get (src, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+  connections = gst_structure_get_value (stats, "connections");
+  fail_unless (connections != NULL);
+  fail_unless_equals_int (gst_value_array_get_size (connections), 4);
+  fail_unless (gst_structure_get_uint64 (stats, "bytes", &bytes));
+  fail_unless_equals_uint64 (bytes, LARGE_SIZE);
+  gst_structure_free (stats);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (pipe);
+  g_object_unref (server);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  guint64 end;
+  gboolean data_ok;
+} SeekCheck;
+
+static void
+seek_handoff_cb (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    SeekCheck * check)
+{
+  GstMapInfo map;
+  gsize i;
+
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  for (i = 0; i < map.size; i++) {
+    if (map.data[i] != LARGE_BYTE (GST_BUFFER_OFFSET (buf) + i))
+      check->data_ok = FALSE;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  check->end = GST_BUFFER_OFFSET (buf) + map.size;
+}
+
+/* Polling the bus keeps the server running while waiting for preroll */
+static void
+wait_preroll (GstElement * pipe)
+{
+  GstMessage *msg;
+
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_ASYNC_DONE | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_ASYNC_DONE);
+  gst_message_unref (msg);
+}
+
+static void
+seek_and_wait (GstElement * pipe, gint64 position)
+{
+  fail_unless (gst_element_seek_simple (pipe, GST_FORMAT_BYTES,
+          GST_SEEK_FLAG_FLUSH, position));
+  wait_preroll (pipe);
+}
+
+/* Short seeks are served from the cache or by reading ahead on the open
+ * response, so the whole resource is read with a single request */
+GST_START_TEST (test_seek_reuses_connection)
+{
+  GstElement *pipe, *src, *sink;
+  SeekCheck check = { 0, TRUE };
+  SoupServer *server;
+  GstMessage *msg;
+  gchar *url;
+
+  server = run_server (FALSE);
+  fail_unless (server != NULL);
+  g_atomic_int_set (&large_requests, 0);
+
+  pipe = gst_parse_launch ("souphttpsrc name=src blocksize=1024 ! "
+      "fakesink name=sink signal-handoffs=true", NULL);
+  fail_unless (pipe != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipe), "src");
+  url = g_strdup_printf ("http://127.0.0.1:%u/large",
+      get_port_from_server (server));
+  g_object_set (src, "location", url, NULL);
+  g_free (url);
+  gst_object_unref (src);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (seek_handoff_cb), &check);
+  g_signal_connect (sink, "preroll-handoff", G_CALLBACK (seek_handoff_cb),
+      &check);
+  gst_object_unref (sink);
+
+  gst_element_set_state (pipe, GST_STATE_PAUSED);
+  wait_preroll (pipe);
+
+  /* back into the first buffer, then a bit ahead */
+  seek_and_wait (pipe, 100);
+  fail_unless (check.end <= 1024);
+  seek_and_wait (pipe, 20000);
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  fail_unless (check.data_ok);
+  fail_unless_equals_uint64 (check.end, LARGE_SIZE);
+  fail_unless_equals_int (g_atomic_int_get (&large_requests), 1);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+  g_object_unref (server);
+}
+
+GST_END_TEST;
+
 static Suite *
 souphttpsrc_suite (void)
 {
@@ -474,6 +659,8 @@ souphttpsrc_suite (void)
   tcase_add_test (tc_chain, test_bad_user_digest_auth);
   tcase_add_test (tc_chain, test_bad_password_digest_auth);
   tcase_add_test (tc_chain, test_https);
+  tcase_add_test (tc_chain, test_parallel_range_requests);
+  tcase_add_test (tc_chain, test_seek_reuses_connection);
 
   suite_add_tcase (s, tc_internet);
   tcase_set_timeout (tc_internet, 250);
@@ -484,6 +671,43 @@ souphttpsrc_suite (void)
 
 GST_CHECK_MAIN (souphttpsrc);
 
+static void
+do_get_large (SoupMessage * msg)
+{
+  SoupRange *ranges;
+  gint n_ranges;
+  goffset start = 0, end = LARGE_SIZE - 1;
+
+  if (msg->method == SOUP_METHOD_GET)
+    g_atomic_int_inc (&large_requests);
+
+  if (soup_message_headers_get_ranges (msg->request_headers, LARGE_SIZE,
+          &ranges, &n_ranges)) {
+    start = ranges[0].start;
+    end = ranges[0].end;
+    soup_message_headers_free_ranges (msg->request_headers, ranges);
+    soup_message_headers_set_content_range (msg->response_headers, start,
+        end, LARGE_SIZE);
+    soup_message_set_status (msg, SOUP_STATUS_PARTIAL_CONTENT);
+  } else {
+    soup_message_set_status (msg, SOUP_STATUS_OK);
+  }
+
+  if (msg->method == SOUP_METHOD_GET) {
+    guint8 *buf;
+    goffset i;
+
+    buf = g_malloc (end - start + 1);
+    for (i = start; i <= end; i++)
+      buf[i - start] = LARGE_BYTE (i);
+    soup_message_body_append (msg->response_body, SOUP_MEMORY_TAKE,
+        buf, end - start + 1);
+  } else {
+    soup_message_headers_set_content_length (msg->response_headers,
+        end - start + 1);
+  }
+}
+
 static void
 do_get (SoupMessage * msg, const char *path)
 {
@@ -494,6 +718,11 @@ do_get (SoupMessage * msg, const char *path)
 
   SoupStatus status = SOUP_STATUS_OK;
 
+  if (!strcmp (path, "/large")) {
+    do_get_large (msg);
+    return;
+  }
+
   uri = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
   GST_DEBUG ("request: \"%s\"", uri);
 
@@ -371,6 +371,178 @@ GST_START_TEST (test_splitmuxsink)
 
 GST_END_TEST;
 
+GST_START_TEST (test_splitmuxsink_async)
+{
+  GstMessage *msg;
+  GstElement *pipeline;
+  GstElement *sink;
+  gchar *dest_pattern;
+  guint count;
+  gchar *in_pattern;
+
+  /* Same as test_splitmuxsink, but with each fragment finalized in the
+   * background by its own muxer and sink */
+  pipeline =
+      gst_parse_launch
+      ("videotestsrc num-buffers=15 ! video/x-raw,width=80,height=64,framerate=5/1 ! videoconvert !"
+      " queue ! theoraenc keyframe-force=5 ! splitmuxsink name=splitsink "
+      " max-size-time=1000000 max-size-bytes=1000000 async-finalize=true "
+      " muxer-factory=oggmux max-finalizing-fragments=1", NULL);
+  fail_if (pipeline == NULL);
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "splitsink");
+  fail_if (sink == NULL);
+  g_signal_connect (sink, "format-location-full",
+      (GCallback) check_format_location, NULL);
+  dest_pattern = g_build_filename (tmpdir, "out%05d.ogg", NULL);
+  g_object_set (G_OBJECT (sink), "location", dest_pattern, NULL);
+  g_free (dest_pattern);
+  g_object_unref (sink);
+
+  msg = run_pipeline (pipeline);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    dump_error (msg);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  gst_object_unref (pipeline);
+
+  count = count_files (tmpdir);
+  fail_unless (count == 3, "Expected 3 output files, got %d", count);
+
+  in_pattern = g_build_filename (tmpdir, "out*.ogg", NULL);
+  test_playback (in_pattern, 0, 3 * GST_SECOND);
+  g_free (in_pattern);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_splitmuxsink_async_fast_switch)
+{
+  GstMessage *msg;
+  GstElement *pipeline;
+  GstElement *sink;
+  GstBus *bus;
+  gchar *dest_pattern;
+  guint closed = 0;
+  guint count;
+
+  /* Every frame is a keyframe and starts a new fragment, so the old sinks
+   * often get EOS before the next fragment's sink is in the bin. The
+   * pipeline must only see EOS once all fragments are closed */
+  pipeline =
+      gst_parse_launch
+      ("videotestsrc num-buffers=50 ! video/x-raw,width=80,height=64,framerate=25/1 ! videoconvert !"
+      " queue ! theoraenc keyframe-force=1 ! splitmuxsink name=splitsink "
+      " max-size-time=1000000 async-finalize=true "
+      " muxer-factory=oggmux max-finalizing-fragments=0", NULL);
+  fail_if (pipeline == NULL);
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "splitsink");
+  fail_if (sink == NULL);
+  dest_pattern = g_build_filename (tmpdir, "out%05d.ogg", NULL);
+  g_object_set (G_OBJECT (sink), "location", dest_pattern, NULL);
+  g_free (dest_pattern);
+  g_object_unref (sink);
+
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  while (TRUE) {
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT);
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+      dump_error (msg);
+    fail_if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR);
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS)
+      break;
+
+    if (gst_message_has_name (msg, "splitmuxsink-fragment-closed"))
+      closed++;
+    gst_message_unref (msg);
+  }
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  count = count_files (tmpdir);
+  fail_unless (count == 50, "Expected 50 output files, got %d", count);
+  fail_unless (closed == count, "Got EOS after %u of %u fragments", closed,
+      count);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_splitmuxsrc_index)
+{
+  GstMessage *msg;
+  GstElement *pipeline;
+  GstElement *elem;
+  gchar *dest_pattern, *index_location, *in_pattern;
+  gchar *contents = NULL;
+  gchar **lines;
+  gint64 duration;
+  guint count;
+
+  pipeline =
+      gst_parse_launch
+      ("videotestsrc num-buffers=15 ! video/x-raw,width=80,height=64,framerate=5/1 ! videoconvert !"
+      " queue ! theoraenc keyframe-force=5 ! splitmuxsink name=splitsink "
+      " max-size-time=1000000 max-size-bytes=1000000 muxer=oggmux", NULL);
+  fail_if (pipeline == NULL);
+  elem = gst_bin_get_by_name (GST_BIN (pipeline), "splitsink");
+  fail_if (elem == NULL);
+  dest_pattern = g_build_filename (tmpdir, "out%05d.ogg", NULL);
+  index_location = g_build_filename (tmpdir, "out.idx", NULL);
+  g_object_set (G_OBJECT (elem), "location", dest_pattern,
+      "index-location", index_location, NULL);
+  g_free (dest_pattern);
+  g_object_unref (elem);
+
+  msg = run_pipeline (pipeline);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (pipeline);
+
+  count = count_files (tmpdir);
+  fail_unless (count == 4, "Expected 3 output files and an index, got %d",
+      count);
+
+  /* One line per fragment */
+  fail_unless (g_file_get_contents (index_location, &contents, NULL, NULL));
+  lines = g_strsplit (g_strstrip (contents), "\n", -1);
+  fail_unless_equals_int (g_strv_length (lines), 3);
+  g_strfreev (lines);
+  g_free (contents);
+
+  /* Read the files back with the durations taken from the index */
+  pipeline = gst_parse_launch ("splitmuxsrc name=splitsrc ! fakesink", NULL);
+  fail_if (pipeline == NULL);
+  elem = gst_bin_get_by_name (GST_BIN (pipeline), "splitsrc");
+  fail_if (elem == NULL);
+  in_pattern = g_build_filename (tmpdir, "out*.ogg", NULL);
+  g_object_set (G_OBJECT (elem), "location", in_pattern,
+      "index-location", index_location, "probe-threads", 2, NULL);
+  g_free (in_pattern);
+  g_object_unref (elem);
+
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  fail_unless (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_query_duration (pipeline, GST_FORMAT_TIME,
+          &duration));
+  fail_unless_equals_uint64 (duration, 3 * GST_SECOND);
+
+  msg = run_pipeline (pipeline);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (pipeline);
+
+  g_free (index_location);
+}
+
+GST_END_TEST;
+
 static GstPadProbeReturn
 intercept_stream_start (GstPad * pad, GstPadProbeInfo * info,
     gpointer user_data)
@@ -765,6 +937,9 @@ splitmux_suite (void)
     tcase_add_test (tc_chain, test_splitmuxsrc);
     tcase_add_test (tc_chain, test_splitmuxsrc_format_location);
     tcase_add_test (tc_chain, test_splitmuxsink);
+    tcase_add_test (tc_chain, test_splitmuxsink_async);
+    tcase_add_test (tc_chain, test_splitmuxsink_async_fast_switch);
+    tcase_add_test (tc_chain, test_splitmuxsrc_index);
 
     if (have_matroska && have_vorbis) {
       tcase_add_checked_fixture (tc_chain_complex, tempdir_setup,
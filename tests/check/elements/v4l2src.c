@@ -0,0 +1,356 @@
+/* GStreamer
+ *
+ * unit tests for v4l2src io-modes and capture timing, run against the vivid virtual driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* These tests need the vivid driver, which is part of the normal kernel:
+ *
+ *   modprobe vivid
+ *
+ * The capture and output nodes are looked up automatically, or can be forced
+ * with the GST_V4L2_VIVID_CAPTURE and GST_V4L2_VIVID_OUTPUT environment
+ * variables. Without a vivid device no test is run.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define VIVID_CAPS "video/x-raw,format=YUY2,width=640,height=480"
+#define NUM_BUFFERS 10
+
+static gchar *capture_device = NULL;
+static gchar *output_device = NULL;
+
+/* Returns the first vivid node that @factory can be opened on */
+static gchar *
+find_vivid_device (const gchar * factory, const gchar * env)
+{
+  GstElement *element;
+  gchar *device = NULL;
+  gint i;
+
+  if (g_getenv (env))
+    return g_strdup (g_getenv (env));
+
+  element = gst_element_factory_make (factory, NULL);
+  if (element == NULL)
+    return NULL;
+
+  for (i = 0; i < 64 && device == NULL; i++) {
+    gchar *path = g_strdup_printf ("/dev/video%d", i);
+    gchar *name = NULL;
+
+    if (!g_file_test (path, G_FILE_TEST_EXISTS)) {
+      g_free (path);
+      continue;
+    }
+
+    g_object_set (element, "device", path, NULL);
+    if (gst_element_set_state (element, GST_STATE_READY) ==
+        GST_STATE_CHANGE_SUCCESS) {
+      g_object_get (element, "device-name", &name, NULL);
+      if (name && strstr (name, "vivid"))
+        device = g_strdup (path);
+    }
+    gst_element_set_state (element, GST_STATE_NULL);
+
+    g_free (name);
+    g_free (path);
+  }
+
+  gst_object_unref (element);
+
+  return device;
+}
+
+/* Answer the allocation query like a video sink with its own pool would */
+static GstPadProbeReturn
+allocation_query_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstQuery *query = GST_PAD_PROBE_INFO_QUERY (info);
+  GstBufferPool *pool;
+  GstStructure *config;
+  GstVideoInfo vinfo;
+  GstCaps *caps;
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_ALLOCATION)
+    return GST_PAD_PROBE_OK;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  fail_unless (gst_video_info_from_caps (&vinfo, caps));
+
+  pool = gst_video_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, vinfo.size, 2, 0);
+  fail_unless (gst_buffer_pool_set_config (pool, config));
+
+  gst_query_add_allocation_pool (query, pool, vinfo.size, 2, 0);
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  gst_object_unref (pool);
+
+  return GST_PAD_PROBE_HANDLED;
+}
+
+/* Runs @desc until EOS and returns the allocation message of element "src" */
+static GstStructure *
+run_pipeline (const gchar * desc, gboolean answer_allocation)
+{
+  GstElement *pipeline, *src;
+  GstStructure *alloc = NULL;
+  GstMessage *msg;
+  GstBus *bus;
+
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+
+  if (answer_allocation) {
+    GstElement *sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+    GstPad *pad = gst_element_get_static_pad (sink, "sink");
+
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM,
+        allocation_query_probe, NULL, NULL);
+    gst_object_unref (pad);
+    gst_object_unref (sink);
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  bus = gst_element_get_bus (pipeline);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  while (TRUE) {
+    msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT);
+    fail_unless (msg != NULL, "timeout waiting for EOS");
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      GError *err = NULL;
+      gchar *dbg = NULL;
+
+      gst_message_parse_error (msg, &err, &dbg);
+      fail ("error from %s: %s (%s)", GST_OBJECT_NAME (msg->src),
+          err->message, GST_STR_NULL (dbg));
+    }
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+      gst_message_unref (msg);
+      break;
+    }
+
+    if (GST_MESSAGE_SRC (msg) == GST_OBJECT (src) &&
+        gst_message_has_name (msg, "GstV4l2Allocation")) {
+      fail_unless (alloc == NULL);
+      alloc = gst_structure_copy (gst_message_get_structure (msg));
+    }
+    gst_message_unref (msg);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  fail_unless (alloc != NULL, "no allocation message posted");
+  return alloc;
+}
+
+static void
+check_capture (const gchar * io_mode, gboolean answer_allocation,
+    gboolean zero_copy, gboolean copy_threshold)
+{
+  GstStructure *alloc;
+  gboolean val;
+  gchar *desc;
+
+  desc = g_strdup_printf ("v4l2src name=src device=%s io-mode=%s "
+      "num-buffers=%d ! " VIVID_CAPS " ! fakesink name=sink",
+      capture_device, io_mode, NUM_BUFFERS);
+  alloc = run_pipeline (desc, answer_allocation);
+  g_free (desc);
+
+  GST_INFO ("%s: %" GST_PTR_FORMAT, io_mode, alloc);
+
+  fail_unless (gst_structure_get_boolean (alloc, "zero-copy", &val));
+  fail_unless_equals_int (val, zero_copy);
+  fail_unless (gst_structure_get_boolean (alloc, "copy-threshold", &val));
+  fail_unless_equals_int (val, copy_threshold);
+  if (!zero_copy)
+    fail_unless (gst_structure_get_string (alloc, "reason") != NULL);
+
+  gst_structure_free (alloc);
+}
+
+GST_START_TEST (test_io_mode_rw)
+{
+  check_capture ("rw", TRUE, FALSE, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_io_mode_mmap)
+{
+  check_capture ("mmap", TRUE, TRUE, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_io_mode_dmabuf)
+{
+  check_capture ("dmabuf", TRUE, TRUE, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_io_mode_userptr)
+{
+  check_capture ("userptr", TRUE, TRUE, FALSE);
+}
+
+GST_END_TEST;
+
+/* Without any allocation answer we still push our own buffers and only copy
+ * while running low */
+GST_START_TEST (test_io_mode_dmabuf_no_pool)
+{
+  check_capture ("dmabuf", FALSE, TRUE, TRUE);
+}
+
+GST_END_TEST;
+
+/* Exported dmabufs from the capture node are imported by the output node */
+GST_START_TEST (test_io_mode_dmabuf_import)
+{
+  GstStructure *alloc;
+  gboolean zero_copy;
+  gchar *desc;
+
+  desc = g_strdup_printf ("v4l2src name=src device=%s io-mode=dmabuf "
+      "num-buffers=%d ! " VIVID_CAPS " ! v4l2sink name=sink device=%s "
+      "io-mode=dmabuf-import sync=false", capture_device, NUM_BUFFERS,
+      output_device);
+  alloc = run_pipeline (desc, FALSE);
+  g_free (desc);
+
+  fail_unless (gst_structure_get_boolean (alloc, "zero-copy", &zero_copy));
+  fail_unless (zero_copy);
+  gst_structure_free (alloc);
+}
+
+GST_END_TEST;
+
+static void
+capture_meta_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gint * n_metas)
+{
+  GType api = g_type_from_name ("GstV4l2CaptureMetaAPI");
+
+  fail_unless (api != 0);
+  if (gst_buffer_get_meta (buffer, api))
+    (*n_metas)++;
+}
+
+GST_START_TEST (test_capture_meta_and_stats)
+{
+  GstElement *pipeline, *src, *sink;
+  GstStructure *stats;
+  GstMessage *msg;
+  GstBus *bus;
+  guint64 captured;
+  gint n_metas = 0, n_latency = 0;
+  gchar *desc;
+
+  desc = g_strdup_printf ("v4l2src name=src device=%s num-buffers=%d "
+      "capture-meta=true post-latency-messages=true ! " VIVID_CAPS " ! "
+      "fakesink name=sink signal-handoffs=true", capture_device, NUM_BUFFERS);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (capture_meta_handoff),
+      &n_metas);
+
+  bus = gst_element_get_bus (pipeline);
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  while ((msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+              GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT))) {
+    fail_unless (GST_MESSAGE_TYPE (msg) != GST_MESSAGE_ERROR);
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+      gst_message_unref (msg);
+      break;
+    }
+    if (gst_message_has_name (msg, "GstV4l2SrcLatency")) {
+      fail_unless (gst_structure_has_field (gst_message_get_structure (msg),
+              "queue-depth"));
+      n_latency++;
+    }
+    gst_message_unref (msg);
+  }
+  fail_unless (msg != NULL, "timeout waiting for EOS");
+
+  fail_unless_equals_int (n_metas, NUM_BUFFERS);
+  fail_unless_equals_int (n_latency, NUM_BUFFERS);
+
+  g_object_get (src, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "frames-captured", &captured));
+  fail_unless_equals_uint64 (captured, NUM_BUFFERS);
+  fail_unless (gst_structure_has_field (stats, "frames-dropped"));
+  gst_structure_free (stats);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (sink);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+static Suite *
+v4l2src_suite (void)
+{
+  Suite *s = suite_create ("v4l2src");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  capture_device = find_vivid_device ("v4l2src", "GST_V4L2_VIVID_CAPTURE");
+  if (capture_device == NULL) {
+    GST_INFO ("no vivid capture device found, skipping tests");
+    return s;
+  }
+
+  tcase_add_test (tc_chain, test_io_mode_rw);
+  tcase_add_test (tc_chain, test_io_mode_mmap);
+  tcase_add_test (tc_chain, test_io_mode_dmabuf);
+  tcase_add_test (tc_chain, test_io_mode_userptr);
+  tcase_add_test (tc_chain, test_io_mode_dmabuf_no_pool);
+  tcase_add_test (tc_chain, test_capture_meta_and_stats);
+
+  output_device = find_vivid_device ("v4l2sink", "GST_V4L2_VIVID_OUTPUT");
+  if (output_device != NULL)
+    tcase_add_test (tc_chain, test_io_mode_dmabuf_import);
+
+  return s;
+}
+
+GST_CHECK_MAIN (v4l2src);
@@ -0,0 +1,223 @@
+/* GStreamer
+ *
+ * unit tests for the v4l2 m2m converter, run against the vim2m virtual driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* These tests need the vim2m driver, which is part of the normal kernel:
+ *
+ *   modprobe vim2m
+ *
+ * The converter element registered for the vim2m node is looked up
+ * automatically. Without one no test is run.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#define NUM_BUFFERS 30
+
+static gchar *converter = NULL;
+
+/* Returns the name of the v4l2 converter factory driving a vim2m device */
+static gchar *
+find_vim2m_converter (void)
+{
+  GList *features, *l;
+  gchar *found = NULL;
+
+  features = gst_registry_get_feature_list_by_plugin (gst_registry_get (),
+      "video4linux2");
+
+  for (l = features; l != NULL && found == NULL; l = l->next) {
+    GstElementFactory *factory;
+    const gchar *klass;
+    GstElement *element;
+    gchar *name = NULL;
+
+    if (!GST_IS_ELEMENT_FACTORY (l->data))
+      continue;
+
+    factory = GST_ELEMENT_FACTORY (l->data);
+    klass = gst_element_factory_get_metadata (factory,
+        GST_ELEMENT_METADATA_KLASS);
+    if (klass == NULL || strstr (klass, "Converter") == NULL)
+      continue;
+
+    element = gst_element_factory_create (factory, NULL);
+    if (element == NULL)
+      continue;
+
+    if (gst_element_set_state (element, GST_STATE_READY) ==
+        GST_STATE_CHANGE_SUCCESS) {
+      g_object_get (element, "device-name", &name, NULL);
+      if (name && strstr (name, "vim2m"))
+        found = g_strdup (GST_OBJECT_NAME (factory));
+    }
+    gst_element_set_state (element, GST_STATE_NULL);
+    gst_object_unref (element);
+    g_free (name);
+  }
+
+  gst_plugin_feature_list_free (features);
+
+  return found;
+}
+
+typedef struct
+{
+  gint count;
+  GstClockTime last_pts;
+} BufferCheck;
+
+static GstPadProbeReturn
+buffer_probe (GstPad * pad, GstPadProbeInfo * info, BufferCheck * check)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  /* Frames come out of the capture thread in order, with the metadata of
+   * the matching input frame */
+  fail_unless (GST_BUFFER_PTS_IS_VALID (buffer));
+  if (check->count > 0)
+    fail_unless (GST_BUFFER_PTS (buffer) > check->last_pts);
+  check->last_pts = GST_BUFFER_PTS (buffer);
+  check->count++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+run_conversion (const gchar * desc, gint n_buffers)
+{
+  GstElement *pipeline, *sink;
+  BufferCheck check = { 0, GST_CLOCK_TIME_NONE };
+  GstMessage *msg;
+  GstPad *pad;
+
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) buffer_probe, &check, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      10 * GST_SECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "timeout waiting for EOS");
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  /* EOS is only forwarded once the device has been drained */
+  fail_unless_equals_int (check.count, n_buffers);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+GST_START_TEST (test_convert)
+{
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+      "video/x-raw,format=YUY2,width=320,height=240,framerate=30/1 ! %s ! "
+      "video/x-raw,format=RGB16 ! fakesink name=sink", NUM_BUFFERS,
+      converter);
+  run_conversion (desc, NUM_BUFFERS);
+  g_free (desc);
+}
+
+GST_END_TEST;
+
+/* A queue lets the input side run ahead, so several frames are owned by the
+ * device at once */
+GST_START_TEST (test_convert_pipelined)
+{
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+      "video/x-raw,format=YUY2,width=320,height=240,framerate=30/1 ! queue ! "
+      "%s ! video/x-raw,format=RGB16 ! queue ! fakesink name=sink sync=true",
+      NUM_BUFFERS, converter);
+  run_conversion (desc, NUM_BUFFERS);
+  g_free (desc);
+}
+
+GST_END_TEST;
+
+/* Seeking flushes the capture thread and restarts it */
+GST_START_TEST (test_convert_flush)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+      "video/x-raw,format=YUY2,width=320,height=240,framerate=30/1 ! %s ! "
+      "video/x-raw,format=RGB16 ! fakesink sync=true", NUM_BUFFERS, converter);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PAUSED) !=
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, 100 * GST_MSECOND));
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      10 * GST_SECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "timeout waiting for EOS");
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+static Suite *
+v4l2transform_suite (void)
+{
+  Suite *s = suite_create ("v4l2transform");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  converter = find_vim2m_converter ();
+  if (converter == NULL) {
+    GST_INFO ("no vim2m converter found, skipping tests");
+    return s;
+  }
+
+  tcase_add_test (tc_chain, test_convert);
+  tcase_add_test (tc_chain, test_convert_pipelined);
+  tcase_add_test (tc_chain, test_convert_flush);
+
+  return s;
+}
+
+GST_CHECK_MAIN (v4l2transform);
@@ -26,6 +26,8 @@
 #include <unistd.h>
 
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
 
 typedef struct _GstVideoBoxTestContext
 {
@@ -208,6 +210,92 @@ GST_START_TEST (test_caps_transform)
 
 GST_END_TEST;
 
+static GstHarness *
+videobox_crop_harness_new (gboolean crop_meta)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_parse ("videobox left=8 right=8 top=4 bottom=6");
+  if (crop_meta) {
+    gst_harness_add_propose_allocation_meta (h, GST_VIDEO_META_API_TYPE,
+        NULL);
+    gst_harness_add_propose_allocation_meta (h, GST_VIDEO_CROP_META_API_TYPE,
+        NULL);
+  }
+  gst_harness_set_sink_caps_str (h, "video/x-raw,format=I420");
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=I420,"
+      "width=64,height=48,framerate=25/1");
+
+  return h;
+}
+
+GST_START_TEST (test_crop_meta)
+{
+  GstHarness *h;
+  GstBuffer *inbuf, *outbuf;
+  GstVideoCropMeta *crop_meta;
+  GstVideoMeta *video_meta;
+  GstVideoInfo info;
+
+  h = videobox_crop_harness_new (TRUE);
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, 64, 48);
+  inbuf = gst_harness_create_buffer (h, GST_VIDEO_INFO_SIZE (&info));
+  gst_buffer_memset (inbuf, 0, 0x80, GST_VIDEO_INFO_SIZE (&info));
+
+  outbuf = gst_harness_push_and_pull (h, gst_buffer_ref (inbuf));
+  fail_unless (outbuf != NULL);
+
+  /* no copy was made, only the metadata was added */
+  fail_unless (gst_buffer_peek_memory (outbuf, 0) ==
+      gst_buffer_peek_memory (inbuf, 0));
+
+  crop_meta = gst_buffer_get_video_crop_meta (outbuf);
+  fail_unless (crop_meta != NULL);
+  fail_unless_equals_int (crop_meta->x, 8);
+  fail_unless_equals_int (crop_meta->y, 4);
+  fail_unless_equals_int (crop_meta->width, 48);
+  fail_unless_equals_int (crop_meta->height, 38);
+
+  video_meta = gst_buffer_get_video_meta (outbuf);
+  fail_unless (video_meta != NULL);
+  fail_unless_equals_int (video_meta->width, 64);
+  fail_unless_equals_int (video_meta->height, 48);
+
+  gst_buffer_unref (outbuf);
+  gst_buffer_unref (inbuf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_crop_no_meta)
+{
+  GstHarness *h;
+  GstBuffer *inbuf, *outbuf;
+  GstVideoInfo info;
+
+  h = videobox_crop_harness_new (FALSE);
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, 64, 48);
+  inbuf = gst_harness_create_buffer (h, GST_VIDEO_INFO_SIZE (&info));
+  gst_buffer_memset (inbuf, 0, 0x80, GST_VIDEO_INFO_SIZE (&info));
+
+  outbuf = gst_harness_push_and_pull (h, gst_buffer_ref (inbuf));
+  fail_unless (outbuf != NULL);
+
+  /* without downstream support the picture is copied */
+  fail_unless (gst_buffer_get_video_crop_meta (outbuf) == NULL);
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, 48, 38);
+  fail_unless_equals_int (gst_buffer_get_size (outbuf),
+      GST_VIDEO_INFO_SIZE (&info));
+
+  gst_buffer_unref (outbuf);
+  gst_buffer_unref (inbuf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
 
 static Suite *
 videobox_suite (void)
@@ -217,6 +305,8 @@ videobox_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_caps_transform);
+  tcase_add_test (tc_chain, test_crop_meta);
+  tcase_add_test (tc_chain, test_crop_no_meta);
 
   return s;
 }
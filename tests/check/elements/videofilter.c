@@ -22,9 +22,12 @@
 
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <gst/video/video.h>
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 
 gboolean have_eos = FALSE;
 
@@ -240,6 +243,283 @@ GST_START_TEST (test_videoflip)
 
 GST_END_TEST;
 
+static void
+videoflip_map_coords (GstVideoOrientationMethod method, gint dx, gint dy,
+    gint sw, gint sh, gint * sx, gint * sy)
+{
+  switch (method) {
+    case GST_VIDEO_ORIENTATION_90R:
+      *sx = dy;
+      *sy = sh - 1 - dx;
+      break;
+    case GST_VIDEO_ORIENTATION_180:
+      *sx = sw - 1 - dx;
+      *sy = sh - 1 - dy;
+      break;
+    case GST_VIDEO_ORIENTATION_90L:
+      *sx = sw - 1 - dy;
+      *sy = dx;
+      break;
+    case GST_VIDEO_ORIENTATION_HORIZ:
+      *sx = sw - 1 - dx;
+      *sy = dy;
+      break;
+    case GST_VIDEO_ORIENTATION_VERT:
+      *sx = dx;
+      *sy = sh - 1 - dy;
+      break;
+    case GST_VIDEO_ORIENTATION_UL_LR:
+      *sx = dy;
+      *sy = dx;
+      break;
+    case GST_VIDEO_ORIENTATION_UR_LL:
+      *sx = sw - 1 - dy;
+      *sy = sh - 1 - dx;
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+}
+
+static void
+check_videoflip_output (GstVideoOrientationMethod method, GstVideoInfo * in_info,
+    GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  GstVideoFrame in_frame, out_frame;
+  GstVideoInfo out_info;
+  gint comp, dx, dy, sx, sy, pstride, size;
+  const guint8 *s;
+  guint8 *d;
+
+  out_info = *in_info;
+  if (method == GST_VIDEO_ORIENTATION_90R || method == GST_VIDEO_ORIENTATION_90L
+      || method == GST_VIDEO_ORIENTATION_UL_LR
+      || method == GST_VIDEO_ORIENTATION_UR_LL) {
+    gst_video_info_set_format (&out_info, GST_VIDEO_INFO_FORMAT (in_info),
+        GST_VIDEO_INFO_HEIGHT (in_info), GST_VIDEO_INFO_WIDTH (in_info));
+  }
+  fail_unless (gst_video_frame_map (&in_frame, in_info, inbuf, GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&out_frame, &out_info, outbuf,
+          GST_MAP_READ));
+
+  for (comp = 0; comp < GST_VIDEO_FRAME_N_COMPONENTS (&in_frame); comp++) {
+    pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (&in_frame, comp);
+    size = (GST_VIDEO_FRAME_COMP_DEPTH (&in_frame, comp) + 7) / 8;
+    for (dy = 0; dy < GST_VIDEO_FRAME_COMP_HEIGHT (&out_frame, comp); dy++) {
+      for (dx = 0; dx < GST_VIDEO_FRAME_COMP_WIDTH (&out_frame, comp); dx++) {
+        videoflip_map_coords (method, dx, dy,
+            GST_VIDEO_FRAME_COMP_WIDTH (&in_frame, comp),
+            GST_VIDEO_FRAME_COMP_HEIGHT (&in_frame, comp), &sx, &sy);
+        s = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA (&in_frame, comp) +
+            sy * GST_VIDEO_FRAME_COMP_STRIDE (&in_frame, comp) + sx * pstride;
+        d = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (&out_frame, comp) +
+            dy * GST_VIDEO_FRAME_COMP_STRIDE (&out_frame, comp) + dx * pstride;
+        fail_unless (memcmp (s, d, size) == 0,
+            "component %d differs at %d,%d", comp, dx, dy);
+      }
+    }
+  }
+
+  gst_video_frame_unmap (&out_frame);
+  gst_video_frame_unmap (&in_frame);
+}
+
+GST_START_TEST (test_videoflip_output)
+{
+  static const GstVideoFormat formats[] = {
+    GST_VIDEO_FORMAT_I420, GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_xRGB,
+    GST_VIDEO_FORMAT_RGB, GST_VIDEO_FORMAT_GRAY16_LE
+  };
+  GstVideoOrientationMethod method;
+  GstHarness *h;
+  GstBuffer *inbuf, *outbuf;
+  GstVideoInfo info;
+  GstMapInfo map;
+  guint f, n_threads;
+  gsize i;
+  gchar *launch;
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    /* odd sizes larger than a tile to exercise the edges */
+    gst_video_info_set_format (&info, formats[f], 77, 45);
+    inbuf = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&info));
+    gst_buffer_map (inbuf, &map, GST_MAP_WRITE);
+    for (i = 0; i < map.size; i++)
+      map.data[i] = (i * 7 + i / 13) & 0xff;
+    gst_buffer_unmap (inbuf, &map);
+
+    for (method = GST_VIDEO_ORIENTATION_90R;
+        method <= GST_VIDEO_ORIENTATION_UR_LL; method++) {
+      for (n_threads = 1; n_threads <= 3; n_threads += 2) {
+        launch = g_strdup_printf ("videoflip video-direction=%d n-threads=%u",
+            method, n_threads);
+        h = gst_harness_new_parse (launch);
+        g_free (launch);
+        gst_harness_set_src_caps (h, gst_video_info_to_caps (&info));
+
+        outbuf = gst_harness_push_and_pull (h, gst_buffer_ref (inbuf));
+        fail_unless (outbuf != NULL);
+        check_videoflip_output (method, &info, inbuf, outbuf);
+        gst_buffer_unref (outbuf);
+
+        gst_harness_teardown (h);
+      }
+    }
+
+    gst_buffer_unref (inbuf);
+  }
+}
+
+GST_END_TEST;
+
+static gint
+compare_guint8 (gconstpointer a, gconstpointer b)
+{
+  return *(const guint8 *) a - *(const guint8 *) b;
+}
+
+GST_START_TEST (test_videomedian_box)
+{
+  static const gint sizes[] = { 9, 25, 49 };
+  GstVideoFrame in_frame, out_frame;
+  GstBuffer *inbuf, *outbuf;
+  GstVideoInfo info;
+  GstMapInfo map;
+  GstHarness *h;
+  guint8 window[49];
+  gint i, x, y, dx, dy, n, radius, plane;
+  gchar *launch;
+  const guint8 *s;
+  guint8 expected;
+  GRand *rand;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, 67, 45);
+  inbuf = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&info));
+  gst_buffer_map (inbuf, &map, GST_MAP_WRITE);
+  /* the lower half has little contrast, so neighbouring medians mostly
+   * fall into the same coarse histogram bin */
+  rand = g_rand_new_with_seed (0x5eed);
+  for (i = 0; i < (gint) map.size; i++) {
+    if (i < (gint) map.size / 2)
+      map.data[i] = g_rand_int_range (rand, 0, 256);
+    else
+      map.data[i] = g_rand_int_range (rand, 120, 136);
+  }
+  g_rand_free (rand);
+  gst_buffer_unmap (inbuf, &map);
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    launch = g_strdup_printf ("videomedian filtersize=%d lum-only=false",
+        sizes[i]);
+    h = gst_harness_new_parse (launch);
+    g_free (launch);
+    gst_harness_set_src_caps (h, gst_video_info_to_caps (&info));
+
+    outbuf = gst_harness_push_and_pull (h, gst_buffer_ref (inbuf));
+    fail_unless (outbuf != NULL);
+
+    fail_unless (gst_video_frame_map (&in_frame, &info, inbuf, GST_MAP_READ));
+    fail_unless (gst_video_frame_map (&out_frame, &info, outbuf,
+            GST_MAP_READ));
+
+    radius = (sizes[i] == 9) ? 1 : (sizes[i] == 25) ? 2 : 3;
+    for (plane = 0; plane < 3; plane++) {
+      gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (&in_frame, plane);
+      gint width = GST_VIDEO_FRAME_COMP_WIDTH (&in_frame, plane);
+      gint height = GST_VIDEO_FRAME_COMP_HEIGHT (&in_frame, plane);
+
+      s = GST_VIDEO_FRAME_PLANE_DATA (&in_frame, plane);
+      for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+          if (x < radius || y < radius || x >= width - radius
+              || y >= height - radius) {
+            /* border pixels are copied */
+            expected = s[y * stride + x];
+          } else {
+            n = 0;
+            for (dy = -radius; dy <= radius; dy++)
+              for (dx = -radius; dx <= radius; dx++)
+                window[n++] = s[(y + dy) * stride + x + dx];
+            qsort (window, n, 1, compare_guint8);
+            expected = window[n / 2];
+          }
+          fail_unless_equals_int (((guint8 *)
+                  GST_VIDEO_FRAME_PLANE_DATA (&out_frame, plane))[y *
+                  GST_VIDEO_FRAME_PLANE_STRIDE (&out_frame, plane) + x],
+              expected);
+        }
+      }
+    }
+
+    gst_video_frame_unmap (&out_frame);
+    gst_video_frame_unmap (&in_frame);
+    gst_buffer_unref (outbuf);
+    gst_harness_teardown (h);
+  }
+
+  gst_buffer_unref (inbuf);
+}
+
+GST_END_TEST;
+
+static GstBuffer *
+run_harness_pipeline (const gchar * launch, GstVideoInfo * info,
+    GstBuffer * inbuf)
+{
+  GstHarness *h;
+  GstBuffer *outbuf;
+
+  h = gst_harness_new_parse (launch);
+  gst_harness_set_src_caps (h, gst_video_info_to_caps (info));
+  outbuf = gst_harness_push_and_pull (h, gst_buffer_ref (inbuf));
+  fail_unless (outbuf != NULL);
+  gst_harness_teardown (h);
+
+  return outbuf;
+}
+
+GST_START_TEST (test_videobalance_gamma)
+{
+  GstBuffer *inbuf, *chained, *fused;
+  GstVideoInfo info;
+  GstMapInfo map;
+  GRand *rand;
+  gint i;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, 64, 48);
+  inbuf = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&info));
+  gst_buffer_map (inbuf, &map, GST_MAP_WRITE);
+  rand = g_rand_new_with_seed (0x5eed);
+  for (i = 0; i < (gint) map.size; i++)
+    map.data[i] = g_rand_int_range (rand, 0, 256);
+  g_rand_free (rand);
+  gst_buffer_unmap (inbuf, &map);
+
+  /* gamma folded into videobalance gives the same result as chaining */
+  chained = run_harness_pipeline ("gamma gamma=1.7 ! "
+      "videobalance contrast=1.3 brightness=0.1 saturation=0.5", &info,
+      inbuf);
+  fused = run_harness_pipeline ("videobalance gamma=1.7 contrast=1.3 "
+      "brightness=0.1 saturation=0.5", &info, inbuf);
+  fail_unless (chained != inbuf);
+  fail_unless (fused != inbuf);
+  gst_buffer_map (fused, &map, GST_MAP_READ);
+  fail_unless (gst_buffer_memcmp (chained, 0, map.data, map.size) == 0);
+  gst_buffer_unmap (fused, &map);
+  gst_buffer_unref (chained);
+  gst_buffer_unref (fused);
+
+  /* settings that are too small to change any value are passed through */
+  fused = run_harness_pipeline ("videobalance brightness=0.001", &info, inbuf);
+  fail_unless (fused == inbuf);
+  gst_buffer_unref (fused);
+
+  gst_buffer_unref (inbuf);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_gamma)
 {
   check_filter ("gamma", 2, NULL);
@@ -258,6 +538,9 @@ videofilter_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_videobalance);
   tcase_add_test (tc_chain, test_videoflip);
+  tcase_add_test (tc_chain, test_videoflip_output);
+  tcase_add_test (tc_chain, test_videomedian_box);
+  tcase_add_test (tc_chain, test_videobalance_gamma);
   tcase_add_test (tc_chain, test_gamma);
 
   return s;
@@ -82,6 +82,74 @@ GST_START_TEST (test_simple_file_push)
 
 GST_END_TEST;
 
+static void
+collect_size_handoff (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    GArray * sizes)
+{
+  gsize size = gst_buffer_get_size (buf);
+
+  g_array_append_val (sizes, size);
+}
+
+static void
+do_test_buffer_duration (GstPadMode mode)
+{
+  GstElement *pipeline, *fakesink;
+  GstMessage *msg;
+  GArray *sizes;
+  gchar *desc;
+  guint i;
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" %s ! wavparse "
+      "buffer-duration=%" G_GUINT64_FORMAT " ! fakesink name=sink "
+      "signal-handoffs=true", SIMPLE_WAV_PATH,
+      mode == GST_PAD_MODE_PUSH ? "! queue" : "", 100 * GST_MSECOND);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  sizes = g_array_new (FALSE, FALSE, sizeof (gsize));
+  fakesink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (fakesink, "handoff", G_CALLBACK (collect_size_handoff),
+      sizes);
+  gst_object_unref (fakesink);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_string (GST_MESSAGE_TYPE_NAME (msg), "eos");
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* all buffers but the last one have the same size, made of whole pages */
+  fail_unless (sizes->len > 0);
+  for (i = 0; i + 1 < sizes->len; i++) {
+    fail_unless_equals_uint64 (g_array_index (sizes, gsize, i),
+        g_array_index (sizes, gsize, 0));
+    fail_unless_equals_uint64 (g_array_index (sizes, gsize, i) % 4096, 0);
+  }
+
+  g_array_unref (sizes);
+}
+
+GST_START_TEST (test_buffer_duration_pull)
+{
+  do_test_buffer_duration (GST_PAD_MODE_PULL);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffer_duration_push)
+{
+  do_test_buffer_duration (GST_PAD_MODE_PUSH);
+}
+
+GST_END_TEST;
+
 static void
 do_test_empty_file (gboolean can_activate_pull)
 {
@@ -144,6 +212,8 @@ wavparse_suite (void)
   tcase_add_test (tc_chain, test_empty_file_push);
   tcase_add_test (tc_chain, test_simple_file_pull);
   tcase_add_test (tc_chain, test_simple_file_push);
+  tcase_add_test (tc_chain, test_buffer_duration_pull);
+  tcase_add_test (tc_chain, test_buffer_duration_push);
   return s;
 }
 
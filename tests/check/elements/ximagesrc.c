@@ -0,0 +1,238 @@
+/* GStreamer
+ *
+ * unit tests for ximagesrc, run against the X server in $DISPLAY
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* These tests need an idle X server, e.g.
+ *
+ *   Xvfb :99 -screen 0 640x480x24 &
+ *   DISPLAY=:99 make elements/ximagesrc.check
+ *
+ * Without a display no test is run.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#include <X11/Xlib.h>
+
+#define NUM_BUFFERS 8
+
+typedef struct
+{
+  GPtrArray *checksums;
+  gint n_full_damage;
+
+  /* when set, the root window is drawn on after some of the frames */
+  Display *disp;
+  GC gc;
+} CaptureData;
+
+/* Fills a few rectangles in different tiles of the root window with a
+ * colour that changes with @n, so that several areas are damaged at the
+ * same time */
+static void
+draw_damage (CaptureData * data, guint n)
+{
+  Window root = DefaultRootWindow (data->disp);
+  gint width = DisplayWidth (data->disp, DefaultScreen (data->disp));
+  gint height = DisplayHeight (data->disp, DefaultScreen (data->disp));
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    XSetForeground (data->disp, data->gc,
+        (0x3f2f1f * (n + 1) + 0x102030 * i) & 0xffffff);
+    XFillRectangle (data->disp, root, data->gc,
+        (i % 2) * width / 2 + 10 * n, (i / 2) * height / 2 + 7 * n, 37, 23);
+  }
+  XSync (data->disp, False);
+}
+
+static void
+capture_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    CaptureData * data)
+{
+  GstVideoRegionOfInterestMeta *roi;
+  GstMapInfo map;
+
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  g_ptr_array_add (data->checksums,
+      g_compute_checksum_for_data (G_CHECKSUM_MD5, map.data, map.size));
+  gst_buffer_unmap (buffer, &map);
+
+  /* The first frame of the tile mode is entirely new */
+  roi = (GstVideoRegionOfInterestMeta *) gst_buffer_get_meta (buffer,
+      GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE);
+  if (roi && roi->x == 0 && roi->y == 0)
+    data->n_full_damage++;
+
+  /* leave a few frames at the end for the last damage to show up */
+  if (data->disp && data->checksums->len < NUM_BUFFERS - 3)
+    draw_damage (data, data->checksums->len);
+}
+
+static CaptureData *
+capture (gboolean use_damage, guint tile_size, gint n_buffers,
+    Display * disp)
+{
+  GstElement *pipeline, *sink;
+  CaptureData *data;
+  GstMessage *msg;
+  gchar *desc;
+
+  desc = g_strdup_printf ("ximagesrc show-pointer=false use-damage=%d "
+      "damage-tile-size=%u num-buffers=%d ! video/x-raw,framerate=25/1 ! "
+      "fakesink name=sink signal-handoffs=true", use_damage, tile_size,
+      n_buffers);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  data = g_new0 (CaptureData, 1);
+  data->checksums = g_ptr_array_new_with_free_func (g_free);
+  if (disp) {
+    data->disp = disp;
+    data->gc = XCreateGC (disp, DefaultRootWindow (disp), 0, NULL);
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (capture_handoff), data);
+  gst_object_unref (sink);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      10 * GST_SECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "timeout waiting for EOS");
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  fail_unless_equals_int (data->checksums->len, n_buffers);
+
+  if (data->disp)
+    XFreeGC (data->disp, data->gc);
+
+  return data;
+}
+
+static void
+capture_data_free (CaptureData * data)
+{
+  g_ptr_array_unref (data->checksums);
+  g_free (data);
+}
+
+/* On an idle screen, every frame rebuilt from the damage tiles matches a
+ * full grab, including the recycled output buffers */
+GST_START_TEST (test_damage_tiles)
+{
+  CaptureData *reference, *tiles;
+  guint i;
+
+  reference = capture (FALSE, 0, 1, NULL);
+
+  tiles = capture (TRUE, 64, NUM_BUFFERS, NULL);
+  for (i = 0; i < tiles->checksums->len; i++)
+    fail_unless_equals_string (g_ptr_array_index (tiles->checksums, i),
+        g_ptr_array_index (reference->checksums, 0));
+  fail_unless (tiles->n_full_damage <= 1);
+
+  capture_data_free (tiles);
+
+  /* tiles not dividing the frame size */
+  tiles = capture (TRUE, 50, NUM_BUFFERS, NULL);
+  for (i = 0; i < tiles->checksums->len; i++)
+    fail_unless_equals_string (g_ptr_array_index (tiles->checksums, i),
+        g_ptr_array_index (reference->checksums, 0));
+  capture_data_free (tiles);
+
+  capture_data_free (reference);
+}
+
+GST_END_TEST;
+
+/* Damage in several tiles per frame, the last frame must match a full
+ * grab of the final screen */
+GST_START_TEST (test_damage_tiles_drawn)
+{
+  CaptureData *reference, *tiles;
+  Display *disp;
+
+  disp = XOpenDisplay (NULL);
+  fail_unless (disp != NULL);
+
+  tiles = capture (TRUE, 64, NUM_BUFFERS, disp);
+  reference = capture (FALSE, 0, 1, NULL);
+
+  fail_unless_equals_string (g_ptr_array_index (tiles->checksums,
+          NUM_BUFFERS - 1), g_ptr_array_index (reference->checksums, 0));
+  /* the screen did change */
+  fail_if (g_str_equal (g_ptr_array_index (tiles->checksums, 0),
+          g_ptr_array_index (reference->checksums, 0)));
+
+  capture_data_free (tiles);
+  capture_data_free (reference);
+
+  /* restore the idle screen for the other tests */
+  XClearWindow (disp, DefaultRootWindow (disp));
+  XCloseDisplay (disp);
+}
+
+GST_END_TEST;
+
+static gboolean
+have_display (void)
+{
+  GstElement *src;
+  GstStateChangeReturn ret;
+
+  src = gst_element_factory_make ("ximagesrc", NULL);
+  if (src == NULL)
+    return FALSE;
+
+  ret = gst_element_set_state (src, GST_STATE_PAUSED);
+  gst_element_set_state (src, GST_STATE_NULL);
+  gst_object_unref (src);
+
+  return ret != GST_STATE_CHANGE_FAILURE;
+}
+
+static Suite *
+ximagesrc_suite (void)
+{
+  Suite *s = suite_create ("ximagesrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  if (!have_display ()) {
+    GST_INFO ("no X display, skipping tests");
+    return s;
+  }
+
+  tcase_add_test (tc_chain, test_damage_tiles);
+  tcase_add_test (tc_chain, test_damage_tiles_drawn);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ximagesrc);
@@ -0,0 +1,166 @@
+/* GStreamer benchmark for the dvdec element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Decodes synthetic DV frames with one thread and with --n-threads threads,
+ * e.g.
+ *
+ *   dvdec-benchmark --frames 2000 --n-threads 4
+ *
+ * and reports the frame rate of both runs. The frames only have DC
+ * coefficients, so libdv spends less time per frame than on real footage
+ * and the numbers are an upper bound.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#include <stdlib.h>
+
+#include "../check/elements/dvframe.h"
+
+static gdouble
+run_one (GstBuffer * frame, gboolean pal, gint n_threads, gint n_frames)
+{
+  GstElement *pipeline, *src;
+  GstMessage *msg;
+  GstCaps *caps;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start, end;
+  gint fps_n = pal ? 25 : 30000, fps_d = pal ? 1 : 1001;
+  gint i;
+
+  desc = g_strdup_printf ("appsrc name=src format=time block=true ! "
+      "dvdec n-threads=%d ! fakesink sync=false", n_threads);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+
+  if (pipeline == NULL) {
+    g_printerr ("Failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1.0;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  caps = gst_caps_new_simple ("video/x-dv",
+      "systemstream", G_TYPE_BOOLEAN, FALSE,
+      "framerate", GST_TYPE_FRACTION, fps_n, fps_d, NULL);
+  gst_app_src_set_caps (GST_APP_SRC (src), caps);
+  gst_caps_unref (caps);
+
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < n_frames; i++) {
+    GstBuffer *buf;
+
+    /* all frames share the same memory */
+    buf = gst_buffer_copy (frame);
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND * fps_d,
+        fps_n);
+    GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (i + 1,
+        GST_SECOND * fps_d, fps_n) - GST_BUFFER_PTS (buf);
+    if (gst_app_src_push_buffer (GST_APP_SRC (src), buf) != GST_FLOW_OK)
+      break;
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  end = g_get_monotonic_time ();
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("Error: %s\n", err->message);
+    g_clear_error (&err);
+    start = end + 1;
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  if (end < start)
+    return -1.0;
+
+  return n_frames * 1000000.0 / MAX (end - start, 1);
+}
+
+int
+main (int argc, char **argv)
+{
+  static gint n_frames = 1000;
+  static gint n_threads = 0;
+  static gboolean ntsc = FALSE;
+  static const GOptionEntry entries[] = {
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &n_frames,
+        "Number of frames per run", NULL},
+    {"n-threads", 't', 0, G_OPTION_ARG_INT, &n_threads,
+        "Value of the dvdec n-threads property for the second run "
+          "(0 = number of CPUs)", NULL},
+    {"ntsc", 0, 0, G_OPTION_ARG_NONE, &ntsc, "Decode NTSC instead of PAL",
+        NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GstBuffer *frame;
+  GRand *rand;
+  gdouble single, parallel;
+
+  ctx = g_option_context_new ("");
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_print ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free (ctx);
+
+  if (n_frames <= 0)
+    n_frames = 1;
+  if (n_threads < 0)
+    n_threads = 0;
+
+  rand = g_rand_new_with_seed (0xd1f);
+  frame = make_frame (!ntsc, SMP_48000, ntsc ? 22 : 24, rand);
+  g_rand_free (rand);
+
+  g_print ("%d %s frames, frames per second\n\n", n_frames,
+      ntsc ? "NTSC" : "PAL");
+
+  single = run_one (frame, !ntsc, 1, n_frames);
+  parallel = run_one (frame, !ntsc, n_threads, n_frames);
+  gst_buffer_unref (frame);
+
+  if (single < 0 || parallel < 0)
+    return EXIT_FAILURE;
+
+  g_print ("n-threads=1:  %8.1f\n", single);
+  g_print ("n-threads=%d: %8.1f (%.2fx)\n", n_threads, parallel,
+      parallel / single);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+/* GStreamer benchmark for the qtmux sample tables
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Muxes a synthetic long recording with a video and an audio track, e.g.
+ *
+ *   qtmux-benchmark --hours 24
+ *
+ * and reports the peak memory use of the process and the time qtmux needs
+ * to write the headers at EOS. The samples are tiny, so nearly all of the
+ * memory goes into the sample tables. The video samples all have different
+ * sizes, the audio samples all have the same size like CBR mp3.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <glib/gstdio.h>
+
+#include <stdlib.h>
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#define VIDEO_FPS 30
+#define VIDEO_KEYFRAME_INTERVAL 60
+#define AUDIO_FRAME_DURATION (GST_SECOND * 1152 / 48000)
+#define AUDIO_FRAME_SIZE 96
+
+static glong
+get_peak_rss_kb (void)
+{
+#ifdef G_OS_UNIX
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return -1;
+}
+
+static GstBuffer *
+make_buffer (GstBuffer * data, gsize size, GstClockTime pts,
+    GstClockTime duration, gboolean delta)
+{
+  GstBuffer *buf;
+
+  buf = gst_buffer_copy_region (data, GST_BUFFER_COPY_MEMORY, 0, size);
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = duration;
+  if (delta)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buf;
+}
+
+int
+main (int argc, char **argv)
+{
+  static gdouble hours = 24.0;
+  static gchar *location = NULL;
+  static const GOptionEntry entries[] = {
+    {"hours", 0, 0, G_OPTION_ARG_DOUBLE, &hours,
+        "Duration of the recording in hours", NULL},
+    {"location", 'o', 0, G_OPTION_ARG_FILENAME, &location,
+        "Output file (default: a temporary file that is removed again)",
+        NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GstElement *pipeline, *vsrc, *asrc;
+  GstBuffer *data;
+  GstMessage *msg;
+  GstCaps *caps;
+  GstClockTime duration, vpts = 0, apts = 0;
+  guint64 n_video = 0, n_audio = 0;
+  gint64 start, eos, end;
+  gboolean remove_file = FALSE;
+  GStatBuf st;
+  gchar *desc;
+
+  ctx = g_option_context_new ("");
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_print ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free (ctx);
+
+  if (location == NULL) {
+    gint fd = g_file_open_tmp ("qtmux-benchmark-XXXXXX.mov", &location, &err);
+
+    if (fd < 0) {
+      g_printerr ("Failed to create temporary file: %s\n", err->message);
+      g_clear_error (&err);
+      return EXIT_FAILURE;
+    }
+    g_close (fd, NULL);
+    remove_file = TRUE;
+  }
+
+  desc = g_strdup_printf ("appsrc name=vsrc format=time block=true ! "
+      "qtmux name=mux ! filesink location=\"%s\" "
+      "appsrc name=asrc format=time block=true ! mux.", location);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("Failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return EXIT_FAILURE;
+  }
+
+  vsrc = gst_bin_get_by_name (GST_BIN (pipeline), "vsrc");
+  caps = gst_caps_from_string ("image/jpeg, width=(int)640, "
+      "height=(int)480, framerate=(fraction)30/1");
+  gst_app_src_set_caps (GST_APP_SRC (vsrc), caps);
+  gst_caps_unref (caps);
+
+  asrc = gst_bin_get_by_name (GST_BIN (pipeline), "asrc");
+  caps = gst_caps_from_string ("audio/mpeg, mpegversion=(int)1, "
+      "layer=(int)3, rate=(int)48000, channels=(int)2");
+  gst_app_src_set_caps (GST_APP_SRC (asrc), caps);
+  gst_caps_unref (caps);
+
+  /* all samples share the same memory */
+  data = gst_buffer_new_allocate (NULL, 256, NULL);
+  gst_buffer_memset (data, 0, 0, 256);
+
+  duration = hours * 3600 * GST_SECOND;
+
+  g_print ("Muxing %.2f hours to %s\n", hours, location);
+
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  while (vpts < duration || apts < duration) {
+    GstFlowReturn ret;
+
+    if (vpts <= apts && vpts < duration) {
+      GstClockTime next = gst_util_uint64_scale (n_video + 1, GST_SECOND,
+          VIDEO_FPS);
+
+      ret = gst_app_src_push_buffer (GST_APP_SRC (vsrc),
+          make_buffer (data, 16 + (n_video * 37) % 128, vpts, next - vpts,
+              n_video % VIDEO_KEYFRAME_INTERVAL != 0));
+      n_video++;
+      vpts = next;
+    } else {
+      ret = gst_app_src_push_buffer (GST_APP_SRC (asrc),
+          make_buffer (data, AUDIO_FRAME_SIZE, apts, AUDIO_FRAME_DURATION,
+              FALSE));
+      n_audio++;
+      apts += AUDIO_FRAME_DURATION;
+    }
+
+    if (ret != GST_FLOW_OK)
+      break;
+  }
+
+  gst_app_src_end_of_stream (GST_APP_SRC (vsrc));
+  gst_app_src_end_of_stream (GST_APP_SRC (asrc));
+  eos = g_get_monotonic_time ();
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  end = g_get_monotonic_time ();
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("Error: %s\n", err->message);
+    g_clear_error (&err);
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (vsrc);
+  gst_object_unref (asrc);
+  gst_object_unref (pipeline);
+  gst_buffer_unref (data);
+
+  g_print ("%" G_GUINT64_FORMAT " video and %" G_GUINT64_FORMAT
+      " audio samples\n", n_video, n_audio);
+  g_print ("total time:    %.3f s\n", (end - start) / 1000000.0);
+  g_print ("finalize time: %.3f s\n", (end - eos) / 1000000.0);
+  g_print ("peak memory:   %ld kB\n", get_peak_rss_kb ());
+  if (g_stat (location, &st) == 0)
+    g_print ("file size:     %" G_GINT64_FORMAT " bytes\n",
+        (gint64) st.st_size);
+
+  if (remove_file)
+    g_unlink (location);
+  g_free (location);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+/* GStreamer benchmark for the videoflip element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Times videoflip for every method and a selection of formats with one
+ * thread and with --n-threads threads, e.g.
+ *
+ *   videoflip-benchmark --width 3840 --height 2160 --n-threads 4
+ *
+ * and prints the speedup of the second run. The "none" column runs
+ * videoflip in passthrough and gives the cost of the rest of the pipeline,
+ * which should be subtracted from the other columns.
+ *
+ * As a baseline for the tiled transposition, a clockwise rotation with one
+ * source pixel read per destination pixel in destination order is timed on
+ * a single 1 and 4 byte per pixel plane and compared with videoflip.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const gchar *formats[] = {
+  "I420", "NV12", "Y444", "GRAY8", "YUY2", "RGB", "BGRx", "AYUV", "GRAY16_LE"
+};
+
+static const gchar *methods[] = {
+  "none", "clockwise", "rotate-180", "counterclockwise", "horizontal-flip",
+  "vertical-flip", "upper-left-diagonal", "upper-right-diagonal"
+};
+
+static gdouble
+run_one (const gchar * format, const gchar * method, gint width, gint height,
+    guint n_threads, gint n_buffers)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start, end;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d pattern=smpte ! "
+      "video/x-raw,format=%s,width=%d,height=%d,framerate=0/1 ! "
+      "videoflip method=%s n-threads=%u ! fakesink sync=false",
+      n_buffers, format, width, height, method, n_threads);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+
+  if (pipeline == NULL) {
+    g_printerr ("Failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1.0;
+  }
+
+  /* preroll first so caps negotiation and allocation are not timed */
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  if (gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) ==
+      GST_STATE_CHANGE_FAILURE) {
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+    return -1.0;
+  }
+
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  end = g_get_monotonic_time ();
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("Error: %s\n", err->message);
+    g_clear_error (&err);
+    start = end + 1;
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  if (end < start)
+    return -1.0;
+
+  return (end - start) / 1000.0 / n_buffers;
+}
+
+/* Clockwise rotation the straightforward way: walking the destination
+ * lines reads every source pixel from a different line */
+static gdouble
+run_per_pixel (gint pixel_stride, gint width, gint height, gint n_buffers)
+{
+  guint8 *src, *dest, *d;
+  const guint8 *s;
+  gint64 start, end;
+  gint i, x, y;
+
+  src = g_malloc (width * height * pixel_stride);
+  dest = g_malloc (width * height * pixel_stride);
+  for (i = 0; i < width * height * pixel_stride; i++)
+    src[i] = i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_buffers; i++) {
+    /* the destination is height pixels wide and width lines high */
+    for (y = 0; y < width; y++) {
+      d = dest + y * height * pixel_stride;
+      for (x = 0; x < height; x++) {
+        s = src + ((height - 1 - x) * width + y) * pixel_stride;
+        if (pixel_stride == 4)
+          memcpy (d + x * 4, s, 4);
+        else
+          d[x] = s[0];
+      }
+    }
+  }
+  end = g_get_monotonic_time ();
+
+  g_free (src);
+  g_free (dest);
+
+  return (end - start) / 1000.0 / n_buffers;
+}
+
+static void
+print_table (gdouble * ms, gdouble * baseline)
+{
+  guint f, m;
+
+  g_print ("%-10s", "");
+  for (m = 0; m < G_N_ELEMENTS (methods); m++)
+    g_print (" %15.15s", methods[m]);
+  g_print ("\n");
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    g_print ("%-10s", formats[f]);
+    for (m = 0; m < G_N_ELEMENTS (methods); m++) {
+      gdouble v = ms[f * G_N_ELEMENTS (methods) + m];
+
+      if (v < 0)
+        g_print (" %15s", "n/a");
+      else if (baseline && baseline[f * G_N_ELEMENTS (methods) + m] > 0)
+        g_print (" %7.3f (%.2fx)", v,
+            baseline[f * G_N_ELEMENTS (methods) + m] / MAX (v, 0.001));
+      else
+        g_print (" %15.3f", v);
+    }
+    g_print ("\n");
+  }
+  g_print ("\n");
+}
+
+static gdouble
+find_result (gdouble * ms, const gchar * format, const gchar * method)
+{
+  guint f, m;
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++)
+    for (m = 0; m < G_N_ELEMENTS (methods); m++)
+      if (!strcmp (formats[f], format) && !strcmp (methods[m], method))
+        return ms[f * G_N_ELEMENTS (methods) + m];
+
+  return -1.0;
+}
+
+int
+main (int argc, char **argv)
+{
+  static gint width = 1920, height = 1080, n_buffers = 100;
+  static guint n_threads = 0;
+  static const GOptionEntry entries[] = {
+    {"width", 0, 0, G_OPTION_ARG_INT, &width, "Frame width", NULL},
+    {"height", 0, 0, G_OPTION_ARG_INT, &height, "Frame height", NULL},
+    {"buffers", 'n', 0, G_OPTION_ARG_INT, &n_buffers,
+        "Number of buffers per run", NULL},
+    {"n-threads", 't', 0, G_OPTION_ARG_INT, &n_threads,
+        "Value of the videoflip n-threads property for the second run "
+          "(0 = number of CPUs)", NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gdouble single[G_N_ELEMENTS (formats) * G_N_ELEMENTS (methods)];
+  gdouble parallel[G_N_ELEMENTS (formats) * G_N_ELEMENTS (methods)];
+  guint f, m, i;
+  static const gchar *per_pixel_formats[] = { "GRAY8", "BGRx" };
+  static const gint per_pixel_strides[] = { 1, 4 };
+
+  ctx = g_option_context_new ("");
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_print ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free (ctx);
+
+  if (n_buffers <= 0)
+    n_buffers = 1;
+
+  g_print ("%dx%d, %d buffers, ms per frame\n\n", width, height,
+      n_buffers);
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    for (m = 0; m < G_N_ELEMENTS (methods); m++) {
+      i = f * G_N_ELEMENTS (methods) + m;
+      single[i] = run_one (formats[f], methods[m], width, height, 1,
+          n_buffers);
+      parallel[i] = run_one (formats[f], methods[m], width, height,
+          n_threads, n_buffers);
+    }
+  }
+
+  g_print ("n-threads=1\n");
+  print_table (single, NULL);
+  g_print ("n-threads=%u, speedup over n-threads=1\n", n_threads);
+  print_table (parallel, single);
+
+  g_print ("clockwise, speedup of n-threads=1 over per-pixel rotation\n");
+  for (i = 0; i < G_N_ELEMENTS (per_pixel_formats); i++) {
+    const gchar *format = per_pixel_formats[i];
+    gdouble base = run_per_pixel (per_pixel_strides[i], width, height,
+        n_buffers);
+    gdouble ms = find_result (single, format, "clockwise") -
+        MAX (find_result (single, format, "none"), 0.0);
+
+    if (ms <= 0)
+      g_print ("%-10s per-pixel %8.3f, videoflip n/a\n", format, base);
+    else
+      g_print ("%-10s per-pixel %8.3f, videoflip %8.3f (%.2fx)\n", format,
+          base, ms, base / ms);
+  }
+
+  return EXIT_SUCCESS;
+}